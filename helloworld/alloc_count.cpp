@@ -0,0 +1,21 @@
+// 统计 operator new 的调用次数：只链接进 make bench 生成的 hello_bench，
+// ./hello_bench --bench arena 用它比较两种存储的分配次数。hello 本身不替换全局的 new/delete
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> heapAllocations{0};
+
+size_t heapAllocationCount() { return heapAllocations.load(std::memory_order_relaxed); }
+
+void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return ::operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
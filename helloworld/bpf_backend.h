@@ -0,0 +1,17 @@
+/* bpf_backend.h
+ * hooktrace run --backend bpf：用 eBPF 程序代替 LD_PRELOAD 采集 exec/exit/openat 事件，
+ * 写到会话目录下的 bpf.log，行格式与 hook 库的 <pid>.log 相同，汇总流程不变。
+ * 只在 make tools-bpf(定义 HOOKTRACE_BPF)时编译进启动器。
+ */
+
+#ifndef BPF_BACKEND_H
+#define BPF_BACKEND_H
+
+// cgroup_path 为 NULL 时追踪启动器的后代，否则追踪该 cgroup(v2)中的所有进程。
+// 在启动构建命令之前调用
+int bpf_backend_start(const char *session_dir, const char *cgroup_path);
+
+// 取完 ring buffer 中剩余的事件，输出统计并卸载程序
+void bpf_backend_stop(void);
+
+#endif
@@ -0,0 +1,53 @@
+#!/bin/bash
+# bpf_bench.sh - 比较 LD_PRELOAD 和 eBPF 两种采集方式的开销
+# 用法: ./bpf_bench.sh [轮数] [-- 命令...]
+# 默认命令是 500 次 fork+exec 的 shell 循环；bpf 一项需要 make tools-bpf 并以 root 运行
+
+ROUNDS=${1:-5}
+shift
+[ "$1" = "--" ] && shift
+if [ $# -eq 0 ]; then
+    set -- sh -c 'i=0; while [ $i -lt 500 ]; do /bin/true; i=$((i+1)); done'
+fi
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+OUT=$(mktemp -d /tmp/bpf_bench.XXXXXX)
+trap 'rm -rf "$OUT"' EXIT
+
+# 运行若干轮，输出平均墙钟时间(ms)
+measure() {
+    local total=0
+    for ((r = 0; r < ROUNDS; r++)); do
+        local t0=$(date +%s%N)
+        "$@" >/dev/null 2>&1
+        local t1=$(date +%s%N)
+        total=$((total + (t1 - t0) / 1000))
+    done
+    echo $((total / ROUNDS / 1000))
+}
+
+# 最后一个会话的执行记录数
+records() {
+    local session=$(ls -td "$OUT/$1"/*/ 2>/dev/null | head -1)
+    [ -n "$session" ] && wc -l < "$session/records.jsonl" || echo "-"
+}
+
+echo "命令: $*"
+echo "轮数: $ROUNDS"
+echo ""
+
+base=$(measure "$@")
+printf "%-10s %10s %10s %10s\n" "方式" "平均(ms)" "开销" "执行记录"
+printf "%-10s %10d %10s %10s\n" "无追踪" "$base" "-" "-"
+
+preload=$(measure "$DIR/hooktrace" run --out "$OUT/preload" --orphan-wait 0 -- "$@")
+printf "%-10s %10d %9d%% %10s\n" "preload" "$preload" $(((preload - base) * 100 / (base > 0 ? base : 1))) "$(records preload)"
+
+if [ "$(id -u)" -ne 0 ]; then
+    echo "bpf: 需要 root，跳过"
+elif ! "$DIR/hooktrace" run --backend bpf --out "$OUT/probe" --orphan-wait 0 -- true >/dev/null 2>&1; then
+    echo "bpf: hooktrace 没有 eBPF 后端或加载失败(make tools-bpf)，跳过"
+else
+    bpf=$(measure "$DIR/hooktrace" run --backend bpf --out "$OUT/bpf" --orphan-wait 0 -- "$@")
+    printf "%-10s %10d %9d%% %10s\n" "bpf" "$bpf" $(((bpf - base) * 100 / (base > 0 ? base : 1))) "$(records bpf)"
+fi
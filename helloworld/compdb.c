@@ -0,0 +1,695 @@
+/* compdb.c
+ * hooktrace run --compdb DIR 和 hooktrace compdb：增量维护的编译数据库(格式见 compdb.h)。
+ *
+ * 索引文件是一个头加两张同样大小的开放寻址表：
+ *   slots  按 (输出, 源文件) 的哈希，指向该键在 compdb.dat 中最新的一行；
+ *   srcs   按源文件的哈希，指向该源文件的第一个 slot，同一源文件的各 slot 用 next 串起来。
+ * 合并一次构建时每个编译调用只查一次表：内容哈希没变就跳过，变了就在 compdb.dat 末尾
+ * 追加一行并改写 slot。索引和数据都不整体读写，只碰到用到的页，代价与本次编译的
+ * 翻译单元数成正比。负载超过 70% 时表扩大一倍(从旧表重新插入，均摊 O(1))；
+ * compdb.dat 里被覆盖的旧行超过有效数据且大于 1MB 时压缩一次。
+ *
+ * 路径按 cwd 拼成绝对路径并在字面上去掉 . 和 ..(不解析符号链接)，同一文件从不同目录
+ * 编译也是同一个键。没有 -o 时输出按 -c/-S 推出源文件对应的 .o/.s，否则是 a.out。
+ * 删除了的源文件不会自动移出数据库。
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "compdb.h"
+#include "trace_record.h"
+#include "trace_sink.h"
+
+#define COMPDB_MAGIC 0x44435448u       // "HTCD"
+#define COMPDB_VERSION 1
+#define COMPDB_MIN_SLOTS 4096          // 2 的幂
+#define COMPDB_MAX_LOAD 70             // 负载上限(%)
+#define COMPDB_COMPACT_SLACK (1u << 20)
+
+struct compdb_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t nslots;                   // 两张表的大小，2 的幂
+    uint64_t count;                    // 条目数
+    uint64_t sources;                  // 不同的源文件数
+    uint64_t data_end;                 // compdb.dat 中有效数据的长度，之后的内容会被覆盖
+    uint64_t live_bytes;               // 各条目最新一行的总长度
+    uint64_t dat_ino;                  // 建索引时 compdb.dat 的 inode
+    uint64_t builds;                   // 合并过的构建次数
+};
+
+struct compdb_slot {
+    uint64_t key;                      // (输出, 源文件) 的哈希，0 表示空
+    uint64_t src;                      // 源文件的哈希
+    uint64_t entry;                    // 整行内容的哈希
+    uint64_t offset;                   // 行在 compdb.dat 中的位置，含结尾的 '\n'
+    uint32_t length;
+    uint32_t next;                     // 同一源文件的下一个 slot 下标 + 1，0 结束
+};
+
+struct compdb_src {
+    uint64_t src;                      // 0 表示空
+    uint32_t head;                     // 第一个 slot 下标 + 1
+    uint32_t count;
+};
+
+struct compdb {
+    char dir[PATH_MAX];
+    int lock_fd;                       // compdb.lock 上的 flock；索引会被整体替换，不能锁它本身
+    int dat_fd;
+    int idx_fd;
+    struct compdb_header *hdr;
+    struct compdb_slot *slots;
+    struct compdb_src *srcs;
+    size_t map_size;
+};
+
+static uint64_t fnv(const void *p, size_t len, uint64_t h) {
+    const unsigned char *s = p;
+    for (size_t i = 0; i < len; i++) {
+        h ^= s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+#define FNV_BASIS 1469598103934665603ull
+
+static uint64_t nonzero(uint64_t h) {
+    return h ? h : 1;
+}
+
+static uint64_t entry_key(const char *output, const char *file) {
+    return nonzero(fnv(file, strlen(file) + 1, fnv(output, strlen(output) + 1, FNV_BASIS)));
+}
+
+static uint64_t source_key(const char *file) {
+    return nonzero(fnv(file, strlen(file), FNV_BASIS));
+}
+
+static size_t index_size(uint64_t nslots) {
+    return sizeof(struct compdb_header) + nslots * (sizeof(struct compdb_slot) + sizeof(struct compdb_src));
+}
+
+// 拼上 cwd 并在字面上去掉 "."、".." 和重复的 '/'
+static void norm_path(const char *path, const char *cwd, char *out, size_t cap) {
+    char buf[PATH_MAX * 2];
+    if (path[0] == '/' || !cwd || !cwd[0]) snprintf(buf, sizeof(buf), "%s", path);
+    else snprintf(buf, sizeof(buf), "%s/%s", cwd, path);
+
+    size_t n = 0;
+    char *save = NULL;
+    for (char *part = strtok_r(buf, "/", &save); part; part = strtok_r(NULL, "/", &save)) {
+        if (strcmp(part, ".") == 0) continue;
+        if (strcmp(part, "..") == 0) {
+            while (n > 0 && out[--n] != '/') {}
+            continue;
+        }
+        int w = snprintf(out + n, cap - n, "/%s", part);
+        n = (size_t)w < cap - n ? n + (size_t)w : cap - 1;
+    }
+    if (n == 0) out[n++] = '/';
+    out[n] = '\0';
+}
+
+static int has_arg(const struct exec_record *rec, const char *what) {
+    for (int a = 1; a < rec->argc; a++) {
+        if (strcmp(rec->argv[a], what) == 0) return 1;
+    }
+    return 0;
+}
+
+// 源文件 argv[src] 的产物：-o 的值，没有 -o 时按 -c/-S 推出 .o/.s，否则是 a.out
+static void output_path(const struct exec_record *rec, int src, char *out, size_t cap) {
+    char name[PATH_MAX];
+    const char *o = exec_output_arg(rec);
+    const char *ext = has_arg(rec, "-c") ? ".o" : has_arg(rec, "-S") ? ".s" : NULL;
+    if (o) {
+        snprintf(name, sizeof(name), "%s", o);
+    } else if (ext) {
+        const char *base = strrchr(rec->argv[src], '/');
+        snprintf(name, sizeof(name), "%s", base ? base + 1 : rec->argv[src]);
+        char *dot = strrchr(name, '.');
+        if (dot) *dot = '\0';
+        strncat(name, ext, sizeof(name) - strlen(name) - 1);
+    } else {
+        snprintf(name, sizeof(name), "a.out");
+    }
+    norm_path(name, rec->cwd, out, cap);
+}
+
+// 一项的 JSON 行(含 '\n')，用 free 释放
+static char *format_entry(const struct exec_record *rec, const char *file, const char *output,
+                          size_t *len) {
+    char *buf = NULL;
+    FILE *out = open_memstream(&buf, len);
+    if (!out) return NULL;
+    fputs("{\"directory\":", out);
+    json_write_str(out, rec->cwd ? rec->cwd : "");
+    fputs(",\"arguments\":[", out);
+    for (int i = 0; i < rec->argc; i++) {
+        if (i) fputc(',', out);
+        json_write_str(out, rec->argv[i]);
+    }
+    fputs("],\"file\":", out);
+    json_write_str(out, file);
+    fputs(",\"output\":", out);
+    json_write_str(out, output);
+    fputs("}\n", out);
+    if (fclose(out) != 0) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+// ===== 索引 =====
+
+static void set_map(struct compdb *db, void *map, size_t size) {
+    db->hdr = map;
+    db->slots = (struct compdb_slot *)(db->hdr + 1);
+    db->srcs = (struct compdb_src *)(db->slots + db->hdr->nslots);
+    db->map_size = size;
+}
+
+// key 所在的 slot，或者它应该插入的空 slot
+static uint64_t find_slot(const struct compdb_slot *slots, uint64_t nslots, uint64_t key) {
+    uint64_t i = key & (nslots - 1);
+    while (slots[i].key && slots[i].key != key) i = (i + 1) & (nslots - 1);
+    return i;
+}
+
+static uint64_t find_src(const struct compdb_src *srcs, uint64_t nslots, uint64_t src) {
+    uint64_t i = src & (nslots - 1);
+    while (srcs[i].src && srcs[i].src != src) i = (i + 1) & (nslots - 1);
+    return i;
+}
+
+// 在空 slot i 放入新条目并挂到源文件链表上
+static void link_slot(struct compdb_header *hdr, struct compdb_slot *slots, struct compdb_src *srcs,
+                      uint64_t i, uint64_t key, uint64_t src) {
+    slots[i].key = key;
+    slots[i].src = src;
+    uint64_t s = find_src(srcs, hdr->nslots, src);
+    if (!srcs[s].src) {
+        srcs[s].src = src;
+        hdr->sources++;
+    }
+    slots[i].next = srcs[s].head;
+    srcs[s].head = (uint32_t)(i + 1);
+    srcs[s].count++;
+    hdr->count++;
+}
+
+static uint64_t slots_for(uint64_t count) {
+    uint64_t n = COMPDB_MIN_SLOTS;
+    while (count * 100 >= n * COMPDB_MAX_LOAD) n *= 2;
+    return n;
+}
+
+// 创建并映射一个空索引的临时文件，之后由调用者填好再改名成 compdb.idx
+static int create_index(struct compdb *db, uint64_t nslots, const char *tmp, void **map, int *fd_out) {
+    size_t size = index_size(nslots);
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, (off_t)size) != 0 ||
+        (*map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    struct compdb_header *hdr = *map;
+    hdr->magic = COMPDB_MAGIC;
+    hdr->version = COMPDB_VERSION;
+    hdr->nslots = nslots;
+    struct stat st;
+    if (fstat(db->dat_fd, &st) == 0) hdr->dat_ino = (uint64_t)st.st_ino;
+    *fd_out = fd;
+    return 0;
+}
+
+static int install_index(struct compdb *db, const char *tmp, void *map, int fd) {
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/compdb.idx", db->dir);
+    if (rename(tmp, path) != 0) {
+        munmap(map, index_size(((struct compdb_header *)map)->nslots));
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    if (db->hdr) munmap(db->hdr, db->map_size);
+    if (db->idx_fd >= 0) close(db->idx_fd);
+    db->idx_fd = fd;
+    set_map(db, map, index_size(((struct compdb_header *)map)->nslots));
+    return 0;
+}
+
+// 表扩大一倍：按旧表的条目重新插入，不用读 compdb.dat
+static int grow_index(struct compdb *db) {
+    char tmp[PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s/compdb.idx.tmp", db->dir);
+    void *map;
+    int fd;
+    if (create_index(db, db->hdr->nslots * 2, tmp, &map, &fd) != 0) return -1;
+    struct compdb_header *hdr = map;
+    struct compdb_slot *slots = (struct compdb_slot *)(hdr + 1);
+    struct compdb_src *srcs = (struct compdb_src *)(slots + hdr->nslots);
+    hdr->data_end = db->hdr->data_end;
+    hdr->live_bytes = db->hdr->live_bytes;
+    hdr->dat_ino = db->hdr->dat_ino;
+    hdr->builds = db->hdr->builds;
+    for (uint64_t i = 0; i < db->hdr->nslots; i++) {
+        const struct compdb_slot *old = &db->slots[i];
+        if (!old->key) continue;
+        uint64_t j = find_slot(slots, hdr->nslots, old->key);
+        link_slot(hdr, slots, srcs, j, old->key, old->src);
+        slots[j].entry = old->entry;
+        slots[j].offset = old->offset;
+        slots[j].length = old->length;
+    }
+    return install_index(db, tmp, map, fd);
+}
+
+// 从头重放 compdb.dat 重建索引：同一个键后面的行覆盖前面的；结尾不完整的行截掉
+static int rebuild_index(struct compdb *db) {
+    struct stat st;
+    if (fstat(db->dat_fd, &st) != 0) return -1;
+    size_t size = (size_t)st.st_size;
+    const char *data = NULL;
+    if (size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, db->dat_fd, 0);
+        if (data == MAP_FAILED) return -1;
+    }
+    uint64_t lines = 0;
+    for (size_t p = 0; p < size; p++) lines += data[p] == '\n';
+
+    char tmp[PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s/compdb.idx.tmp", db->dir);
+    void *map;
+    int fd;
+    if (create_index(db, slots_for(lines), tmp, &map, &fd) != 0) {
+        if (data) munmap((void *)data, size);
+        return -1;
+    }
+    struct compdb_header *hdr = map;
+    struct compdb_slot *slots = (struct compdb_slot *)(hdr + 1);
+    struct compdb_src *srcs = (struct compdb_src *)(slots + hdr->nslots);
+
+    size_t p = 0;
+    while (p < size) {
+        const char *nl = memchr(data + p, '\n', size - p);
+        if (!nl) break;
+        size_t len = (size_t)(nl - (data + p)) + 1;
+        struct json_value *v = json_parse(data + p, len - 1);
+        const char *file = v ? json_get_str(v, "file") : NULL;
+        const char *output = v ? json_get_str(v, "output") : NULL;
+        if (file && output) {
+            uint64_t key = entry_key(output, file);
+            uint64_t i = find_slot(slots, hdr->nslots, key);
+            if (slots[i].key) hdr->live_bytes -= slots[i].length;
+            else link_slot(hdr, slots, srcs, i, key, source_key(file));
+            slots[i].entry = fnv(data + p, len, FNV_BASIS);
+            slots[i].offset = p;
+            slots[i].length = (uint32_t)len;
+            hdr->live_bytes += len;
+        }
+        json_free(v);
+        p += len;
+    }
+    hdr->data_end = p;
+    if (data) munmap((void *)data, size);
+    if (p < size && ftruncate(db->dat_fd, (off_t)p) != 0) {
+        // 截不掉也没关系，data_end 之后的内容下次追加时会被覆盖
+    }
+    return install_index(db, tmp, map, fd);
+}
+
+static int index_valid(const struct compdb *db, const void *map, size_t size) {
+    const struct compdb_header *hdr = map;
+    struct stat st;
+    if (size < sizeof(*hdr) || hdr->magic != COMPDB_MAGIC || hdr->version != COMPDB_VERSION) return 0;
+    if (hdr->nslots < COMPDB_MIN_SLOTS || (hdr->nslots & (hdr->nslots - 1)) ||
+        size != index_size(hdr->nslots)) {
+        return 0;
+    }
+    if (fstat(db->dat_fd, &st) != 0) return 0;
+    return hdr->dat_ino == (uint64_t)st.st_ino && hdr->data_end <= (uint64_t)st.st_size;
+}
+
+static int map_index(struct compdb *db) {
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/compdb.idx", db->dir);
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (!index_valid(db, map, (size_t)st.st_size)) {
+        munmap(map, (size_t)st.st_size);
+        close(fd);
+        return -1;
+    }
+    db->idx_fd = fd;
+    set_map(db, map, (size_t)st.st_size);
+    return 0;
+}
+
+static void compdb_close(struct compdb *db) {
+    if (db->hdr) munmap(db->hdr, db->map_size);
+    if (db->idx_fd >= 0) close(db->idx_fd);
+    if (db->dat_fd >= 0) close(db->dat_fd);
+    if (db->lock_fd >= 0) close(db->lock_fd);
+}
+
+// create 时目录和文件不存在就创建。持有排他锁或共享锁直到 compdb_close；
+// 索引无效时临时换成排他锁重建
+static int compdb_open(struct compdb *db, const char *dir, int exclusive, int create) {
+    memset(db, 0, sizeof(*db));
+    db->lock_fd = db->dat_fd = db->idx_fd = -1;
+    snprintf(db->dir, sizeof(db->dir), "%s", dir);
+    if (create && mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "hooktrace: 无法创建 %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/compdb.lock", dir);
+    db->lock_fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    snprintf(path, sizeof(path), "%s/compdb.dat", dir);
+    if (db->lock_fd < 0 || flock(db->lock_fd, exclusive ? LOCK_EX : LOCK_SH) != 0 ||
+        (db->dat_fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644)) < 0) {
+        fprintf(stderr, "hooktrace: 无法打开编译数据库 %s: %s\n", dir, strerror(errno));
+        compdb_close(db);
+        return -1;
+    }
+    if (map_index(db) == 0) return 0;
+
+    if (!exclusive) flock(db->lock_fd, LOCK_EX);
+    // 等锁期间可能已经有别人重建好了
+    if (map_index(db) != 0 && rebuild_index(db) != 0) {
+        fprintf(stderr, "hooktrace: 无法建立 %s 的索引: %s\n", dir, strerror(errno));
+        compdb_close(db);
+        return -1;
+    }
+    if (!exclusive) flock(db->lock_fd, LOCK_SH);
+    return 0;
+}
+
+// ===== 写入 =====
+
+static int append_line(struct compdb *db, const char *line, size_t len, uint64_t *offset) {
+    uint64_t at = db->hdr->data_end;
+    for (size_t done = 0; done < len;) {
+        ssize_t w = pwrite(db->dat_fd, line + done, len - done, (off_t)(at + done));
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        done += (size_t)w;
+    }
+    // 数据先写完再移动 data_end，中途崩溃只会在 data_end 之后留下下次被覆盖的内容
+    db->hdr->data_end = at + len;
+    *offset = at;
+    return 0;
+}
+
+static int upsert(struct compdb *db, const char *file, const char *output, const char *line,
+                  size_t len, struct compdb_stats *stats) {
+    uint64_t key = entry_key(output, file);
+    uint64_t entry = fnv(line, len, FNV_BASIS);
+    uint64_t i = find_slot(db->slots, db->hdr->nslots, key);
+    struct compdb_slot *slot = &db->slots[i];
+    if (slot->key && slot->entry == entry && slot->length == len) {
+        stats->unchanged++;
+        return 0;
+    }
+    if (!slot->key && (db->hdr->count + 1) * 100 >= db->hdr->nslots * COMPDB_MAX_LOAD) {
+        if (grow_index(db) != 0) return -1;
+        i = find_slot(db->slots, db->hdr->nslots, key);
+        slot = &db->slots[i];
+    }
+
+    uint64_t offset;
+    if (append_line(db, line, len, &offset) != 0) return -1;
+    if (slot->key) {
+        db->hdr->live_bytes -= slot->length;
+        stats->updated++;
+    } else {
+        link_slot(db->hdr, db->slots, db->srcs, i, key, source_key(file));
+        stats->inserted++;
+    }
+    slot->entry = entry;
+    slot->offset = offset;
+    slot->length = (uint32_t)len;
+    db->hdr->live_bytes += len;
+    return 0;
+}
+
+// 按位置排序的有效条目，导出和压缩时顺序读 compdb.dat
+static int offset_cmp(const void *a, const void *b) {
+    uint64_t x = (*(const struct compdb_slot *const *)a)->offset;
+    uint64_t y = (*(const struct compdb_slot *const *)b)->offset;
+    return x < y ? -1 : x > y;
+}
+
+static struct compdb_slot **sorted_slots(const struct compdb *db) {
+    struct compdb_slot **list = malloc((db->hdr->count + 1) * sizeof(*list));
+    if (!list) return NULL;
+    size_t n = 0;
+    for (uint64_t i = 0; i < db->hdr->nslots; i++) {
+        if (db->slots[i].key) list[n++] = &db->slots[i];
+    }
+    qsort(list, n, sizeof(*list), offset_cmp);
+    return list;
+}
+
+static const char *map_data(const struct compdb *db) {
+    if (db->hdr->data_end == 0) return NULL;
+    const char *data = mmap(NULL, db->hdr->data_end, PROT_READ, MAP_PRIVATE, db->dat_fd, 0);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+// 只保留各条目最新的一行。先写好新的 compdb.dat.tmp，再把索引的 inode 和位置改成新文件的，
+// 最后改名：任何一步中断，索引和数据文件的 inode 都对不上，下次打开时从数据文件重建
+static int compact(struct compdb *db) {
+    char tmp[PATH_MAX + 16], path[PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s/compdb.dat.tmp", db->dir);
+    snprintf(path, sizeof(path), "%s/compdb.dat", db->dir);
+    const char *data = map_data(db);
+    struct compdb_slot **list = data ? sorted_slots(db) : NULL;
+    FILE *out = list ? fopen(tmp, "w+e") : NULL;
+    if (!out) {
+        free(list);
+        if (data) munmap((void *)data, db->hdr->data_end);
+        return -1;
+    }
+    uint64_t *offsets = malloc((db->hdr->count + 1) * sizeof(*offsets));
+    uint64_t pos = 0;
+    for (uint64_t n = 0; offsets && n < db->hdr->count; n++) {
+        offsets[n] = pos;
+        fwrite(data + list[n]->offset, 1, list[n]->length, out);
+        pos += list[n]->length;
+    }
+    munmap((void *)data, db->hdr->data_end);
+    struct stat st;
+    int fd = -1;
+    if (fflush(out) != 0 || !offsets || fstat(fileno(out), &st) != 0 || (fd = dup(fileno(out))) < 0) {
+        fclose(out);
+        unlink(tmp);
+        free(offsets);
+        free(list);
+        return -1;
+    }
+    fclose(out);
+
+    db->hdr->dat_ino = (uint64_t)st.st_ino;
+    for (uint64_t n = 0; n < db->hdr->count; n++) list[n]->offset = offsets[n];
+    db->hdr->data_end = pos;
+    db->hdr->live_bytes = pos;
+    free(offsets);
+    free(list);
+    if (rename(tmp, path) != 0) {
+        close(fd);
+        return -1;            // 下次打开时重建
+    }
+    close(db->dat_fd);
+    db->dat_fd = fd;
+    return 0;
+}
+
+static int compdb_merge(struct compdb *db, const struct trace_set *set, struct compdb_stats *stats) {
+    char file[PATH_MAX * 2], output[PATH_MAX * 2];
+    for (size_t r = 0; r < set->count; r++) {
+        const struct exec_record *rec = &set->records[r];
+        if (!exec_is_compile(rec)) continue;
+        for (int a = exec_next_source(rec, 1); a > 0; a = exec_next_source(rec, a + 1)) {
+            norm_path(rec->argv[a], rec->cwd, file, sizeof(file));
+            output_path(rec, a, output, sizeof(output));
+            size_t len;
+            char *line = format_entry(rec, file, output, &len);
+            if (!line || upsert(db, file, output, line, len, stats) != 0) {
+                free(line);
+                return -1;
+            }
+            free(line);
+        }
+    }
+    db->hdr->builds++;
+    stats->total = db->hdr->count;
+    if (db->hdr->data_end > 2 * db->hdr->live_bytes + COMPDB_COMPACT_SLACK && compact(db) != 0) {
+        fprintf(stderr, "hooktrace: 压缩 %s/compdb.dat 失败，下次打开时重建索引\n", db->dir);
+    }
+    return 0;
+}
+
+int compdb_update(const char *dir, const struct trace_set *set, struct compdb_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    struct compdb db;
+    if (compdb_open(&db, dir, 1, 1) != 0) return -1;
+    int rc = compdb_merge(&db, set, stats);
+    compdb_close(&db);
+    return rc;
+}
+
+// ===== 查询和导出 =====
+
+static int compdb_export(struct compdb *db, const char *path) {
+    struct trace_sink *out = trace_sink_open(path, SINK_AUTO);
+    if (!out) {
+        fprintf(stderr, "hooktrace: 无法写入 %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+    const char *data = map_data(db);
+    struct compdb_slot **list = data ? sorted_slots(db) : NULL;
+    trace_sink_write(out, "[", 1);
+    for (uint64_t n = 0; list && n < db->hdr->count; n++) {
+        trace_sink_write(out, n ? ",\n" : "\n", n ? 2 : 1);
+        trace_sink_write(out, data + list[n]->offset, list[n]->length - 1);
+    }
+    trace_sink_write(out, db->hdr->count ? "\n]\n" : "]\n", db->hdr->count ? 3 : 2);
+    free(list);
+    if (data) munmap((void *)data, db->hdr->data_end);
+    if (trace_sink_close(out, NULL) != 0) {
+        fprintf(stderr, "hooktrace: 写入 %s 失败\n", path);
+        return 2;
+    }
+    fprintf(stderr, "hooktrace: 导出 %llu 项到 %s\n", (unsigned long long)db->hdr->count, path);
+    return 0;
+}
+
+// 打印源文件的所有条目(每行一项 JSON)，没有时返回 1
+static int compdb_query(struct compdb *db, const char *source) {
+    char cwd[PATH_MAX], file[PATH_MAX * 2];
+    norm_path(source, getcwd(cwd, sizeof(cwd)), file, sizeof(file));
+    uint64_t src = source_key(file);
+    const struct compdb_src *s = &db->srcs[find_src(db->srcs, db->hdr->nslots, src)];
+
+    int found = 0;
+    for (uint32_t i = s->src ? s->head : 0; i; i = db->slots[i - 1].next) {
+        const struct compdb_slot *slot = &db->slots[i - 1];
+        char *line = malloc(slot->length + 1);
+        if (!line) break;
+        // 哈希相同不代表路径相同，对一下 file 字段
+        if (pread(db->dat_fd, line, slot->length, (off_t)slot->offset) == (ssize_t)slot->length) {
+            struct json_value *v = json_parse(line, slot->length - 1);
+            const char *f = v ? json_get_str(v, "file") : NULL;
+            if (f && strcmp(f, file) == 0) {
+                fwrite(line, 1, slot->length, stdout);
+                found++;
+            }
+            json_free(v);
+        }
+        free(line);
+    }
+    if (!found) fprintf(stderr, "hooktrace: 编译数据库中没有 %s\n", file);
+    return found ? 0 : 1;
+}
+
+static void compdb_print_stats(const struct compdb *db) {
+    const struct compdb_header *h = db->hdr;
+    printf("条目       %llu (源文件 %llu)\n", (unsigned long long)h->count, (unsigned long long)h->sources);
+    printf("索引       %llu 槽, 负载 %.1f%%, %.1f MB\n", (unsigned long long)h->nslots,
+           100.0 * (double)h->count / (double)h->nslots, db->map_size / 1048576.0);
+    printf("数据       %.1f MB, 其中有效 %.1f MB\n", h->data_end / 1048576.0, h->live_bytes / 1048576.0);
+    printf("合并构建   %llu 次\n", (unsigned long long)h->builds);
+}
+
+static void compdb_usage(void) {
+    fprintf(stderr,
+            "用法: hooktrace compdb DIR add 会话目录|records.jsonl...\n"
+            "      hooktrace compdb DIR export [FILE]   导出 compile_commands.json(默认 DIR/compile_commands.json)\n"
+            "      hooktrace compdb DIR query 源文件...   打印源文件的编译命令，每行一项\n"
+            "      hooktrace compdb DIR stats\n"
+            "hooktrace run --compdb DIR 在构建结束时自动合并\n");
+}
+
+static int compdb_add(const char *dir, int argc, char **argv) {
+    for (int i = 0; i < argc; i++) {
+        char path[PATH_MAX + 16];
+        struct stat st;
+        if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) snprintf(path, sizeof(path), "%s/records.jsonl", argv[i]);
+        else snprintf(path, sizeof(path), "%s", argv[i]);
+        struct trace_set set;
+        if (trace_load_records(path, &set) != 0) {
+            fprintf(stderr, "hooktrace: 无法读取 %s\n", path);
+            return 2;
+        }
+        struct compdb_stats stats;
+        int rc = compdb_update(dir, &set, &stats);
+        trace_free(&set);
+        if (rc != 0) {
+            fprintf(stderr, "hooktrace: 无法更新编译数据库 %s\n", dir);
+            return 2;
+        }
+        printf("%s: 新增 %llu, 更新 %llu, 未变 %llu, 共 %llu 项\n", argv[i],
+               (unsigned long long)stats.inserted, (unsigned long long)stats.updated,
+               (unsigned long long)stats.unchanged, (unsigned long long)stats.total);
+    }
+    return 0;
+}
+
+int cmd_compdb(int argc, char **argv) {
+    if (argc < 2) {
+        compdb_usage();
+        return 2;
+    }
+    const char *dir = argv[0], *op = argv[1];
+    if (strcmp(op, "add") == 0 && argc > 2) return compdb_add(dir, argc - 2, argv + 2);
+
+    int rc;
+    struct compdb db;
+    if (strcmp(op, "export") == 0 && argc <= 3) {
+        char path[PATH_MAX + 32];
+        if (argc == 3) snprintf(path, sizeof(path), "%s", argv[2]);
+        else snprintf(path, sizeof(path), "%s/compile_commands.json", dir);
+        if (compdb_open(&db, dir, 0, 0) != 0) return 2;
+        rc = compdb_export(&db, path);
+    } else if (strcmp(op, "query") == 0 && argc > 2) {
+        if (compdb_open(&db, dir, 0, 0) != 0) return 2;
+        rc = 0;
+        for (int i = 2; i < argc; i++) rc |= compdb_query(&db, argv[i]);
+    } else if (strcmp(op, "stats") == 0 && argc == 2) {
+        if (compdb_open(&db, dir, 0, 0) != 0) return 2;
+        compdb_print_stats(&db);
+        rc = 0;
+    } else {
+        compdb_usage();
+        return 2;
+    }
+    compdb_close(&db);
+    return rc;
+}
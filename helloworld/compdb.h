@@ -0,0 +1,32 @@
+/* compdb.h
+ * 增量维护的编译数据库：跨多次构建保存在一个目录里，每次构建只把本次追踪到的编译调用
+ * 按 (输出文件, 源文件) 写入(upsert)，合并的代价与本次编译的翻译单元数成正比，与仓库大小无关。
+ *
+ *   compdb.dat  只追加的 JSON 行，每行是一项 compile_commands.json 条目；同一键的新内容追加在后面
+ *   compdb.idx  mmap 的开放寻址哈希索引：(输出, 源文件) -> 最新一行的位置，另有按源文件的表
+ *
+ * 索引记下 compdb.dat 的 inode，两者不匹配(例如压缩过程中崩溃)时按顺序重放 compdb.dat 重建索引。
+ * 写者持有 compdb.idx 的排他 flock，读者持有共享 flock。
+ */
+
+#ifndef COMPDB_H
+#define COMPDB_H
+
+#include <stdint.h>
+
+#include "trace_record.h"
+
+struct compdb_stats {
+    uint64_t inserted;
+    uint64_t updated;
+    uint64_t unchanged;
+    uint64_t total;              // 更新后的条目数
+};
+
+// 把 set 中的编译调用写入 dir 下的数据库(不存在时创建)
+int compdb_update(const char *dir, const struct trace_set *set, struct compdb_stats *stats);
+
+// hooktrace compdb DIR add|export|query|stats ...
+int cmd_compdb(int argc, char **argv);
+
+#endif
@@ -0,0 +1,430 @@
+/* compile_cache.c
+ * 编译缓存，见 compile_cache.h
+ *
+ * 键由以下内容哈希得到(两路 64 位哈希拼成 128 位)：
+ *   工具路径、大小和修改时间；当前目录；除 -o 的值以外的全部参数；
+ *   cc1/cc1plus 再加上同样参数加 -E 得到的预处理结果，as 则用输入 .s 文件的内容代替文件名
+ *   (驱动传给 as 的是每次不同的临时文件名)。
+ * 只缓存退出码为 0 的结果。产物和工具的 stderr 输出保存为 <目录>/<前两位>/<键>.out/.err，
+ * 先写到带进程号的临时文件再 rename，并发的构建同时写同一个键也只会看到完整的文件；
+ * .err 先于 .out 就位，读到 .out 即可认为 .err 也已完整。
+ * 会产生额外输出文件的参数(依赖文件、-fdump-* 等)不缓存，直接运行工具。
+ */
+
+#define _GNU_SOURCE
+#include "compile_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+enum cc_kind { CC_NONE, CC_CC1, CC_AS };
+
+struct cc_hash {
+    uint64_t a, b;
+};
+
+static void cc_hash_init(struct cc_hash *h) {
+    h->a = 1469598103934665603ull;
+    h->b = 0x9E3779B97F4A7C15ull;
+}
+
+// a 是 FNV-1a，b 用另一组乘数和旋转，两路互不相关
+static void cc_hash_update(struct cc_hash *h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint64_t a = h->a, b = h->b;
+    for (size_t i = 0; i < len; i++) {
+        a = (a ^ p[i]) * 1099511628211ull;
+        b = (b ^ p[i]) * 0xff51afd7ed558ccdull;
+        b = (b << 29) | (b >> 35);
+    }
+    h->a = a;
+    h->b = b;
+}
+
+// 字段前带长度，避免 "ab"+"c" 与 "a"+"bc" 相同
+static void cc_hash_field(struct cc_hash *h, const char *s) {
+    uint64_t len = strlen(s);
+    cc_hash_update(h, &len, sizeof(len));
+    cc_hash_update(h, s, len);
+}
+
+static uint64_t cc_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static void cc_hash_hex(const struct cc_hash *h, char out[33]) {
+    snprintf(out, 33, "%016lx%016lx", (unsigned long)cc_mix(h->a), (unsigned long)cc_mix(h->b ^ h->a));
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static enum cc_kind classify(const char *tool) {
+    const char *base = strrchr(tool, '/');
+    base = base ? base + 1 : tool;
+    if (strcmp(base, "cc1") == 0 || strcmp(base, "cc1plus") == 0) return CC_CC1;
+    if (strcmp(base, "as") == 0) return CC_AS;
+    return CC_NONE;
+}
+
+// 直接用系统调用 exec，hook 库不会再把它转回到这里
+static void run_direct(const char *path, char **argv) {
+    syscall(SYS_execve, path, argv, environ);
+    fprintf(stderr, "hooktrace compile-cache: 无法执行 %s: %s\n", path, strerror(errno));
+    _exit(127);
+}
+
+static int resolve_tool(const char *name, char *out, size_t size) {
+    if (strchr(name, '/')) {
+        snprintf(out, size, "%s", name);
+        return 0;
+    }
+    const char *path_env = getenv("PATH");
+    char *copy = strdup(path_env ? path_env : "/bin:/usr/bin");
+    char *save = NULL;
+    int found = -1;
+    for (char *dir = strtok_r(copy, ":", &save); dir && found != 0; dir = strtok_r(NULL, ":", &save)) {
+        snprintf(out, size, "%s/%s", dir, name);
+        if (access(out, X_OK) == 0) found = 0;
+    }
+    free(copy);
+    return found;
+}
+
+static int output_index(char **argv) {
+    for (int i = 1; argv[i]; i++) {
+        if (strcmp(argv[i], "-o") == 0) return argv[i + 1] ? i : -1;
+    }
+    return -1;
+}
+
+// 会写出 -o 以外文件、或本身就不产生目标文件的参数
+static int has_side_output(enum cc_kind kind, char **argv) {
+    static const char *const exact[] = {"-M", "-MM", "-MD", "-MMD", "-MF", "-E", "-save-temps",
+                                        "-fstack-usage", "-fcallgraph-info", "-aux-info", "--MD", "-"};
+    static const char *const prefix[] = {"-fdump-", "-fprofile-", "-save-temps=", "-fcallgraph-info="};
+    for (int i = 1; argv[i]; i++) {
+        for (size_t k = 0; k < sizeof(exact) / sizeof(exact[0]); k++) {
+            if (strcmp(argv[i], exact[k]) == 0) return 1;
+        }
+        for (size_t k = 0; k < sizeof(prefix) / sizeof(prefix[0]); k++) {
+            if (strncmp(argv[i], prefix[k], strlen(prefix[k])) == 0) return 1;
+        }
+        // as 的列表输出: -al, -ahl=file ...
+        if (kind == CC_AS && strncmp(argv[i], "-a", 2) == 0 && argv[i][2] != '\0') return 1;
+    }
+    return 0;
+}
+
+static int hash_fd(struct cc_hash *h, int fd) {
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        cc_hash_update(h, buf, (size_t)n);
+    }
+    return 0;
+}
+
+static int hash_file(struct cc_hash *h, const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int r = hash_fd(h, fd);
+    close(fd);
+    return r;
+}
+
+// 以 -E 重新运行 cc1/cc1plus，把预处理结果计入哈希；失败时返回 -1，由调用者直接运行工具
+static int hash_preprocessed(struct cc_hash *h, const char *path, char **argv, int out_idx) {
+    int argc = 0;
+    while (argv[argc]) argc++;
+    char **pp = calloc((size_t)argc + 2, sizeof(char *));
+    if (!pp) return -1;
+    int n = 0;
+    for (int i = 0; i < argc; i++) {
+        if (i == out_idx) {
+            i++;
+            continue;
+        }
+        pp[n++] = argv[i];
+    }
+    pp[n++] = "-E";
+    pp[n] = NULL;
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        free(pp);
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) dup2(devnull, STDERR_FILENO);
+        syscall(SYS_execve, path, pp, environ);
+        _exit(127);
+    }
+    free(pp);
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return -1;
+    }
+
+    int r = hash_fd(h, fds[0]);
+    close(fds[0]);
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return (r == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+static int compute_key(enum cc_kind kind, const char *path, char **argv, int out_idx, char key[33]) {
+    struct cc_hash h;
+    cc_hash_init(&h);
+    cc_hash_field(&h, "hooktrace-compile-cache-1");
+    cc_hash_field(&h, path);
+
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    uint64_t ident[3] = {(uint64_t)st.st_size, (uint64_t)st.st_mtim.tv_sec, (uint64_t)st.st_mtim.tv_nsec};
+    cc_hash_update(&h, ident, sizeof(ident));
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) return -1;
+    cc_hash_field(&h, cwd);
+
+    for (int i = 1; argv[i]; i++) {
+        if (i == out_idx) {
+            i++;
+            continue;
+        }
+        struct stat in;
+        if (kind == CC_AS && argv[i][0] != '-' && stat(argv[i], &in) == 0 && S_ISREG(in.st_mode)) {
+            cc_hash_field(&h, "<input>");
+            if (hash_file(&h, argv[i]) != 0) return -1;
+        } else {
+            cc_hash_field(&h, argv[i]);
+        }
+    }
+
+    if (kind == CC_CC1) {
+        cc_hash_field(&h, "<preprocessed>");
+        if (hash_preprocessed(&h, path, argv, out_idx) != 0) return -1;
+    }
+    cc_hash_hex(&h, key);
+    return 0;
+}
+
+static int copy_fd(int in, int out) {
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        for (ssize_t off = 0; off < n; ) {
+            ssize_t w = write(out, buf + off, (size_t)(n - off));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            off += w;
+        }
+    }
+    return 0;
+}
+
+static int copy_file(const char *src, const char *dst) {
+    int in = open(src, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return -1;
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+    int r = copy_fd(in, out);
+    close(in);
+    if (close(out) != 0) r = -1;
+    return r;
+}
+
+static void replay_stderr(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    copy_fd(fd, STDERR_FILENO);
+    close(fd);
+}
+
+// 会话模式下每次调用追加一行到 compile_cache.log，O_APPEND 单次 write，多进程不会交错
+static void log_result(const char *path, const char *result, const char *key, uint64_t ns) {
+    const char *dir = getenv("HOOKTRACE_DIR");
+    if (!dir || !*dir) return;
+    char file[PATH_MAX];
+    snprintf(file, sizeof(file), "%s/compile_cache.log", dir);
+    int fd = open(file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+
+    const char *base = strrchr(path, '/');
+    char line[512];
+    int n = snprintf(line, sizeof(line), "{\"pid\":%d,\"tool\":\"%s\",\"result\":\"%s\",\"key\":\"%s\",\"ns\":%lu}\n",
+                     getpid(), base ? base + 1 : path, result, key ? key : "", (unsigned long)ns);
+    if (n > 0 && (size_t)n < sizeof(line)) {
+        ssize_t w = write(fd, line, (size_t)n);
+        (void)w;
+    }
+    close(fd);
+}
+
+// 以与子进程相同的方式结束：正常退出码，或被同一个信号终止
+static void exit_like(int status) {
+    if (WIFSIGNALED(status)) {
+        signal(WTERMSIG(status), SIG_DFL);
+        raise(WTERMSIG(status));
+    }
+    _exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+}
+
+int cmd_compile_cache(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "用法: hooktrace compile-cache 工具路径 argv0 [参数...]\n");
+        return 2;
+    }
+    uint64_t t0 = now_ns();
+    char **tool_argv = argv + 1;
+
+    char path[PATH_MAX];
+    if (resolve_tool(argv[0], path, sizeof(path)) != 0) {
+        fprintf(stderr, "hooktrace compile-cache: 找不到 %s\n", argv[0]);
+        return 127;
+    }
+
+    enum cc_kind kind = classify(path);
+    const char *cache_dir = getenv("HOOKTRACE_COMPILE_CACHE");
+    int out_idx = output_index(tool_argv);
+    if (kind == CC_NONE || !cache_dir || !*cache_dir || out_idx < 0 || has_side_output(kind, tool_argv)) {
+        log_result(path, "uncacheable", NULL, now_ns() - t0);
+        run_direct(path, tool_argv);
+    }
+    const char *output = tool_argv[out_idx + 1];
+
+    char key[33];
+    if (compute_key(kind, path, tool_argv, out_idx, key) != 0) {
+        log_result(path, "uncacheable", NULL, now_ns() - t0);
+        run_direct(path, tool_argv);
+    }
+
+    char sub[PATH_MAX], out_file[PATH_MAX + 64], err_file[PATH_MAX + 64];
+    snprintf(sub, sizeof(sub), "%s/%.2s", cache_dir, key);
+    snprintf(out_file, sizeof(out_file), "%s/%s.out", sub, key);
+    snprintf(err_file, sizeof(err_file), "%s/%s.err", sub, key);
+
+    // 命中：写出产物，重放当时的诊断输出
+    if (access(out_file, R_OK) == 0 && copy_file(out_file, output) == 0) {
+        replay_stderr(err_file);
+        log_result(path, "hit", key, now_ns() - t0);
+        _exit(0);
+    }
+
+    // 未命中：运行工具，stderr 先写到临时文件以便保存
+    if (mkdir(sub, 0755) != 0 && errno != EEXIST) {
+        log_result(path, "uncacheable", key, now_ns() - t0);
+        run_direct(path, tool_argv);
+    }
+    char err_tmp[PATH_MAX + 96], out_tmp[PATH_MAX + 96];
+    snprintf(err_tmp, sizeof(err_tmp), "%s.tmp.%d", err_file, getpid());
+    snprintf(out_tmp, sizeof(out_tmp), "%s.tmp.%d", out_file, getpid());
+
+    int err_fd = open(err_tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (err_fd < 0) {
+        log_result(path, "uncacheable", key, now_ns() - t0);
+        run_direct(path, tool_argv);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(err_fd, STDERR_FILENO);
+        run_direct(path, tool_argv);
+    }
+    close(err_fd);
+    if (pid < 0) {
+        unlink(err_tmp);
+        run_direct(path, tool_argv);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            status = 1 << 8;
+            break;
+        }
+    }
+    replay_stderr(err_tmp);
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && copy_file(output, out_tmp) == 0 &&
+        rename(err_tmp, err_file) == 0 && rename(out_tmp, out_file) == 0) {
+        log_result(path, "miss", key, now_ns() - t0);
+    } else {
+        unlink(err_tmp);
+        unlink(out_tmp);
+        log_result(path, WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "miss" : "failed",
+                   key, now_ns() - t0);
+    }
+    exit_like(status);
+    return 1;
+}
+
+void compile_cache_report(const char *session_dir) {
+    char file[PATH_MAX + 64];
+    snprintf(file, sizeof(file), "%s/compile_cache.log", session_dir);
+    FILE *f = fopen(file, "r");
+    if (!f) return;
+
+    static const char *const results[] = {"hit", "miss", "failed", "uncacheable"};
+    unsigned long count[4] = {0};
+    double ms[4] = {0};
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        const char *r = strstr(line, "\"result\":\"");
+        const char *ns = strstr(line, "\"ns\":");
+        if (!r || !ns) continue;
+        r += 10;
+        for (int i = 0; i < 4; i++) {
+            size_t len = strlen(results[i]);
+            if (strncmp(r, results[i], len) == 0 && r[len] == '"') {
+                count[i]++;
+                ms[i] += strtod(ns + 5, NULL) / 1e6;
+            }
+        }
+    }
+    fclose(f);
+
+    fprintf(stderr, "hooktrace: 编译缓存 命中 %lu (平均 %.1f ms), 未命中 %lu (平均 %.1f ms), "
+            "失败 %lu, 不可缓存 %lu\n",
+            count[0], count[0] ? ms[0] / count[0] : 0.0, count[1], count[1] ? ms[1] / count[1] : 0.0,
+            count[2], count[3]);
+}
@@ -0,0 +1,20 @@
+/* compile_cache.h
+ * hooktrace 的编译缓存：hook 库在 exec cc1/cc1plus/as 之前改为 exec
+ * "hooktrace compile-cache 工具路径 argv..."，由这里按输入查缓存，命中时直接写出产物并退出，
+ * 未命中时运行真正的工具并保存产物。
+ *
+ * 环境变量(由 hooktrace run --compile-cache DIR 设置，hook 库在 exec 时继续传递)：
+ *   HOOKTRACE_COMPILE_CACHE  缓存目录
+ *   HOOKTRACE_BIN            hooktrace 可执行文件路径
+ */
+
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+// argv[0] 是工具路径，其后是工具自己的 argv(从 argv[0] 开始)；不返回
+int cmd_compile_cache(int argc, char **argv);
+
+// 汇总会话目录下 compile_cache.log 的命中情况，没有该文件时不输出
+void compile_cache_report(const char *session_dir);
+
+#endif
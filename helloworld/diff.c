@@ -0,0 +1,554 @@
+/* diff.c
+ * hooktrace diff A B：比较两次构建的编译器调用。A、B 是会话目录或 records.jsonl。
+ *
+ * 每个 records.jsonl 旁边建一个索引 records.jsonl.idx(源文件大小或修改时间变化时重建)，
+ * 每条编译器驱动调用一项：输出文件的哈希、归一化 argv 的哈希、耗时和该行在 jsonl 中的
+ * 位置。比较时两边的索引和 jsonl 都直接 mmap，用 A 的输出文件哈希建开放寻址表，
+ * 逐项查找 B，整体是线性的；只有需要报告的调用才回到 jsonl 解析原始记录。
+ *
+ * 归一化：追踪根目录(第一条记录的 cwd)替换成 $ROOT，argv[0] 只保留程序名，这样不同
+ * 目录下的两次构建也能对上。同一输出文件出现多次时按出现顺序配对，优先配参数相同的。
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "diff.h"
+#include "trace_record.h"
+
+#define DIFF_INDEX_MAGIC 0x58445448u   // "HTDX"
+#define DIFF_INDEX_VERSION 1
+
+struct diff_index_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t src_size;                 // 建索引时 records.jsonl 的大小和修改时间
+    int64_t src_mtime_ns;
+    uint64_t count;
+    char root[PATH_MAX];               // 归一化用的根目录
+};
+
+struct diff_index_entry {
+    uint64_t key_hash;                 // 归一化后的输出文件
+    uint64_t argv_hash;                // 归一化后的 argv
+    uint64_t duration_ns;              // 0 表示未知
+    uint64_t offset;                   // 记录行在 records.jsonl 中的位置
+    uint32_t length;
+    int32_t exit_status;
+};
+
+struct diff_trace {
+    char path[PATH_MAX];
+    const char *data;                  // mmap 的 records.jsonl
+    size_t size;
+    const struct diff_index_header *hdr;
+    const struct diff_index_entry *entries;
+    void *index;                       // mmap 的索引，写不了索引文件时是 malloc 的
+    size_t index_size;
+    int index_mapped;
+};
+
+struct diff_options {
+    double threshold;                  // 变慢的相对阈值(%)
+    uint64_t min_ns;                   // 变慢的绝对阈值
+    int limit;                         // 每一节最多列出的条数
+};
+
+static uint64_t fnv(const void *p, size_t len, uint64_t h) {
+    const unsigned char *s = p;
+    for (size_t i = 0; i < len; i++) {
+        h ^= s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+#define FNV_BASIS 1469598103934665603ull
+
+// 把 arg 中的根目录替换成 $ROOT(后面必须是 '/' 或结尾，避免 /a/b 匹配 /a/bc)
+static void norm_arg(const char *arg, const char *root, char *out, size_t cap) {
+    size_t rlen = strlen(root), n = 0;
+    while (*arg && n + 1 < cap) {
+        if (rlen > 1 && strncmp(arg, root, rlen) == 0 && (arg[rlen] == '/' || arg[rlen] == '\0')) {
+            int w = snprintf(out + n, cap - n, "$ROOT");
+            n = (size_t)w < cap - n ? n + (size_t)w : cap - 1;
+            arg += rlen;
+            continue;
+        }
+        out[n++] = *arg++;
+    }
+    out[n] = '\0';
+}
+
+static int has_arg(const struct exec_record *rec, const char *what) {
+    for (int a = 1; a < rec->argc; a++) {
+        if (strcmp(rec->argv[a], what) == 0) return 1;
+    }
+    return 0;
+}
+
+// 只做预处理或生成依赖的调用没有产物，不参与比较
+static int diff_wanted(const struct exec_record *rec) {
+    if (!exec_is_compiler(rec)) return 0;
+    return !has_arg(rec, "-E") && !has_arg(rec, "-M") && !has_arg(rec, "-MM");
+}
+
+// 调用的产物：-o 的值，没有 -o 时按 -c/-S 推出源文件对应的 .o/.s，否则是 a.out
+static void output_key(const struct exec_record *rec, const char *root, char *out, size_t cap) {
+    char name[PATH_MAX];
+    const char *o = exec_output_arg(rec);
+    if (o) {
+        snprintf(name, sizeof(name), "%s", o);
+    } else {
+        int src = exec_next_source(rec, 1);
+        const char *ext = has_arg(rec, "-c") ? ".o" : has_arg(rec, "-S") ? ".s" : NULL;
+        if (src > 0 && ext) {
+            const char *base = strrchr(rec->argv[src], '/');
+            snprintf(name, sizeof(name), "%s", base ? base + 1 : rec->argv[src]);
+            char *dot = strrchr(name, '.');
+            if (dot) *dot = '\0';
+            strncat(name, ext, sizeof(name) - strlen(name) - 1);
+        } else {
+            snprintf(name, sizeof(name), "a.out");
+        }
+    }
+    char full[PATH_MAX * 2];
+    if (name[0] == '/' || !rec->cwd) snprintf(full, sizeof(full), "%s", name);
+    else snprintf(full, sizeof(full), "%s/%s", rec->cwd, name);
+    norm_arg(full, root, out, cap);
+}
+
+static uint64_t argv_hash(const struct exec_record *rec, const char *root) {
+    uint64_t h = FNV_BASIS;
+    char buf[PATH_MAX * 2];
+    const char *tool = exec_basename(rec);
+    h = fnv(tool, strlen(tool) + 1, h);
+    for (int a = 1; a < rec->argc; a++) {
+        norm_arg(rec->argv[a], root, buf, sizeof(buf));
+        h = fnv(buf, strlen(buf) + 1, h);
+    }
+    return h;
+}
+
+static uint64_t record_duration(const struct exec_record *rec) {
+    return rec->end_ns > rec->start_ns && rec->start_ns ? rec->end_ns - rec->start_ns : 0;
+}
+
+// ===== 索引 =====
+
+static int index_valid(const void *map, size_t size, const struct stat *src) {
+    const struct diff_index_header *hdr = map;
+    if (size < sizeof(*hdr) || hdr->magic != DIFF_INDEX_MAGIC || hdr->version != DIFF_INDEX_VERSION) {
+        return 0;
+    }
+    if (hdr->src_size != (uint64_t)src->st_size ||
+        hdr->src_mtime_ns != (int64_t)src->st_mtim.tv_sec * 1000000000 + src->st_mtim.tv_nsec) {
+        return 0;
+    }
+    return size == sizeof(*hdr) + hdr->count * sizeof(struct diff_index_entry);
+}
+
+static int map_index(struct diff_trace *t, const char *idx_path, const struct stat *src) {
+    int fd = open(idx_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    if (!index_valid(map, (size_t)st.st_size, src)) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    t->index = map;
+    t->index_size = (size_t)st.st_size;
+    t->index_mapped = 1;
+    return 0;
+}
+
+// 扫描 records.jsonl 生成索引，尽量写到 idx_path(先写临时文件再改名)，写不了就留在内存里
+static int build_index(struct diff_trace *t, const char *idx_path, const struct stat *src) {
+    size_t cap = 1024, count = 0;
+    struct diff_index_header *hdr = calloc(1, sizeof(*hdr) + cap * sizeof(struct diff_index_entry));
+    if (!hdr) return -1;
+    hdr->magic = DIFF_INDEX_MAGIC;
+    hdr->version = DIFF_INDEX_VERSION;
+    hdr->src_size = (uint64_t)src->st_size;
+    hdr->src_mtime_ns = (int64_t)src->st_mtim.tv_sec * 1000000000 + src->st_mtim.tv_nsec;
+
+    char key[PATH_MAX * 2];
+    const char *p = t->data, *end = t->data + t->size;
+    int first = 1;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        struct exec_record rec;
+        if (len > 0 && trace_parse_record(p, len, &rec) == 0) {
+            if (first && rec.cwd) snprintf(hdr->root, sizeof(hdr->root), "%s", rec.cwd);
+            first = 0;
+            if (diff_wanted(&rec)) {
+                if (count == cap) {
+                    cap *= 2;
+                    struct diff_index_header *grown =
+                        realloc(hdr, sizeof(*hdr) + cap * sizeof(struct diff_index_entry));
+                    if (!grown) {
+                        trace_record_free(&rec);
+                        free(hdr);
+                        return -1;
+                    }
+                    hdr = grown;
+                }
+                struct diff_index_entry *e = (struct diff_index_entry *)(hdr + 1) + count++;
+                output_key(&rec, hdr->root, key, sizeof(key));
+                e->key_hash = fnv(key, strlen(key), FNV_BASIS);
+                e->argv_hash = argv_hash(&rec, hdr->root);
+                e->duration_ns = record_duration(&rec);
+                e->offset = (uint64_t)(p - t->data);
+                e->length = (uint32_t)len;
+                e->exit_status = rec.exit_status;
+            }
+            trace_record_free(&rec);
+        }
+        p += len + 1;
+    }
+    hdr->count = count;
+    size_t size = sizeof(*hdr) + count * sizeof(struct diff_index_entry);
+
+    char tmp[PATH_MAX + 32];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d", idx_path, getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        ssize_t w = write(fd, hdr, size);
+        close(fd);
+        if (w == (ssize_t)size && rename(tmp, idx_path) == 0 && map_index(t, idx_path, src) == 0) {
+            free(hdr);
+            return 0;
+        }
+        unlink(tmp);
+    }
+    t->index = hdr;
+    t->index_size = size;
+    t->index_mapped = 0;
+    return 0;
+}
+
+static int open_trace(const char *arg, struct diff_trace *t) {
+    memset(t, 0, sizeof(*t));
+    struct stat st;
+    if (stat(arg, &st) != 0) {
+        fprintf(stderr, "hooktrace: 无法访问 %s: %s\n", arg, strerror(errno));
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) snprintf(t->path, sizeof(t->path), "%s/records.jsonl", arg);
+    else snprintf(t->path, sizeof(t->path), "%s", arg);
+
+    int fd = open(t->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "hooktrace: 无法读取 %s: %s\n", t->path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    t->size = (size_t)st.st_size;
+    if (t->size > 0) {
+        void *map = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "hooktrace: 无法映射 %s: %s\n", t->path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        t->data = map;
+    }
+    close(fd);
+
+    char idx_path[PATH_MAX + 8];
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", t->path);
+    if (map_index(t, idx_path, &st) != 0 && build_index(t, idx_path, &st) != 0) {
+        fprintf(stderr, "hooktrace: 无法为 %s 建立索引\n", t->path);
+        return -1;
+    }
+    t->hdr = t->index;
+    t->entries = (const struct diff_index_entry *)(t->hdr + 1);
+    return 0;
+}
+
+static void close_trace(struct diff_trace *t) {
+    if (t->data) munmap((void *)t->data, t->size);
+    if (t->index_mapped) munmap(t->index, t->index_size);
+    else free(t->index);
+}
+
+static int load_entry(const struct diff_trace *t, const struct diff_index_entry *e,
+                      struct exec_record *rec) {
+    return trace_parse_record(t->data + e->offset, e->length, rec);
+}
+
+// ===== 报告 =====
+
+static void print_command(const struct diff_trace *t, const struct diff_index_entry *e) {
+    struct exec_record rec;
+    if (load_entry(t, e, &rec) != 0) return;
+    char key[PATH_MAX * 2], buf[PATH_MAX * 2];
+    output_key(&rec, t->hdr->root, key, sizeof(key));
+    printf("  %s\n    %s", key, exec_basename(&rec));
+    for (int a = 1; a < rec.argc; a++) {
+        norm_arg(rec.argv[a], t->hdr->root, buf, sizeof(buf));
+        printf(" %s", buf);
+    }
+    putchar('\n');
+    trace_record_free(&rec);
+}
+
+static int str_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// 归一化并排序后的参数(不含 argv[0])
+static char **sorted_args(const struct diff_trace *t, const struct exec_record *rec) {
+    char **args = calloc((size_t)rec->argc + 1, sizeof(char *));
+    if (!args) return NULL;
+    char buf[PATH_MAX * 2];
+    for (int a = 1; a < rec->argc; a++) {
+        norm_arg(rec->argv[a], t->hdr->root, buf, sizeof(buf));
+        args[a - 1] = strdup(buf);
+        if (!args[a - 1]) args[a - 1] = strdup("");
+    }
+    qsort(args, (size_t)(rec->argc > 0 ? rec->argc - 1 : 0), sizeof(char *), str_cmp);
+    return args;
+}
+
+// 参数变化按多重集合比较：列出 A 独有(-)和 B 独有(+)的参数；只有顺序不同时注明
+static void print_changed(const struct diff_trace *ta, const struct diff_index_entry *ea,
+                          const struct diff_trace *tb, const struct diff_index_entry *eb) {
+    struct exec_record ra, rb;
+    if (load_entry(ta, ea, &ra) != 0) return;
+    if (load_entry(tb, eb, &rb) != 0) {
+        trace_record_free(&ra);
+        return;
+    }
+    char key[PATH_MAX * 2];
+    output_key(&rb, tb->hdr->root, key, sizeof(key));
+    printf("  %s\n", key);
+    if (strcmp(exec_basename(&ra), exec_basename(&rb)) != 0) {
+        printf("    - %s\n    + %s\n", exec_basename(&ra), exec_basename(&rb));
+    }
+
+    char **aa = sorted_args(ta, &ra), **ab = sorted_args(tb, &rb);
+    int na = ra.argc > 0 ? ra.argc - 1 : 0, nb = rb.argc > 0 ? rb.argc - 1 : 0;
+    int i = 0, j = 0, changes = 0;
+    while (aa && ab && (i < na || j < nb)) {
+        int c = i == na ? 1 : j == nb ? -1 : strcmp(aa[i], ab[j]);
+        if (c == 0) {
+            i++;
+            j++;
+        } else if (c < 0) {
+            printf("    - %s\n", aa[i++]);
+            changes++;
+        } else {
+            printf("    + %s\n", ab[j++]);
+            changes++;
+        }
+    }
+    if (changes == 0 && strcmp(exec_basename(&ra), exec_basename(&rb)) == 0) {
+        printf("    (参数相同，顺序不同)\n");
+    }
+    for (int k = 0; aa && k < na; k++) free(aa[k]);
+    for (int k = 0; ab && k < nb; k++) free(ab[k]);
+    free(aa);
+    free(ab);
+    trace_record_free(&ra);
+    trace_record_free(&rb);
+}
+
+struct diff_pair {
+    uint32_t a, b;
+    int64_t delta_ns;
+};
+
+static int slower_cmp(const void *x, const void *y) {
+    const struct diff_pair *p = x, *q = y;
+    return (p->delta_ns < q->delta_ns) - (p->delta_ns > q->delta_ns);
+}
+
+#define DIFF_EMPTY UINT32_MAX
+
+static int run_diff(const struct diff_trace *ta, const struct diff_trace *tb,
+                    const struct diff_options *opts) {
+    size_t na = ta->hdr->count, nb = tb->hdr->count;
+    size_t cap = 16;
+    while (cap < na * 2) cap *= 2;
+    uint32_t *table = malloc(cap * sizeof(uint32_t));
+    uint32_t *next = malloc((na + 1) * sizeof(uint32_t));
+    uint32_t *tail = malloc((na + 1) * sizeof(uint32_t));
+    uint8_t *used = calloc(na + 1, 1);
+    uint32_t *added = malloc((nb + 1) * sizeof(uint32_t));
+    struct diff_pair *changed = malloc((nb + 1) * sizeof(*changed));
+    struct diff_pair *slower = malloc((nb + 1) * sizeof(*slower));
+    int rc = 2;
+    if (!table || !next || !tail || !used || !added || !changed || !slower) goto out;
+    memset(table, 0xff, cap * sizeof(uint32_t));
+
+    // A 按输出文件建表，同一输出的多次调用串成链，保持出现顺序
+    size_t mask = cap - 1;
+    for (uint32_t i = 0; i < na; i++) {
+        uint64_t key = ta->entries[i].key_hash;
+        size_t slot = key & mask;
+        while (table[slot] != DIFF_EMPTY && ta->entries[table[slot]].key_hash != key) {
+            slot = (slot + 1) & mask;
+        }
+        next[i] = DIFF_EMPTY;
+        if (table[slot] == DIFF_EMPTY) {
+            table[slot] = i;
+            tail[i] = i;
+        } else {
+            uint32_t head = table[slot];
+            next[tail[head]] = i;
+            tail[head] = i;
+        }
+    }
+
+    size_t nadded = 0, nchanged = 0, nslower = 0, nfaster = 0, nsame = 0;
+    uint64_t total_a = 0, total_b = 0;
+    for (size_t i = 0; i < na; i++) total_a += ta->entries[i].duration_ns;
+    for (uint32_t j = 0; j < nb; j++) {
+        const struct diff_index_entry *eb = &tb->entries[j];
+        total_b += eb->duration_ns;
+        size_t slot = eb->key_hash & mask;
+        while (table[slot] != DIFF_EMPTY && ta->entries[table[slot]].key_hash != eb->key_hash) {
+            slot = (slot + 1) & mask;
+        }
+        uint32_t match = DIFF_EMPTY;
+        for (uint32_t i = table[slot]; i != DIFF_EMPTY; i = next[i]) {
+            if (used[i]) continue;
+            if (match == DIFF_EMPTY) match = i;
+            if (ta->entries[i].argv_hash == eb->argv_hash) {
+                match = i;
+                break;
+            }
+        }
+        if (match == DIFF_EMPTY) {
+            added[nadded++] = j;
+            continue;
+        }
+        used[match] = 1;
+        const struct diff_index_entry *ea = &ta->entries[match];
+        if (ea->argv_hash != eb->argv_hash) {
+            changed[nchanged++] = (struct diff_pair){ match, j, 0 };
+        } else {
+            nsame++;
+        }
+        if (ea->duration_ns && eb->duration_ns) {
+            int64_t delta = (int64_t)eb->duration_ns - (int64_t)ea->duration_ns;
+            if (delta >= (int64_t)opts->min_ns &&
+                (double)delta * 100.0 >= (double)ea->duration_ns * opts->threshold) {
+                slower[nslower++] = (struct diff_pair){ match, j, delta };
+            } else if (-delta >= (int64_t)opts->min_ns &&
+                       (double)-delta * 100.0 >= (double)ea->duration_ns * opts->threshold) {
+                nfaster++;
+            }
+        }
+    }
+    size_t nremoved = 0;
+    for (size_t i = 0; i < na; i++) nremoved += !used[i];
+
+    printf("A: %s (%zu 次编译器调用, 合计 %.1f s)\n", ta->path, na, (double)total_a / 1e9);
+    printf("B: %s (%zu 次编译器调用, 合计 %.1f s)\n", tb->path, nb, (double)total_b / 1e9);
+    printf("相同 %zu, 新增 %zu, 删除 %zu, 参数变化 %zu, 变慢 %zu, 变快 %zu (阈值 %.0f%% 且 %.0f ms)\n",
+           nsame, nadded, nremoved, nchanged, nslower, nfaster, opts->threshold,
+           (double)opts->min_ns / 1e6);
+
+    if (nchanged) printf("\n== 参数变化 ==\n");
+    for (size_t k = 0; k < nchanged && (int)k < opts->limit; k++) {
+        print_changed(ta, &ta->entries[changed[k].a], tb, &tb->entries[changed[k].b]);
+    }
+    if (nadded) printf("\n== 新增 ==\n");
+    for (size_t k = 0; k < nadded && (int)k < opts->limit; k++) print_command(tb, &tb->entries[added[k]]);
+    if (nremoved) printf("\n== 删除 ==\n");
+    for (size_t i = 0, shown = 0; i < na && (int)shown < opts->limit; i++) {
+        if (used[i]) continue;
+        print_command(ta, &ta->entries[i]);
+        shown++;
+    }
+    if (nslower) {
+        qsort(slower, nslower, sizeof(*slower), slower_cmp);
+        printf("\n== 变慢 ==\n");
+    }
+    for (size_t k = 0; k < nslower && (int)k < opts->limit; k++) {
+        const struct diff_index_entry *ea = &ta->entries[slower[k].a], *eb = &tb->entries[slower[k].b];
+        struct exec_record rec;
+        char key[PATH_MAX * 2] = "";
+        if (load_entry(tb, eb, &rec) == 0) {
+            output_key(&rec, tb->hdr->root, key, sizeof(key));
+            trace_record_free(&rec);
+        }
+        printf("  %+10.1f ms (%+5.0f%%)  %9.1f -> %9.1f ms  %s\n", (double)slower[k].delta_ns / 1e6,
+               (double)slower[k].delta_ns * 100.0 / (double)ea->duration_ns,
+               (double)ea->duration_ns / 1e6, (double)eb->duration_ns / 1e6, key);
+    }
+
+    // 与 diff(1) 相同：有差异时退出码为 1
+    rc = (nadded || nremoved || nchanged || nslower) ? 1 : 0;
+out:
+    free(table);
+    free(next);
+    free(tail);
+    free(used);
+    free(added);
+    free(changed);
+    free(slower);
+    return rc;
+}
+
+static void diff_usage(void) {
+    fprintf(stderr,
+            "用法: hooktrace diff [选项] A B\n"
+            "  A、B 是会话目录或 records.jsonl，比较其中的编译器调用\n"
+            "  --threshold PCT  耗时增加超过该百分比才算变慢(默认 20)\n"
+            "  --min-ms MS      且增加超过该毫秒数(默认 50)\n"
+            "  --limit N        每一节最多列出 N 条(默认 50)\n"
+            "有差异时退出码为 1\n");
+}
+
+int cmd_diff(int argc, char **argv) {
+    struct diff_options opts = { .threshold = 20.0, .min_ns = 50000000ull, .limit = 50 };
+    const char *paths[2];
+    int npaths = 0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            opts.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+            opts.min_ns = (uint64_t)(atof(argv[++i]) * 1e6);
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            opts.limit = atoi(argv[++i]);
+        } else if (argv[i][0] == '-' || npaths == 2) {
+            diff_usage();
+            return 2;
+        } else {
+            paths[npaths++] = argv[i];
+        }
+    }
+    if (npaths != 2) {
+        diff_usage();
+        return 2;
+    }
+
+    struct diff_trace a, b;
+    if (open_trace(paths[0], &a) != 0) return 2;
+    if (open_trace(paths[1], &b) != 0) {
+        close_trace(&a);
+        return 2;
+    }
+    int rc = run_diff(&a, &b, &opts);
+    close_trace(&a);
+    close_trace(&b);
+    return rc;
+}
@@ -0,0 +1,10 @@
+/* diff.h
+ * hooktrace diff：比较两次构建追踪到的编译器调用，找出新增、删除、参数变化和变慢的命令。
+ */
+
+#ifndef DIFF_H
+#define DIFF_H
+
+int cmd_diff(int argc, char **argv);
+
+#endif
@@ -7,6 +7,212 @@
 #include <map>
 #include <set>
 #include <numeric>
+#include <string_view>
+#include <optional>
+#include <functional>
+#include <cstdint>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <charconv>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 统计用的热字段按列存放（结构数组），由 School 持有。实体加入学校时登记行号，
+// 之后字段变化（打分、改状态、选课）直接写到列里，统计时顺序扫描连续内存
+struct StatColumns {
+    std::vector<double> activeGpa;    // 学生：在校时为 GPA，否则为 0，求和时不用再按状态筛选
+    std::vector<uint8_t> active;      // 0/1
+    std::vector<int32_t> experience;  // 教师
+    std::vector<int32_t> enrolled;    // 课程
+};
+
+struct ColumnRef {
+    StatColumns* columns = nullptr;
+    uint32_t row = 0;
+};
+
+// 报表的输出格式
+enum class ReportFormat { Text, Json };
+
+// 报表缓冲：show* 把整份报表格式化到这里，再一次 write 写出，不再每行 std::endl 刷新一次。
+// 文本用 print/line 依次拼接参数；JSON 用 beginObject/value/endObject 等，逗号和转义由缓冲处理，
+// 顶层的每个对象占一行，一批报表写出来是 JSON Lines
+class ReportBuffer {
+private:
+    std::string data;
+    ReportFormat fmt;
+    uint64_t hasElement = 0;          // JSON：第 depth 层已经写过元素时对应的位为 1，下一个元素前加逗号
+    int depth = 0;
+
+    void put(std::string_view s) { data.append(s); }
+    void put(const char* s) { data.append(s); }
+    void put(const std::string& s) { data.append(s); }
+    void put(char c) { data.push_back(c); }
+    void put(bool b) { data.push_back(b ? '1' : '0'); }
+
+    template <typename T, std::enable_if_t<std::is_integral<T>::value, int> = 0>
+    void put(T v) {
+        char buf[24];
+        data.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+    }
+
+    // 与 ostream 的默认格式（%g，6 位有效数字）相同
+    void put(double v) {
+        char buf[32];
+        data.append(buf, std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, 6).ptr);
+    }
+
+    // 不需要转义的连续字节整段追加
+    void jsonString(std::string_view s) {
+        data.push_back('"');
+        size_t run = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+            char c = s[i];
+            if (c != '"' && c != '\\' && static_cast<unsigned char>(c) >= 0x20) continue;
+            data.append(s.data() + run, i - run);
+            run = i + 1;
+            if (c == '"' || c == '\\') {
+                data.push_back('\\');
+                data.push_back(c);
+            } else {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                data.append(buf);
+            }
+        }
+        data.append(s.data() + run, s.size() - run);
+        data.push_back('"');
+    }
+
+    void jsonValue(std::string_view s) { jsonString(s); }
+    void jsonValue(const char* s) { jsonString(s); }
+    void jsonValue(const std::string& s) { jsonString(s); }
+    void jsonValue(bool b) { data.append(b ? "true" : "false"); }
+    void jsonValue(std::nullptr_t) { data.append("null"); }
+
+    template <typename T, std::enable_if_t<std::is_integral<T>::value, int> = 0>
+    void jsonValue(T v) { put(v); }
+
+    void jsonValue(double v) {
+        if (!std::isfinite(v)) {
+            data.append("null");
+            return;
+        }
+        char buf[32];
+        data.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+    }
+
+    // 元素前的逗号和键名；数组里的元素没有键名
+    void key(std::string_view name) {
+        uint64_t bit = uint64_t(1) << depth;
+        if (hasElement & bit) data.push_back(',');
+        hasElement |= bit;
+        if (!name.empty()) {
+            jsonString(name);
+            data.push_back(':');
+        }
+    }
+
+    void open(std::string_view name, char bracket) {
+        key(name);
+        data.push_back(bracket);
+        depth++;
+        hasElement &= ~(uint64_t(1) << depth);
+    }
+
+    void close(char bracket) {
+        depth--;
+        data.push_back(bracket);
+        if (depth == 0) {
+            data.push_back('\n');
+            hasElement = 0;
+        }
+    }
+
+public:
+    explicit ReportBuffer(ReportFormat format = ReportFormat::Text) : fmt(format) {}
+
+    // show* 共用的线程内缓冲，取出时清空，容量保留下来给下一份报表
+    static ReportBuffer& scratch(ReportFormat format = ReportFormat::Text) {
+        thread_local ReportBuffer buffer;
+        buffer.clear();
+        buffer.fmt = format;
+        return buffer;
+    }
+
+    ReportFormat format() const { return fmt; }
+
+    template <typename... Args>
+    ReportBuffer& print(const Args&... args) {
+        (put(args), ...);
+        return *this;
+    }
+
+    template <typename... Args>
+    ReportBuffer& line(const Args&... args) {
+        (put(args), ...);
+        data.push_back('\n');
+        return *this;
+    }
+
+    ReportBuffer& beginObject(std::string_view name = {}) {
+        open(name, '{');
+        return *this;
+    }
+    ReportBuffer& endObject() {
+        close('}');
+        return *this;
+    }
+    ReportBuffer& beginArray(std::string_view name = {}) {
+        open(name, '[');
+        return *this;
+    }
+    ReportBuffer& endArray() {
+        close(']');
+        return *this;
+    }
+
+    // 对象里的键值；name 为空时是数组元素
+    template <typename T>
+    ReportBuffer& value(std::string_view name, const T& v) {
+        key(name);
+        jsonValue(v);
+        return *this;
+    }
+
+    std::string_view view() const { return data; }
+    size_t size() const { return data.size(); }
+
+    void clear() {
+        data.clear();
+        hasElement = 0;
+        depth = 0;
+    }
+
+    // 一次写出并清空
+    void writeTo(std::ostream& out) {
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        out.flush();
+        clear();
+    }
+};
 
 // 基础人员类（抽象基类）
 class Person {
@@ -23,14 +229,20 @@ public:
     virtual ~Person() = default;
 
     // 纯虚函数，子类必须实现
-    virtual void introduce() const = 0;
+    virtual void renderIntroduction(ReportBuffer& out) const = 0;
     virtual std::string getRole() const = 0;
 
+    void introduce() const {
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderIntroduction(out);
+        out.writeTo(std::cout);
+    }
+
     // 普通成员函数
-    std::string getName() const { return name; }
+    const std::string& getName() const { return name; }
     int getAge() const { return age; }
-    std::string getGender() const { return gender; }
-    std::string getId() const { return id; }
+    const std::string& getGender() const { return gender; }
+    const std::string& getId() const { return id; }
 
     void setAge(int newAge) { age = newAge; }
 
@@ -48,6 +260,13 @@ private:
     std::map<std::string, int> grades;
     bool isActive;
     int graduationYear;
+    ColumnRef statRow;
+
+    void syncStatRow() {
+        if (!statRow.columns) return;
+        statRow.columns->activeGpa[statRow.row] = isActive ? gpa : 0.0;
+        statRow.columns->active[statRow.row] = isActive;
+    }
 
 public:
     Student(const std::string& name, int age, const std::string& gender, const std::string& id,
@@ -56,9 +275,13 @@ public:
           gpa(0.0), isActive(true), graduationYear(graduationYear) {}
 
     // 重写虚函数
-    void introduce() const override {
-        std::cout << "大家好，我是学生 " << name << "，学号：" << studentNumber
-                  << "，专业：" << major << "，GPA：" << gpa << std::endl;
+    void renderIntroduction(ReportBuffer& out) const override {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("role", "学生").value("name", name).value("studentNumber", studentNumber)
+                .value("major", major).value("gpa", gpa).endObject();
+            return;
+        }
+        out.line("大家好，我是学生 ", name, "，学号：", studentNumber, "，专业：", major, "，GPA：", gpa);
     }
 
     std::string getRole() const override {
@@ -80,6 +303,7 @@ public:
     void calculateGPA() {
         if (grades.empty()) {
             gpa = 0.0;
+            syncStatRow();
             return;
         }
 
@@ -88,6 +312,7 @@ public:
                                        return sum + p.second;
                                    });
         gpa = static_cast<double>(total) / grades.size();
+        syncStatRow();
     }
 
     // 获取所有课程
@@ -98,24 +323,47 @@ public:
         auto it = grades.find(course);
         return it != grades.end() ? it->second : 0;
     }
+    const std::map<std::string, int>& getGrades() const { return grades; }
 
     // 获取学生信息
-    std::string getStudentNumber() const { return studentNumber; }
-    std::string getMajor() const { return major; }
+    const std::string& getStudentNumber() const { return studentNumber; }
+    const std::string& getMajor() const { return major; }
     double getGPA() const { return gpa; }
     bool getActiveStatus() const { return isActive; }
     int getGraduationYear() const { return graduationYear; }
 
     // 设置状态
-    void setActiveStatus(bool status) { isActive = status; }
+    void setActiveStatus(bool status) {
+        isActive = status;
+        syncStatRow();
+    }
 
-    // 显示所有成绩
-    void showAllGrades() const {
-        std::cout << name << " 的成绩单：" << std::endl;
+    // 统计列的登记，由 School 调用
+    const ColumnRef& getStatRow() const { return statRow; }
+    void setStatRow(const ColumnRef& ref) { statRow = ref; }
+
+    // 成绩单
+    void renderGrades(ReportBuffer& out) const {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("name", name).beginArray("grades");
+            for (const auto& grade : grades) {
+                out.beginObject().value("course", grade.first).value("grade", grade.second).endObject();
+            }
+            out.endArray().value("gpa", gpa).endObject();
+            return;
+        }
+        out.line(name, " 的成绩单：");
         for (const auto& grade : grades) {
-            std::cout << "  " << grade.first << ": " << grade.second << "分" << std::endl;
+            out.line("  ", grade.first, ": ", grade.second, "分");
         }
-        std::cout << "  平均GPA: " << gpa << std::endl;
+        out.line("  平均GPA: ", gpa);
+    }
+
+    // 显示所有成绩
+    void showAllGrades() const {
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderGrades(out);
+        out.writeTo(std::cout);
     }
 };
 
@@ -138,9 +386,13 @@ public:
           title(title), salary(salary), yearsOfExperience(yearsOfExperience) {}
 
     // 重写虚函数
-    void introduce() const override {
-        std::cout << "大家好，我是 " << title << " " << name << "，来自 " << department
-                  << " 系，工作经验：" << yearsOfExperience << " 年" << std::endl;
+    void renderIntroduction(ReportBuffer& out) const override {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("role", "教师").value("name", name).value("title", title)
+                .value("department", department).value("yearsOfExperience", yearsOfExperience).endObject();
+            return;
+        }
+        out.line("大家好，我是 ", title, " ", name, "，来自 ", department, " 系，工作经验：", yearsOfExperience, " 年");
     }
 
     std::string getRole() const override {
@@ -171,34 +423,67 @@ public:
     }
 
     // 获取信息
-    std::string getEmployeeId() const { return employeeId; }
-    std::string getDepartment() const { return department; }
-    std::string getTitle() const { return title; }
+    const std::string& getEmployeeId() const { return employeeId; }
+    const std::string& getDepartment() const { return department; }
+    const std::string& getTitle() const { return title; }
     double getSalary() const { return salary; }
     int getYearsOfExperience() const { return yearsOfExperience; }
+    const std::vector<std::string>& getCourses() const { return courses; }
+    const std::vector<std::shared_ptr<Student>>& getStudents() const { return students; }
 
     // 设置信息
     void setSalary(double newSalary) { salary = newSalary; }
     void setTitle(const std::string& newTitle) { title = newTitle; }
 
-    // 显示所有学生
-    void showAllStudents() const {
-        std::cout << name << " 老师的学生列表：" << std::endl;
+    // 学生列表
+    void renderStudents(ReportBuffer& out) const {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("teacher", name).beginArray("students");
+            for (const auto& student : students) {
+                out.beginObject().value("name", student->getName())
+                    .value("studentNumber", student->getStudentNumber()).endObject();
+            }
+            out.endArray().endObject();
+            return;
+        }
+        out.line(name, " 老师的学生列表：");
         for (const auto& student : students) {
-            std::cout << "  " << student->getName() << " (学号："
-                      << student->getStudentNumber() << ")" << std::endl;
+            out.line("  ", student->getName(), " (学号：", student->getStudentNumber(), ")");
         }
     }
 
-    // 显示所有课程
-    void showAllCourses() const {
-        std::cout << name << " 老师教授的课程：" << std::endl;
+    // 课程列表
+    void renderCourses(ReportBuffer& out) const {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("teacher", name).beginArray("courses");
+            for (const auto& course : courses) out.value({}, course);
+            out.endArray().endObject();
+            return;
+        }
+        out.line(name, " 老师教授的课程：");
         for (const auto& course : courses) {
-            std::cout << "  " << course << std::endl;
+            out.line("  ", course);
         }
     }
+
+    // 显示所有学生
+    void showAllStudents() const {
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderStudents(out);
+        out.writeTo(std::cout);
+    }
+
+    // 显示所有课程
+    void showAllCourses() const {
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderCourses(out);
+        out.writeTo(std::cout);
+    }
 };
 
+// 选课结果
+enum class EnrollResult { Enrolled, Full };
+
 // 课程类
 class Course {
 private:
@@ -207,9 +492,33 @@ private:
     int credits;
     std::string description;
     std::shared_ptr<Teacher> teacher;
-    std::vector<std::shared_ptr<Student>> enrolledStudents;
+    // 名单在第一次选课时按容量分配(CAS 发布指针，没抢到的线程释放自己分配的)，
+    // 选课时先用 CAS 预占席位号，再写到自己的位置上，多个线程同时选同一门课也不用加锁，
+    // 名单也不会扩容搬家；没人选的课不占名单的内存
+    std::atomic<std::shared_ptr<Student>*> enrolledStudents{nullptr};
+    std::atomic<int> enrolledCount{0};
     std::map<std::string, int> schedule; // 星期 -> 课时
     int maxCapacity;
+    ColumnRef statRow;
+
+    // 学生的课程列表的分段锁：并发选课时同一个学生可能同时加进几门课
+    static std::mutex& studentLock(const Student* student) {
+        static std::mutex stripes[64];
+        return stripes[(reinterpret_cast<uintptr_t>(student) >> 4) % 64];
+    }
+
+    // 从快照恢复名单和教师时直接写字段：学生和教师的课程列表已经在快照里
+    friend class SchoolSnapshot;
+
+    // 名单的席位数组，还没有时分配一个
+    std::shared_ptr<Student>* rosterSlots() {
+        std::shared_ptr<Student>* slots = enrolledStudents.load(std::memory_order_acquire);
+        if (slots) return slots;
+        auto* fresh = new std::shared_ptr<Student>[maxCapacity];
+        if (enrolledStudents.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel)) return fresh;
+        delete[] fresh;
+        return slots;
+    }
 
 public:
     Course(const std::string& code, const std::string& name, int credits,
@@ -217,6 +526,8 @@ public:
         : courseCode(code), courseName(name), credits(credits),
           description(description), maxCapacity(maxCapacity) {}
 
+    ~Course() { delete[] enrolledStudents.load(std::memory_order_relaxed); }
+
     // 设置授课教师
     void setTeacher(std::shared_ptr<Teacher> t) {
         teacher = t;
@@ -225,15 +536,26 @@ public:
         }
     }
 
+    // 添加学生（不输出，线程安全）。读名单的 show* 要等选课的线程都结束后再调用
+    EnrollResult tryEnroll(const std::shared_ptr<Student>& student) {
+        int seat = enrolledCount.load(std::memory_order_relaxed);
+        do {
+            if (seat >= maxCapacity) return EnrollResult::Full;
+        } while (!enrolledCount.compare_exchange_weak(seat, seat + 1, std::memory_order_relaxed));
+
+        rosterSlots()[seat] = student;
+        if (statRow.columns) __atomic_fetch_add(&statRow.columns->enrolled[statRow.row], 1, __ATOMIC_RELAXED);
+        std::lock_guard<std::mutex> lock(studentLock(student.get()));
+        student->addCourse(courseName);
+        return EnrollResult::Enrolled;
+    }
+
     // 添加学生
     bool enrollStudent(std::shared_ptr<Student> student) {
-        if (enrolledStudents.size() >= maxCapacity) {
+        if (tryEnroll(student) == EnrollResult::Full) {
             std::cout << "课程 " << courseName << " 已满，无法添加学生" << std::endl;
             return false;
         }
-
-        enrolledStudents.push_back(student);
-        student->addCourse(courseName);
         std::cout << "学生 " << student->getName() << " 已成功选课 " << courseName << std::endl;
         return true;
     }
@@ -244,41 +566,331 @@ public:
     }
 
     // 获取信息
-    std::string getCourseCode() const { return courseCode; }
-    std::string getCourseName() const { return courseName; }
+    const std::string& getCourseCode() const { return courseCode; }
+    const std::string& getCourseName() const { return courseName; }
     int getCredits() const { return credits; }
-    std::string getDescription() const { return description; }
-    int getEnrolledCount() const { return enrolledStudents.size(); }
+    const std::string& getDescription() const { return description; }
+    int getEnrolledCount() const { return enrolledCount.load(std::memory_order_relaxed); }
     int getMaxCapacity() const { return maxCapacity; }
-
-    // 显示课程信息
-    void showCourseInfo() const {
-        std::cout << "=== 课程信息 ===" << std::endl;
-        std::cout << "课程代码：" << courseCode << std::endl;
-        std::cout << "课程名称：" << courseName << std::endl;
-        std::cout << "学分：" << credits << std::endl;
-        std::cout << "描述：" << description << std::endl;
-        std::cout << "授课教师：" << (teacher ? teacher->getName() : "待定") << std::endl;
-        std::cout << "选课人数：" << enrolledStudents.size() << "/" << maxCapacity << std::endl;
+    const std::shared_ptr<Teacher>& getTeacher() const { return teacher; }
+    const std::map<std::string, int>& getSchedule() const { return schedule; }
+
+    // 统计列的登记，由 School 调用
+    const ColumnRef& getStatRow() const { return statRow; }
+    void setStatRow(const ColumnRef& ref) { statRow = ref; }
+
+    // 课程信息
+    void renderCourseInfo(ReportBuffer& out) const {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("code", courseCode).value("name", courseName).value("credits", credits)
+                .value("description", description);
+            if (teacher) out.value("teacher", teacher->getName());
+            else out.value("teacher", nullptr);
+            out.value("enrolled", getEnrolledCount()).value("capacity", maxCapacity).beginArray("schedule");
+            for (const auto& s : schedule) {
+                out.beginObject().value("day", s.first).value("hours", s.second).endObject();
+            }
+            out.endArray().endObject();
+            return;
+        }
+        out.line("=== 课程信息 ===")
+            .line("课程代码：", courseCode)
+            .line("课程名称：", courseName)
+            .line("学分：", credits)
+            .line("描述：", description)
+            .line("授课教师：", teacher ? std::string_view(teacher->getName()) : std::string_view("待定"))
+            .line("选课人数：", getEnrolledCount(), "/", maxCapacity);
 
         if (!schedule.empty()) {
-            std::cout << "上课时间：" << std::endl;
+            out.line("上课时间：");
             for (const auto& s : schedule) {
-                std::cout << "  " << s.first << ": " << s.second << " 课时" << std::endl;
+                out.line("  ", s.first, ": ", s.second, " 课时");
             }
         }
     }
 
+    // 选课学生名单
+    void renderEnrolledStudents(ReportBuffer& out) const {
+        int count = getEnrolledCount();
+        const std::shared_ptr<Student>* slots = enrolledStudents.load(std::memory_order_acquire);
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("course", courseName).beginArray("students");
+            for (int i = 0; i < count; i++) {
+                out.beginObject().value("name", slots[i]->getName())
+                    .value("studentNumber", slots[i]->getStudentNumber()).endObject();
+            }
+            out.endArray().endObject();
+            return;
+        }
+        out.line(courseName, " 选课学生名单：");
+        for (int i = 0; i < count; i++) {
+            const auto& student = slots[i];
+            out.line("  ", student->getName(), " (学号：", student->getStudentNumber(), ")");
+        }
+    }
+
+    // 显示课程信息
+    void showCourseInfo() const {
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderCourseInfo(out);
+        out.writeTo(std::cout);
+    }
+
     // 显示选课学生
     void showEnrolledStudents() const {
-        std::cout << courseName << " 选课学生名单：" << std::endl;
-        for (const auto& student : enrolledStudents) {
-            std::cout << "  " << student->getName() << " (学号："
-                      << student->getStudentNumber() << ")" << std::endl;
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderEnrolledStudents(out);
+        out.writeTo(std::cout);
+    }
+
+    // 当前名单的副本
+    std::vector<std::shared_ptr<Student>> getEnrolledStudents() const {
+        const std::shared_ptr<Student>* slots = enrolledStudents.load(std::memory_order_acquire);
+        if (!slots) return {};
+        return std::vector<std::shared_ptr<Student>>(slots, slots + getEnrolledCount());
+    }
+};
+
+// 一批选课的结果：计数和攒起来的消息，最后一次写出
+struct EnrollmentReport {
+    size_t enrolled = 0;
+    size_t rejected = 0;
+    std::string messages;
+
+    void merge(EnrollmentReport&& other) {
+        enrolled += other.enrolled;
+        rejected += other.rejected;
+        messages += other.messages;
+    }
+
+    void flush(std::ostream& out) {
+        out.write(messages.data(), static_cast<std::streamsize>(messages.size()));
+        out.flush();
+        messages.clear();
+    }
+};
+
+// 批量/并发选课
+class Registrar {
+public:
+    struct Request {
+        std::shared_ptr<Course> course;
+        std::shared_ptr<Student> student;
+    };
+
+    // 把 requests 分给 threads 个线程处理；每个线程把消息记在自己的报告里，结束后按线程顺序合并。
+    // withMessages 为 false 时只计数
+    static EnrollmentReport enrollBatch(const std::vector<Request>& requests, unsigned threads = 1,
+                                        bool withMessages = true) {
+        threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(requests.size() / 64 + 1)));
+        std::vector<EnrollmentReport> reports(threads);
+        auto work = [&](unsigned t) {
+            size_t begin = requests.size() * t / threads, end = requests.size() * (t + 1) / threads;
+            EnrollmentReport& report = reports[t];
+            for (size_t i = begin; i < end; i++) {
+                const Request& r = requests[i];
+                if (r.course->tryEnroll(r.student) == EnrollResult::Enrolled) {
+                    report.enrolled++;
+                    if (withMessages) {
+                        report.messages.append("学生 ").append(r.student->getName()).append(" 已成功选课 ")
+                            .append(r.course->getCourseName()).append("\n");
+                    }
+                } else {
+                    report.rejected++;
+                    if (withMessages) {
+                        report.messages.append("课程 ").append(r.course->getCourseName()).append(" 已满，无法添加学生\n");
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) workers.emplace_back(work, t);
+        work(0);
+        for (auto& w : workers) w.join();
+        for (unsigned t = 1; t < threads; t++) reports[0].merge(std::move(reports[t]));
+        return std::move(reports[0]);
+    }
+};
+
+// 字符串键索引（开放寻址，线性探测）
+// 槽位只保存哈希的高 32 位和元素在 vector 中的下标，键不复制：比较时用 KeyOf 从元素上
+// 取出键，查找参数是 string_view，不构造临时 std::string。元素只追加不删除，下标一直有效。
+template <typename T, typename KeyOf>
+class StringIndex {
+private:
+    struct Slot {
+        uint32_t tag;   // 哈希高 32 位
+        uint32_t pos;   // 下标 + 1，0 表示空槽
+    };
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    static uint64_t hashOf(std::string_view key) {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    void rehash(size_t newSize, const std::vector<T>& items) {
+        std::vector<Slot> old(newSize, Slot{0, 0});
+        old.swap(slots);
+        for (const auto& slot : old) {
+            if (slot.pos == 0) continue;
+            uint64_t h = hashOf(KeyOf{}(items[slot.pos - 1]));
+            size_t i = h & (slots.size() - 1);
+            while (slots[i].pos != 0) i = (i + 1) & (slots.size() - 1);
+            slots[i] = slot;
+        }
+    }
+
+public:
+    void reserve(size_t n, const std::vector<T>& items) {
+        size_t size = 16;
+        while (size * 7 < n * 10) size *= 2;
+        if (size > slots.size()) rehash(size, items);
+    }
+
+    // 返回元素下标，没有则返回 -1
+    int64_t find(std::string_view key, const std::vector<T>& items) const {
+        if (slots.empty()) return -1;
+        uint64_t h = hashOf(key);
+        uint32_t tag = static_cast<uint32_t>(h >> 32);
+        for (size_t i = h & (slots.size() - 1); slots[i].pos != 0; i = (i + 1) & (slots.size() - 1)) {
+            if (slots[i].tag == tag && KeyOf{}(items[slots[i].pos - 1]) == key) {
+                return slots[i].pos - 1;
+            }
         }
+        return -1;
     }
+
+    // items[pos] 已经加入 vector；键重复时保留先加入的元素（与顺序查找的结果一致）
+    void insert(size_t pos, const std::vector<T>& items) {
+        if ((count + 1) * 10 > slots.size() * 7) rehash(slots.empty() ? 16 : slots.size() * 2, items);
+        std::string_view key = KeyOf{}(items[pos]);
+        uint64_t h = hashOf(key);
+        uint32_t tag = static_cast<uint32_t>(h >> 32);
+        size_t i = h & (slots.size() - 1);
+        for (; slots[i].pos != 0; i = (i + 1) & (slots.size() - 1)) {
+            if (slots[i].tag == tag && KeyOf{}(items[slots[i].pos - 1]) == key) return;
+        }
+        slots[i] = Slot{tag, static_cast<uint32_t>(pos + 1)};
+        count++;
+    }
+};
+
+struct StudentNumberKey {
+    std::string_view operator()(const std::shared_ptr<Student>& s) const { return s->getStudentNumber(); }
+};
+struct EmployeeIdKey {
+    std::string_view operator()(const std::shared_ptr<Teacher>& t) const { return t->getEmployeeId(); }
+};
+struct CourseCodeKey {
+    std::string_view operator()(const std::shared_ptr<Course>& c) const { return c->getCourseCode(); }
+};
+
+// 学校统计信息
+struct SchoolStatistics {
+    size_t students = 0;
+    size_t activeStudents = 0;
+    double averageGPA = 0.0;          // 在校学生
+    size_t teachers = 0;
+    double averageExperience = 0.0;   // 年
+    size_t courses = 0;
+    double averageEnrolled = 0.0;
 };
 
+// 列上的统计内核：GCC 向量扩展，用 16 字节向量（x86-64 的 SSE2 基线上每个都是一条指令，
+// 32 字节向量在没有 AVX 时会被拆开并来回倒栈）；超过 kParallelThreshold 个元素时
+// 切成几段由多个线程各自计算再合并
+namespace statkernel {
+
+typedef double v2df __attribute__((vector_size(16)));
+typedef uint8_t v16qu __attribute__((vector_size(16)));
+typedef int32_t v2si __attribute__((vector_size(8)));
+typedef int64_t v2di __attribute__((vector_size(16)));
+
+const size_t kParallelThreshold = 1 << 20;
+const size_t kMinChunk = 1 << 18;     // 每个线程至少处理的元素数
+
+inline double sumDouble(const double* v, size_t begin, size_t end) {
+    v2df s0 = {0, 0}, s1 = {0, 0}, s2 = {0, 0}, s3 = {0, 0};
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        v2df x0, x1, x2, x3;
+        std::memcpy(&x0, v + i, sizeof(x0));
+        std::memcpy(&x1, v + i + 2, sizeof(x1));
+        std::memcpy(&x2, v + i + 4, sizeof(x2));
+        std::memcpy(&x3, v + i + 6, sizeof(x3));
+        s0 += x0;
+        s1 += x1;
+        s2 += x2;
+        s3 += x3;
+    }
+    v2df s = (s0 + s1) + (s2 + s3);
+    double r = s[0] + s[1];
+    for (; i < end; i++) r += v[i];
+    return r;
+}
+
+// 0/1 字节的个数：按字节累加，每 255 轮（不会溢出）汇总一次
+inline size_t sumFlags(const uint8_t* v, size_t begin, size_t end) {
+    size_t total = 0, i = begin;
+    while (i + 16 <= end) {
+        v16qu acc = {};
+        size_t stop = std::min(end, i + 255 * 16);
+        for (; i + 16 <= stop; i += 16) {
+            v16qu x;
+            std::memcpy(&x, v + i, sizeof(x));
+            acc += x;
+        }
+        for (int k = 0; k < 16; k++) total += acc[k];
+    }
+    for (; i < end; i++) total += v[i];
+    return total;
+}
+
+inline int64_t sumInt32(const int32_t* v, size_t begin, size_t end) {
+    v2di s0 = {0, 0}, s1 = {0, 0};
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        v2si x0, x1;
+        std::memcpy(&x0, v + i, sizeof(x0));
+        std::memcpy(&x1, v + i + 2, sizeof(x1));
+        s0 += __builtin_convertvector(x0, v2di);
+        s1 += __builtin_convertvector(x1, v2di);
+    }
+    v2di s = s0 + s1;
+    int64_t r = s[0] + s[1];
+    for (; i < end; i++) r += v[i];
+    return r;
+}
+
+// n 个元素时使用的线程数（hardware_concurrency 每次都要读 /sys，只取一次）
+inline size_t threadsFor(size_t n) {
+    static const size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    return n < kParallelThreshold ? 1 : std::max<size_t>(1, std::min(cpus, n / kMinChunk));
+}
+
+// 把 [0, n) 分段交给 kernel(begin, end)，用 combine 合并各段结果
+template <typename R, typename Kernel, typename Combine>
+R reduce(size_t n, Kernel kernel, Combine combine) {
+    size_t threads = threadsFor(n);
+    if (threads <= 1) return kernel(0, n);
+
+    std::vector<R> partial(threads);
+    std::vector<std::thread> workers;
+    size_t chunk = (n + threads - 1) / threads;
+    for (size_t t = 1; t < threads; t++) {
+        workers.emplace_back([&, t] { partial[t] = kernel(t * chunk, std::min(n, (t + 1) * chunk)); });
+    }
+    partial[0] = kernel(0, chunk);
+    for (auto& w : workers) w.join();
+    R r = partial[0];
+    for (size_t t = 1; t < threads; t++) r = combine(r, partial[t]);
+    return r;
+}
+
+} // namespace statkernel
+
 // 学校类
 class School {
 private:
@@ -289,27 +901,95 @@ private:
     std::vector<std::shared_ptr<Course>> courses;
     std::map<std::string, std::string> departments;
     int establishedYear;
+    bool verbose = true;
+
+    // 按学号/教工号/课程代码的索引，随 add* 更新
+    StringIndex<std::shared_ptr<Student>, StudentNumberKey> studentIndex;
+    StringIndex<std::shared_ptr<Teacher>, EmployeeIdKey> teacherIndex;
+    StringIndex<std::shared_ptr<Course>, CourseCodeKey> courseIndex;
+
+    // 统计列，与 students/teachers/courses 按下标对应。实体已经登记在别的学校时
+    // 列不会随它更新，这时 columnsExact 为 false，统计退回逐个对象读取
+    std::unique_ptr<StatColumns> columns = std::make_unique<StatColumns>();
+    bool columnsExact = true;
+
+    template <typename T>
+    void attachRow(T& entity, size_t row) {
+        if (entity.getStatRow().columns) {
+            columnsExact = false;
+            return;
+        }
+        entity.setStatRow(ColumnRef{columns.get(), static_cast<uint32_t>(row)});
+    }
+
+    template <typename T>
+    void detachRows(std::vector<std::shared_ptr<T>>& items) {
+        for (auto& item : items) {
+            if (item->getStatRow().columns == columns.get()) item->setStatRow(ColumnRef{});
+        }
+    }
 
 public:
     School(const std::string& name, const std::string& address, int establishedYear)
         : schoolName(name), address(address), establishedYear(establishedYear) {}
 
+    // 实体登记了指向本学校统计列的行号，学校不能复制
+    School(const School&) = delete;
+    School& operator=(const School&) = delete;
+
+    ~School() {
+        detachRows(students);
+        detachRows(courses);
+    }
+
+    // 批量导入时关闭逐条输出
+    void setVerbose(bool v) { verbose = v; }
+
+    // 预留容量，批量导入前调用可以避免反复扩容
+    void reserve(size_t nStudents, size_t nTeachers, size_t nCourses) {
+        students.reserve(nStudents);
+        teachers.reserve(nTeachers);
+        courses.reserve(nCourses);
+        columns->activeGpa.reserve(nStudents);
+        columns->active.reserve(nStudents);
+        columns->experience.reserve(nTeachers);
+        columns->enrolled.reserve(nCourses);
+        studentIndex.reserve(nStudents, students);
+        teacherIndex.reserve(nTeachers, teachers);
+        courseIndex.reserve(nCourses, courses);
+    }
+
     // 添加学生
     void addStudent(std::shared_ptr<Student> student) {
         students.push_back(student);
-        std::cout << "学生 " << student->getName() << " 已加入 " << schoolName << std::endl;
+        studentIndex.insert(students.size() - 1, students);
+        columns->activeGpa.push_back(student->getActiveStatus() ? student->getGPA() : 0.0);
+        columns->active.push_back(student->getActiveStatus());
+        attachRow(*student, students.size() - 1);
+        if (verbose) {
+            std::cout << "学生 " << student->getName() << " 已加入 " << schoolName << std::endl;
+        }
     }
 
     // 添加教师
     void addTeacher(std::shared_ptr<Teacher> teacher) {
         teachers.push_back(teacher);
-        std::cout << "教师 " << teacher->getName() << " 已加入 " << schoolName << std::endl;
+        teacherIndex.insert(teachers.size() - 1, teachers);
+        columns->experience.push_back(teacher->getYearsOfExperience());  // 没有修改接口，不用登记
+        if (verbose) {
+            std::cout << "教师 " << teacher->getName() << " 已加入 " << schoolName << std::endl;
+        }
     }
 
     // 添加课程
     void addCourse(std::shared_ptr<Course> course) {
         courses.push_back(course);
-        std::cout << "课程 " << course->getCourseName() << " 已添加到 " << schoolName << std::endl;
+        courseIndex.insert(courses.size() - 1, courses);
+        columns->enrolled.push_back(course->getEnrolledCount());
+        attachRow(*course, courses.size() - 1);
+        if (verbose) {
+            std::cout << "课程 " << course->getCourseName() << " 已添加到 " << schoolName << std::endl;
+        }
     }
 
     // 添加院系
@@ -318,97 +998,167 @@ public:
     }
 
     // 查找学生
-    std::shared_ptr<Student> findStudent(const std::string& studentNumber) {
-        for (auto& student : students) {
-            if (student->getStudentNumber() == studentNumber) {
-                return student;
-            }
-        }
-        return nullptr;
+    std::shared_ptr<Student> findStudent(std::string_view studentNumber) const {
+        int64_t pos = studentIndex.find(studentNumber, students);
+        return pos >= 0 ? students[pos] : nullptr;
     }
 
     // 查找教师
-    std::shared_ptr<Teacher> findTeacher(const std::string& employeeId) {
-        for (auto& teacher : teachers) {
-            if (teacher->getEmployeeId() == employeeId) {
-                return teacher;
-            }
-        }
-        return nullptr;
+    std::shared_ptr<Teacher> findTeacher(std::string_view employeeId) const {
+        int64_t pos = teacherIndex.find(employeeId, teachers);
+        return pos >= 0 ? teachers[pos] : nullptr;
     }
 
     // 查找课程
-    std::shared_ptr<Course> findCourse(const std::string& courseCode) {
-        for (auto& course : courses) {
-            if (course->getCourseCode() == courseCode) {
-                return course;
-            }
+    std::shared_ptr<Course> findCourse(std::string_view courseCode) const {
+        int64_t pos = courseIndex.find(courseCode, courses);
+        return pos >= 0 ? courses[pos] : nullptr;
+    }
+
+    const std::vector<std::shared_ptr<Student>>& getStudents() const { return students; }
+    const std::vector<std::shared_ptr<Teacher>>& getTeachers() const { return teachers; }
+    const std::vector<std::shared_ptr<Course>>& getCourses() const { return courses; }
+    const std::map<std::string, std::string>& getDepartments() const { return departments; }
+
+    // 学校信息
+    void renderSchoolInfo(ReportBuffer& out) const {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("name", schoolName).value("address", address)
+                .value("establishedYear", establishedYear).value("students", students.size())
+                .value("teachers", teachers.size()).value("courses", courses.size())
+                .value("departments", departments.size()).endObject();
+            return;
+        }
+        out.line("=== 学校信息 ===")
+            .line("学校名称：", schoolName)
+            .line("学校地址：", address)
+            .line("建校年份：", establishedYear)
+            .line("学生人数：", students.size())
+            .line("教师人数：", teachers.size())
+            .line("课程数量：", courses.size())
+            .line("院系数量：", departments.size());
+    }
+
+    // 院系列表
+    void renderDepartments(ReportBuffer& out) const {
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("school", schoolName).beginObject("departments");
+            for (const auto& dept : departments) out.value(dept.first, dept.second);
+            out.endObject().endObject();
+            return;
+        }
+        out.line(schoolName, " 院系列表：");
+        for (const auto& dept : departments) {
+            out.line("  ", dept.first, ": ", dept.second);
         }
-        return nullptr;
     }
 
     // 显示学校信息
     void showSchoolInfo() const {
-        std::cout << "=== 学校信息 ===" << std::endl;
-        std::cout << "学校名称：" << schoolName << std::endl;
-        std::cout << "学校地址：" << address << std::endl;
-        std::cout << "建校年份：" << establishedYear << std::endl;
-        std::cout << "学生人数：" << students.size() << std::endl;
-        std::cout << "教师人数：" << teachers.size() << std::endl;
-        std::cout << "课程数量：" << courses.size() << std::endl;
-        std::cout << "院系数量：" << departments.size() << std::endl;
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderSchoolInfo(out);
+        out.writeTo(std::cout);
     }
 
     // 显示所有院系
     void showAllDepartments() const {
-        std::cout << schoolName << " 院系列表：" << std::endl;
-        for (const auto& dept : departments) {
-            std::cout << "  " << dept.first << ": " << dept.second << std::endl;
-        }
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderDepartments(out);
+        out.writeTo(std::cout);
     }
 
-    // 显示统计信息
-    void showStatistics() const {
-        std::cout << "=== 学校统计信息 ===" << std::endl;
+    // 计算统计信息：在统计列上做向量化（必要时多线程）的求和
+    SchoolStatistics computeStatistics() const {
+        if (!columnsExact) return computeStatisticsByObject();
+
+        const StatColumns& c = *columns;
+        SchoolStatistics stats;
+        stats.students = students.size();
+        stats.teachers = teachers.size();
+        stats.courses = courses.size();
+
+        // 各列分别归约；列的元素和结果类型决定用哪个内核
+        auto sumColumn = [](const auto& v, auto kernel) {
+            using R = decltype(kernel(v.data(), 0, 0));
+            return statkernel::reduce<R>(
+                v.size(), [&](size_t b, size_t e) { return kernel(v.data(), b, e); },
+                [](R x, R y) { return x + y; });
+        };
+        double totalGPA = sumColumn(c.activeGpa, statkernel::sumDouble);
+        size_t active = sumColumn(c.active, statkernel::sumFlags);
+        int64_t experience = sumColumn(c.experience, statkernel::sumInt32);
+        int64_t enrolled = sumColumn(c.enrolled, statkernel::sumInt32);
+
+        stats.activeStudents = active;
+        if (active) stats.averageGPA = totalGPA / active;
+        if (stats.teachers) stats.averageExperience = static_cast<double>(experience) / stats.teachers;
+        if (stats.courses) stats.averageEnrolled = static_cast<double>(enrolled) / stats.courses;
+        return stats;
+    }
+
+    // 逐个对象读取的统计（原来的做法），实体登记在别的学校时使用，也用于对照
+    SchoolStatistics computeStatisticsByObject() const {
+        SchoolStatistics stats;
+        stats.students = students.size();
+        stats.teachers = teachers.size();
+        stats.courses = courses.size();
 
-        // 学生平均GPA
         double totalGPA = 0.0;
-        int activeStudents = 0;
         for (const auto& student : students) {
             if (student->getActiveStatus()) {
                 totalGPA += student->getGPA();
-                activeStudents++;
+                stats.activeStudents++;
             }
         }
-
-        if (activeStudents > 0) {
-            std::cout << "在校学生平均GPA：" << totalGPA / activeStudents << std::endl;
-        }
-
-        // 教师平均工作经验
-        int totalExperience = 0;
+        int64_t totalExperience = 0;
         for (const auto& teacher : teachers) {
             totalExperience += teacher->getYearsOfExperience();
         }
-
-        if (!teachers.empty()) {
-            std::cout << "教师平均工作经验：" << static_cast<double>(totalExperience) / teachers.size() << " 年" << std::endl;
-        }
-
-        // 课程平均选课人数
-        int totalEnrolled = 0;
+        int64_t totalEnrolled = 0;
         for (const auto& course : courses) {
             totalEnrolled += course->getEnrolledCount();
         }
 
-        if (!courses.empty()) {
-            std::cout << "课程平均选课人数：" << static_cast<double>(totalEnrolled) / courses.size() << " 人" << std::endl;
+        if (stats.activeStudents) stats.averageGPA = totalGPA / stats.activeStudents;
+        if (stats.teachers) stats.averageExperience = static_cast<double>(totalExperience) / stats.teachers;
+        if (stats.courses) stats.averageEnrolled = static_cast<double>(totalEnrolled) / stats.courses;
+        return stats;
+    }
+
+    // 统计信息
+    void renderStatistics(ReportBuffer& out) const {
+        SchoolStatistics stats = computeStatistics();
+        if (out.format() == ReportFormat::Json) {
+            out.beginObject().value("students", stats.students).value("activeStudents", stats.activeStudents)
+                .value("teachers", stats.teachers).value("courses", stats.courses);
+            if (stats.activeStudents > 0) out.value("averageGPA", stats.averageGPA);
+            if (stats.teachers > 0) out.value("averageExperience", stats.averageExperience);
+            if (stats.courses > 0) out.value("averageEnrolled", stats.averageEnrolled);
+            out.endObject();
+            return;
+        }
+        out.line("=== 学校统计信息 ===");
+        if (stats.activeStudents > 0) {
+            out.line("在校学生平均GPA：", stats.averageGPA);
+        }
+        if (stats.teachers > 0) {
+            out.line("教师平均工作经验：", stats.averageExperience, " 年");
+        }
+        if (stats.courses > 0) {
+            out.line("课程平均选课人数：", stats.averageEnrolled, " 人");
         }
     }
 
+    // 显示统计信息
+    void showStatistics() const {
+        ReportBuffer& out = ReportBuffer::scratch();
+        renderStatistics(out);
+        out.writeTo(std::cout);
+    }
+
     // 获取信息
-    std::string getSchoolName() const { return schoolName; }
-    std::string getAddress() const { return address; }
+    const std::string& getSchoolName() const { return schoolName; }
+    const std::string& getAddress() const { return address; }
     int getEstablishedYear() const { return establishedYear; }
 
     // 获取历史（计算学校存在年数）
@@ -419,48 +1169,1966 @@ public:
     }
 };
 
-// 实用工具类
-class Utility {
+// ===== School 快照 =====
+// 把整个 School（院系、课程和时间表、名单、学生、教师）写成一个二进制文件，启动时 mmap 进来直接读，
+// 不用重新构造对象图。文件里没有指针：记录之间用下标引用，字符串是指向字符串区的 (偏移, 长度)，
+// 映射到任何地址都能用。读取返回指向映射内存的 string_view；某个实体要修改时才构造成完整的
+// Student/Teacher/Course 对象，之后对它的读取都走这个对象。
+//
+//   Header | 学生 | 教师 | 课程 | 院系 | 条目 | 引用 | 学号索引 | 教工号索引 | 课程代码索引 | 字符串
+//
+// 各区 8 字节对齐，位置和长度记在 Header 里。格式有变化时增加 kVersion，旧版本的文件拒绝打开。
+namespace snapshot {
+
+const char kMagic[8] = {'S', 'C', 'H', 'S', 'N', 'A', 'P', 0};
+const uint32_t kVersion = 1;
+const uint32_t kNone = UINT32_MAX;
+
+struct Str {
+    uint32_t offset;                  // 相对字符串区
+    uint32_t len;
+};
+
+struct Range {
+    uint32_t begin;
+    uint32_t count;
+};
+
+// 课程名、成绩（课程名 + 分数）、时间表（星期 + 课时）
+struct Item {
+    Str text;
+    int32_t value;
+};
+
+struct StudentRecord {
+    Str name, gender, id, studentNumber, major;
+    int32_t age;
+    int32_t graduationYear;
+    double gpa;
+    uint32_t active;
+    Range courses;                    // 条目：课程名
+    Range grades;                     // 条目：课程名和分数
+    uint32_t reserved;                // 补齐 double 的 8 字节对齐，写 0，同样的数据保存出同样的字节
+};
+
+struct TeacherRecord {
+    Str name, gender, id, employeeId, department, title;
+    int32_t age;
+    int32_t yearsOfExperience;
+    double salary;
+    Range courses;                    // 条目：课程名
+    Range students;                   // 引用：学生下标
+};
+
+struct CourseRecord {
+    Str code, name, description;
+    int32_t credits;
+    int32_t maxCapacity;
+    uint32_t teacher;                 // 教师下标，kNone 表示待定
+    Range schedule;                   // 条目：星期和课时
+    Range roster;                     // 引用：学生下标
+};
+
+struct DepartmentRecord {
+    Str code, name;
+};
+
+enum Section {
+    kStudents, kTeachers, kCourses, kDepartments, kItems, kRefs,
+    kStudentIndex, kTeacherIndex, kCourseIndex,   // 开放寻址，存下标 + 1，0 表示空；大小是 2 的幂
+    kStrings,
+    kSectionCount
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    struct {
+        uint64_t offset;
+        uint64_t size;                // 字节数
+    } sections[kSectionCount];
+    Str schoolName, address;
+    int32_t establishedYear;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(StudentRecord) == 80 && sizeof(TeacherRecord) == 80 && sizeof(CourseRecord) == 52 &&
+              sizeof(Item) == 12 && sizeof(Header) == 208, "快照记录的布局是文件格式的一部分");
+
+// FNV-1a，写进文件的索引要求哈希与实现无关
+inline uint32_t hash(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : s) h = (h ^ c) * 16777619u;
+    return h;
+}
+
+} // namespace snapshot
+
+class SchoolSnapshot {
 public:
-    // 生成随机学号
-    static std::string generateStudentNumber() {
-        std::string number = "2024";
-        for (int i = 0; i < 6; i++) {
-            number += std::to_string(rand() % 10);
+    class StudentView;
+    class TeacherView;
+    class CourseView;
+
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+    const snapshot::Header* header = nullptr;
+
+    // 各区的起始位置和元素个数，打开时校验过
+    template <typename T>
+    struct Table {
+        const T* data = nullptr;
+        uint32_t size = 0;
+    };
+    Table<snapshot::StudentRecord> studentRecs;
+    Table<snapshot::TeacherRecord> teacherRecs;
+    Table<snapshot::CourseRecord> courseRecs;
+    Table<snapshot::DepartmentRecord> departmentRecs;
+    Table<snapshot::Item> items;
+    Table<uint32_t> refs;
+    Table<uint32_t> studentIndex, teacherIndex, courseIndex;
+    Table<char> strings;
+
+    // 已经构造成对象的实体，按下标
+    std::unordered_map<uint32_t, std::shared_ptr<Student>> students;
+    std::unordered_map<uint32_t, std::shared_ptr<Teacher>> teachers;
+    std::unordered_map<uint32_t, std::shared_ptr<Course>> courses;
+
+    SchoolSnapshot() = default;
+
+    template <typename T>
+    bool mapSection(snapshot::Section s, Table<T>& table) {
+        const auto& sec = header->sections[s];
+        if (sec.offset % 8 || sec.offset < sizeof(snapshot::Header) || sec.offset > length ||
+            sec.size > length - sec.offset || sec.size % sizeof(T) || sec.size / sizeof(T) > UINT32_MAX) {
+            return false;
         }
-        return number;
+        table.data = reinterpret_cast<const T*>(base + sec.offset);
+        table.size = static_cast<uint32_t>(sec.size / sizeof(T));
+        return true;
     }
 
-    // 生成随机教工号
-    static std::string generateEmployeeId() {
-        std::string id = "T";
-        for (int i = 0; i < 5; i++) {
-            id += std::to_string(rand() % 10);
+    bool validate(const std::string& path) {
+        header = reinterpret_cast<const snapshot::Header*>(base);
+        if (std::memcmp(header->magic, snapshot::kMagic, sizeof(snapshot::kMagic)) != 0) {
+            std::cerr << path << " 不是学校快照文件" << std::endl;
+            return false;
         }
-        return id;
+        if (header->version != snapshot::kVersion || header->headerSize != sizeof(snapshot::Header)) {
+            std::cerr << path << " 的快照版本是 " << header->version << "，当前只支持 " << snapshot::kVersion
+                      << std::endl;
+            return false;
+        }
+        bool ok = header->fileSize == length && mapSection(snapshot::kStudents, studentRecs) &&
+                  mapSection(snapshot::kTeachers, teacherRecs) && mapSection(snapshot::kCourses, courseRecs) &&
+                  mapSection(snapshot::kDepartments, departmentRecs) && mapSection(snapshot::kItems, items) &&
+                  mapSection(snapshot::kRefs, refs) && mapSection(snapshot::kStudentIndex, studentIndex) &&
+                  mapSection(snapshot::kTeacherIndex, teacherIndex) &&
+                  mapSection(snapshot::kCourseIndex, courseIndex) && mapSection(snapshot::kStrings, strings);
+        for (const auto* index : {&studentIndex, &teacherIndex, &courseIndex}) {
+            ok = ok && (index->size & (index->size - 1)) == 0;
+        }
+        if (!ok) std::cerr << path << " 已损坏：文件长度或分区与文件头不符" << std::endl;
+        return ok;
     }
 
-    // 生成随机课程代码
-    static std::string generateCourseCode() {
-        std::string code = "CS";
-        for (int i = 0; i < 3; i++) {
-            code += std::to_string(rand() % 10);
-        }
-        return code;
+    // 下面两个在越界时返回空，损坏的记录不会让读取跑出映射范围
+    std::string_view str(snapshot::Str s) const {
+        if (s.offset > strings.size || s.len > strings.size - s.offset) return {};
+        return std::string_view(strings.data + s.offset, s.len);
     }
 
-    // 格式化输出分割线
-    static void printSeparator(const std::string& title = "") {
-        std::cout << "\n" << std::string(50, '=') << std::endl;
-        if (!title.empty()) {
-            std::cout << title << std::endl;
-            std::cout << std::string(50, '=') << std::endl;
-        }
+    template <typename T>
+    Table<T> slice(const Table<T>& table, snapshot::Range r) const {
+        if (r.begin > table.size || r.count > table.size - r.begin) return {};
+        return Table<T>{table.data + r.begin, r.count};
     }
-};
+
+    template <typename Rec>
+    int64_t lookup(const Table<uint32_t>& index, const Table<Rec>& recs, snapshot::Str Rec::*key,
+                   std::string_view value) const {
+        if (!index.size) return -1;
+        uint32_t mask = index.size - 1;
+        for (uint32_t i = snapshot::hash(value) & mask, probes = 0; index.data[i] && probes < index.size;
+             i = (i + 1) & mask, probes++) {
+            uint32_t row = index.data[i] - 1;
+            if (row < recs.size && str(recs.data[row].*key) == value) return row;
+        }
+        return -1;
+    }
+
+    template <typename T>
+    static const T* find(const std::unordered_map<uint32_t, std::shared_ptr<T>>& objects, uint32_t i) {
+        if (objects.empty()) return nullptr;
+        auto it = objects.find(i);
+        return it != objects.end() ? it->second.get() : nullptr;
+    }
+
+public:
+    SchoolSnapshot(const SchoolSnapshot&) = delete;
+    SchoolSnapshot& operator=(const SchoolSnapshot&) = delete;
+
+    ~SchoolSnapshot() {
+        if (base) munmap(const_cast<char*>(base), length);
+    }
+
+    // 写快照：先写到 path.tmp 再改名，中途失败不会留下半个文件。
+    // 教师的学生、课程的教师和名单都必须是本学校登记过的实体
+    static bool save(const School& school, const std::string& path);
+
+    // 映射并校验文件头，不读取记录；失败时输出原因并返回空
+    static std::unique_ptr<SchoolSnapshot> open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "无法打开快照 " << path << "：" << std::strerror(errno) << std::endl;
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(snapshot::Header))) {
+            std::cerr << path << " 太短，不是学校快照文件" << std::endl;
+            close(fd);
+            return nullptr;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            std::cerr << "无法映射快照 " << path << "：" << std::strerror(errno) << std::endl;
+            return nullptr;
+        }
+        std::unique_ptr<SchoolSnapshot> snap(new SchoolSnapshot());
+        snap->base = static_cast<const char*>(p);
+        snap->length = st.st_size;
+        if (!snap->validate(path)) return nullptr;
+        return snap;
+    }
+
+    // 只读视图：实体构造过对象时读对象，否则读映射的记录。视图和它返回的 string_view
+    // 在快照销毁前有效
+    class StudentView {
+    private:
+        const SchoolSnapshot* snap;
+        const snapshot::StudentRecord* rec;
+        const Student* obj;
+
+    public:
+        StudentView(const SchoolSnapshot* snap, const snapshot::StudentRecord* rec, const Student* obj)
+            : snap(snap), rec(rec), obj(obj) {}
+
+        bool isMaterialized() const { return obj != nullptr; }
+        std::string_view getName() const { return obj ? obj->getName() : snap->str(rec->name); }
+        std::string_view getGender() const { return obj ? obj->getGender() : snap->str(rec->gender); }
+        std::string_view getId() const { return obj ? obj->getId() : snap->str(rec->id); }
+        std::string_view getStudentNumber() const {
+            return obj ? obj->getStudentNumber() : snap->str(rec->studentNumber);
+        }
+        std::string_view getMajor() const { return obj ? obj->getMajor() : snap->str(rec->major); }
+        int getAge() const { return obj ? obj->getAge() : rec->age; }
+        int getGraduationYear() const { return obj ? obj->getGraduationYear() : rec->graduationYear; }
+        double getGPA() const { return obj ? obj->getGPA() : rec->gpa; }
+        bool getActiveStatus() const { return obj ? obj->getActiveStatus() : rec->active != 0; }
+
+        // f(课程名)
+        template <typename F>
+        void forEachCourse(F f) const {
+            if (obj) {
+                for (const auto& c : obj->getCourses()) f(std::string_view(c));
+                return;
+            }
+            auto list = snap->slice(snap->items, rec->courses);
+            for (uint32_t i = 0; i < list.size; i++) f(snap->str(list.data[i].text));
+        }
+
+        // f(课程名, 分数)
+        template <typename F>
+        void forEachGrade(F f) const {
+            if (obj) {
+                for (const auto& g : obj->getGrades()) f(std::string_view(g.first), g.second);
+                return;
+            }
+            auto list = snap->slice(snap->items, rec->grades);
+            for (uint32_t i = 0; i < list.size; i++) f(snap->str(list.data[i].text), int(list.data[i].value));
+        }
+    };
+
+    class TeacherView {
+    private:
+        const SchoolSnapshot* snap;
+        const snapshot::TeacherRecord* rec;
+        const Teacher* obj;
+
+    public:
+        TeacherView(const SchoolSnapshot* snap, const snapshot::TeacherRecord* rec, const Teacher* obj)
+            : snap(snap), rec(rec), obj(obj) {}
+
+        bool isMaterialized() const { return obj != nullptr; }
+        std::string_view getName() const { return obj ? obj->getName() : snap->str(rec->name); }
+        std::string_view getEmployeeId() const { return obj ? obj->getEmployeeId() : snap->str(rec->employeeId); }
+        std::string_view getDepartment() const { return obj ? obj->getDepartment() : snap->str(rec->department); }
+        std::string_view getTitle() const { return obj ? obj->getTitle() : snap->str(rec->title); }
+        double getSalary() const { return obj ? obj->getSalary() : rec->salary; }
+        int getYearsOfExperience() const { return obj ? obj->getYearsOfExperience() : rec->yearsOfExperience; }
+
+        // f(课程名)
+        template <typename F>
+        void forEachCourse(F f) const {
+            if (obj) {
+                for (const auto& c : obj->getCourses()) f(std::string_view(c));
+                return;
+            }
+            auto list = snap->slice(snap->items, rec->courses);
+            for (uint32_t i = 0; i < list.size; i++) f(snap->str(list.data[i].text));
+        }
+    };
+
+    class CourseView {
+    private:
+        const SchoolSnapshot* snap;
+        const snapshot::CourseRecord* rec;
+        const Course* obj;
+
+    public:
+        CourseView(const SchoolSnapshot* snap, const snapshot::CourseRecord* rec, const Course* obj)
+            : snap(snap), rec(rec), obj(obj) {}
+
+        bool isMaterialized() const { return obj != nullptr; }
+        std::string_view getCourseCode() const { return obj ? obj->getCourseCode() : snap->str(rec->code); }
+        std::string_view getCourseName() const { return obj ? obj->getCourseName() : snap->str(rec->name); }
+        std::string_view getDescription() const { return obj ? obj->getDescription() : snap->str(rec->description); }
+        int getCredits() const { return obj ? obj->getCredits() : rec->credits; }
+        int getMaxCapacity() const { return obj ? obj->getMaxCapacity() : rec->maxCapacity; }
+        int getEnrolledCount() const {
+            return obj ? obj->getEnrolledCount() : static_cast<int>(snap->slice(snap->refs, rec->roster).size);
+        }
+
+        // 授课教师的名字，没有时为空
+        std::string_view getTeacherName() const {
+            if (obj) return obj->getTeacher() ? std::string_view(obj->getTeacher()->getName()) : std::string_view();
+            return rec->teacher < snap->teacherRecs.size ? snap->teacherAt(rec->teacher).getName() : std::string_view();
+        }
+
+        // f(星期, 课时)
+        template <typename F>
+        void forEachSchedule(F f) const {
+            if (obj) {
+                for (const auto& s : obj->getSchedule()) f(std::string_view(s.first), s.second);
+                return;
+            }
+            auto list = snap->slice(snap->items, rec->schedule);
+            for (uint32_t i = 0; i < list.size; i++) f(snap->str(list.data[i].text), int(list.data[i].value));
+        }
+
+        // f(StudentView)，按选课顺序
+        template <typename F>
+        void forEachEnrolled(F f) const {
+            if (obj) {
+                for (const auto& s : obj->getEnrolledStudents()) f(StudentView(snap, nullptr, s.get()));
+                return;
+            }
+            auto roster = snap->slice(snap->refs, rec->roster);
+            for (uint32_t i = 0; i < roster.size; i++) {
+                if (roster.data[i] < snap->studentRecs.size) f(snap->studentAt(roster.data[i]));
+            }
+        }
+    };
+
+private:
+    // 不检查下标，调用者已经确认 i 小于记录数
+    StudentView studentAt(uint32_t i) const { return StudentView(this, &studentRecs.data[i], find(students, i)); }
+    TeacherView teacherAt(uint32_t i) const { return TeacherView(this, &teacherRecs.data[i], find(teachers, i)); }
+    CourseView courseAt(uint32_t i) const { return CourseView(this, &courseRecs.data[i], find(courses, i)); }
+
+public:
+
+    std::string_view getSchoolName() const { return str(header->schoolName); }
+    std::string_view getAddress() const { return str(header->address); }
+    int getEstablishedYear() const { return header->establishedYear; }
+    uint32_t studentCount() const { return studentRecs.size; }
+    uint32_t teacherCount() const { return teacherRecs.size; }
+    uint32_t courseCount() const { return courseRecs.size; }
+    uint32_t departmentCount() const { return departmentRecs.size; }
+    size_t fileSize() const { return length; }
+
+    // 按下标取视图，下标超出记录数时为空
+    std::optional<StudentView> student(uint32_t i) const {
+        if (i >= studentRecs.size) return std::nullopt;
+        return studentAt(i);
+    }
+    std::optional<TeacherView> teacher(uint32_t i) const {
+        if (i >= teacherRecs.size) return std::nullopt;
+        return teacherAt(i);
+    }
+    std::optional<CourseView> course(uint32_t i) const {
+        if (i >= courseRecs.size) return std::nullopt;
+        return courseAt(i);
+    }
+
+    // f(院系代码, 院系名称)，按代码排序
+    template <typename F>
+    void forEachDepartment(F f) const {
+        for (uint32_t i = 0; i < departmentRecs.size; i++) {
+            f(str(departmentRecs.data[i].code), str(departmentRecs.data[i].name));
+        }
+    }
+
+    // 按学号/教工号/课程代码查找，返回下标，找不到时为 -1
+    int64_t findStudent(std::string_view studentNumber) const {
+        return lookup(studentIndex, studentRecs, &snapshot::StudentRecord::studentNumber, studentNumber);
+    }
+    int64_t findTeacher(std::string_view employeeId) const {
+        return lookup(teacherIndex, teacherRecs, &snapshot::TeacherRecord::employeeId, employeeId);
+    }
+    int64_t findCourse(std::string_view courseCode) const {
+        return lookup(courseIndex, courseRecs, &snapshot::CourseRecord::code, courseCode);
+    }
+
+    // 取得可修改的对象，第一次调用时从记录构造，之后返回同一个对象。
+    // 教师会连带构造他的学生，课程会连带构造教师和名单里的学生，对象之间的引用和原来的学校一致
+    std::shared_ptr<Student> mutableStudent(uint32_t i) {
+        if (i >= studentRecs.size) return nullptr;
+        auto& slot = students[i];
+        if (slot) return slot;
+        const auto& r = studentRecs.data[i];
+        auto s = std::make_shared<Student>(std::string(str(r.name)), r.age, std::string(str(r.gender)),
+                                           std::string(str(r.id)), std::string(str(r.studentNumber)),
+                                           std::string(str(r.major)), r.graduationYear);
+        auto list = slice(items, r.courses);
+        for (uint32_t k = 0; k < list.size; k++) s->addCourse(std::string(str(list.data[k].text)));
+        list = slice(items, r.grades);
+        for (uint32_t k = 0; k < list.size; k++) s->addGrade(std::string(str(list.data[k].text)), list.data[k].value);
+        s->setActiveStatus(r.active != 0);
+        slot = s;
+        return s;
+    }
+
+    std::shared_ptr<Teacher> mutableTeacher(uint32_t i) {
+        if (i >= teacherRecs.size) return nullptr;
+        if (auto it = teachers.find(i); it != teachers.end()) return it->second;
+        const auto& r = teacherRecs.data[i];
+        auto t = std::make_shared<Teacher>(std::string(str(r.name)), r.age, std::string(str(r.gender)),
+                                           std::string(str(r.id)), std::string(str(r.employeeId)),
+                                           std::string(str(r.department)), std::string(str(r.title)), r.salary,
+                                           r.yearsOfExperience);
+        auto list = slice(items, r.courses);
+        for (uint32_t k = 0; k < list.size; k++) t->addCourse(std::string(str(list.data[k].text)));
+        auto taught = slice(refs, r.students);
+        for (uint32_t k = 0; k < taught.size; k++) {
+            if (auto s = mutableStudent(taught.data[k])) t->addStudent(s);
+        }
+        teachers[i] = t;
+        return t;
+    }
+
+    std::shared_ptr<Course> mutableCourse(uint32_t i) {
+        if (i >= courseRecs.size) return nullptr;
+        if (auto it = courses.find(i); it != courses.end()) return it->second;
+        const auto& r = courseRecs.data[i];
+        auto c = std::make_shared<Course>(std::string(str(r.code)), std::string(str(r.name)), r.credits,
+                                          std::string(str(r.description)), r.maxCapacity);
+        c->teacher = mutableTeacher(r.teacher);
+        auto list = slice(items, r.schedule);
+        for (uint32_t k = 0; k < list.size; k++) c->setSchedule(std::string(str(list.data[k].text)), list.data[k].value);
+        auto roster = slice(refs, r.roster);
+        int seats = 0;
+        for (uint32_t k = 0; k < roster.size && seats < c->maxCapacity; k++) {
+            if (auto s = mutableStudent(roster.data[k])) c->rosterSlots()[seats++] = s;
+        }
+        c->enrolledCount.store(seats, std::memory_order_relaxed);
+        courses[i] = c;
+        return c;
+    }
+
+    // 构造完整的 School（所有实体都会构造成对象），返回的学校关闭了逐条输出
+    std::unique_ptr<School> toSchool() {
+        auto school = std::make_unique<School>(std::string(getSchoolName()), std::string(getAddress()),
+                                               getEstablishedYear());
+        school->setVerbose(false);
+        school->reserve(studentRecs.size, teacherRecs.size, courseRecs.size);
+        forEachDepartment([&](std::string_view code, std::string_view name) {
+            school->addDepartment(std::string(code), std::string(name));
+        });
+        for (uint32_t i = 0; i < studentRecs.size; i++) school->addStudent(mutableStudent(i));
+        for (uint32_t i = 0; i < teacherRecs.size; i++) school->addTeacher(mutableTeacher(i));
+        for (uint32_t i = 0; i < courseRecs.size; i++) school->addCourse(mutableCourse(i));
+        return school;
+    }
+
+    // 与 School::computeStatistics 相同的统计，构造过的实体读对象
+    SchoolStatistics computeStatistics() const {
+        SchoolStatistics stats;
+        stats.students = studentRecs.size;
+        stats.teachers = teacherRecs.size;
+        stats.courses = courseRecs.size;
+        double totalGPA = 0.0;
+        for (uint32_t i = 0; i < studentRecs.size; i++) {
+            StudentView s = studentAt(i);
+            if (s.getActiveStatus()) {
+                totalGPA += s.getGPA();
+                stats.activeStudents++;
+            }
+        }
+        int64_t experience = 0, enrolled = 0;
+        for (uint32_t i = 0; i < teacherRecs.size; i++) experience += teacherAt(i).getYearsOfExperience();
+        for (uint32_t i = 0; i < courseRecs.size; i++) enrolled += courseAt(i).getEnrolledCount();
+        if (stats.activeStudents) stats.averageGPA = totalGPA / stats.activeStudents;
+        if (stats.teachers) stats.averageExperience = static_cast<double>(experience) / stats.teachers;
+        if (stats.courses) stats.averageEnrolled = static_cast<double>(enrolled) / stats.courses;
+        return stats;
+    }
+};
+
+bool SchoolSnapshot::save(const School& school, const std::string& path) {
+    using namespace snapshot;
+    const auto& studentList = school.getStudents();
+    const auto& teacherList = school.getTeachers();
+    const auto& courseList = school.getCourses();
+
+    std::unordered_map<const Student*, uint32_t> studentRow;
+    std::unordered_map<const Teacher*, uint32_t> teacherRow;
+    studentRow.reserve(studentList.size());
+    for (size_t i = 0; i < studentList.size(); i++) studentRow.emplace(studentList[i].get(), i);
+    for (size_t i = 0; i < teacherList.size(); i++) teacherRow.emplace(teacherList[i].get(), i);
+
+    // 相同的字符串只存一份。查重表开放寻址，高 32 位是哈希，低 32 位是 distinct 的下标 + 1
+    std::string blob;
+    std::vector<Str> distinct;
+    std::vector<uint64_t> seen(1024, 0);
+    bool tooLarge = false;
+    auto str = [&](const std::string& s) {
+        if ((distinct.size() + 1) * 2 > seen.size()) {
+            std::vector<uint64_t> bigger(seen.size() * 2, 0);
+            for (uint64_t slot : seen) {
+                if (!slot) continue;
+                size_t i = (slot >> 32) & (bigger.size() - 1);
+                while (bigger[i]) i = (i + 1) & (bigger.size() - 1);
+                bigger[i] = slot;
+            }
+            seen.swap(bigger);
+        }
+        uint32_t h = static_cast<uint32_t>(std::hash<std::string>{}(s));
+        size_t i = h & (seen.size() - 1);
+        for (; seen[i]; i = (i + 1) & (seen.size() - 1)) {
+            if (seen[i] >> 32 != h) continue;
+            Str old = distinct[static_cast<uint32_t>(seen[i]) - 1];
+            if (std::string_view(blob.data() + old.offset, old.len) == s) return old;
+        }
+        if (blob.size() + s.size() > UINT32_MAX) tooLarge = true;
+        distinct.push_back(Str{static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(s.size())});
+        seen[i] = static_cast<uint64_t>(h) << 32 | distinct.size();
+        blob += s;
+        return distinct.back();
+    };
+    std::vector<Item> itemList;
+    std::vector<uint32_t> refList;
+    auto addItems = [&](const auto& container, auto text, auto value) {
+        Range r{static_cast<uint32_t>(itemList.size()), 0};
+        for (const auto& e : container) itemList.push_back(Item{str(text(e)), value(e)});
+        r.count = static_cast<uint32_t>(itemList.size() - r.begin);
+        return r;
+    };
+    auto name = [](const std::string& s) -> const std::string& { return s; };
+    auto zero = [](const std::string&) { return 0; };
+    auto key = [](const auto& p) -> const std::string& { return p.first; };
+    auto second = [](const auto& p) { return static_cast<int32_t>(p.second); };
+    const char* missing = nullptr;
+    auto addRefs = [&](const auto& list) {
+        Range r{static_cast<uint32_t>(refList.size()), 0};
+        for (const auto& s : list) {
+            auto it = studentRow.find(s.get());
+            if (it == studentRow.end()) {
+                missing = "学生";
+                continue;
+            }
+            refList.push_back(it->second);
+        }
+        r.count = static_cast<uint32_t>(refList.size() - r.begin);
+        return r;
+    };
+
+    std::vector<StudentRecord> studentRecs(studentList.size());
+    for (size_t i = 0; i < studentList.size(); i++) {
+        const Student& s = *studentList[i];
+        StudentRecord& r = studentRecs[i];
+        r = StudentRecord{str(s.getName()), str(s.getGender()), str(s.getId()), str(s.getStudentNumber()),
+                          str(s.getMajor()), s.getAge(), s.getGraduationYear(), s.getGPA(), s.getActiveStatus(),
+                          addItems(s.getCourses(), name, zero), addItems(s.getGrades(), key, second), 0};
+    }
+    std::vector<TeacherRecord> teacherRecs(teacherList.size());
+    for (size_t i = 0; i < teacherList.size(); i++) {
+        const Teacher& t = *teacherList[i];
+        teacherRecs[i] = TeacherRecord{str(t.getName()), str(t.getGender()), str(t.getId()),
+                                       str(t.getEmployeeId()), str(t.getDepartment()), str(t.getTitle()),
+                                       t.getAge(), t.getYearsOfExperience(), t.getSalary(),
+                                       addItems(t.getCourses(), name, zero), addRefs(t.getStudents())};
+    }
+    std::vector<CourseRecord> courseRecs(courseList.size());
+    for (size_t i = 0; i < courseList.size(); i++) {
+        const Course& c = *courseList[i];
+        uint32_t teacher = kNone;
+        if (c.getTeacher()) {
+            auto it = teacherRow.find(c.getTeacher().get());
+            if (it != teacherRow.end()) teacher = it->second;
+            else missing = "教师";
+        }
+        courseRecs[i] = CourseRecord{str(c.getCourseCode()), str(c.getCourseName()), str(c.getDescription()),
+                                     c.getCredits(), c.getMaxCapacity(), teacher,
+                                     addItems(c.getSchedule(), key, second), addRefs(c.getEnrolledStudents())};
+    }
+    std::vector<DepartmentRecord> departmentRecs;
+    for (const auto& d : school.getDepartments()) departmentRecs.push_back(DepartmentRecord{str(d.first), str(d.second)});
+    Str schoolName = str(school.getSchoolName()), address = str(school.getAddress());
+
+    if (missing) {
+        std::cerr << "无法保存快照：引用了没有登记在 " << school.getSchoolName() << " 的" << missing << std::endl;
+        return false;
+    }
+    if (tooLarge || itemList.size() > UINT32_MAX || refList.size() > UINT32_MAX) {
+        std::cerr << "无法保存快照：数据超过了 32 位偏移的范围" << std::endl;
+        return false;
+    }
+
+    // 索引：重复的键只登记第一个，与 School 的索引一致
+    auto buildIndex = [&](const auto& recs, Str std::remove_reference_t<decltype(recs[0])>::*field) {
+        uint32_t size = 16;
+        while (size < recs.size() * 2) size <<= 1;
+        std::vector<uint32_t> slots(size, 0);
+        for (size_t row = 0; row < recs.size(); row++) {
+            Str k = recs[row].*field;
+            std::string_view value(blob.data() + k.offset, k.len);
+            uint32_t i = hash(value) & (size - 1);
+            bool duplicate = false;
+            for (; slots[i]; i = (i + 1) & (size - 1)) {
+                Str other = recs[slots[i] - 1].*field;
+                if (std::string_view(blob.data() + other.offset, other.len) == value) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) slots[i] = static_cast<uint32_t>(row + 1);
+        }
+        return slots;
+    };
+    std::vector<uint32_t> studentIdx = buildIndex(studentRecs, &StudentRecord::studentNumber);
+    std::vector<uint32_t> teacherIdx = buildIndex(teacherRecs, &TeacherRecord::employeeId);
+    std::vector<uint32_t> courseIdx = buildIndex(courseRecs, &CourseRecord::code);
+
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.headerSize = sizeof(Header);
+    h.schoolName = schoolName;
+    h.address = address;
+    h.establishedYear = school.getEstablishedYear();
+    const std::pair<const void*, size_t> parts[kSectionCount] = {
+        {studentRecs.data(), studentRecs.size() * sizeof(StudentRecord)},
+        {teacherRecs.data(), teacherRecs.size() * sizeof(TeacherRecord)},
+        {courseRecs.data(), courseRecs.size() * sizeof(CourseRecord)},
+        {departmentRecs.data(), departmentRecs.size() * sizeof(DepartmentRecord)},
+        {itemList.data(), itemList.size() * sizeof(Item)},
+        {refList.data(), refList.size() * sizeof(uint32_t)},
+        {studentIdx.data(), studentIdx.size() * sizeof(uint32_t)},
+        {teacherIdx.data(), teacherIdx.size() * sizeof(uint32_t)},
+        {courseIdx.data(), courseIdx.size() * sizeof(uint32_t)},
+        {blob.data(), blob.size()},
+    };
+    uint64_t offset = sizeof(Header);
+    for (int s = 0; s < kSectionCount; s++) {
+        h.sections[s].offset = offset;
+        h.sections[s].size = parts[s].second;
+        offset = (offset + parts[s].second + 7) & ~uint64_t(7);
+    }
+    h.fileSize = offset;
+
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    for (int s = 0; s < kSectionCount; s++) {
+        static const char zeros[8] = {};
+        out.write(static_cast<const char*>(parts[s].first), static_cast<std::streamsize>(parts[s].second));
+        out.write(zeros, static_cast<std::streamsize>((8 - parts[s].second % 8) % 8));
+    }
+    out.close();
+    if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "无法写入快照 " << path << "：" << std::strerror(errno) << std::endl;
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ===== 紧凑实体存储 =====
+// School 的另一种存储方式：实体、关系和字符串都从少数几块大内存（arena）里顺序分配，
+// 互相用 32 位句柄引用。没有 shared_ptr 的引用计数，也没有每个对象、每个字符串各自的
+// 堆分配；建一个百万实体的学校只需要几十次分配，销毁时整块释放。
+// 只追加不删除，放进去的记录不调用析构函数。
+
+// 顺序分配器：从当前块里切，块用完了再申请一块更大的（1MB 起，翻倍到 64MB）
+class Arena {
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cur = nullptr;
+    size_t left = 0;
+    size_t nextBlock = 1 << 20;
+    size_t reserved = 0;
+
+    static size_t padding(const char* p, size_t align) {
+        return (align - reinterpret_cast<uintptr_t>(p) % align) % align;
+    }
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        size_t pad = padding(cur, align);
+        if (!cur || pad + size > left) {
+            size_t blockSize = std::max(nextBlock, size + align);
+            blocks.emplace_back(new char[blockSize]);
+            cur = blocks.back().get();
+            left = blockSize;
+            reserved += blockSize;
+            nextBlock = std::min<size_t>(nextBlock * 2, 64 << 20);
+            pad = padding(cur, align);
+        }
+        char* p = cur + pad;
+        cur = p + size;
+        left -= pad + size;
+        return p;
+    }
+
+    size_t blockCount() const { return blocks.size(); }
+    size_t bytesReserved() const { return reserved; }
+};
+
+// 类型化的 32 位句柄
+template <typename T>
+struct Handle {
+    static const uint32_t kNone = UINT32_MAX;
+    uint32_t index = kNone;
+
+    bool valid() const { return index != kNone; }
+    bool operator==(Handle other) const { return index == other.index; }
+};
+
+// 定长记录池：每 2^14 个记录一组从 arena 分配，句柄就是序号，记录的地址不会变
+template <typename T>
+class Pool {
+private:
+    static_assert(std::is_trivially_destructible<T>::value, "arena 里的记录不调用析构函数");
+    static const uint32_t kChunkBits = 14;
+    static const uint32_t kChunkSize = 1u << kChunkBits;
+
+    Arena* arena;
+    std::vector<T*> chunks;
+    uint32_t count = 0;
+
+public:
+    explicit Pool(Arena* arena) : arena(arena) {}
+
+    void reserve(size_t n) { chunks.reserve((n + kChunkSize - 1) / kChunkSize); }
+
+    Handle<T> add(const T& value) {
+        if (count % kChunkSize == 0) {
+            chunks.push_back(static_cast<T*>(arena->allocate(sizeof(T) * kChunkSize, alignof(T))));
+        }
+        uint32_t index = count++;
+        new (&chunks[index >> kChunkBits][index & (kChunkSize - 1)]) T(value);
+        return Handle<T>{index};
+    }
+
+    T& operator[](Handle<T> h) { return chunks[h.index >> kChunkBits][h.index & (kChunkSize - 1)]; }
+    const T& operator[](Handle<T> h) const { return chunks[h.index >> kChunkBits][h.index & (kChunkSize - 1)]; }
+    uint32_t size() const { return count; }
+};
+
+// arena 里的字符串。性别、专业、课程名这类重复多的值驻留，相同内容只存一份；
+// 姓名、学号这类几乎每个实体各不相同的值直接复制，不进哈希表
+struct StrEntry {
+    const char* data;
+    uint32_t len;
+    uint32_t hash;
+};
+using StrId = Handle<StrEntry>;
+
+class StringPool {
+private:
+    Arena* arena;
+    Pool<StrEntry> entries;
+    // 开放寻址，高 32 位是哈希，低 32 位是序号 + 1，0 表示空。
+    // 哈希放在表里，探测时不用为了比较去读条目
+    std::vector<uint64_t> table;
+    uint32_t interned = 0;
+
+    void grow() {
+        std::vector<uint64_t> bigger(table.empty() ? 1024 : table.size() * 2, 0);
+        for (uint64_t slot : table) {
+            if (!slot) continue;
+            size_t i = (slot >> 32) & (bigger.size() - 1);
+            while (bigger[i]) i = (i + 1) & (bigger.size() - 1);
+            bigger[i] = slot;
+        }
+        table.swap(bigger);
+    }
+
+public:
+    explicit StringPool(Arena* arena) : arena(arena), entries(arena) {}
+
+    void reserve(size_t nStored, size_t nInterned) {
+        entries.reserve(nStored + nInterned);
+        while (table.size() * 7 < nInterned * 10) grow();
+    }
+
+    // 复制一份，不查重
+    StrId store(std::string_view s) {
+        char* data = static_cast<char*>(arena->allocate(s.size(), 1));
+        std::memcpy(data, s.data(), s.size());
+        return entries.add(StrEntry{data, static_cast<uint32_t>(s.size()), 0});
+    }
+
+    StrId intern(std::string_view s) {
+        if ((interned + 1) * 10 > table.size() * 7) grow();
+        uint32_t hash = static_cast<uint32_t>(std::hash<std::string_view>{}(s));
+        size_t i = hash & (table.size() - 1);
+        for (; table[i]; i = (i + 1) & (table.size() - 1)) {
+            if (table[i] >> 32 != hash) continue;
+            StrId id{static_cast<uint32_t>(table[i]) - 1};
+            const StrEntry& e = entries[id];
+            if (std::string_view(e.data, e.len) == s) return id;
+        }
+        StrId id = store(s);
+        entries[id].hash = hash;
+        table[i] = static_cast<uint64_t>(hash) << 32 | (id.index + 1);
+        interned++;
+        return id;
+    }
+
+    std::string_view view(StrId id) const {
+        if (!id.valid()) return {};
+        const StrEntry& e = entries[id];
+        return std::string_view(e.data, e.len);
+    }
+
+    uint32_t size() const { return entries.size(); }
+    uint32_t internedCount() const { return interned; }
+};
+
+// 一对多关系用单链表表示，节点放在同一个池里，按加入顺序追加在表尾
+struct Link {
+    uint32_t value;                   // 目标的句柄
+    uint32_t aux;                     // 成绩、课时等附带的数
+    Handle<Link> next;
+};
+
+struct LinkList {
+    Handle<Link> head, tail;
+    uint32_t count = 0;
+};
+
+struct StudentRec {
+    StrId name, gender, id, studentNumber, major;
+    int32_t age;
+    int32_t graduationYear;
+    double gpa;
+    int64_t gradeTotal;
+    bool active;
+    LinkList courses;                 // 课程名 StrId
+    LinkList grades;                  // 课程名 StrId，aux 为分数
+};
+
+struct TeacherRec {
+    StrId name, gender, id, employeeId, department, title;
+    int32_t age;
+    int32_t yearsOfExperience;
+    double salary;
+    LinkList courses;                 // 课程名 StrId
+    LinkList students;                // StudentRec 句柄
+};
+
+struct CourseRec {
+    StrId code, name, description;
+    int32_t credits;
+    int32_t maxCapacity;
+    Handle<TeacherRec> teacher;
+    LinkList roster;                  // StudentRec 句柄
+    LinkList schedule;                // 星期 StrId，aux 为课时
+};
+
+class CompactSchool {
+public:
+    using StudentH = Handle<StudentRec>;
+    using TeacherH = Handle<TeacherRec>;
+    using CourseH = Handle<CourseRec>;
+
+private:
+    Arena arena;
+    StringPool strings{&arena};
+    Pool<StudentRec> students{&arena};
+    Pool<TeacherRec> teachers{&arena};
+    Pool<CourseRec> courses{&arena};
+    Pool<Link> links{&arena};
+    StrId schoolName, address;
+    int establishedYear;
+    LinkList departments;             // 院系代码 StrId，aux 为院系名称的 StrId
+
+    void append(LinkList& list, uint32_t value, uint32_t aux = 0) {
+        Handle<Link> h = links.add(Link{value, aux, Handle<Link>{}});
+        if (list.tail.valid()) links[list.tail].next = h;
+        else list.head = h;
+        list.tail = h;
+        list.count++;
+    }
+
+public:
+    CompactSchool(std::string_view name, std::string_view addr, int year) : establishedYear(year) {
+        schoolName = strings.intern(name);
+        address = strings.intern(addr);
+    }
+
+    // 预留句柄表和字符串表，批量导入前调用可以避免反复扩容。nDistinct 是驻留字符串的不同值个数
+    void reserve(size_t nStudents, size_t nTeachers, size_t nCourses, size_t nDistinct, size_t nLinks) {
+        students.reserve(nStudents);
+        teachers.reserve(nTeachers);
+        courses.reserve(nCourses);
+        strings.reserve(nStudents * 3 + nTeachers * 3 + nCourses, nDistinct);
+        links.reserve(nLinks);
+    }
+
+    StudentH addStudent(std::string_view name, int age, std::string_view gender, std::string_view id,
+                        std::string_view studentNumber, std::string_view major, int graduationYear) {
+        StudentRec r{};
+        r.name = strings.store(name);
+        r.gender = strings.intern(gender);
+        r.id = strings.store(id);
+        r.studentNumber = strings.store(studentNumber);
+        r.major = strings.intern(major);
+        r.age = age;
+        r.graduationYear = graduationYear;
+        r.active = true;
+        return students.add(r);
+    }
+
+    TeacherH addTeacher(std::string_view name, int age, std::string_view gender, std::string_view id,
+                        std::string_view employeeId, std::string_view department, std::string_view title,
+                        double salary, int yearsOfExperience) {
+        TeacherRec r{};
+        r.name = strings.store(name);
+        r.gender = strings.intern(gender);
+        r.id = strings.store(id);
+        r.employeeId = strings.store(employeeId);
+        r.department = strings.intern(department);
+        r.title = strings.intern(title);
+        r.age = age;
+        r.yearsOfExperience = yearsOfExperience;
+        r.salary = salary;
+        return teachers.add(r);
+    }
+
+    CourseH addCourse(std::string_view code, std::string_view name, int credits, std::string_view description,
+                      int maxCapacity) {
+        CourseRec r{};
+        r.code = strings.store(code);
+        r.name = strings.intern(name);
+        r.description = strings.intern(description);
+        r.credits = credits;
+        r.maxCapacity = maxCapacity;
+        return courses.add(r);
+    }
+
+    void addDepartment(std::string_view code, std::string_view name) {
+        append(departments, strings.intern(code).index, strings.intern(name).index);
+    }
+
+    void setTeacher(CourseH c, TeacherH t) {
+        courses[c].teacher = t;
+        append(teachers[t].courses, courses[c].name.index);
+    }
+
+    void setSchedule(CourseH c, std::string_view day, int hours) {
+        append(courses[c].schedule, strings.intern(day).index, static_cast<uint32_t>(hours));
+    }
+
+    bool enroll(CourseH c, StudentH s) {
+        CourseRec& course = courses[c];
+        if (course.roster.count >= static_cast<uint32_t>(std::max(course.maxCapacity, 0))) return false;
+        append(course.roster, s.index);
+        append(students[s].courses, course.name.index);
+        return true;
+    }
+
+    void addTeacherStudent(TeacherH t, StudentH s) { append(teachers[t].students, s.index); }
+
+    // 同一门课再次打分时覆盖原来的成绩
+    void addGrade(StudentH s, std::string_view course, int grade) {
+        StudentRec& r = students[s];
+        StrId name = strings.intern(course);
+        for (Handle<Link> h = r.grades.head; h.valid(); h = links[h].next) {
+            if (links[h].value == name.index) {
+                r.gradeTotal += grade - static_cast<int32_t>(links[h].aux);
+                links[h].aux = static_cast<uint32_t>(grade);
+                r.gpa = static_cast<double>(r.gradeTotal) / r.grades.count;
+                return;
+            }
+        }
+        append(r.grades, name.index, static_cast<uint32_t>(grade));
+        r.gradeTotal += grade;
+        r.gpa = static_cast<double>(r.gradeTotal) / r.grades.count;
+    }
+
+    void setActiveStatus(StudentH s, bool active) { students[s].active = active; }
+
+    // 依次以 (value, aux) 调用 f
+    template <typename F>
+    void forEach(const LinkList& list, F f) const {
+        for (Handle<Link> h = list.head; h.valid(); h = links[h].next) f(links[h].value, links[h].aux);
+    }
+
+    const StudentRec& student(StudentH h) const { return students[h]; }
+    const TeacherRec& teacher(TeacherH h) const { return teachers[h]; }
+    const CourseRec& course(CourseH h) const { return courses[h]; }
+    std::string_view str(StrId id) const { return strings.view(id); }
+    std::string_view str(uint32_t index) const { return strings.view(StrId{index}); }
+
+    uint32_t studentCount() const { return students.size(); }
+    uint32_t teacherCount() const { return teachers.size(); }
+    uint32_t courseCount() const { return courses.size(); }
+    uint32_t stringCount() const { return strings.size(); }
+    uint32_t internedCount() const { return strings.internedCount(); }
+    size_t arenaBlocks() const { return arena.blockCount(); }
+    size_t arenaBytes() const { return arena.bytesReserved(); }
+
+    SchoolStatistics computeStatistics() const {
+        SchoolStatistics stats;
+        stats.students = students.size();
+        stats.teachers = teachers.size();
+        stats.courses = courses.size();
+        double totalGPA = 0.0;
+        for (uint32_t i = 0; i < students.size(); i++) {
+            const StudentRec& r = students[StudentH{i}];
+            if (r.active) {
+                totalGPA += r.gpa;
+                stats.activeStudents++;
+            }
+        }
+        int64_t experience = 0, enrolled = 0;
+        for (uint32_t i = 0; i < teachers.size(); i++) experience += teachers[TeacherH{i}].yearsOfExperience;
+        for (uint32_t i = 0; i < courses.size(); i++) enrolled += courses[CourseH{i}].roster.count;
+        if (stats.activeStudents) stats.averageGPA = totalGPA / stats.activeStudents;
+        if (stats.teachers) stats.averageExperience = static_cast<double>(experience) / stats.teachers;
+        if (stats.courses) stats.averageEnrolled = static_cast<double>(enrolled) / stats.courses;
+        return stats;
+    }
+};
+
+// 编号分配器：在 [0, 10^digits) 里不重复地随机取号，格式化成 前缀 + 定宽数字。
+// 已发出的号记在位图里（学号 10^6 个号占 125KB），用原子的 fetch_or 占位，多线程同时取号也不会重复；
+// 随机数用每个线程自己的 xorshift 状态。抽中的号已被占用时向后找同一个字里的空位，
+// 整个字满了再看下一个字，所以号快用完时取号也不会变慢
+struct IdBuffer {
+    char data[24];
+    uint8_t len = 0;
+
+    std::string_view view() const { return std::string_view(data, len); }
+    std::string str() const { return std::string(data, len); }
+};
+
+class IdAllocator {
+private:
+    static const int kMaxDigits = 9;      // 号码空间不超过 2^32，随机数映射到空间时用 32 位乘法
+    char prefix[sizeof(IdBuffer::data) - kMaxDigits];
+    uint8_t prefixLen;
+    int digits;
+    uint64_t space;
+    std::vector<std::atomic<uint64_t>> used;
+    std::atomic<uint64_t> issued{0};
+
+    static uint64_t nextRandom() {
+        static std::atomic<uint64_t> seeds{0x9e3779b97f4a7c15ull};
+        thread_local uint64_t state = 0;
+        if (state == 0) {
+            // splitmix64 打散线程的序号，同样的线程启动顺序得到同样的号码序列
+            uint64_t z = seeds.fetch_add(0x9e3779b97f4a7c15ull, std::memory_order_relaxed);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            state = (z ^ (z >> 31)) | 1;
+        }
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // 在 bit 所在的字里占一个空位（优先 bit 本身和它后面的位），成功时返回号码
+    bool claimInWord(uint64_t word, unsigned bit, uint64_t& number) {
+        uint64_t bits = used[word].load(std::memory_order_relaxed);
+        while (~bits) {
+            uint64_t free = ~bits;
+            uint64_t after = free & (~uint64_t(0) << bit);
+            unsigned pick = __builtin_ctzll(after ? after : free);
+            uint64_t mask = uint64_t(1) << pick;
+            bits = used[word].fetch_or(mask, std::memory_order_relaxed);
+            if (!(bits & mask)) {
+                number = word * 64 + pick;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static uint64_t powerOf10(int n) {
+        uint64_t p = 1;
+        while (n-- > 0) p *= 10;
+        return p;
+    }
+
+    // 先占一个名额，保证位图里还有空位；next 的查找因此总会结束
+    bool reserveQuota() {
+        if (issued.fetch_add(1, std::memory_order_relaxed) < space) return true;
+        issued.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void format(uint64_t number, IdBuffer& out) const {
+        std::memcpy(out.data, prefix, prefixLen);
+        for (int i = prefixLen + digits - 1; i >= prefixLen; i--) {
+            out.data[i] = static_cast<char>('0' + number % 10);
+            number /= 10;
+        }
+        out.len = static_cast<uint8_t>(prefixLen + digits);
+    }
+
+public:
+    IdAllocator(std::string_view prefixText, int digits)
+        : prefixLen(static_cast<uint8_t>(std::min(prefixText.size(), sizeof(prefix)))),
+          digits(std::max(1, std::min(digits, kMaxDigits))), space(powerOf10(this->digits)),
+          used((space + 63) / 64) {
+        std::memcpy(prefix, prefixText.data(), prefixLen);
+        // 最后一个字里超出空间的位先标成已用
+        if (space % 64) used.back().store(~uint64_t(0) << (space % 64), std::memory_order_relaxed);
+    }
+
+    IdAllocator(const IdAllocator&) = delete;
+    IdAllocator& operator=(const IdAllocator&) = delete;
+
+    // 取一个新号写到 out，号码用完时返回 false。线程安全，不分配内存
+    bool next(IdBuffer& out) {
+        if (!reserveQuota()) return false;
+        uint64_t start = (nextRandom() >> 32) * space >> 32;
+        uint64_t word = start / 64, number = 0;
+        if (!claimInWord(word, static_cast<unsigned>(start % 64), number)) {
+            do {
+                word = word + 1 == used.size() ? 0 : word + 1;
+            } while (!claimInWord(word, 0, number));
+        }
+        format(number, out);
+        return true;
+    }
+
+    // 登记一个已经在用的号（例如从快照读回来的学生），之后不会再发出。
+    // 格式不符或者已经登记过时返回 false
+    bool claim(std::string_view id) {
+        if (id.size() != static_cast<size_t>(prefixLen + digits) ||
+            id.substr(0, prefixLen) != std::string_view(prefix, prefixLen)) {
+            return false;
+        }
+        uint64_t number = 0;
+        for (char c : id.substr(prefixLen)) {
+            if (c < '0' || c > '9') return false;
+            number = number * 10 + (c - '0');
+        }
+        if (!reserveQuota()) return false;
+        uint64_t mask = uint64_t(1) << (number % 64);
+        if (used[number / 64].fetch_or(mask, std::memory_order_relaxed) & mask) {
+            issued.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t issuedCount() const { return issued.load(std::memory_order_relaxed); }
+    uint64_t capacity() const { return space; }
+};
+
+// 实用工具类
+class Utility {
+public:
+    // 各类编号的分配器，进程内不重复
+    static IdAllocator& studentNumbers() {
+        static IdAllocator allocator("2024", 6);
+        return allocator;
+    }
+    static IdAllocator& employeeIds() {
+        static IdAllocator allocator("T", 5);
+        return allocator;
+    }
+    static IdAllocator& courseCodes() {
+        static IdAllocator allocator("CS", 4);
+        return allocator;
+    }
+
+    // 取号，号码用完时输出提示并返回空串
+    static std::string generate(IdAllocator& allocator, const char* what) {
+        IdBuffer id;
+        if (!allocator.next(id)) {
+            std::cerr << what << "已经用完（共 " << allocator.capacity() << " 个）" << std::endl;
+            return std::string();
+        }
+        return id.str();
+    }
+
+    // 生成随机学号
+    static std::string generateStudentNumber() { return generate(studentNumbers(), "学号"); }
+
+    // 生成随机教工号
+    static std::string generateEmployeeId() { return generate(employeeIds(), "教工号"); }
+
+    // 生成随机课程代码
+    static std::string generateCourseCode() { return generate(courseCodes(), "课程代码"); }
+
+    // 格式化输出分割线
+    static void printSeparator(const std::string& title = "") {
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        if (!title.empty()) {
+            std::cout << title << std::endl;
+            std::cout << std::string(50, '=') << std::endl;
+        }
+    }
+};
+
+// ===== 基准测试：./hello --bench 名称 =====
+#ifdef HELLO_ALLOC_COUNT
+// operator new 的调用次数，由 alloc_count.cpp 提供，只链接进 make bench 生成的 hello_bench
+size_t heapAllocationCount();
+#endif
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// 基准数据不能用 Utility 的随机编号（规模大了会重复），按序号生成
+std::shared_ptr<Student> makeStudent(size_t i) {
+    return std::make_shared<Student>("学生" + std::to_string(i), 18 + i % 10, i % 2 ? "男" : "女",
+                                     "ID" + std::to_string(i), "S" + std::to_string(i),
+                                     "专业" + std::to_string(i % 50), 2024 + static_cast<int>(i % 4));
+}
+
+// findStudent：索引查找与原来的顺序扫描对比，查询键一半存在一半不存在
+int lookup() {
+    std::cout << "规模        索引(ns/次)   索引(百万次/秒)   顺序扫描(ns/次)\n";
+    std::mt19937_64 rng(42);
+    for (size_t n : {1000u, 10000u, 100000u, 1000000u}) {
+        School school("基准学校", "", 2000);
+        school.setVerbose(false);
+        school.reserve(n, 0, 0);
+        for (size_t i = 0; i < n; i++) school.addStudent(makeStudent(i));
+
+        std::vector<std::string> keys(1 << 14);
+        for (auto& key : keys) {
+            size_t i = rng() % n;
+            key = (rng() & 1) ? "S" + std::to_string(i) : "X" + std::to_string(i);
+        }
+
+        const size_t queries = 2000000;
+        size_t found = 0;
+        auto t0 = Clock::now();
+        for (size_t q = 0; q < queries; q++) {
+            found += school.findStudent(keys[q & (keys.size() - 1)]) != nullptr;
+        }
+        double indexed = secondsSince(t0);
+
+        // 顺序扫描的总工作量限制在 2 亿次比较左右
+        size_t scans = std::max<size_t>(16, 200000000 / n);
+        const auto& students = school.getStudents();
+        size_t scanned = 0;
+        t0 = Clock::now();
+        for (size_t q = 0; q < scans; q++) {
+            const std::string& key = keys[q & (keys.size() - 1)];
+            scanned += std::find_if(students.begin(), students.end(), [&](const auto& st) {
+                           return st->getStudentNumber() == key;
+                       }) != students.end();
+        }
+        double linear = secondsSince(t0);
+
+        std::cout << std::left << std::setw(12) << n << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << indexed * 1e9 / queries << std::setw(16) << queries / indexed / 1e6
+                  << std::setw(20) << linear * 1e9 / scans
+                  << "   (命中 " << found << "/" << queries << ", " << scanned << "/" << scans << ")\n";
+    }
+    return 0;
+}
+
+// 可用物理内存（字节，/proc/meminfo 的 MemAvailable），大规模测试据此跳过放不下的规模
+size_t availableMemory() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    size_t kb;
+    while (meminfo >> key >> kb) {
+        if (key == "MemAvailable:") return kb * 1024;
+        meminfo.ignore(64, '\n');
+    }
+    long pages = sysconf(_SC_AVPHYS_PAGES), pageSize = sysconf(_SC_PAGESIZE);
+    return pages > 0 && pageSize > 0 ? static_cast<size_t>(pages) * pageSize : SIZE_MAX;
+}
+
+// 反复运行 f 直到累计至少 0.3 秒，返回每次的平均秒数
+template <typename F>
+double timeRepeated(F f) {
+    size_t reps = 0;
+    auto t0 = Clock::now();
+    do {
+        f();
+        reps++;
+    } while (secondsSince(t0) < 0.3 || reps < 3);
+    return secondsSince(t0) / reps;
+}
+
+// computeStatistics（统计列 + 向量化/多线程）与逐个 shared_ptr 对象读取对比
+int stats() {
+    std::cout << "学生数       逐对象(ns/个)   统计列(ns/个)   加速比   线程   平均GPA\n";
+    std::mt19937_64 rng(7);
+    for (size_t n : {10000u, 100000u, 1000000u, 10000000u}) {
+        if (n * 350 > availableMemory() / 10 * 8) {
+            std::cout << std::left << std::setw(13) << n << "可用内存不足，跳过\n";
+            continue;
+        }
+        School school("基准学校", "", 2000);
+        school.setVerbose(false);
+        school.reserve(n, n / 20, n / 50);
+
+        // 按打乱的顺序加入，模拟对象在堆上分散分配后的访问模式
+        std::vector<std::shared_ptr<Student>> created(n);
+        for (size_t i = 0; i < n; i++) {
+            created[i] = makeStudent(i);
+            if (i % 64 == 0) created[i]->addGrade("课程", 60 + static_cast<int>(i % 40));
+            if (i % 7 == 0) created[i]->setActiveStatus(false);
+        }
+        std::shuffle(created.begin(), created.end(), rng);
+        for (auto& s : created) school.addStudent(std::move(s));
+        created.clear();
+        created.shrink_to_fit();
+        for (size_t i = 0; i < n / 20; i++) {
+            school.addTeacher(std::make_shared<Teacher>("教师" + std::to_string(i), 40, "男", "ID",
+                                                        "T" + std::to_string(i), "系", "教授", 10000.0,
+                                                        static_cast<int>(i % 30)));
+        }
+        for (size_t i = 0; i < n / 50; i++) {
+            school.addCourse(std::make_shared<Course>("C" + std::to_string(i), "课程", 3, "", 100));
+        }
+
+        SchoolStatistics a, b;
+        double byObject = timeRepeated([&] { a = school.computeStatisticsByObject(); });
+        double columnar = timeRepeated([&] { b = school.computeStatistics(); });
+        if (a.activeStudents != b.activeStudents || std::abs(a.averageGPA - b.averageGPA) > 1e-9 ||
+            a.averageExperience != b.averageExperience || a.averageEnrolled != b.averageEnrolled) {
+            std::cerr << "统计结果不一致" << std::endl;
+            return 1;
+        }
+        size_t threads = statkernel::threadsFor(n);
+        std::cout << std::left << std::setw(13) << n << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(12) << byObject * 1e9 / n << std::setw(16) << columnar * 1e9 / n
+                  << std::setw(10) << std::setprecision(1) << byObject / columnar << "x"
+                  << std::setw(6) << threads << std::setw(10) << std::setprecision(4) << b.averageGPA << "\n";
+    }
+    return 0;
+}
+
+// 批量选课：不同线程数下的吞吐，并检查每门课的人数正好是 min(容量, 申请数)、
+// 名单和学生的课程列表与计数一致
+int enroll() {
+    const size_t nStudents = 200000, nRequests = 1000000;
+    std::vector<std::shared_ptr<Student>> students(nStudents);
+    std::ofstream devnull("/dev/null");
+
+    struct Scenario {
+        const char* name;
+        size_t courses;
+        int capacity;
+    };
+    const Scenario scenarios[] = {
+        {"1000 门课 x 1000 人", 1000, 1000},
+        {"1 门课 x 10000 人", 1, 10000},
+    };
+    for (const auto& sc : scenarios) {
+        std::cout << sc.name << "\n  线程   申请(百万次/秒)   成功(百万次/秒)      成功      拒绝   方式\n";
+        std::mt19937_64 rng(1);
+        std::vector<size_t> pick(nRequests);
+        for (auto& p : pick) p = rng() % sc.courses;
+
+        auto runOnce = [&](const char* how, unsigned threads, int mode) -> int {
+            std::vector<std::shared_ptr<Course>> courses(sc.courses);
+            for (size_t c = 0; c < sc.courses; c++) {
+                courses[c] = std::make_shared<Course>("C" + std::to_string(c), "课程" + std::to_string(c), 3, "",
+                                                      sc.capacity);
+            }
+            for (size_t i = 0; i < nStudents; i++) students[i] = makeStudent(i);  // 课程列表从空开始
+            std::vector<Registrar::Request> requests(nRequests);
+            for (size_t i = 0; i < nRequests; i++) requests[i] = {courses[pick[i]], students[i % nStudents]};
+
+            size_t total = mode == 0 ? nRequests / 10 : nRequests;
+            EnrollmentReport report;
+            auto t0 = Clock::now();
+            if (mode == 0) {
+                // 原来的逐条 enrollStudent，每条 endl 刷新
+                auto* old = std::cout.rdbuf(devnull.rdbuf());
+                for (size_t i = 0; i < total; i++) {
+                    (requests[i].course->enrollStudent(requests[i].student) ? report.enrolled : report.rejected)++;
+                }
+                std::cout.rdbuf(old);
+            } else {
+                report = Registrar::enrollBatch(requests, threads, mode == 2);
+                report.flush(devnull);
+            }
+            double secs = secondsSince(t0);
+
+            // 不变量
+            std::vector<size_t> demand(sc.courses);
+            for (size_t i = 0; i < total; i++) demand[pick[i]]++;
+            size_t rostered = 0, listed = 0;
+            for (size_t c = 0; c < sc.courses; c++) {
+                auto roster = courses[c]->getEnrolledStudents();
+                size_t expect = std::min<size_t>(demand[c], sc.capacity);
+                if (roster.size() != expect || courses[c]->getEnrolledCount() > sc.capacity ||
+                    std::count(roster.begin(), roster.end(), nullptr) != 0) {
+                    std::cerr << "课程 " << c << " 人数 " << roster.size() << "，应为 " << expect << std::endl;
+                    return 1;
+                }
+                rostered += roster.size();
+            }
+            for (const auto& st : students) listed += st->getCourses().size();
+            if (rostered != report.enrolled || listed != report.enrolled || report.enrolled + report.rejected != total) {
+                std::cerr << "计数不一致：名单 " << rostered << "，课程列表 " << listed << "，报告 " << report.enrolled
+                          << " + " << report.rejected << std::endl;
+                return 1;
+            }
+            std::cout << std::setw(6) << threads << std::fixed << std::setprecision(2) << std::setw(18)
+                      << total / secs / 1e6 << std::setw(18) << report.enrolled / secs / 1e6 << std::setw(10) << report.enrolled << std::setw(10) << report.rejected
+                      << "   " << how << "\n";
+            return 0;
+        };
+
+        if (runOnce("enrollStudent 逐条输出", 1, 0) != 0) return 1;
+        if (runOnce("enrollBatch 攒消息", 1, 2) != 0) return 1;
+        for (unsigned threads : {1u, 2u, 4u, 8u}) {
+            if (runOnce("enrollBatch 只计数", threads, 1) != 0) return 1;
+        }
+    }
+    std::cout << "不变量检查通过\n";
+    return 0;
+}
+
+// 在子进程里运行 f，返回它写回的结果，子进程的峰值 RSS（KB）记在 peakKB。
+// 每种存储各用一个进程，峰值就是这种存储自己的占用，不受前一种释放后留在堆里的内存影响
+template <typename R, typename F>
+bool runInChild(F f, R& result, long& peakKB) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(fds[0]);
+        R r = f();
+        bool ok = write(fds[1], &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r));
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    bool ok = read(fds[0], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    peakKB = usage.ru_maxrss;
+    return ok;
+}
+
+// 同一所学校分别用 shared_ptr 对象和 CompactSchool 建立、再销毁：
+// 每个学生选一门课、拿一个成绩，每门课有一位教师。比较耗时、分配次数和内存占用
+int arena() {
+    size_t n = 1000000;
+    while (n > 10000 && n * 700 > availableMemory()) n /= 2;  // 按旧模型的占用估算
+    const size_t nTeachers = n / 20, nCourses = n / 50;
+    const int capacity = 100;
+
+    struct Result {
+        double build = 0, teardown = 0;
+        size_t allocations = 0;
+        size_t arenaBlocks = 0, arenaBytes = 0, strings = 0, interned = 0;
+        SchoolStatistics stats;
+    };
+    auto grade = [](size_t i) { return 60 + static_cast<int>(i * 7 % 41); };
+    auto allocations = [] {
+#ifdef HELLO_ALLOC_COUNT
+        return heapAllocationCount();
+#else
+        return size_t(0);
+#endif
+    };
+
+    auto buildObjects = [&] {
+        Result r;
+        size_t allocs0 = allocations();
+        auto t0 = Clock::now();
+        auto school = std::make_unique<School>("学校", "地址", 1900);
+        school->setVerbose(false);
+        school->reserve(n, nTeachers, nCourses);
+        std::vector<std::shared_ptr<Teacher>> teachers(nTeachers);
+        for (size_t t = 0; t < nTeachers; t++) {
+            teachers[t] = std::make_shared<Teacher>("教师" + std::to_string(t), 40, "男", "TID" + std::to_string(t),
+                                                    "T" + std::to_string(t), "系" + std::to_string(t % 20), "教授",
+                                                    10000.0, static_cast<int>(t % 30));
+            school->addTeacher(teachers[t]);
+        }
+        std::vector<std::shared_ptr<Course>> courses(nCourses);
+        for (size_t c = 0; c < nCourses; c++) {
+            courses[c] = std::make_shared<Course>("C" + std::to_string(c), "课程" + std::to_string(c), 3, "",
+                                                  capacity);
+            courses[c]->setTeacher(teachers[c % nTeachers]);
+            school->addCourse(courses[c]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            auto s = makeStudent(i);
+            const auto& course = courses[i % nCourses];
+            course->tryEnroll(s);
+            s->addGrade(course->getCourseName(), grade(i));
+            school->addStudent(std::move(s));
+        }
+        r.build = secondsSince(t0);
+        r.allocations = allocations() - allocs0;
+        r.stats = school->computeStatistics();
+
+        t0 = Clock::now();
+        courses.clear();
+        teachers.clear();
+        school.reset();
+        r.teardown = secondsSince(t0);
+        return r;
+    };
+
+    auto buildCompact = [&] {
+        Result r;
+        size_t allocs0 = allocations();
+        auto t0 = Clock::now();
+        auto school = std::make_unique<CompactSchool>("学校", "地址", 1900);
+        // 驻留的不同值：课程名、描述、专业、院系、性别、职称；关系节点每个学生 3 个、每门课 1 个
+        school->reserve(n, nTeachers, nCourses, nCourses + 128, n * 3 + nCourses);
+        std::vector<CompactSchool::TeacherH> teachers(nTeachers);
+        for (size_t t = 0; t < nTeachers; t++) {
+            teachers[t] = school->addTeacher("教师" + std::to_string(t), 40, "男", "TID" + std::to_string(t),
+                                             "T" + std::to_string(t), "系" + std::to_string(t % 20), "教授",
+                                             10000.0, static_cast<int>(t % 30));
+        }
+        std::vector<CompactSchool::CourseH> courses(nCourses);
+        for (size_t c = 0; c < nCourses; c++) {
+            courses[c] = school->addCourse("C" + std::to_string(c), "课程" + std::to_string(c), 3, "", capacity);
+            school->setTeacher(courses[c], teachers[c % nTeachers]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            auto s = school->addStudent("学生" + std::to_string(i), 18 + i % 10, i % 2 ? "男" : "女",
+                                        "ID" + std::to_string(i), "S" + std::to_string(i),
+                                        "专业" + std::to_string(i % 50), 2024 + static_cast<int>(i % 4));
+            CompactSchool::CourseH c = courses[i % nCourses];
+            school->enroll(c, s);
+            school->addGrade(s, school->str(school->course(c).name), grade(i));
+        }
+        r.build = secondsSince(t0);
+        r.allocations = allocations() - allocs0;
+        r.stats = school->computeStatistics();
+        r.arenaBlocks = school->arenaBlocks();
+        r.arenaBytes = school->arenaBytes();
+        r.strings = school->stringCount();
+        r.interned = school->internedCount();
+
+        t0 = Clock::now();
+        courses.clear();
+        teachers.clear();
+        school.reset();
+        r.teardown = secondsSince(t0);
+        return r;
+    };
+
+    // 什么都不做的子进程：fork 时从父进程带过来的 RSS，从两种存储的峰值里扣掉
+    Result idle, objects, compact;
+    long idleKB = 0, objectsKB = 0, compactKB = 0;
+    if (!runInChild([] { return Result(); }, idle, idleKB) || !runInChild(buildObjects, objects, objectsKB) ||
+        !runInChild(buildCompact, compact, compactKB)) {
+        std::cerr << "子进程运行失败" << std::endl;
+        return 1;
+    }
+
+    if (objects.stats.students != compact.stats.students || objects.stats.activeStudents != compact.stats.activeStudents ||
+        std::abs(objects.stats.averageGPA - compact.stats.averageGPA) > 1e-9 ||
+        objects.stats.averageExperience != compact.stats.averageExperience ||
+        objects.stats.averageEnrolled != compact.stats.averageEnrolled) {
+        std::cerr << "两种存储的统计结果不一致" << std::endl;
+        return 1;
+    }
+
+    std::cout << "CompactSchool：" << compact.arenaBlocks << " 块 arena 共 " << compact.arenaBytes / (1 << 20)
+              << " MB，" << compact.strings << " 个字符串，其中驻留 " << compact.interned << " 个\n"
+              << n << " 个学生、" << nTeachers << " 位教师、" << nCourses << " 门课\n"
+              << "      建立(ms)    销毁(ms)        分配次数  峰值 RSS(MB)   字节/学生   存储\n";
+    for (const auto& [r, kb, how] : {std::make_tuple(&objects, objectsKB, "shared_ptr 对象"),
+                                     std::make_tuple(&compact, compactKB, "CompactSchool")}) {
+        double bytes = std::max(kb - idleKB, 0L) * 1024.0;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(12) << r->build * 1e3 << std::setw(12)
+                  << r->teardown * 1e3 << std::setw(16);
+#ifdef HELLO_ALLOC_COUNT
+        std::cout << r->allocations;
+#else
+        std::cout << "-";
+#endif
+        std::cout << std::setw(14) << bytes / (1 << 20) << std::setw(12) << std::setprecision(0) << bytes / n
+                  << "   " << how << "\n";
+    }
+#ifndef HELLO_ALLOC_COUNT
+    std::cout << "分配次数只在 make bench 生成的 hello_bench 里统计\n";
+#endif
+    std::cout << "平均 GPA 一致：" << std::setprecision(4) << compact.stats.averageGPA << "\n";
+    return 0;
+}
+
+// 快照：从源数据构造 School 与保存、映射快照对比，并检查快照上的读取、按需构造和还原都与原学校一致
+int snapshotLoad() {
+    size_t n = 1000000;
+    while (n > 10000 && n * 1500 > availableMemory()) n /= 2;  // 原学校、还原出的学校和快照文件同时存在
+    const size_t nTeachers = n / 20, nCourses = n / 50;
+    const std::string path = "/tmp/hello_snapshot_" + std::to_string(getpid()) + ".bin";
+
+    auto t0 = Clock::now();
+    School school("学校", "地址", 1900);
+    school.setVerbose(false);
+    school.reserve(n, nTeachers, nCourses);
+    for (int d = 0; d < 20; d++) school.addDepartment("D" + std::to_string(d), "系" + std::to_string(d));
+    for (size_t t = 0; t < nTeachers; t++) {
+        school.addTeacher(std::make_shared<Teacher>("教师" + std::to_string(t), 40, "男", "TID" + std::to_string(t),
+                                                    "T" + std::to_string(t), "系" + std::to_string(t % 20), "教授",
+                                                    10000.0, static_cast<int>(t % 30)));
+    }
+    const auto& teachers = school.getTeachers();
+    for (size_t c = 0; c < nCourses; c++) {
+        auto course = std::make_shared<Course>("C" + std::to_string(c), "课程" + std::to_string(c), 3, "", 100);
+        course->setTeacher(teachers[c % nTeachers]);
+        course->setSchedule(c % 2 ? "周一" : "周三", 2);
+        school.addCourse(course);
+    }
+    const auto& courses = school.getCourses();
+    for (size_t i = 0; i < n; i++) {
+        auto s = makeStudent(i);
+        courses[i % nCourses]->tryEnroll(s);
+        s->addGrade(courses[i % nCourses]->getCourseName(), 60 + static_cast<int>(i * 7 % 41));
+        if (i % 7 == 0) s->setActiveStatus(false);
+        teachers[i % nTeachers]->addStudent(s);
+        school.addStudent(std::move(s));
+    }
+    double build = secondsSince(t0);
+
+    t0 = Clock::now();
+    if (!SchoolSnapshot::save(school, path)) return 1;
+    double save = secondsSince(t0);
+
+    t0 = Clock::now();
+    auto snap = SchoolSnapshot::open(path);
+    double load = secondsSince(t0);
+    if (!snap) return 1;
+    std::remove(path.c_str());  // 映射在文件删除后仍然有效
+
+    auto fail = [](const char* what) {
+        std::cerr << "快照与原学校不一致：" << what << std::endl;
+        return 1;
+    };
+    auto sameStats = [](const SchoolStatistics& a, const SchoolStatistics& b) {
+        return a.students == b.students && a.activeStudents == b.activeStudents && a.teachers == b.teachers &&
+               a.courses == b.courses && std::abs(a.averageGPA - b.averageGPA) < 1e-9 &&
+               a.averageExperience == b.averageExperience && a.averageEnrolled == b.averageEnrolled;
+    };
+
+    // 随机按学号查找并读字段，一半的键不存在
+    std::mt19937_64 rng(7);
+    std::vector<std::string> keys(100000);
+    for (auto& k : keys) k = "S" + std::to_string(rng() % (2 * n));
+    size_t hits = 0;
+    t0 = Clock::now();
+    for (const auto& k : keys) {
+        int64_t i = snap->findStudent(k);
+        if (i >= 0) hits += snap->student(static_cast<uint32_t>(i))->getName().size() > 0;
+    }
+    double lookup = secondsSince(t0) / keys.size();
+    for (size_t k = 0; k < keys.size(); k += 97) {
+        int64_t i = snap->findStudent(keys[k]);
+        auto expect = school.findStudent(keys[k]);
+        if ((i >= 0) != (expect != nullptr)) return fail("查找结果");
+        if (expect && (snap->student(i)->getName() != expect->getName() ||
+                       snap->student(i)->getGPA() != expect->getGPA())) {
+            return fail("学生字段");
+        }
+    }
+    if (snap->student(snap->studentCount()) || snap->teacher(snap->teacherCount()) ||
+        snap->course(snap->courseCount())) {
+        return fail("越界的下标");
+    }
+
+    SchoolStatistics stats;
+    t0 = Clock::now();
+    stats = snap->computeStatistics();
+    double scan = secondsSince(t0);
+    if (!sameStats(stats, school.computeStatistics())) return fail("统计");
+
+    // 修改一个学生：只有它被构造成对象，读取和统计都要看到修改
+    std::string number = "S" + std::to_string(n / 2);
+    uint32_t row = static_cast<uint32_t>(snap->findStudent(number));
+    snap->mutableStudent(row)->addGrade("补考", 100);
+    school.findStudent(number)->addGrade("补考", 100);
+    if (!snap->student(row)->isMaterialized() || snap->student(row + 1)->isMaterialized() ||
+        snap->student(row)->getGPA() != school.findStudent(number)->getGPA()) {
+        return fail("修改后的学生");
+    }
+    if (!sameStats(snap->computeStatistics(), school.computeStatistics())) return fail("修改后的统计");
+
+    t0 = Clock::now();
+    auto course = snap->mutableCourse(static_cast<uint32_t>(snap->findCourse("C0")));
+    double materialize = secondsSince(t0);
+    auto expectRoster = school.findCourse("C0")->getEnrolledStudents();
+    auto roster = course->getEnrolledStudents();
+    if (roster.size() != expectRoster.size() || roster.front()->getName() != expectRoster.front()->getName() ||
+        course->getTeacher()->getEmployeeId() != school.findCourse("C0")->getTeacher()->getEmployeeId() ||
+        course->getTeacher()->getStudents().size() != teachers[0]->getStudents().size()) {
+        return fail("构造出的课程");
+    }
+
+    t0 = Clock::now();
+    auto restored = snap->toSchool();
+    double restore = secondsSince(t0);
+    if (!sameStats(restored->computeStatistics(), school.computeStatistics()) ||
+        restored->getDepartments() != school.getDepartments()) {
+        return fail("还原的学校");
+    }
+
+    std::cout << n << " 个学生、" << nTeachers << " 位教师、" << nCourses << " 门课，快照 " << std::fixed
+              << std::setprecision(1) << snap->fileSize() / double(1 << 20) << " MB\n"
+              << "  从源数据构造 School   " << std::setw(10) << build * 1e3 << " ms\n"
+              << "  保存快照              " << std::setw(10) << save * 1e3 << " ms\n"
+              << "  打开快照（mmap）      " << std::setw(10) << std::setprecision(3) << load * 1e3 << " ms\n"
+              << "  按学号查找并读姓名    " << std::setw(10) << std::setprecision(0) << lookup * 1e9 << " ns/次（命中 "
+              << hits << "）\n"
+              << "  快照上统计（读全部记录）" << std::setw(8) << std::setprecision(1) << scan * 1e3 << " ms\n"
+              << "  按需构造一门课        " << std::setw(10) << materialize * 1e3 << " ms（含教师和 "
+              << course->getTeacher()->getStudents().size() + roster.size() << " 个学生）\n"
+              << "  还原成完整的 School   " << std::setw(10) << restore * 1e3 << " ms\n"
+              << "一致性检查通过\n";
+    return 0;
+}
+
+// 编号分配：单线程与多线程的取号速度、与原来 rand() + to_string 拼接的对比，并检查号码不重复、
+// 号码空间用完时正好发出全部号码
+int ids() {
+    auto legacy = [] {
+        std::string number = "2024";
+        for (int i = 0; i < 6; i++) number += std::to_string(rand() % 10);
+        return number;
+    };
+    const size_t nLegacy = 1000000;
+    size_t sink = 0;
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < nLegacy; i++) sink += legacy().size();
+    double legacyRate = nLegacy / secondsSince(t0);
+    if (sink != nLegacy * 10) return 1;
+
+    std::cout << "  线程   每线程(百万个/秒)   合计(百万个/秒)       已发出   方式\n";
+    std::cout << std::fixed << std::setprecision(2) << std::setw(6) << 1 << std::setw(20) << legacyRate / 1e6
+              << std::setw(18) << legacyRate / 1e6 << std::setw(13) << nLegacy << "   rand() + to_string（可能重复）\n";
+
+    // 7 位号码空间 10^7（位图 1.2MB），每轮发出 200 万个，最后一轮结束时用掉 60%
+    IdAllocator allocator("2024", 7);
+    const size_t perRound = 2000000;
+    std::vector<uint32_t> numbers;
+    numbers.reserve(perRound * 3);
+    for (unsigned threads : {1u, 2u, 4u}) {
+        std::vector<std::vector<uint32_t>> got(threads);
+        std::vector<double> seconds(threads);
+        auto work = [&](unsigned t) {
+            size_t count = perRound / threads;
+            IdBuffer id;
+            auto start = Clock::now();
+            for (size_t i = 0; i < count; i++) {
+                allocator.next(id);
+                uint32_t n = 0;
+                for (int k = 4; k < id.len; k++) n = n * 10 + (id.data[k] - '0');
+                got[t].push_back(n);
+            }
+            seconds[t] = secondsSince(start);
+        };
+        for (auto& g : got) g.reserve(perRound / threads);
+        t0 = Clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) workers.emplace_back(work, t);
+        work(0);
+        for (auto& w : workers) w.join();
+        double wall = secondsSince(t0);
+        double perThread = 0;
+        for (unsigned t = 0; t < threads; t++) perThread += (perRound / threads) / seconds[t];
+        perThread /= threads;
+        for (auto& g : got) numbers.insert(numbers.end(), g.begin(), g.end());
+        std::cout << std::setw(6) << threads << std::setw(20) << perThread / 1e6 << std::setw(18)
+                  << (perRound / threads) * threads / wall / 1e6 << std::setw(13) << allocator.issuedCount()
+                  << "   IdAllocator\n";
+    }
+    std::sort(numbers.begin(), numbers.end());
+    if (std::adjacent_find(numbers.begin(), numbers.end()) != numbers.end() ||
+        numbers.size() != allocator.issuedCount()) {
+        std::cerr << "发出了重复的号码" << std::endl;
+        return 1;
+    }
+
+    // 小空间取满：CS + 4 位正好 10000 个，第 10001 次失败；登记过的号不再发出
+    IdAllocator codes("CS", 4);
+    if (!codes.claim("CS0042") || codes.claim("CS0042") || codes.claim("XX0001") || codes.claim("CS12")) {
+        std::cerr << "claim 的结果不对" << std::endl;
+        return 1;
+    }
+    std::vector<bool> seen(codes.capacity());
+    IdBuffer id;
+    size_t filled = 1;
+    seen[42] = true;
+    while (codes.next(id)) {
+        size_t n = std::stoul(id.str().substr(2));
+        if (seen[n]) {
+            std::cerr << "课程代码 " << id.view() << " 重复" << std::endl;
+            return 1;
+        }
+        seen[n] = true;
+        filled++;
+    }
+    if (filled != codes.capacity()) {
+        std::cerr << "课程代码只发出了 " << filled << " 个" << std::endl;
+        return 1;
+    }
+    std::cout << "不重复检查通过（" << numbers.size() << " 个学号，" << filled << " 个课程代码取满）"
+              << "\n";
+    return 0;
+}
+
+// 本进程到目前为止的 write 系统调用次数，读不到 /proc/self/io 时为 0
+size_t writeSyscalls() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    size_t value;
+    while (io >> key >> value) {
+        if (key == "syscw:") return value;
+    }
+    return 0;
+}
+
+// 10 万人的选课名单：原来每行 std::endl 的写法与 ReportBuffer 一次写出对比，
+// 并检查文本渲染与原来的输出逐字节相同
+int report() {
+    const int n = 100000;
+    Course course("C1", "程序设计", 3, "", n);
+    for (int i = 0; i < n; i++) course.tryEnroll(makeStudent(i));
+    std::ofstream devnull("/dev/null");
+
+    auto legacy = [&](std::ostream& out) {
+        out << course.getCourseName() << " 选课学生名单：" << std::endl;
+        for (const auto& student : course.getEnrolledStudents()) {
+            out << "  " << student->getName() << " (学号：" << student->getStudentNumber() << ")" << std::endl;
+        }
+    };
+    std::ostringstream expected;
+    legacy(expected);
+    ReportBuffer text;
+    course.renderEnrolledStudents(text);
+    if (text.view() != expected.str()) {
+        std::cerr << "文本渲染与原来的输出不同" << std::endl;
+        return 1;
+    }
+    ReportBuffer json(ReportFormat::Json);
+    course.renderEnrolledStudents(json);
+    std::string_view j = json.view();
+    if (j.substr(0, 2) != "{\"" || j.substr(j.size() - 3) != "]}\n" ||
+        std::count(j.begin(), j.end(), '{') != n + 1 || std::count(j.begin(), j.end(), '}') != n + 1) {
+        std::cerr << "JSON 渲染的结构不对" << std::endl;
+        return 1;
+    }
+
+    std::cout << "    耗时(ms)     write 次数      字节数   方式\n";
+    auto row = [&](const char* how, auto render) {
+        size_t bytes = 0, writes = writeSyscalls();
+        auto t0 = Clock::now();
+        bytes = render();
+        double secs = secondsSince(t0);
+        writes = writeSyscalls() - writes;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(12) << secs * 1e3 << std::setw(15) << writes
+                  << std::setw(12) << bytes << "   " << how << "\n";
+    };
+    row("逐行 std::endl", [&] {
+        legacy(devnull);
+        return expected.str().size();
+    });
+    // 每种格式渲染两次：第二次复用缓冲，不再扩容
+    for (ReportFormat format : {ReportFormat::Text, ReportFormat::Json}) {
+        ReportBuffer buffer(format);
+        for (const char* pass : {"首次", "复用缓冲"}) {
+            std::string how = std::string("ReportBuffer ") + (format == ReportFormat::Text ? "文本" : "JSON") + "（" +
+                              pass + "）";
+            row(how.c_str(), [&] {
+                course.renderEnrolledStudents(buffer);
+                size_t bytes = buffer.size();
+                buffer.writeTo(devnull);
+                return bytes;
+            });
+        }
+    }
+    std::cout << "文本输出与原来逐字节相同\n";
+    return 0;
+}
+
+struct Benchmark {
+    const char* name;
+    const char* description;
+    int (*run)();
+};
+
+const Benchmark benchmarks[] = {
+    {"lookup", "findStudent 索引查找与顺序扫描，1k 到 1M 个学生", lookup},
+    {"stats", "统计列与逐对象统计，10k 到 10M 个学生", stats},
+    {"enroll", "多线程批量选课的吞吐和容量不变量", enroll},
+    {"arena", "CompactSchool 与 shared_ptr 对象的建立/销毁耗时、分配次数和内存", arena},
+    {"snapshot", "School 快照的保存、mmap 打开、查找、按需构造和还原", snapshotLoad},
+    {"ids", "IdAllocator 单线程/多线程取号速度和不重复检查", ids},
+    {"report", "10 万人选课名单的渲染：逐行 std::endl 与 ReportBuffer 文本/JSON", report},
+};
+
+int run(const std::string& name) {
+    int rc = 0;
+    bool matched = false;
+    for (const auto& b : benchmarks) {
+        if (name != "all" && name != b.name) continue;
+        matched = true;
+        std::cout << "=== " << b.name << ": " << b.description << " ===\n";
+        rc |= b.run();
+    }
+    if (!matched) {
+        std::cerr << "未知的基准测试 " << name << "，可选：all";
+        for (const auto& b : benchmarks) std::cerr << " " << b.name;
+        std::cerr << std::endl;
+        return 2;
+    }
+    return rc;
+}
+
+} // namespace bench
 
 // 主函数演示
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc == 3 && std::string(argv[1]) == "--bench") {
+        return bench::run(argv[2]);
+    }
+
     std::cout << "=== 面向对象学校管理系统演示 ===" << std::endl;
 
     // 创建学校
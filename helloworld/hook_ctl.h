@@ -0,0 +1,48 @@
+/* hook_ctl.h
+ * hook 库的控制页：hooktrace run 在会话目录下创建 ctl.shm，hook 库(syscall_hook_fixed.so、
+ * gcc_spawn_tracer.so)映射后在每个 hook 入口用一次 relaxed 原子读取 level，
+ * hooktrace ctl 改写它，已经在运行的进程下一次调用 hook 时就按新级别工作，不用重启构建。
+ *
+ * 级别从低到高，每一级包含前一级的内容：
+ *   off       直接调用真实函数，不记录、不统计(exec 时仍传递会话环境变量，之后可以再打开)
+ *   counters  hook 自身耗时直方图和按 fd 的读写计数(hook_stats/io_summary)
+ *   exec      加上进程生命周期：exec/fork/spawn/wait 事件和 exec_record/exit_record/reap_record
+ *   full      加上 open/close/access/unlink 等逐次事件(默认)
+ */
+
+#ifndef HOOK_CTL_H
+#define HOOK_CTL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define HOOK_CTL_MAGIC 0x4c435448u     // "HTCL"
+#define HOOK_CTL_VERSION 1
+
+enum hook_level {
+    HOOK_LEVEL_OFF,
+    HOOK_LEVEL_COUNTERS,
+    HOOK_LEVEL_EXEC,
+    HOOK_LEVEL_FULL,
+    HOOK_LEVEL_COUNT
+};
+
+struct hook_ctl {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t level;                    // enum hook_level
+    uint32_t changes;                  // 修改次数
+    uint64_t changed_ns;               // 最近一次修改的时刻(CLOCK_MONOTONIC)
+};
+
+static const char *const hook_level_names[HOOK_LEVEL_COUNT] = {"off", "counters", "exec", "full"};
+
+// 未知的名字返回 -1
+static inline int hook_level_parse(const char *name) {
+    for (int i = 0; i < HOOK_LEVEL_COUNT; i++) {
+        if (strcmp(name, hook_level_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+#endif
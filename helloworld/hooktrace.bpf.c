@@ -0,0 +1,144 @@
+/* hooktrace.bpf.c
+ * hooktrace 的 eBPF 后端：在 sched_process_fork/exec/exit 和 sys_enter_openat 上采集事件，
+ * 不依赖动态加载器，静态链接的程序、Go 工具链和丢弃 LD_PRELOAD 的 setuid 程序也能追踪到。
+ *
+ * 追踪范围二选一：
+ *   - 会话：procs 表里的进程及其后代。启动器把自己以 quiet 放进表里，fork 时继承
+ *   - cgroup：target_cgroup 非 0 时，只看当前 cgroup id 是否相同
+ *
+ * Compile with: make tools-bpf (需要 clang、bpftool 和 libbpf)
+ */
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "hooktrace_bpf.h"
+
+char LICENSE[] SEC("license") = "GPL";
+
+// 加载前由启动器填入
+const volatile __u64 target_cgroup = 0;
+const volatile __u64 pidns_dev = 0;
+const volatile __u64 pidns_ino = 0;
+
+// ring buffer 满时丢掉的事件数
+__u64 drops = 0;
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, 65536);
+    __type(key, __u32);                // 初始命名空间的 tgid
+    __type(value, struct bpf_proc_info);
+} procs SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, 8 << 20);
+} events SEC(".maps");
+
+// 当前进程在启动器 PID 命名空间里的进程号，不在该命名空间内时为 0
+static __always_inline __u32 ns_tgid(void) {
+    struct bpf_pidns_info ns = {};
+    if (bpf_get_ns_current_pid_tgid(pidns_dev, pidns_ino, &ns, sizeof(ns)) != 0) return 0;
+    return ns.tgid;
+}
+
+static __always_inline int in_scope(struct bpf_proc_info *info) {
+    if (target_cgroup) return bpf_get_current_cgroup_id() == target_cgroup;
+    return info && !info->quiet;
+}
+
+static __always_inline void fill_hdr(struct bpf_event_hdr *hdr, __u32 type, __u32 host_pid,
+                                     struct bpf_proc_info *info, struct task_struct *task) {
+    hdr->type = type;
+    hdr->pid = ns_tgid();
+    hdr->ppid = info ? info->ppid : BPF_CORE_READ(task, real_parent, tgid);
+    hdr->host_pid = host_pid;
+    hdr->ts = bpf_ktime_get_ns();
+}
+
+SEC("tp_btf/sched_process_fork")
+int BPF_PROG(on_fork, struct task_struct *parent, struct task_struct *child) {
+    __u32 ptgid = parent->tgid;
+    __u32 tgid = child->tgid;
+    if (child->pid != tgid) return 0;  // 新线程
+    if (target_cgroup) {
+        if (bpf_get_current_cgroup_id() != target_cgroup) return 0;
+    } else if (!bpf_map_lookup_elem(&procs, &ptgid)) {
+        return 0;
+    }
+    // 在父进程上下文中运行，ns_tgid() 是父进程的进程号
+    struct bpf_proc_info info = { .ppid = ns_tgid(), .quiet = 0 };
+    bpf_map_update_elem(&procs, &tgid, &info, BPF_ANY);
+    return 0;
+}
+
+SEC("tp_btf/sched_process_exec")
+int BPF_PROG(on_exec, struct task_struct *task, pid_t old_pid, struct linux_binprm *bprm) {
+    __u32 tgid = task->tgid;
+    struct bpf_proc_info *info = bpf_map_lookup_elem(&procs, &tgid);
+    if (!in_scope(info)) return 0;
+
+    struct bpf_exec_event *e = bpf_ringbuf_reserve(&events, sizeof(*e), 0);
+    if (!e) {
+        __sync_fetch_and_add(&drops, 1);
+        return 0;
+    }
+    fill_hdr(&e->hdr, BPF_EVENT_EXEC, tgid, info, task);
+    bpf_probe_read_kernel_str(e->path, sizeof(e->path), bprm->filename);
+
+    // 此时新映像的参数已经在用户栈上
+    unsigned long start = BPF_CORE_READ(task, mm, arg_start);
+    unsigned long end = BPF_CORE_READ(task, mm, arg_end);
+    __u64 len = end > start ? end - start : 0;
+    e->truncated = len > BPF_ARGS_MAX - 1;
+    if (e->truncated) len = BPF_ARGS_MAX - 1;
+    len &= BPF_ARGS_MAX - 1;
+    if (bpf_probe_read_user(e->args, len, (const void *)start) != 0) len = 0;
+    e->args_len = (__u32)len;
+
+    bpf_ringbuf_submit(e, 0);
+    return 0;
+}
+
+SEC("tp_btf/sched_process_exit")
+int BPF_PROG(on_exit, struct task_struct *task) {
+    // 线程组里最后一个线程退出时才算进程退出
+    if (BPF_CORE_READ(task, signal, live.counter) != 0) return 0;
+
+    __u32 tgid = task->tgid;
+    struct bpf_proc_info *info = bpf_map_lookup_elem(&procs, &tgid);
+    if (in_scope(info)) {
+        struct bpf_exit_event *e = bpf_ringbuf_reserve(&events, sizeof(*e), 0);
+        if (e) {
+            fill_hdr(&e->hdr, BPF_EVENT_EXIT, tgid, info, task);
+            e->exit_code = task->exit_code;
+            bpf_ringbuf_submit(e, 0);
+        } else {
+            __sync_fetch_and_add(&drops, 1);
+        }
+    }
+    if (info) bpf_map_delete_elem(&procs, &tgid);
+    return 0;
+}
+
+SEC("tracepoint/syscalls/sys_enter_openat")
+int on_openat(struct trace_event_raw_sys_enter *ctx) {
+    __u32 tgid = bpf_get_current_pid_tgid() >> 32;
+    struct bpf_proc_info *info = bpf_map_lookup_elem(&procs, &tgid);
+    if (!in_scope(info)) return 0;
+
+    struct bpf_open_event *e = bpf_ringbuf_reserve(&events, sizeof(*e), 0);
+    if (!e) {
+        __sync_fetch_and_add(&drops, 1);
+        return 0;
+    }
+    fill_hdr(&e->hdr, BPF_EVENT_OPEN, tgid, info, (struct task_struct *)bpf_get_current_task_btf());
+    e->dirfd = (__s32)ctx->args[0];
+    e->flags = (__s32)ctx->args[2];
+    e->mode = (__u32)ctx->args[3];
+    bpf_probe_read_user_str(e->path, sizeof(e->path), (const char *)ctx->args[1]);
+    bpf_ringbuf_submit(e, 0);
+    return 0;
+}
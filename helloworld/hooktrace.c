@@ -0,0 +1,1056 @@
+/* hooktrace.c
+ * 构建追踪启动器：为一次构建分配独立会话，设置 LD_PRELOAD 和会话环境变量后运行构建命令，
+ * 结束后汇总会话目录。同一台机器上并发的多个构建各自有会话目录，日志互不交叉。
+ * Compile with: gcc -O2 -pthread -o hooktrace hooktrace.c trace_record.c compile_cache.c replay.c verify.c \
+ *               diff.c trace_sink.c compdb.c
+ * Use with: ./hooktrace run [--out DIR] [--lib PATH.so] [--session ID] -- make -j32
+ *           ./hooktrace replay [-j N] --add -fsyntax-only --drop-output 会话目录
+ *
+ * 会话通过环境变量传给被追踪的进程(exec 时由 hook 库继续传递)：
+ *   HOOKTRACE_SESSION  会话ID
+ *   HOOKTRACE_DIR      会话输出目录(绝对路径)，每个进程写其中的 <pid>.log
+ *
+ * 启动器把自己设为子进程收割者(PR_SET_CHILD_SUBREAPER)，构建中被父进程遗弃的孤儿进程
+ * 会被重新挂到启动器下，由它回收并写入 reaper.log。构建结束后合并会话目录，生成：
+ *   records.jsonl          每次 exec 一行，含开始/结束时间和退出状态
+ *   compile_commands.json  编译数据库，每个源文件一项
+ *   timing.txt             按工具汇总的耗时和最慢的进程
+ * --compdb DIR 时还把本次的编译调用合并进 DIR 中跨构建维护的编译数据库(见 compdb.h)。
+ *
+ * --backend bpf 时不设置 LD_PRELOAD，改由 eBPF 程序采集 exec/exit/openat，写到 bpf.log
+ * (见 bpf_backend.h)，需要用 make tools-bpf 编译。
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <libgen.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "trace_record.h"
+#include "path_cache.h"
+#include "intern.h"
+#include "hook_ctl.h"
+#include "compile_cache.h"
+#include "replay.h"
+#include "verify.h"
+#include "diff.h"
+#include "trace_sink.h"
+#include "compdb.h"
+#ifdef HOOKTRACE_BPF
+#include "bpf_backend.h"
+#endif
+
+extern char **environ;
+
+#define DEFAULT_OUT_DIR "hooktrace-out"
+#define DEFAULT_HOOK_LIB "syscall_hook_fixed.so"
+#define DEFAULT_ORPHAN_WAIT 10     // 主命令结束后等待孤儿进程的秒数
+#define TIMING_TOP 10
+
+struct run_options {
+    const char *out_dir;
+    const char *session;
+    int orphan_wait;
+    int path_cache;
+    int intern;                // --intern
+    int level;                 // --level，-1 表示未指定(full)
+    const char *compile_cache;
+    const char *compdb;        // --compdb
+    int bpf;                   // --backend bpf
+    int defer_preload;         // 不设置 LD_PRELOAD，由命令自己传给要追踪的进程(verify 用 strace -E)
+    const char *cgroup;
+    char lib_paths[4096];      // 以 ':' 分隔，按 LD_PRELOAD 的格式
+    char **command;
+};
+
+static void usage(void) {
+    fprintf(stderr,
+            "用法: hooktrace run [选项] -- 命令 [参数...]\n"
+            "  --out DIR       会话输出根目录(默认 ./" DEFAULT_OUT_DIR ")\n"
+            "  --lib PATH      预加载的 hook 库，可多次指定(默认与 hooktrace 同目录的 "
+            DEFAULT_HOOK_LIB ")\n"
+            "  --session ID    指定会话ID(默认按时间和进程号生成)\n"
+            "  --orphan-wait N 主命令结束后等待孤儿进程的秒数(默认 %d, 0 表示不等待)\n"
+            "  --path-cache    execvp 等通过共享缓存查找 PATH 中的程序\n"
+            "  --level L       初始记录级别 off|counters|exec|full(默认 full)，运行中可用 hooktrace ctl 修改\n"
+            "  --intern        exec 记录中的路径和参数写成整个构建共享的字符串表中的 ID\n"
+            "  --compile-cache DIR  cc1/cc1plus/as 的输入未变时直接使用 DIR 中缓存的产物\n"
+            "  --compdb DIR    把本次的编译调用合并进 DIR 中的增量编译数据库\n"
+            "  --backend preload|bpf  采集方式(默认 preload；bpf 需要 make tools-bpf 和 root)\n"
+            "  --cgroup PATH   bpf 后端追踪该 cgroup 中的所有进程，而不是命令的后代\n"
+            "\n"
+            "      hooktrace replay [选项] 会话目录|records.jsonl\n"
+            "  并行重新执行追踪到的编译命令，选项见 hooktrace replay --help\n"
+            "\n"
+            "      hooktrace verify [--out DIR] [--lib PATH] [--strace PATH] [--baseline verify.json] -- 命令\n"
+            "      hooktrace verify [--baseline verify.json] --compare 会话目录 strace.log\n"
+            "  在 strace -f 下运行带 hook 库的命令，报告 hook 库遗漏/重复/记错进程的事件；\n"
+            "  指定基线时任一类问题比基线多则退出码为 1\n"
+            "\n"
+            "      hooktrace diff [--threshold PCT] [--min-ms MS] A B\n"
+            "  比较两次构建(会话目录或 records.jsonl)的编译器调用：新增、删除、参数变化和变慢的命令\n"
+            "\n"
+            "      hooktrace ctl 会话目录 [off|counters|exec|full]\n"
+            "  查看或修改正在运行的会话的记录级别，已经在运行的进程立即生效\n"
+            "\n"
+            "      hooktrace compdb DIR add|export|query|stats ...\n"
+            "  增量编译数据库：合并追踪、导出 compile_commands.json、按源文件查询\n"
+            "\n"
+            "      hooktrace bench-sink [--mb N] [--rounds N] [--dir DIR] [--fsync]\n"
+            "  比较逐行 write、pwritev 和 io_uring 写追踪日志的吞吐和 CPU\n",
+            DEFAULT_ORPHAN_WAIT);
+}
+
+// mkdir -p
+static int make_dirs(const char *path) {
+    char buf[PATH_MAX];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(buf, 0755) != 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    if (mkdir(buf, 0755) != 0 && errno != EEXIST) return -1;
+    return 0;
+}
+
+static int append_lib(struct run_options *opts, const char *lib) {
+    char abs[PATH_MAX];
+    if (!realpath(lib, abs)) {
+        fprintf(stderr, "hooktrace: 找不到 hook 库 %s: %s\n", lib, strerror(errno));
+        return -1;
+    }
+    size_t used = strlen(opts->lib_paths);
+    snprintf(opts->lib_paths + used, sizeof(opts->lib_paths) - used, "%s%s",
+             used ? ":" : "", abs);
+    return 0;
+}
+
+// 默认库：与 hooktrace 可执行文件放在同一目录
+static int default_lib(struct run_options *opts) {
+    char exe[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n < 0) return append_lib(opts, DEFAULT_HOOK_LIB);
+    exe[n] = '\0';
+
+    char lib[PATH_MAX];
+    snprintf(lib, sizeof(lib), "%s/%s", dirname(exe), DEFAULT_HOOK_LIB);
+    return append_lib(opts, lib);
+}
+
+static int parse_run_options(int argc, char **argv, struct run_options *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->out_dir = DEFAULT_OUT_DIR;
+    opts->orphan_wait = DEFAULT_ORPHAN_WAIT;
+    opts->level = -1;
+
+    int i = 0;
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            opts->out_dir = argv[++i];
+        } else if (strcmp(argv[i], "--lib") == 0 && i + 1 < argc) {
+            if (append_lib(opts, argv[++i]) != 0) return -1;
+        } else if (strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+            opts->session = argv[++i];
+        } else if (strcmp(argv[i], "--orphan-wait") == 0 && i + 1 < argc) {
+            opts->orphan_wait = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--path-cache") == 0) {
+            opts->path_cache = 1;
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            opts->level = hook_level_parse(argv[++i]);
+            if (opts->level < 0) {
+                fprintf(stderr, "hooktrace: 未知的级别 %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--intern") == 0) {
+            opts->intern = 1;
+        } else if (strcmp(argv[i], "--compile-cache") == 0 && i + 1 < argc) {
+            opts->compile_cache = argv[++i];
+        } else if (strcmp(argv[i], "--compdb") == 0 && i + 1 < argc) {
+            opts->compdb = argv[++i];
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            const char *backend = argv[++i];
+            if (strcmp(backend, "bpf") == 0) {
+                opts->bpf = 1;
+            } else if (strcmp(backend, "preload") != 0) {
+                fprintf(stderr, "hooktrace: 未知的采集方式 %s\n", backend);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--cgroup") == 0 && i + 1 < argc) {
+            opts->cgroup = argv[++i];
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "hooktrace: 未知选项 %s\n", argv[i]);
+            return -1;
+        } else {
+            break; // 允许省略 "--"
+        }
+    }
+    if (i >= argc) {
+        usage();
+        return -1;
+    }
+    opts->command = argv + i;
+
+    if (opts->bpf) {
+#ifndef HOOKTRACE_BPF
+        fprintf(stderr, "hooktrace: 没有编译 eBPF 后端，请用 make tools-bpf 构建\n");
+        return -1;
+#endif
+        // 这几项都靠 hook 库实现
+        if (opts->lib_paths[0] || opts->path_cache || opts->intern || opts->compile_cache || opts->level >= 0) {
+            fprintf(stderr, "hooktrace: --lib/--path-cache/--intern/--compile-cache/--level 不能与 --backend bpf 同时使用\n");
+            return -1;
+        }
+        return 0;
+    }
+    if (opts->cgroup) {
+        fprintf(stderr, "hooktrace: --cgroup 只用于 --backend bpf\n");
+        return -1;
+    }
+    if (opts->lib_paths[0] == '\0' && default_lib(opts) != 0) return -1;
+    return 0;
+}
+
+static int count_process_logs(const char *session_dir) {
+    DIR *dir = opendir(session_dir);
+    if (!dir) return 0;
+    int count = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len > 4 && strcmp(ent->d_name + len - 4, ".log") == 0) count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+// 把子进程的等待状态转换成 shell 风格的退出码
+static int exit_code_of(int status) {
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 1;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// 启动器所在的 PID 命名空间，与 hook 库记录里的 pidns 相同含义
+static unsigned long self_pidns(void) {
+    struct stat st;
+    if (stat("/proc/self/ns/pid", &st) != 0) return 0;
+    return (unsigned long)st.st_ino;
+}
+
+// ===== 子进程回收 =====
+
+static volatile pid_t main_child;
+static volatile sig_atomic_t orphan_deadline;
+
+// 终端信号通常已经发给了整个进程组，这里再转发一次，覆盖 kill 启动器本身的情况
+static void forward_signal(int sig) {
+    if (main_child > 0) kill(main_child, sig);
+}
+
+static void orphan_wait_expired(int sig) {
+    (void)sig;
+    orphan_deadline = 1;
+}
+
+// 主命令由启动器直接 spawn，hook 库还没加载，由启动器补上它的 exec 记录。
+// 记录里带完整环境，是 hook 库各条环境增量的根
+static void write_root_record(FILE *out, pid_t pid, unsigned long pidns, uint64_t ts,
+                              char **command) {
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) cwd[0] = '\0';
+
+    fprintf(out, "{\"type\":\"exec\",\"fn\":\"hooktrace\",\"pid\":%d,\"ppid\":%d,"
+            "\"pidns\":%lu,\"ts\":%lu,\"cwd\":", pid, getpid(), pidns, (unsigned long)ts);
+    json_write_str(out, cwd);
+    fputs(",\"path\":", out);
+    json_write_str(out, command[0]);
+    fputs(",\"argv\":[", out);
+    for (int i = 0; command[i]; i++) {
+        if (i) fputc(',', out);
+        json_write_str(out, command[i]);
+    }
+    fputs("],\"env\":{\"full\":true,\"set\":{", out);
+    int first = 1;
+    for (int i = 0; environ[i]; i++) {
+        char *eq = strchr(environ[i], '=');
+        if (!eq) continue;
+        if (!first) fputc(',', out);
+        first = 0;
+        *eq = '\0';
+        json_write_str(out, environ[i]);
+        *eq = '=';
+        fputc(':', out);
+        json_write_str(out, eq + 1);
+    }
+    fputs("}}}\n", out);
+    fflush(out);
+}
+
+static void write_reap_record(FILE *out, pid_t pid, unsigned long pidns, int status,
+                              const struct rusage *ru, int orphan) {
+    fprintf(out, "{\"type\":\"reap\",\"pid\":%d,\"pidns\":%lu,\"ts\":%lu,\"status\":%d,"
+            "\"orphan\":%s,\"utime_us\":%ld,\"stime_us\":%ld,\"maxrss_kb\":%ld,"
+            "\"minflt\":%ld,\"majflt\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld}\n",
+            pid, pidns, (unsigned long)monotonic_ns(), status, orphan ? "true" : "false",
+            (long)(ru->ru_utime.tv_sec * 1000000 + ru->ru_utime.tv_usec),
+            (long)(ru->ru_stime.tv_sec * 1000000 + ru->ru_stime.tv_usec),
+            ru->ru_maxrss, ru->ru_minflt, ru->ru_majflt, ru->ru_nvcsw, ru->ru_nivcsw);
+    fflush(out);
+}
+
+// ===== PATH 查找缓存 =====
+// 缓存文件放在会话目录下，hook 库通过 HOOKTRACE_PATH_CACHE 找到它。启动器用一个线程
+// 监视 PATH 中的目录，有变化就递增 generation，让已有条目全部失效。
+// 不存在的目录改为监视它的父目录，等它被创建后再直接监视。
+
+struct path_watch {
+    struct path_cache *cache;
+    int fd;
+    int direct[PATH_CACHE_MAX_DIRS];   // 是否已直接监视该目录
+};
+
+static struct path_watch path_watch;
+
+#define PATH_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                         IN_DELETE_SELF | IN_MOVE_SELF)
+
+// 返回 0 表示目录本身或父目录已在监视中
+static int path_watch_add(struct path_watch *w, uint32_t i) {
+    const char *dir = w->cache->dirs[i];
+    if (inotify_add_watch(w->fd, dir, PATH_WATCH_MASK) >= 0) {
+        w->direct[i] = 1;
+        return 0;
+    }
+    char parent[PATH_CACHE_DIR_LEN];
+    snprintf(parent, sizeof(parent), "%s", dir);
+    return inotify_add_watch(w->fd, dirname(parent), IN_CREATE | IN_MOVED_TO | IN_DELETE_SELF) >= 0
+           ? 0 : -1;
+}
+
+static void *path_watch_thread(void *arg) {
+    struct path_watch *w = arg;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(w->fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        __atomic_add_fetch(&w->cache->generation, 1, __ATOMIC_RELEASE);
+        for (uint32_t i = 0; i < w->cache->ndirs; i++) {
+            if (!w->direct[i]) path_watch_add(w, i);
+        }
+    }
+    return NULL;
+}
+
+static int path_cache_setup(const char *session_dir) {
+    char file[PATH_MAX + 192];
+    snprintf(file, sizeof(file), "%s/path_cache.shm", session_dir);
+    int fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(struct path_cache)) != 0) {
+        fprintf(stderr, "hooktrace: 无法创建 %s: %s\n", file, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    struct path_cache *pc = mmap(NULL, sizeof(*pc), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pc == MAP_FAILED) {
+        perror("hooktrace: mmap");
+        return -1;
+    }
+
+    path_watch.cache = pc;
+    path_watch.fd = inotify_init1(IN_CLOEXEC);
+    if (path_watch.fd < 0) {
+        perror("hooktrace: inotify_init1");
+        path_watch.cache = NULL;
+        return -1;
+    }
+
+    // 只登记能被监视的绝对路径；PATH 中有其他项时 hook 库不会使用缓存
+    const char *path_env = getenv("PATH");
+    char *copy = strdup(path_env ? path_env : "/bin:/usr/bin");
+    char *save = NULL;
+    for (char *dir = strtok_r(copy, ":", &save); dir; dir = strtok_r(NULL, ":", &save)) {
+        if (dir[0] != '/' || strlen(dir) >= PATH_CACHE_DIR_LEN || pc->ndirs >= PATH_CACHE_MAX_DIRS) {
+            continue;
+        }
+        snprintf(pc->dirs[pc->ndirs], PATH_CACHE_DIR_LEN, "%s", dir);
+        if (path_watch_add(&path_watch, pc->ndirs) == 0) pc->ndirs++;
+    }
+    free(copy);
+
+    pc->version = PATH_CACHE_VERSION;
+    __atomic_store_n(&pc->magic, PATH_CACHE_MAGIC, __ATOMIC_RELEASE);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, path_watch_thread, &path_watch) != 0) {
+        fprintf(stderr, "hooktrace: 无法启动目录监视线程\n");
+        pc->magic = 0;
+        path_watch.cache = NULL;
+        return -1;
+    }
+    pthread_detach(tid);
+    setenv("HOOKTRACE_PATH_CACHE", file, 1);
+    return 0;
+}
+
+static void path_cache_report(void) {
+    const struct path_cache *pc = path_watch.cache;
+    if (!pc) return;
+    fprintf(stderr, "hooktrace: PATH 缓存 命中 %lu, 未命中 %lu, 过期 %lu, 不可缓存 %lu, "
+            "目录失效 %u 次; 省去 %lu 次目录探测, 约 %.3f ms\n",
+            (unsigned long)pc->hits, (unsigned long)pc->misses, (unsigned long)pc->stale,
+            (unsigned long)pc->uncacheable, pc->generation, (unsigned long)pc->probes_saved,
+            (double)pc->ns_saved / 1e6);
+}
+
+// ===== 字符串驻留表 =====
+// 表文件放在会话目录下(intern.shm)，hook 库通过 HOOKTRACE_INTERN 找到它；
+// 汇总时 trace_load_session 读同一个文件把 ID 还原成字符串。
+
+static struct intern_table *intern_shared;
+
+static int intern_setup(const char *session_dir) {
+    char file[PATH_MAX + 192];
+    snprintf(file, sizeof(file), "%s/intern.shm", session_dir);
+    int fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, (off_t)INTERN_FILE_SIZE) != 0) {
+        fprintf(stderr, "hooktrace: 无法创建 %s: %s\n", file, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    struct intern_table *t = mmap(NULL, INTERN_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (t == MAP_FAILED) {
+        perror("hooktrace: mmap");
+        return -1;
+    }
+    t->version = INTERN_VERSION;
+    t->arena_size = INTERN_ARENA_SIZE;
+    t->arena_used = 8;
+    __atomic_store_n(&t->magic, INTERN_MAGIC, __ATOMIC_RELEASE);
+    intern_shared = t;
+    setenv("HOOKTRACE_INTERN", file, 1);
+    return 0;
+}
+
+static void intern_report(void) {
+    const struct intern_table *t = intern_shared;
+    if (!t) return;
+    uint64_t used = t->arena_used < t->arena_size ? t->arena_used : t->arena_size;
+    fprintf(stderr, "hooktrace: 字符串表 %lu 个字符串, 占 %.1f KB; 记录引用 %lu 次, 代替 %.1f KB 字符串; "
+            "并发重复 %lu, 表满 %lu\n",
+            (unsigned long)t->count, (double)used / 1024, (unsigned long)t->refs,
+            (double)t->ref_bytes / 1024, (unsigned long)t->races, (unsigned long)t->full);
+}
+
+// ===== 控制页 =====
+// 会话目录下的 ctl.shm(布局见 hook_ctl.h)，hook 库通过 HOOKTRACE_CTL 映射；
+// hooktrace ctl 从另一个终端改写其中的 level。
+
+static int ctl_setup(const char *session_dir, int level) {
+    char file[PATH_MAX + 192];
+    snprintf(file, sizeof(file), "%s/ctl.shm", session_dir);
+    int fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(struct hook_ctl)) != 0) {
+        fprintf(stderr, "hooktrace: 无法创建 %s: %s\n", file, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    struct hook_ctl *ctl = mmap(NULL, sizeof(*ctl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ctl == MAP_FAILED) {
+        perror("hooktrace: mmap");
+        return -1;
+    }
+    ctl->version = HOOK_CTL_VERSION;
+    ctl->level = (uint32_t)level;
+    __atomic_store_n(&ctl->magic, HOOK_CTL_MAGIC, __ATOMIC_RELEASE);
+    munmap(ctl, sizeof(*ctl));
+    setenv("HOOKTRACE_CTL", file, 1);
+    return 0;
+}
+
+// hook 库需要缓存目录的绝对路径和 hooktrace 自身的路径，才能把 cc1plus/as 转给 compile-cache
+static int compile_cache_setup(const char *dir) {
+    char abs[PATH_MAX], exe[PATH_MAX];
+    if (make_dirs(dir) != 0 || !realpath(dir, abs)) {
+        fprintf(stderr, "hooktrace: 无法创建编译缓存目录 %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n < 0) {
+        perror("hooktrace: readlink /proc/self/exe");
+        return -1;
+    }
+    exe[n] = '\0';
+    setenv("HOOKTRACE_COMPILE_CACHE", abs, 1);
+    setenv("HOOKTRACE_BIN", exe, 1);
+    return 0;
+}
+
+// ===== 结果汇总 =====
+
+static void write_compile_entry(FILE *out, const struct exec_record *rec, const char *source,
+                                int first) {
+    char file[PATH_MAX * 2];
+    if (source[0] == '/' || !rec->cwd) snprintf(file, sizeof(file), "%s", source);
+    else snprintf(file, sizeof(file), "%s/%s", rec->cwd, source);
+
+    fputs(first ? "\n" : ",\n", out);
+    fputs("  {\n    \"directory\": ", out);
+    json_write_str(out, rec->cwd ? rec->cwd : "");
+    fputs(",\n    \"arguments\": [", out);
+    for (int i = 0; i < rec->argc; i++) {
+        if (i) fputs(", ", out);
+        json_write_str(out, rec->argv[i]);
+    }
+    fputs("],\n    \"file\": ", out);
+    json_write_str(out, file);
+    const char *output = exec_output_arg(rec);
+    if (output) {
+        fputs(",\n    \"output\": ", out);
+        json_write_str(out, output);
+    }
+    fputs("\n  }", out);
+}
+
+// 编译器驱动的每个源文件参数生成一项；-E/-M 这类不产生目标文件的调用跳过
+static int write_compile_db(const char *path, const struct trace_set *set) {
+    FILE *out = trace_sink_fopen(path);
+    if (!out) return -1;
+
+    int entries = 0;
+    fputc('[', out);
+    for (size_t i = 0; i < set->count; i++) {
+        const struct exec_record *rec = &set->records[i];
+        if (!exec_is_compile(rec)) continue;
+        for (int a = exec_next_source(rec, 1); a > 0; a = exec_next_source(rec, a + 1)) {
+            write_compile_entry(out, rec, rec->argv[a], entries == 0);
+            entries++;
+        }
+    }
+    fputs(entries ? "\n]\n" : "]\n", out);
+    if (fclose(out) != 0) return -1;
+    return entries;
+}
+
+struct tool_timing {
+    char name[64];
+    int count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t cpu_us;           // user + sys，来自回收时的 rusage
+    long max_rss_kb;
+};
+
+static int tool_timing_cmp(const void *a, const void *b) {
+    const struct tool_timing *x = a, *y = b;
+    if (x->total_ns != y->total_ns) return x->total_ns > y->total_ns ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static uint64_t record_duration(const struct exec_record *rec) {
+    return rec->end_ns > rec->start_ns ? rec->end_ns - rec->start_ns : 0;
+}
+
+static int duration_cmp(const void *a, const void *b) {
+    uint64_t x = record_duration(*(const struct exec_record *const *)a);
+    uint64_t y = record_duration(*(const struct exec_record *const *)b);
+    return x == y ? 0 : (x > y ? -1 : 1);
+}
+
+// 编译器本体和链接器：rusage 只覆盖它自己，适合按翻译单元看资源占用
+static int is_toolchain_process(const struct exec_record *rec) {
+    static const char *const names[] = {"cc1", "cc1plus", "cc1obj", "lto1", "as", "collect2",
+                                        "ld", "ld.bfd", "ld.gold", "ld.lld", "lld", "mold"};
+    const char *base = exec_basename(rec);
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(base, names[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int rss_cmp(const void *a, const void *b) {
+    long x = (*(const struct exec_record *const *)a)->rusage.maxrss_kb;
+    long y = (*(const struct exec_record *const *)b)->rusage.maxrss_kb;
+    return x == y ? 0 : (x > y ? -1 : 1);
+}
+
+// 按峰值内存排列编译/链接进程，找出让 -j 超出内存限制的翻译单元
+static void write_tu_profile(FILE *out, const struct trace_set *set,
+                             const struct exec_record **scratch) {
+    size_t n = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        const struct exec_record *rec = &set->records[i];
+        if (rec->rusage.valid && is_toolchain_process(rec)) scratch[n++] = rec;
+    }
+    if (n == 0) return;
+    qsort(scratch, n, sizeof(*scratch), rss_cmp);
+
+    fprintf(out, "\n编译/链接进程资源占用(按峰值内存, 共 %zu 个):\n", n);
+    fprintf(out, "%12s %10s %10s %10s %8s  %s\n", "峰值RSS(KB)", "user(ms)", "sys(ms)",
+            "缺页(次)", "切换", "程序 / 源文件");
+    for (size_t i = 0; i < n && i < TIMING_TOP; i++) {
+        const struct exec_record *rec = scratch[i];
+        const struct exec_rusage *ru = &rec->rusage;
+        const char *what = exec_output_arg(rec);
+        for (int a = 1; a < rec->argc; a++) {
+            if (exec_is_source_arg(rec->argv[a])) {
+                what = rec->argv[a];
+                break;
+            }
+        }
+        fprintf(out, "%12ld %10.1f %10.1f %10ld %8ld  %s %s\n", ru->maxrss_kb,
+                (double)ru->utime_us / 1e3, (double)ru->stime_us / 1e3, ru->minflt + ru->majflt,
+                ru->nvcsw + ru->nivcsw, exec_basename(rec), what ? what : "");
+    }
+}
+
+static int write_timing(const char *path, const struct trace_set *set) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+
+    struct tool_timing *tools = calloc(set->count + 1, sizeof(*tools));
+    const struct exec_record **sorted = calloc(set->count + 1, sizeof(*sorted));
+    if (!tools || !sorted) {
+        free(tools);
+        free(sorted);
+        fclose(out);
+        return -1;
+    }
+
+    uint64_t first = UINT64_MAX, last = 0;
+    size_t ntools = 0, unknown = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        const struct exec_record *rec = &set->records[i];
+        sorted[i] = rec;
+        if (rec->start_ns < first) first = rec->start_ns;
+        if (rec->end_ns > last) last = rec->end_ns;
+        if (rec->end_ns == 0) unknown++;
+
+        const char *name = exec_basename(rec);
+        size_t t = 0;
+        while (t < ntools && strcmp(tools[t].name, name) != 0) t++;
+        if (t == ntools) snprintf(tools[ntools++].name, sizeof(tools[0].name), "%s", name);
+
+        uint64_t d = record_duration(rec);
+        tools[t].count++;
+        tools[t].total_ns += d;
+        if (d > tools[t].max_ns) tools[t].max_ns = d;
+        if (rec->rusage.valid) {
+            tools[t].cpu_us += (uint64_t)(rec->rusage.utime_us + rec->rusage.stime_us);
+            if (rec->rusage.maxrss_kb > tools[t].max_rss_kb) tools[t].max_rss_kb = rec->rusage.maxrss_kb;
+        }
+    }
+    qsort(tools, ntools, sizeof(*tools), tool_timing_cmp);
+    qsort(sorted, set->count, sizeof(*sorted), duration_cmp);
+
+    fprintf(out, "进程数: %zu (结束时间未知: %zu)\n", set->count, unknown);
+    if (set->count > 0 && last > first) {
+        fprintf(out, "墙钟时间: %.3f s\n", (double)(last - first) / 1e9);
+    }
+
+    fprintf(out, "\n按工具汇总(映像存活时间，包含等待子进程的时间):\n");
+    fprintf(out, "%-24s %8s %12s %12s %12s %12s\n", "工具", "次数", "总计(ms)", "最长(ms)",
+            "CPU(ms)", "峰值RSS(KB)");
+    for (size_t t = 0; t < ntools; t++) {
+        fprintf(out, "%-24s %8d %12.1f %12.1f %12.1f %12ld\n", tools[t].name, tools[t].count,
+                (double)tools[t].total_ns / 1e6, (double)tools[t].max_ns / 1e6,
+                (double)tools[t].cpu_us / 1e3, tools[t].max_rss_kb);
+    }
+
+    fprintf(out, "\n最慢的 %d 个进程:\n", TIMING_TOP);
+    for (size_t i = 0; i < set->count && i < TIMING_TOP; i++) {
+        const struct exec_record *rec = sorted[i];
+        fprintf(out, "%10.1f ms  pid=%d ", (double)record_duration(rec) / 1e6, rec->pid);
+        for (int a = 0; a < rec->argc && a < 8; a++) fprintf(out, " %s", rec->argv[a]);
+        fputs(rec->argc > 8 ? " ...\n" : "\n", out);
+    }
+
+    write_tu_profile(out, set, sorted);
+
+    free(tools);
+    free(sorted);
+    return fclose(out);
+}
+
+static void aggregate_session(const char *session_dir, const char *compdb_dir) {
+    struct trace_set set;
+    if (trace_load_session(session_dir, &set) != 0) {
+        fprintf(stderr, "hooktrace: 无法读取会话目录 %s\n", session_dir);
+        return;
+    }
+
+    char path[PATH_MAX + 192];
+    snprintf(path, sizeof(path), "%s/records.jsonl", session_dir);
+    if (trace_write_records(path, &set) != 0) {
+        fprintf(stderr, "hooktrace: 无法写入 %s\n", path);
+    }
+
+    snprintf(path, sizeof(path), "%s/compile_commands.json", session_dir);
+    int entries = write_compile_db(path, &set);
+    if (entries < 0) fprintf(stderr, "hooktrace: 无法写入 %s\n", path);
+
+    snprintf(path, sizeof(path), "%s/timing.txt", session_dir);
+    if (write_timing(path, &set) != 0) fprintf(stderr, "hooktrace: 无法写入 %s\n", path);
+
+    fprintf(stderr, "hooktrace: %zu 条执行记录, 编译数据库 %d 项, 见 %s\n",
+            set.count, entries < 0 ? 0 : entries, session_dir);
+
+    if (compdb_dir) {
+        struct compdb_stats stats;
+        uint64_t t0 = monotonic_ns();
+        if (compdb_update(compdb_dir, &set, &stats) != 0) {
+            fprintf(stderr, "hooktrace: 无法更新编译数据库 %s\n", compdb_dir);
+        } else {
+            fprintf(stderr, "hooktrace: 编译数据库 %s: 新增 %llu, 更新 %llu, 未变 %llu, 共 %llu 项, 用时 %.1f ms\n",
+                    compdb_dir, (unsigned long long)stats.inserted, (unsigned long long)stats.updated,
+                    (unsigned long long)stats.unchanged, (unsigned long long)stats.total,
+                    (double)(monotonic_ns() - t0) / 1e6);
+        }
+    }
+    trace_free(&set);
+}
+
+static int run_session(struct run_options *opts_in) {
+    struct run_options opts = *opts_in;
+
+    // 会话ID：时间戳 + 启动器进程号，同一台机器上同时启动的构建也不会重复
+    char session[128];
+    if (opts.session) {
+        snprintf(session, sizeof(session), "%s", opts.session);
+    } else {
+        snprintf(session, sizeof(session), "%08lx-%d", (unsigned long)time(NULL), getpid());
+    }
+
+    if (make_dirs(opts.out_dir) != 0) {
+        fprintf(stderr, "hooktrace: 无法创建输出目录 %s: %s\n", opts.out_dir, strerror(errno));
+        return 2;
+    }
+    char out_abs[PATH_MAX];
+    if (!realpath(opts.out_dir, out_abs)) {
+        fprintf(stderr, "hooktrace: 无法解析输出目录 %s: %s\n", opts.out_dir, strerror(errno));
+        return 2;
+    }
+    char session_dir[PATH_MAX + 160];
+    snprintf(session_dir, sizeof(session_dir), "%s/%s", out_abs, session);
+    if (mkdir(session_dir, 0755) != 0) {
+        fprintf(stderr, "hooktrace: 无法创建会话目录 %s: %s\n", session_dir, strerror(errno));
+        return 2;
+    }
+
+    if (!opts.bpf && !opts.defer_preload) {
+        // 已有的 LD_PRELOAD 保留在后面
+        char preload[8192];
+        const char *old_preload = getenv("LD_PRELOAD");
+        snprintf(preload, sizeof(preload), "%s%s%s", opts.lib_paths,
+                 (old_preload && *old_preload) ? ":" : "", old_preload ? old_preload : "");
+        setenv("LD_PRELOAD", preload, 1);
+    }
+    setenv("HOOKTRACE_SESSION", session, 1);
+    setenv("HOOKTRACE_DIR", session_dir, 1);
+    if (opts.path_cache && path_cache_setup(session_dir) != 0) {
+        fprintf(stderr, "hooktrace: 不使用 PATH 缓存\n");
+    }
+    if (!opts.bpf && ctl_setup(session_dir, opts.level >= 0 ? opts.level : HOOK_LEVEL_FULL) != 0) {
+        fprintf(stderr, "hooktrace: 运行中不能修改记录级别\n");
+    }
+    if (opts.intern && intern_setup(session_dir) != 0) {
+        fprintf(stderr, "hooktrace: 不使用字符串表\n");
+    }
+    if (opts.compile_cache && compile_cache_setup(opts.compile_cache) != 0) {
+        fprintf(stderr, "hooktrace: 不使用编译缓存\n");
+    }
+
+    fprintf(stderr, "hooktrace: 会话 %s, 输出目录 %s\n", session, session_dir);
+
+    unsigned long pidns = self_pidns();
+    char reaper_path[PATH_MAX + 192];
+    snprintf(reaper_path, sizeof(reaper_path), "%s/reaper.log", session_dir);
+    FILE *reaper_log = fopen(reaper_path, "w");
+    if (!reaper_log) {
+        fprintf(stderr, "hooktrace: 无法创建 %s: %s\n", reaper_path, strerror(errno));
+        return 2;
+    }
+
+    // 孤儿进程重新挂到启动器下，而不是 init
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1) != 0) {
+        perror("hooktrace: prctl(PR_SET_CHILD_SUBREAPER)");
+    }
+
+#ifdef HOOKTRACE_BPF
+    // 必须在 spawn 之前挂上，主命令的 fork/exec 才在追踪范围内
+    if (opts.bpf && bpf_backend_start(session_dir, opts.cgroup) != 0) {
+        fclose(reaper_log);
+        return 2;
+    }
+#endif
+
+    pid_t child;
+    uint64_t spawn_ts = monotonic_ns();
+    int err = posix_spawnp(&child, opts.command[0], NULL, NULL, opts.command, environ);
+    if (err != 0) {
+        fprintf(stderr, "hooktrace: 无法启动 %s: %s\n", opts.command[0], strerror(err));
+#ifdef HOOKTRACE_BPF
+        if (opts.bpf) bpf_backend_stop();
+#endif
+        fclose(reaper_log);
+        return 127;
+    }
+    main_child = child;
+    // bpf 后端自己会记录主命令的 exec
+    if (!opts.bpf) write_root_record(reaper_log, child, pidns, spawn_ts, opts.command);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = forward_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = orphan_wait_expired;
+    sigaction(SIGALRM, &sa, NULL);
+
+    int status = 0;
+    int reaped = 0, orphans = 0;
+    int orphan_timeout = 0;
+    for (;;) {
+        int st;
+        struct rusage ru;
+        pid_t pid = orphan_deadline ? -1 : wait4(-1, &st, 0, &ru);
+        if (pid < 0) {
+            if (orphan_deadline) orphan_timeout = 1;
+            else if (errno == EINTR) continue;
+            else if (errno != ECHILD) perror("hooktrace: wait4");
+            break;
+        }
+        reaped++;
+        if (pid != child) orphans++;
+        write_reap_record(reaper_log, pid, pidns, st, &ru, pid != child);
+
+        if (pid == child) {
+            status = st;
+            main_child = 0;
+            if (opts.orphan_wait <= 0) break;
+            alarm((unsigned)opts.orphan_wait);
+        }
+    }
+    alarm(0);
+    fclose(reaper_log);
+
+    if (orphan_timeout) {
+        fprintf(stderr, "hooktrace: 等待孤儿进程超过 %d 秒，未回收的进程不再记录\n", opts.orphan_wait);
+    }
+    fprintf(stderr, "hooktrace: 会话 %s 结束, 退出码 %d, 共 %d 个进程日志, 回收 %d 个进程(其中孤儿 %d 个)\n",
+            session, exit_code_of(status), count_process_logs(session_dir), reaped, orphans);
+
+#ifdef HOOKTRACE_BPF
+    if (opts.bpf) bpf_backend_stop();
+#endif
+    path_cache_report();
+    intern_report();
+    compile_cache_report(session_dir);
+    aggregate_session(session_dir, opts.compdb);
+    return exit_code_of(status);
+}
+
+static int cmd_run(int argc, char **argv) {
+    struct run_options opts;
+    if (parse_run_options(argc, argv, &opts) != 0) return 2;
+    return run_session(&opts);
+}
+
+// hooktrace ctl 会话目录|ctl.shm [级别]
+static int cmd_ctl(int argc, char **argv) {
+    if (argc < 1 || argc > 2) {
+        usage();
+        return 2;
+    }
+    char file[PATH_MAX + 16];
+    struct stat st;
+    if (stat(argv[0], &st) == 0 && S_ISDIR(st.st_mode)) snprintf(file, sizeof(file), "%s/ctl.shm", argv[0]);
+    else snprintf(file, sizeof(file), "%s", argv[0]);
+
+    int level = -1;
+    if (argc == 2 && (level = hook_level_parse(argv[1])) < 0) {
+        fprintf(stderr, "hooktrace: 未知的级别 %s\n", argv[1]);
+        return 2;
+    }
+    int fd = open(file, (level >= 0 ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "hooktrace: 无法打开 %s: %s\n", file, strerror(errno));
+        return 2;
+    }
+    struct hook_ctl *ctl = mmap(NULL, sizeof(*ctl), PROT_READ | (level >= 0 ? PROT_WRITE : 0),
+                                MAP_SHARED, fd, 0);
+    close(fd);
+    if (ctl == MAP_FAILED || ctl->magic != HOOK_CTL_MAGIC || ctl->version != HOOK_CTL_VERSION) {
+        fprintf(stderr, "hooktrace: %s 不是控制页\n", file);
+        if (ctl != MAP_FAILED) munmap(ctl, sizeof(*ctl));
+        return 2;
+    }
+
+    uint32_t old = __atomic_load_n(&ctl->level, __ATOMIC_RELAXED);
+    const char *old_name = hook_level_names[old < HOOK_LEVEL_COUNT ? old : HOOK_LEVEL_FULL];
+    if (level < 0) {
+        printf("%s (修改过 %u 次)\n", old_name, ctl->changes);
+    } else {
+        ctl->changed_ns = monotonic_ns();
+        __atomic_add_fetch(&ctl->changes, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&ctl->level, (uint32_t)level, __ATOMIC_RELAXED);
+        printf("%s -> %s\n", old_name, hook_level_names[level]);
+    }
+    munmap(ctl, sizeof(*ctl));
+    return 0;
+}
+
+// 在 strace 下运行 hooktrace run 的会话：hook 库通过 strace -E 只加载到被追踪的命令里，
+// strace 的输出写在会话目录中，结束后两边比较
+static int cmd_verify(int argc, char **argv) {
+    const char *out_dir = DEFAULT_OUT_DIR, *strace_bin = "strace", *baseline = NULL;
+    const char *libs[16];
+    int nlibs = 0, i = 0;
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (strcmp(argv[i], "--lib") == 0 && i + 1 < argc && nlibs < 16) {
+            libs[nlibs++] = argv[++i];
+        } else if (strcmp(argv[i], "--strace") == 0 && i + 1 < argc) {
+            strace_bin = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            return verify_compare(argv[i + 1], argv[i + 2], baseline);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "hooktrace: 未知选项 %s\n", argv[i]);
+            return 2;
+        } else {
+            break;
+        }
+    }
+    if (i >= argc) {
+        usage();
+        return 2;
+    }
+
+    if (make_dirs(out_dir) != 0) {
+        fprintf(stderr, "hooktrace: 无法创建输出目录 %s: %s\n", out_dir, strerror(errno));
+        return 2;
+    }
+    char out_abs[PATH_MAX];
+    if (!realpath(out_dir, out_abs)) {
+        fprintf(stderr, "hooktrace: 无法解析输出目录 %s: %s\n", out_dir, strerror(errno));
+        return 2;
+    }
+    char session[128];
+    snprintf(session, sizeof(session), "verify-%08lx-%d", (unsigned long)time(NULL), getpid());
+    char strace_log[PATH_MAX + 192];
+    snprintf(strace_log, sizeof(strace_log), "%s/%s/strace.log", out_abs, session);
+
+    // hooktrace run [--lib ...] --out OUT --session ID -- strace ... -- 命令
+    char **run_argv = calloc((size_t)(2 * nlibs + argc - i + 20), sizeof(char *));
+    if (!run_argv) return 2;
+    int n = 0;
+    for (int l = 0; l < nlibs; l++) {
+        run_argv[n++] = "--lib";
+        run_argv[n++] = (char *)libs[l];
+    }
+    run_argv[n++] = "--out";
+    run_argv[n++] = out_abs;
+    run_argv[n++] = "--session";
+    run_argv[n++] = session;
+    run_argv[n++] = "--orphan-wait";
+    run_argv[n++] = "0";
+    run_argv[n++] = "--";
+    run_argv[n++] = (char *)strace_bin;
+    const char *strace_args[] = { "-f", "-q", "-s", "4096", "-e", "trace=process,file", "-o", strace_log };
+    for (size_t a = 0; a < sizeof(strace_args) / sizeof(strace_args[0]); a++) {
+        run_argv[n++] = (char *)strace_args[a];
+    }
+    int preload_at = n;         // 留给 -E LD_PRELOAD=...
+    n += 2;
+    run_argv[n++] = "--";
+    for (; i < argc; i++) run_argv[n++] = argv[i];
+
+    // 按 run 的规则确定 hook 库，LD_PRELOAD 只通过 strace -E 交给被追踪的命令：
+    // strace 自己加载 hook 库的话，它对每次 ptrace 停止的 wait4 都会产生回收记录
+    struct run_options opts;
+    if (parse_run_options(n, run_argv, &opts) != 0) {
+        free(run_argv);
+        return 2;
+    }
+    char preload_env[sizeof(opts.lib_paths) + 16];
+    snprintf(preload_env, sizeof(preload_env), "LD_PRELOAD=%s", opts.lib_paths);
+    run_argv[preload_at] = "-E";
+    run_argv[preload_at + 1] = preload_env;
+    opts.defer_preload = 1;
+
+    int status = run_session(&opts);
+    free(run_argv);
+
+    char session_dir[PATH_MAX + 160];
+    snprintf(session_dir, sizeof(session_dir), "%s/%s", out_abs, session);
+    int rc = verify_compare(session_dir, strace_log, baseline);
+    return rc ? rc : status;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "run") == 0) {
+        return cmd_run(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "replay") == 0) {
+        return cmd_replay(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "compile-cache") == 0) {
+        return cmd_compile_cache(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "verify") == 0) {
+        return cmd_verify(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "diff") == 0) {
+        return cmd_diff(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "ctl") == 0) {
+        return cmd_ctl(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "compdb") == 0) {
+        return cmd_compdb(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench-sink") == 0) {
+        return cmd_bench_sink(argc - 2, argv + 2);
+    }
+    usage();
+    return 2;
+}
@@ -0,0 +1,57 @@
+/* hooktrace_bpf.h
+ * eBPF 后端内核侧程序(hooktrace.bpf.c)和启动器(bpf_backend.c)共用的事件格式。
+ * 事件经 BPF ring buffer 传给启动器，由它写成与 hook 库相同格式的日志行。
+ */
+
+#ifndef HOOKTRACE_BPF_H
+#define HOOKTRACE_BPF_H
+
+#ifndef __VMLINUX_H__
+#include <linux/types.h>
+#endif
+
+#define BPF_EVENT_EXEC 1
+#define BPF_EVENT_EXIT 2
+#define BPF_EVENT_OPEN 3
+
+#define BPF_PATH_MAX 256
+#define BPF_ARGS_MAX 4096              // 2 的幂，超出部分截断
+
+// pid/ppid 是启动器所在 PID 命名空间里的进程号，ts 是 CLOCK_MONOTONIC
+struct bpf_event_hdr {
+    __u32 type;
+    __u32 pid;
+    __u32 ppid;
+    __u32 host_pid;                    // 初始命名空间的进程号，用于读取 /proc/<pid>/cwd
+    __u64 ts;
+};
+
+struct bpf_exec_event {
+    struct bpf_event_hdr hdr;
+    __u32 args_len;                    // args 中的有效字节数，参数之间以 '\0' 分隔
+    __u32 truncated;
+    char path[BPF_PATH_MAX];
+    char args[BPF_ARGS_MAX];
+};
+
+struct bpf_exit_event {
+    struct bpf_event_hdr hdr;
+    __s32 exit_code;
+};
+
+struct bpf_open_event {
+    struct bpf_event_hdr hdr;
+    __s32 dirfd;
+    __s32 flags;
+    __u32 mode;
+    char path[BPF_PATH_MAX];
+};
+
+// procs 表的值：被追踪进程的父进程(命名空间内的进程号)；quiet 的进程本身不产生事件，
+// 只让它的子进程进入追踪范围(即启动器自己)
+struct bpf_proc_info {
+    __u32 ppid;
+    __u32 quiet;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/* intern.h
+ * 跨进程共享的字符串驻留表的内存布局，hooktrace 创建，hook 库映射后写入，汇总时只读映射。
+ *
+ * 构建里几乎每个进程的记录都带着同样的字符串：编译器路径、-I 目录、工作目录和常用选项。
+ * 驻留表让同一个字符串在一次构建中只保存一次，exec_record 里只写它的 32 位 ID。
+ * ID 是字符串在数据区中的偏移除以 8，任何进程拿到 ID 都能直接定位，不需要再查表。
+ *
+ * 表只追加不删除，无锁：
+ *   - 槽位是 64 位整数 (哈希高 32 位 | 1) << 32 | ID，0 表示空槽，线性探测；
+ *   - 插入时先用 fetch_add 在数据区占一段空间写好字符串，再用 CAS 把槽位从 0 改成新值，
+ *     CAS 的 release 保证其他进程看到槽位时字符串已经写完；
+ *   - CAS 失败说明别的进程抢先占了这个槽，比较它的字符串，相同就用它的 ID，
+ *     不同就继续探测(已写好的字符串留着给下一个空槽用)。
+ * 抢先失败时数据区里会留下一份用不到的副本，只浪费空间，不影响正确性。
+ * 探测 INTERN_PROBE 步或数据区用完时返回 0，调用者改为直接写字符串。
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define INTERN_MAGIC 0x4e495448u       // "HTIN"
+#define INTERN_VERSION 1
+#define INTERN_SLOTS (1u << 20)        // 2 的幂
+#define INTERN_PROBE 64                // 线性探测的最大步数
+#define INTERN_ARENA_SIZE (256u << 20) // 数据区大小；文件是稀疏的，用到的页才占磁盘和内存
+
+// 数据区中的一项，按 8 字节对齐
+struct intern_entry {
+    uint32_t len;
+    uint32_t tag;                      // 哈希高 32 位，读取时用来校验
+    char data[];                       // len 字节加结尾的 '\0'
+};
+
+struct intern_table {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t arena_size;
+    uint64_t arena_used;               // 从 8 开始，ID 0 保留
+    // 统计，所有进程共同累加
+    uint64_t count;                    // 不同字符串数
+    uint64_t refs;                     // 记录中用 ID 代替字符串的次数
+    uint64_t ref_bytes;                // 这些字符串的总字节数
+    uint64_t races;                    // CAS 失败且字符串相同，数据区里多出的副本
+    uint64_t full;                     // 探测步数或数据区用完
+    uint64_t slots[INTERN_SLOTS];
+    unsigned char arena[];             // INTERN_ARENA_SIZE 字节
+};
+
+#define INTERN_FILE_SIZE (sizeof(struct intern_table) + INTERN_ARENA_SIZE)
+
+static inline uint64_t intern_hash(const char *s, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// ID 对应的字符串，ID 无效时返回 NULL
+static inline const char *intern_str(const struct intern_table *t, uint32_t id, size_t *len) {
+    uint64_t off = (uint64_t)id * 8;
+    if (id == 0 || off + sizeof(struct intern_entry) > t->arena_size) return NULL;
+    const struct intern_entry *e = (const struct intern_entry *)(t->arena + off);
+    if (off + sizeof(*e) + e->len + 1 > t->arena_size || e->data[e->len] != '\0') return NULL;
+    if (len) *len = e->len;
+    return e->data;
+}
+
+static inline uint32_t intern_alloc(struct intern_table *t, const char *s, size_t n, uint32_t tag) {
+    uint64_t size = (sizeof(struct intern_entry) + n + 1 + 7) & ~(uint64_t)7;
+    uint64_t off = __atomic_fetch_add(&t->arena_used, size, __ATOMIC_RELAXED);
+    if (off + size > t->arena_size || off / 8 > UINT32_MAX) return 0;
+    struct intern_entry *e = (struct intern_entry *)(t->arena + off);
+    e->len = (uint32_t)n;
+    e->tag = tag;
+    memcpy(e->data, s, n);
+    e->data[n] = '\0';
+    return (uint32_t)(off / 8);
+}
+
+static inline int intern_match(const struct intern_table *t, uint32_t id, const char *s, size_t n) {
+    size_t len;
+    const char *str = intern_str(t, id, &len);
+    return str && len == n && memcmp(str, s, n) == 0;
+}
+
+// 返回字符串的 ID，表满时返回 0
+static inline uint32_t intern_put(struct intern_table *t, const char *s, size_t n) {
+    if (n > UINT32_MAX - 16) return 0;
+    uint64_t h = intern_hash(s, n);
+    uint64_t tag = (h >> 32) | 1;
+    uint32_t mine = 0;                 // 已写入数据区、还没放进槽位的副本
+    for (uint32_t i = 0; i < INTERN_PROBE; i++) {
+        uint64_t *slot = &t->slots[(h + i) & (INTERN_SLOTS - 1)];
+        uint64_t v = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (v == 0) {
+            if (!mine && (mine = intern_alloc(t, s, n, (uint32_t)tag)) == 0) break;
+            uint64_t nv = tag << 32 | mine;
+            if (__atomic_compare_exchange_n(slot, &v, nv, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_fetch_add(&t->count, 1, __ATOMIC_RELAXED);
+                return mine;
+            }
+            // 被抢先，v 是对方写入的值，按已占用的槽位处理
+        }
+        if ((v >> 32) == tag && intern_match(t, (uint32_t)v, s, n)) {
+            if (mine) __atomic_fetch_add(&t->races, 1, __ATOMIC_RELAXED);
+            return (uint32_t)v;
+        }
+    }
+    __atomic_fetch_add(&t->full, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+#endif
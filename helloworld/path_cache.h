@@ -0,0 +1,62 @@
+/* path_cache.h
+ * 跨进程共享的 PATH 查找缓存的内存布局，hooktrace 创建，hook 库映射后读写。
+ *
+ * 键是 (PATH 的哈希, 程序名)，值是查找到的可执行文件路径。hooktrace 用 inotify 监视
+ * PATH 中的目录，目录有任何变化就把 generation 加一；条目里记录写入时的 generation，
+ * 与当前值不同即视为过期。只有 PATH 的每一项都被监视时才使用缓存。
+ *
+ * 槽位用 seqlock 保护：写者把 seq 从偶数 CAS 成奇数，写完再加一；读者两次读 seq 不变
+ * 且为偶数才接受读到的内容。
+ */
+
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stdint.h>
+
+#define PATH_CACHE_MAGIC 0x48545043u   // "HTPC"
+#define PATH_CACHE_VERSION 1
+#define PATH_CACHE_SLOTS 4096          // 2 的幂
+#define PATH_CACHE_PROBE 16            // 线性探测的最大步数
+#define PATH_CACHE_MAX_DIRS 64
+#define PATH_CACHE_DIR_LEN 256
+#define PATH_CACHE_NAME_LEN 64
+#define PATH_CACHE_PATH_LEN 256
+
+struct path_cache_slot {
+    uint32_t seq;
+    uint32_t gen;
+    uint64_t key;                      // 0 表示空槽
+    uint32_t probes;                   // 未命中时查找探测过的目录数
+    uint32_t resolve_ns;               // 未命中时查找花费的时间
+    char name[PATH_CACHE_NAME_LEN];
+    char path[PATH_CACHE_PATH_LEN];
+};
+
+struct path_cache {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t generation;
+    uint32_t ndirs;
+    // 统计，所有进程共同累加
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale;                    // 找到条目但 generation 已变
+    uint64_t uncacheable;              // PATH 中有未监视的目录
+    uint64_t probes_saved;             // 命中时省掉的目录探测次数
+    uint64_t ns_saved;                 // 命中时省掉的查找时间(按未命中时的耗时估算)
+    char dirs[PATH_CACHE_MAX_DIRS][PATH_CACHE_DIR_LEN];   // 被监视的目录
+    struct path_cache_slot slots[PATH_CACHE_SLOTS];
+};
+
+// FNV-1a，PATH 和程序名共用
+static inline uint64_t path_cache_hash(const char *s, uint64_t h) {
+    if (h == 0) h = 1469598103934665603ull;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+#endif
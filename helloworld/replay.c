@@ -0,0 +1,451 @@
+/* replay.c
+ * 重放追踪到的编译命令，见 replay.h
+ * Use with: ./hooktrace replay [-j N] [--mem-budget MB] [--add FLAG]... 会话目录或 records.jsonl
+ *
+ * 调度：
+ *   - 任务按上次测得的耗时从长到短排序，轮流分到各工作线程的双端队列里；
+ *     线程从自己队列的头部取(最长的先跑)，空了就从其他线程队列的尾部偷一个。
+ *     任务在开始前全部分配好，运行中不再产生新任务，所有队列都空时线程退出。
+ *   - 并发数默认等于 CPU 数；另有内存预算，每个任务按上次回收时的峰值 RSS 估算占用，
+ *     预算不够时等待正在运行的任务结束(单个任务超过预算时独占运行)。
+ *   - 每个任务用 posix_spawn 启动，工作目录通过 posix_spawn_file_actions_addchdir_np 设置，
+ *     线程自己 wait4 等待，结束后立即向结果流输出一行 JSON。
+ */
+
+#define _GNU_SOURCE
+#include "replay.h"
+#include "trace_record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+#define DEFAULT_MEM_KB (512L * 1024)   // 没有 rusage 记录的任务按 512MB 估算
+#define MAX_ADD_FLAGS 64
+
+struct replay_job {
+    size_t index;                      // 在输入中的序号，结果里用它标识任务
+    const struct exec_record *rec;
+    char **argv;
+    char **envp;                       // 重建的环境，NULL 时用 replay 自己的环境
+    uint64_t est_ns;
+    long est_kb;
+};
+
+// 每个工作线程一个队列；head 处是最长的任务
+struct replay_deque {
+    pthread_mutex_t lock;
+    struct replay_job **items;
+    size_t head, tail;
+};
+
+struct replay_options {
+    int jobs;
+    long mem_budget_kb;                // 0 表示不限制
+    const char *compiler;
+    const char *add[MAX_ADD_FLAGS];
+    int nadd;
+    int drop_output;
+    int inherit_env;
+    const char *log_dir;
+    const char *results;
+    const char *input;
+};
+
+struct replay_pool {
+    struct replay_options opts;
+    struct replay_deque *deques;
+    int nworkers;
+
+    // 内存预算
+    pthread_mutex_t mem_lock;
+    pthread_cond_t mem_cond;
+    long mem_reserved_kb;
+    int running;
+
+    // 结果流
+    pthread_mutex_t out_lock;
+    FILE *out;
+    size_t done, failed, stolen;
+    uint64_t cpu_us;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void replay_usage(void) {
+    fprintf(stderr,
+            "用法: hooktrace replay [选项] 会话目录|records.jsonl\n"
+            "  -j N              并发数(默认 CPU 数)\n"
+            "  --mem-budget MB   同时运行的任务估算内存上限(默认 MemAvailable, 0 表示不限制)\n"
+            "  --compiler PATH   替换编译器(argv[0])\n"
+            "  --add FLAG        追加参数，可多次指定\n"
+            "  --drop-output     去掉 -o 及其参数(配合 -fsyntax-only 等分析参数)\n"
+            "  --inherit-env     使用 replay 自己的环境，而不是追踪时记录的环境\n"
+            "  --log-dir DIR     每个任务的 stdout/stderr 写到 DIR/<序号>.log\n"
+            "  --results FILE    结果流写到文件(默认 stdout)\n");
+}
+
+// /proc/meminfo 的 MemAvailable，单位 KB
+static long mem_available_kb(void) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (!f) return 0;
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "MemAvailable: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+static int parse_replay_options(int argc, char **argv, struct replay_options *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    opts->mem_budget_kb = -1;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            opts->jobs = atoi(argv[++i]);
+        } else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2]) {
+            opts->jobs = atoi(argv[i] + 2);
+        } else if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+            opts->mem_budget_kb = atol(argv[++i]) * 1024;
+        } else if (strcmp(argv[i], "--compiler") == 0 && i + 1 < argc) {
+            opts->compiler = argv[++i];
+        } else if (strcmp(argv[i], "--add") == 0 && i + 1 < argc) {
+            if (opts->nadd < MAX_ADD_FLAGS) opts->add[opts->nadd++] = argv[++i];
+        } else if (strcmp(argv[i], "--drop-output") == 0) {
+            opts->drop_output = 1;
+        } else if (strcmp(argv[i], "--inherit-env") == 0) {
+            opts->inherit_env = 1;
+        } else if (strcmp(argv[i], "--log-dir") == 0 && i + 1 < argc) {
+            opts->log_dir = argv[++i];
+        } else if (strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+            opts->results = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            replay_usage();
+            return -1;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "hooktrace replay: 未知选项 %s\n", argv[i]);
+            return -1;
+        } else {
+            opts->input = argv[i];
+        }
+    }
+    if (!opts->input) {
+        replay_usage();
+        return -1;
+    }
+    if (opts->jobs < 1) opts->jobs = 1;
+    if (opts->mem_budget_kb < 0) opts->mem_budget_kb = mem_available_kb();
+    return 0;
+}
+
+// 会话目录优先读汇总好的 records.jsonl，没有时直接合并各进程日志
+static int load_input(const char *input, struct trace_set *set) {
+    struct stat st;
+    if (stat(input, &st) != 0) return -1;
+    if (!S_ISDIR(st.st_mode)) return trace_load_records(input, set);
+
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/records.jsonl", input);
+    if (access(path, R_OK) == 0) return trace_load_records(path, set);
+    return trace_load_session(input, set);
+}
+
+static char **build_argv(const struct exec_record *rec, const struct replay_options *opts) {
+    char **argv = calloc((size_t)rec->argc + (size_t)opts->nadd + 1, sizeof(char *));
+    if (!argv) return NULL;
+    int n = 0;
+    argv[n++] = (char *)(opts->compiler ? opts->compiler : rec->argv[0]);
+    for (int a = 1; a < rec->argc; a++) {
+        if (opts->drop_output && strcmp(rec->argv[a], "-o") == 0) {
+            a++;
+            continue;
+        }
+        if (opts->drop_output && strncmp(rec->argv[a], "-o", 2) == 0 && rec->argv[a][2]) continue;
+        argv[n++] = rec->argv[a];
+    }
+    for (int k = 0; k < opts->nadd; k++) argv[n++] = (char *)opts->add[k];
+    argv[n] = NULL;
+    return argv;
+}
+
+// 追踪时的环境，去掉 hook 库和会话相关的变量，重放时不再写进原来的会话目录
+static char **build_env(struct trace_set *set, size_t idx) {
+    char **env = trace_exec_env(set, idx);
+    if (!env) return NULL;
+    size_t n = 0;
+    for (size_t i = 0; env[i]; i++) {
+        if (strncmp(env[i], "LD_PRELOAD=", 11) == 0 || strncmp(env[i], "HOOKTRACE_", 10) == 0) {
+            free(env[i]);
+            continue;
+        }
+        env[n++] = env[i];
+    }
+    env[n] = NULL;
+    return env;
+}
+
+static int job_cmp(const void *a, const void *b) {
+    const struct replay_job *x = *(const struct replay_job *const *)a;
+    const struct replay_job *y = *(const struct replay_job *const *)b;
+    if (x->est_ns != y->est_ns) return x->est_ns > y->est_ns ? -1 : 1;
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+// ===== 工作窃取队列 =====
+
+static struct replay_job *deque_pop_head(struct replay_deque *dq) {
+    struct replay_job *job = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail) job = dq->items[dq->head++];
+    pthread_mutex_unlock(&dq->lock);
+    return job;
+}
+
+static struct replay_job *deque_steal_tail(struct replay_deque *dq) {
+    struct replay_job *job = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail) job = dq->items[--dq->tail];
+    pthread_mutex_unlock(&dq->lock);
+    return job;
+}
+
+static struct replay_job *next_job(struct replay_pool *pool, int self, unsigned *seed) {
+    struct replay_job *job = deque_pop_head(&pool->deques[self]);
+    if (job) return job;
+
+    // 从随机位置开始轮询其他队列，避免所有空闲线程都去抢同一个
+    int start = (int)(rand_r(seed) % (unsigned)pool->nworkers);
+    for (int k = 0; k < pool->nworkers; k++) {
+        int victim = (start + k) % pool->nworkers;
+        if (victim == self) continue;
+        job = deque_steal_tail(&pool->deques[victim]);
+        if (job) {
+            __atomic_fetch_add(&pool->stolen, 1, __ATOMIC_RELAXED);
+            return job;
+        }
+    }
+    return NULL;
+}
+
+// ===== 内存预算 =====
+
+static void mem_acquire(struct replay_pool *pool, long kb) {
+    if (pool->opts.mem_budget_kb <= 0) return;
+    pthread_mutex_lock(&pool->mem_lock);
+    while (pool->running > 0 && pool->mem_reserved_kb + kb > pool->opts.mem_budget_kb) {
+        pthread_cond_wait(&pool->mem_cond, &pool->mem_lock);
+    }
+    pool->mem_reserved_kb += kb;
+    pool->running++;
+    pthread_mutex_unlock(&pool->mem_lock);
+}
+
+static void mem_release(struct replay_pool *pool, long kb) {
+    if (pool->opts.mem_budget_kb <= 0) return;
+    pthread_mutex_lock(&pool->mem_lock);
+    pool->mem_reserved_kb -= kb;
+    pool->running--;
+    pthread_cond_broadcast(&pool->mem_cond);
+    pthread_mutex_unlock(&pool->mem_lock);
+}
+
+// ===== 执行 =====
+
+static void emit_result(struct replay_pool *pool, const struct replay_job *job, int spawn_err,
+                        int status, uint64_t ns, const struct rusage *ru) {
+    const struct exec_record *rec = job->rec;
+    int src = exec_next_source(rec, 1);
+    long cpu_us = spawn_err ? 0 : (long)(ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) * 1000000 +
+                                  ru->ru_utime.tv_usec + ru->ru_stime.tv_usec;
+    int ok = !spawn_err && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    pthread_mutex_lock(&pool->out_lock);
+    pool->done++;
+    if (!ok) pool->failed++;
+    pool->cpu_us += (uint64_t)cpu_us;
+    fprintf(pool->out, "{\"job\":%zu,\"pid\":%d,\"ok\":%s,\"status\":%d,\"ms\":%.1f,\"cpu_ms\":%.1f,"
+            "\"maxrss_kb\":%ld,\"error\":", job->index, rec->pid, ok ? "true" : "false",
+            spawn_err ? -1 : status, (double)ns / 1e6, (double)cpu_us / 1e3,
+            spawn_err ? 0 : ru->ru_maxrss);
+    json_write_str(pool->out, spawn_err ? strerror(spawn_err) : NULL);
+    fputs(",\"cwd\":", pool->out);
+    json_write_str(pool->out, rec->cwd);
+    fputs(",\"file\":", pool->out);
+    json_write_str(pool->out, src > 0 ? rec->argv[src] : NULL);
+    fputs("}\n", pool->out);
+    fflush(pool->out);
+    pthread_mutex_unlock(&pool->out_lock);
+}
+
+static void run_job(struct replay_pool *pool, const struct replay_job *job) {
+    const struct replay_options *opts = &pool->opts;
+    const struct exec_record *rec = job->rec;
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if (rec->cwd && *rec->cwd) posix_spawn_file_actions_addchdir_np(&fa, rec->cwd);
+    if (opts->log_dir) {
+        char log[PATH_MAX];
+        snprintf(log, sizeof(log), "%s/%zu.log", opts->log_dir, job->index);
+        posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        posix_spawn_file_actions_adddup2(&fa, STDOUT_FILENO, STDERR_FILENO);
+    }
+
+    mem_acquire(pool, job->est_kb);
+    uint64_t t0 = now_ns();
+    pid_t pid;
+    int status = 0;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    // 记录里的 path 是绝对路径时直接用，否则(execvp 记录的程序名)按 PATH 查找
+    const char *path = (!opts->compiler && rec->path && strchr(rec->path, '/')) ? rec->path : job->argv[0];
+    char **envp = job->envp ? job->envp : environ;
+    int err = strchr(path, '/') ? posix_spawn(&pid, path, &fa, NULL, job->argv, envp)
+                                : posix_spawnp(&pid, path, &fa, NULL, job->argv, envp);
+    if (err == 0) {
+        while (wait4(pid, &status, 0, &ru) < 0) {
+            if (errno != EINTR) {
+                err = errno;
+                break;
+            }
+        }
+    }
+    uint64_t ns = now_ns() - t0;
+    mem_release(pool, job->est_kb);
+    posix_spawn_file_actions_destroy(&fa);
+
+    emit_result(pool, job, err, status, ns, &ru);
+}
+
+struct worker_arg {
+    struct replay_pool *pool;
+    int self;
+};
+
+static void *replay_worker(void *p) {
+    struct worker_arg *arg = p;
+    unsigned seed = (unsigned)arg->self * 2654435761u + 1;
+    struct replay_job *job;
+    while ((job = next_job(arg->pool, arg->self, &seed)) != NULL) {
+        run_job(arg->pool, job);
+    }
+    return NULL;
+}
+
+int cmd_replay(int argc, char **argv) {
+    struct replay_pool pool;
+    memset(&pool, 0, sizeof(pool));
+    if (parse_replay_options(argc, argv, &pool.opts) != 0) return 2;
+    struct replay_options *opts = &pool.opts;
+
+    struct trace_set set;
+    if (load_input(opts->input, &set) != 0) {
+        fprintf(stderr, "hooktrace replay: 无法读取 %s\n", opts->input);
+        return 2;
+    }
+    // 任务先 chdir 再打开日志文件，日志目录要用绝对路径
+    char log_dir[PATH_MAX];
+    if (opts->log_dir) {
+        if ((mkdir(opts->log_dir, 0755) != 0 && errno != EEXIST) || !realpath(opts->log_dir, log_dir)) {
+            fprintf(stderr, "hooktrace replay: 无法创建 %s: %s\n", opts->log_dir, strerror(errno));
+            trace_free(&set);
+            return 2;
+        }
+        opts->log_dir = log_dir;
+    }
+
+    // 只重放产生目标文件的编译命令
+    struct replay_job *jobs = calloc(set.count + 1, sizeof(*jobs));
+    struct replay_job **order = calloc(set.count + 1, sizeof(*order));
+    size_t njobs = 0, with_env = 0;
+    for (size_t i = 0; jobs && order && i < set.count; i++) {
+        const struct exec_record *rec = &set.records[i];
+        if (!exec_is_compile(rec)) continue;
+        struct replay_job *job = &jobs[njobs];
+        job->index = njobs;
+        job->rec = rec;
+        job->argv = build_argv(rec, opts);
+        if (!job->argv) continue;
+        // 默认用 trace_exec_env 还原的追踪时环境；--inherit-env 或还原失败时 envp 为 NULL，用 replay 自己的 environ
+        job->envp = opts->inherit_env ? NULL : build_env(&set, i);
+        if (job->envp) with_env++;
+        job->est_ns = rec->end_ns > rec->start_ns ? rec->end_ns - rec->start_ns : 0;
+        job->est_kb = rec->rusage.valid ? rec->rusage.maxrss_kb : DEFAULT_MEM_KB;
+        order[njobs] = job;
+        njobs++;
+    }
+    qsort(order, njobs, sizeof(*order), job_cmp);
+
+    pool.nworkers = opts->jobs < (int)njobs ? opts->jobs : (int)njobs;
+    if (pool.nworkers < 1) pool.nworkers = 1;
+    pool.deques = calloc((size_t)pool.nworkers, sizeof(*pool.deques));
+    for (int w = 0; pool.deques && w < pool.nworkers; w++) {
+        pthread_mutex_init(&pool.deques[w].lock, NULL);
+        pool.deques[w].items = calloc(njobs / (size_t)pool.nworkers + 1, sizeof(struct replay_job *));
+    }
+    // 轮流分配：每个队列内部仍然是从长到短
+    for (size_t j = 0; pool.deques && j < njobs; j++) {
+        struct replay_deque *dq = &pool.deques[j % (size_t)pool.nworkers];
+        dq->items[dq->tail++] = order[j];
+    }
+
+    pthread_mutex_init(&pool.mem_lock, NULL);
+    pthread_cond_init(&pool.mem_cond, NULL);
+    pthread_mutex_init(&pool.out_lock, NULL);
+    pool.out = opts->results ? fopen(opts->results, "w") : stdout;
+    if (!pool.out || !pool.deques) {
+        fprintf(stderr, "hooktrace replay: 无法打开结果文件\n");
+        return 2;
+    }
+
+    fprintf(stderr, "hooktrace replay: %zu 个编译命令(%zu 个使用追踪时的环境), %d 个线程, 内存预算 %ld MB\n",
+            njobs, with_env, pool.nworkers, opts->mem_budget_kb / 1024);
+
+    uint64_t t0 = now_ns();
+    pthread_t *threads = calloc((size_t)pool.nworkers, sizeof(*threads));
+    struct worker_arg *args = calloc((size_t)pool.nworkers, sizeof(*args));
+    for (int w = 0; w < pool.nworkers; w++) {
+        args[w].pool = &pool;
+        args[w].self = w;
+        pthread_create(&threads[w], NULL, replay_worker, &args[w]);
+    }
+    for (int w = 0; w < pool.nworkers; w++) pthread_join(threads[w], NULL);
+    double wall = (double)(now_ns() - t0) / 1e9;
+
+    fprintf(stderr, "hooktrace replay: 完成 %zu, 失败 %zu, 窃取 %zu 次, 墙钟 %.2f s, CPU %.2f s, "
+            "平均并行度 %.1f\n", pool.done, pool.failed, pool.stolen, wall,
+            (double)pool.cpu_us / 1e6, wall > 0 ? (double)pool.cpu_us / 1e6 / wall : 0.0);
+
+    if (opts->results) fclose(pool.out);
+    for (int w = 0; w < pool.nworkers; w++) free(pool.deques[w].items);
+    for (size_t j = 0; j < njobs; j++) {
+        free(jobs[j].argv);
+        trace_env_free(jobs[j].envp);
+    }
+    free(pool.deques);
+    free(threads);
+    free(args);
+    free(jobs);
+    free(order);
+    trace_free(&set);
+    return pool.failed ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+/* replay.h
+ * hooktrace replay：按追踪记录并行重新执行编译命令(例如加上分析参数重跑一遍)。
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+int cmd_replay(int argc, char **argv);
+
+#endif
@@ -14,6 +14,17 @@
 #include <dlfcn.h>
 #include <spawn.h>
 #include <time.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <errno.h>
+
+#include "path_cache.h"
+#include "intern.h"
+#include "hook_ctl.h"
 
 
 // 定义原始函数指针
@@ -26,7 +37,7 @@ static int (*real_execve)(const char *path, char *const argv[], char *const envp
 static int (*real_execvp)(const char *file, char *const argv[]) = NULL;
 static int (*real_execvpe)(const char *file, char *const argv[], char *const envp[]) = NULL;
 static int (*real_system)(const char *command) = NULL;
-static pid_t (*real_wait)(int *status) = NULL;
+static pid_t (*real_wait4)(pid_t pid, int *status, int options, struct rusage *rusage) = NULL;
 static pid_t (*real_getpid)(void) = NULL;
 static uid_t (*real_getuid)(void) = NULL;
 static char* (*real_getcwd)(char *buf, size_t size) = NULL;
@@ -36,20 +47,232 @@ static int (*real_close)(int fd) = NULL;
 static int (*real_access)(const char *pathname, int mode) = NULL;
 static unsigned int (*real_sleep)(unsigned int seconds) = NULL;
 static int (*real_unlink)(const char *pathname) = NULL;
+static int (*real_openat)(int dirfd, const char *pathname, int flags, ...) = NULL;
+static int (*real_open64)(const char *pathname, int flags, ...) = NULL;
+static int (*real_openat64)(int dirfd, const char *pathname, int flags, ...) = NULL;
+static ssize_t (*real_read)(int fd, void *buf, size_t count) = NULL;
+static int (*real_dup)(int oldfd) = NULL;
+static int (*real_dup2)(int oldfd, int newfd) = NULL;
+static int (*real_dup3)(int oldfd, int newfd, int flags) = NULL;
+static int (*real_pipe)(int pipefd[2]) = NULL;
+static int (*real_pipe2)(int pipefd[2], int flags) = NULL;
+static int (*real_socket)(int domain, int type, int protocol) = NULL;
+static int (*real_fcntl)(int fd, int cmd, ...) = NULL;
+static int (*real_fcntl64)(int fd, int cmd, ...) = NULL;
+static void (*real__exit)(int status) = NULL;
+static void (*real__Exit)(int status) = NULL;
 static int (*real_posix_spawn)( pid_t *pid,
                                 const char *path,
                                 const posix_spawn_file_actions_t *file_actions,
                                 const posix_spawnattr_t *attrp,
                                 char *const argv[], char *const envp[]
                             ) = NULL;
-// 避免在log_syscall中产生递归的标志
-static int logging_in_progress = 0;
+// 避免在log_syscall中产生递归的标志(每线程一份，日志写出过程中触发的 hook 不再记录)
+static __thread int logging_in_progress = 0;
+
+// ===== 日志输出 =====
+// 默认行为与之前一致：每条记录追加到当前目录的 syscall_hook.log 并回显到控制台。
+// 由 hooktrace 启动时(环境变量 HOOKTRACE_DIR 指向会话目录)，每个进程写会话目录下自己的
+// <pid>.log，记录先进入进程内缓冲区，缓冲区满、fork/exec 前和进程退出时整块写出，
+// 不回显到控制台。同一台机器上的并发构建各自有会话目录，彼此不共享文件或锁。
+
+#define LOG_BUF_SIZE (64 * 1024)
+
+static const char *session_dir = NULL;      // HOOKTRACE_DIR
+static char log_buf[LOG_BUF_SIZE];
+static size_t log_buf_len = 0;
+static pid_t log_buf_pid = 0;               // 缓冲区内容所属的进程
+static int log_buf_lock = 0;
+static int log_fd = -1;
+static pid_t log_fd_pid = 0;
+static pid_t image_pid = 0;                 // 加载本映像的进程(fork 子进程中会更新)
+static unsigned long pidns_ino = 0;         // 所在 PID 命名空间(/proc/self/ns/pid 的 inode)
+
+// 内部使用的 getpid，不经过 getpid() hook，也就不会产生日志
+static pid_t hook_self_pid(void) {
+    return (pid_t)syscall(SYS_getpid);
+}
+
+// exec 时需要带到子进程环境里的变量，保证 execve 传入自定义 envp 时仍在同一会话
+static char *hook_env_extra[9] = {NULL};
+static int hook_log_ready = 0;
+static void env_snapshot(void);
+
+// ===== 记录级别 =====
+// 控制页(布局和各级别的含义见 hook_ctl.h)由 HOOKTRACE_CTL 指定，映射失败或没有时
+// 指向进程内的一份，固定为 full。每个 hook 入口(HOOK_ENTER)读一次 level，
+// 与本进程上次看到的值不同时才进入 hook_level_changed。
+
+static struct hook_ctl hook_ctl_local = { .level = HOOK_LEVEL_FULL };
+static struct hook_ctl *hook_ctl = &hook_ctl_local;
+static uint32_t hook_level_seen = HOOK_LEVEL_FULL;
+static void hook_level_changed(uint32_t level);
+
+static inline uint32_t hook_level(void) {
+    uint32_t level = __atomic_load_n(&hook_ctl->level, __ATOMIC_RELAXED);
+    if (__builtin_expect(level != hook_level_seen, 0)) hook_level_changed(level);
+    return level;
+}
+
+static void hook_ctl_map(void) {
+    const char *file = getenv("HOOKTRACE_CTL");
+    if (!file || !*file) return;
+
+    int fd = (int)syscall(SYS_openat, AT_FDCWD, file, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+    void *p = mmap(NULL, sizeof(struct hook_ctl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    syscall(SYS_close, fd);
+    if (p == MAP_FAILED) return;
+
+    struct hook_ctl *ctl = p;
+    if (ctl->magic != HOOK_CTL_MAGIC || ctl->version != HOOK_CTL_VERSION) {
+        munmap(p, sizeof(struct hook_ctl));
+        return;
+    }
+    // 启动时的级别不算变化
+    hook_level_seen = __atomic_load_n(&ctl->level, __ATOMIC_RELAXED);
+    hook_ctl = ctl;
+}
+
+// 预加载库的构造函数在程序其他依赖库(如 libselinux)的构造函数之后才执行，
+// 那些库初始化时触发的 hook 会先走到这里，所以既在构造函数里调用，也在首次记录日志时调用
+__attribute__((constructor(101)))
+static void hook_log_init(void) {
+    if (hook_log_ready) return;
+    hook_log_ready = 1;
+    image_pid = hook_self_pid();
+
+    struct stat ns;
+    if (stat("/proc/self/ns/pid", &ns) == 0) {
+        pidns_ino = (unsigned long)ns.st_ino;
+    }
+
+    const char *dir = getenv("HOOKTRACE_DIR");
+    session_dir = (dir && *dir) ? strdup(dir) : NULL;
+    if (session_dir) env_snapshot();
+    hook_ctl_map();
+
+    static const char *const propagate[] = {"LD_PRELOAD", "HOOKTRACE_SESSION", "HOOKTRACE_DIR",
+                                            "HOOKTRACE_PATH_CACHE", "HOOKTRACE_COMPILE_CACHE",
+                                            "HOOKTRACE_BIN", "HOOKTRACE_INTERN", "HOOKTRACE_CTL"};
+    int n = 0;
+    for (size_t i = 0; i < sizeof(propagate) / sizeof(propagate[0]); i++) {
+        const char *v = getenv(propagate[i]);
+        if (!v) continue;
+        size_t len = strlen(propagate[i]) + strlen(v) + 2;
+        char *var = malloc(len);
+        if (!var) continue;
+        snprintf(var, len, "%s=%s", propagate[i], v);
+        hook_env_extra[n++] = var;
+    }
+    hook_env_extra[n] = NULL;
+}
+
+static void log_lock(void) {
+    while (__atomic_test_and_set(&log_buf_lock, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static void log_unlock(void) {
+    __atomic_clear(&log_buf_lock, __ATOMIC_RELEASE);
+}
+
+static int log_open_for(pid_t pid) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%d.log", session_dir, pid);
+    return open(path, O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0644);
+}
+
+// 调用方持有 log_buf_lock 并已设置 logging_in_progress。
+// vfork 出的子进程与父进程共享内存但不共享 fd 表：子进程写出父进程的缓冲内容时用临时 fd，
+// 缓存的 log_fd 只在 log_fd_pid 等于当前进程时使用，不匹配就重新打开(不关闭旧值，它可能属于别的进程)
+static void log_flush_locked(void) {
+    if (log_buf_len == 0) return;
+
+    pid_t pid = getpid();
+    int fd;
+    if (log_buf_pid != pid) {
+        fd = log_open_for(log_buf_pid);
+    } else {
+        if (log_fd < 0 || log_fd_pid != pid) {
+            log_fd = log_open_for(pid);
+            log_fd_pid = pid;
+        }
+        fd = log_fd;
+    }
+
+    if (fd >= 0) {
+        size_t off = 0;
+        while (off < log_buf_len) {
+            ssize_t n = write(fd, log_buf + off, log_buf_len - off);
+            if (n <= 0) break;
+            off += (size_t)n;
+        }
+        if (fd != log_fd) close(fd);
+    }
+    log_buf_len = 0;
+}
+
+static void log_flush(void) {
+    if (!session_dir) return;
+    int was_logging = logging_in_progress;
+    logging_in_progress = 1;
+    log_lock();
+    log_flush_locked();
+    log_unlock();
+    logging_in_progress = was_logging;
+}
+
+// fork 出的子进程：缓冲区里的内容属于父进程(由父进程写出)，继承来的日志 fd 也是父进程的文件
+static void log_after_fork_child(void) {
+    image_pid = hook_self_pid();
+    if (!session_dir) return;
+    __atomic_clear(&log_buf_lock, __ATOMIC_RELAXED);  // fork 时可能有别的线程持有锁
+    log_buf_len = 0;
+    if (log_fd >= 0) {
+        logging_in_progress = 1;
+        close(log_fd);
+        logging_in_progress = 0;
+        log_fd = -1;
+    }
+}
+
+// 优先级 101 的析构函数最后执行，其他析构函数输出的汇总记录也能写出
+__attribute__((destructor(101)))
+static void hook_log_at_exit(void) {
+    log_flush();
+}
 
 // 简化的日志记录函数，避免调用可能被hook的函数
-static void log_syscall(const char *syscall_name, const char *details) {
-    if (logging_in_progress) return; // 防止递归
+static void log_write(const char *syscall_name, const char *details) {
     logging_in_progress = 1;
 
+    if (session_dir) {
+        // 直接拼进缓冲区，不经过定长的中间行缓冲，较长的 exec_record 也不会被截断
+        pid_t pid = getpid();
+        char prefix[128];
+        size_t prefix_len = (size_t)snprintf(prefix, sizeof(prefix), "[PID:%d] %s: ", pid, syscall_name);
+        size_t details_len = strlen(details);
+        if (prefix_len + details_len + 1 > LOG_BUF_SIZE) {
+            details_len = LOG_BUF_SIZE - prefix_len - 1;
+        }
+        size_t len = prefix_len + details_len + 1;
+
+        log_lock();
+        if (log_buf_len + len > LOG_BUF_SIZE || (log_buf_len > 0 && log_buf_pid != pid)) {
+            log_flush_locked();
+        }
+        memcpy(log_buf + log_buf_len, prefix, prefix_len);
+        memcpy(log_buf + log_buf_len + prefix_len, details, details_len);
+        log_buf[log_buf_len + len - 1] = '\n';
+        log_buf_len += len;
+        log_buf_pid = pid;
+        log_unlock();
+
+        logging_in_progress = 0;
+        return;
+    }
+
     // 直接使用系统调用写入文件 utf-8 编码
     int fd = open("syscall_hook.log", O_CREAT | O_WRONLY | O_APPEND, 0644);
     if (fd >= 0) {
@@ -66,14 +289,893 @@ static void log_syscall(const char *syscall_name, const char *details) {
     logging_in_progress = 0;
 }
 
+// 当前级别低于 min_level 时不记录。先初始化(映射控制页)再判断级别
+static void log_event(uint32_t min_level, const char *syscall_name, const char *details) {
+    if (logging_in_progress) return; // 防止递归
+    if (!hook_log_ready) hook_log_init();
+    if (hook_level() < min_level) return;
+    log_write(syscall_name, details);
+}
+
+// 逐次事件，只在 full 级别记录
+static void log_syscall(const char *syscall_name, const char *details) {
+    log_event(HOOK_LEVEL_FULL, syscall_name, details);
+}
+
+static void fd_table_seed(void);
+
+// 多个线程同时发现变化时只有一个处理
+static void hook_level_changed(uint32_t level) {
+    uint32_t old = __atomic_load_n(&hook_level_seen, __ATOMIC_RELAXED);
+    if (old == level || !__atomic_compare_exchange_n(&hook_level_seen, &old, level, 0,
+                                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return;
+    }
+    // off 期间 open/close/dup 没有登记，fd 表已经过期，重新从 /proc/self/fd 取
+    if (old == HOOK_LEVEL_OFF && level != HOOK_LEVEL_OFF && !logging_in_progress) fd_table_seed();
+
+    char details[128];
+    snprintf(details, sizeof(details), "级别 %s -> %s",
+             hook_level_names[old < HOOK_LEVEL_COUNT ? old : HOOK_LEVEL_FULL],
+             hook_level_names[level < HOOK_LEVEL_COUNT ? level : HOOK_LEVEL_FULL]);
+    log_event(HOOK_LEVEL_COUNTERS, "hook_level", details);
+}
+
+// ===== 钩子自身开销统计 =====
+// 每个 hook 统计"自身耗时"：从进入 hook 到返回的总时间减去真实函数的执行时间，
+// 即 tracer 代码本身引入的额外开销。数据写入每线程私有的对数线性直方图(HDR风格)，
+// 无需加锁；进程退出(或 exec 替换映像)前合并成每进程一条汇总记录。
+
+enum hook_id {
+    HOOK_FORK, HOOK_EXECL, HOOK_EXECLP, HOOK_EXECLE, HOOK_EXECV, HOOK_EXECVE,
+    HOOK_EXECVP, HOOK_EXECVPE, HOOK_SYSTEM, HOOK_WAIT, HOOK_GETPID, HOOK_GETUID,
+    HOOK_GETCWD, HOOK_OPEN, HOOK_WRITE, HOOK_CLOSE, HOOK_ACCESS, HOOK_SLEEP,
+    HOOK_UNLINK, HOOK_POSIX_SPAWN, HOOK_OPENAT, HOOK_READ, HOOK_DUP, HOOK_PIPE,
+    HOOK_SOCKET, HOOK_FCNTL, HOOK_WAITPID, HOOK_WAIT3, HOOK_WAIT4, HOOK_WAITID,
+    HOOK_COUNT
+};
+
+static const char *const hook_names[HOOK_COUNT] = {
+    "fork", "execl", "execlp", "execle", "execv", "execve",
+    "execvp", "execvpe", "system", "wait", "getpid", "getuid",
+    "getcwd", "open", "write", "close", "access", "sleep",
+    "unlink", "posix_spawn", "openat", "read", "dup", "pipe",
+    "socket", "fcntl", "waitpid", "wait3", "wait4", "waitid",
+};
+
+// 对数线性分桶：小于 HIST_SUB 的值各占一个桶，之后每个 2 的幂区间再线性细分 HIST_SUB 份，
+// 相对误差不超过 1/HIST_SUB。不小于 2^HIST_MAX_EXP ns(约18分钟)的值归入最后一个桶，
+// 这个桶没有上界，分位数落在这里时取最大值。
+#define HIST_SUB_BITS 3
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP  40
+#define HIST_BUCKETS  ((HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct hook_thread_stats {
+    struct hook_thread_stats *next;
+    uint64_t count[HOOK_COUNT];
+    uint64_t self_ns[HOOK_COUNT];
+    uint64_t max_ns[HOOK_COUNT];
+    uint32_t hist[HOOK_COUNT][HIST_BUCKETS];
+};
+
+// 每线程的统计块在首次使用时 mmap 分配，挂到全局无锁链表上；线程退出后内存保留，
+// 退出时的合并依然能看到它的数据
+static __thread struct hook_thread_stats *tls_stats = NULL;
+static struct hook_thread_stats *all_stats = NULL;
+
+static inline uint64_t hook_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline unsigned hist_bucket(uint64_t v) {
+    if (v < HIST_SUB) return (unsigned)v;
+    unsigned e = 63 - (unsigned)__builtin_clzll(v);
+    if (e >= HIST_MAX_EXP) return HIST_BUCKETS - 1;
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + (unsigned)((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+// 桶内最大值，用作分位数的(保守)估计；最后一个桶没有上界
+static uint64_t hist_bucket_upper(unsigned idx) {
+    if (idx < HIST_SUB) return idx;
+    if (idx >= HIST_BUCKETS - 1) return UINT64_MAX;
+    unsigned e = idx / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t low = (uint64_t)(HIST_SUB + idx % HIST_SUB) << (e - HIST_SUB_BITS);
+    return low + ((uint64_t)1 << (e - HIST_SUB_BITS)) - 1;
+}
+
+static struct hook_thread_stats *hook_stats_thread(void) {
+    if (tls_stats) return tls_stats;
+
+    struct hook_thread_stats *st = mmap(NULL, sizeof(*st), PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (st == MAP_FAILED) return NULL;
+
+    st->next = __atomic_load_n(&all_stats, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&all_stats, &st->next, st, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    tls_stats = st;
+    return st;
+}
+
+// 只有所属线程写自己的统计块，用 relaxed 原子读写即可与退出时的合并配合
+static void hook_stats_record(enum hook_id id, uint64_t self_ns) {
+    if (logging_in_progress) return; // log_syscall 内部触发的 hook 已计入外层 hook 的开销
+
+    struct hook_thread_stats *st = hook_stats_thread();
+    if (!st) return;
+
+    unsigned b = hist_bucket(self_ns);
+    __atomic_store_n(&st->hist[id][b], st->hist[id][b] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->count[id], st->count[id] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->self_ns[id], st->self_ns[id] + self_ns, __ATOMIC_RELAXED);
+    if (self_ns > st->max_ns[id]) {
+        __atomic_store_n(&st->max_ns[id], self_ns, __ATOMIC_RELAXED);
+    }
+}
+
+// 清空所有线程的统计(fork 出的子进程、exec 前已输出汇总之后)
+static void hook_stats_reset(void) {
+    for (struct hook_thread_stats *st = __atomic_load_n(&all_stats, __ATOMIC_ACQUIRE);
+         st; st = st->next) {
+        struct hook_thread_stats *next = st->next;
+        memset(st, 0, sizeof(*st));
+        st->next = next;
+    }
+}
+
+static uint64_t hist_percentile(const uint64_t *hist, uint64_t count, uint64_t max_ns, double p) {
+    // 向上取整：第 ceil(p*count) 个样本所在的桶
+    uint64_t target = (uint64_t)(p * (double)count);
+    if ((double)target < p * (double)count) target++;
+    if (target < 1) target = 1;
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= target) {
+            uint64_t upper = hist_bucket_upper(b);
+            return upper < max_ns ? upper : max_ns;
+        }
+    }
+    return max_ns;
+}
+
+// 合并所有线程的直方图，每个有调用的 hook 输出一行，最后输出进程总自身耗时
+static void hook_stats_dump(const char *reason) {
+    static uint64_t hist[HIST_BUCKETS];
+    uint64_t total_self_ns = 0, total_calls = 0;
+    int threads = 0;
+
+    struct hook_thread_stats *head = __atomic_load_n(&all_stats, __ATOMIC_ACQUIRE);
+    for (struct hook_thread_stats *st = head; st; st = st->next) threads++;
+
+    for (int id = 0; id < HOOK_COUNT; id++) {
+        uint64_t count = 0, self_ns = 0, max_ns = 0;
+        memset(hist, 0, sizeof(hist));
+
+        for (struct hook_thread_stats *st = head; st; st = st->next) {
+            uint64_t c = __atomic_load_n(&st->count[id], __ATOMIC_RELAXED);
+            if (c == 0) continue;
+            count += c;
+            self_ns += __atomic_load_n(&st->self_ns[id], __ATOMIC_RELAXED);
+            uint64_t m = __atomic_load_n(&st->max_ns[id], __ATOMIC_RELAXED);
+            if (m > max_ns) max_ns = m;
+            for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+                hist[b] += __atomic_load_n(&st->hist[id][b], __ATOMIC_RELAXED);
+            }
+        }
+        if (count == 0) continue;
+
+        char details[256];
+        snprintf(details, sizeof(details),
+                 "hook=%s 次数=%lu p50=%luns p99=%luns max=%luns 自身耗时=%luns",
+                 hook_names[id], (unsigned long)count,
+                 (unsigned long)hist_percentile(hist, count, max_ns, 0.50),
+                 (unsigned long)hist_percentile(hist, count, max_ns, 0.99),
+                 (unsigned long)max_ns, (unsigned long)self_ns);
+        log_event(HOOK_LEVEL_COUNTERS, "hook_stats", details);
+
+        total_self_ns += self_ns;
+        total_calls += count;
+    }
+
+    if (total_calls > 0) {
+        char details[256];
+        snprintf(details, sizeof(details), "汇总(%s): 总调用=%lu 总自身耗时=%luns 线程数=%d",
+                 reason, (unsigned long)total_calls, (unsigned long)total_self_ns, threads);
+        log_event(HOOK_LEVEL_COUNTERS, "hook_stats", details);
+    }
+}
+
+
+// 在每个 hook 中使用：HOOK_ENTER() 记录进入时间，HOOK_REAL() 包裹真实函数调用以扣除其耗时，
+// HOOK_LEAVE() 把剩余部分记作该 hook 的自身耗时
+// 级别在 HOOK_ENTER 时读一次(hook_level_)，hook 内部按它决定做哪些记录；off 时不计时
+#define HOOK_ENTER() \
+    const uint32_t hook_level_ __attribute__((unused)) = hook_level(); \
+    uint64_t hook_t0_ = hook_level_ >= HOOK_LEVEL_COUNTERS ? hook_now_ns() : 0, hook_real_ns_ = 0
+#define HOOK_REAL(expr) do { \
+        if (!hook_t0_) { \
+            expr; \
+            break; \
+        } \
+        uint64_t hook_tr_ = hook_now_ns(); \
+        expr; \
+        hook_real_ns_ += hook_now_ns() - hook_tr_; \
+    } while (0)
+#define HOOK_LEAVE(id) do { \
+        if (hook_t0_) hook_stats_record((id), hook_now_ns() - hook_t0_ - hook_real_ns_); \
+    } while (0)
+
+// ===== 结构化记录 =====
+// 会话模式下，exec 系列和 posix_spawn 额外输出一条 exec_record，进程退出时输出 exit_record，
+// 内容为单行 JSON，由 hooktrace 汇总成 records.jsonl、compile_commands.json 和耗时统计。
+// 时间戳用 CLOCK_MONOTONIC(全系统同一时钟)；pidns 用来区分不同 PID 命名空间里重号的进程。
+
+// exec 记录在 vfork 子进程里生成(gcc 启动 cc1plus/as)，缓冲区用 mmap 而不用 malloc/realloc，
+// 增长时映射一块两倍大的新内存，复制后解除旧的映射
+struct json_buf {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+static void jb_reserve(struct json_buf *jb, size_t extra) {
+    if (jb->len + extra + 1 <= jb->cap) return;
+    size_t cap = jb->cap ? jb->cap : 4096;
+    while (jb->len + extra + 1 > cap) cap *= 2;
+    char *data = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) return;
+    if (jb->data) {
+        memcpy(data, jb->data, jb->len + 1);
+        munmap(jb->data, jb->cap);
+    }
+    jb->data = data;
+    jb->cap = cap;
+}
+
+static void jb_free(struct json_buf *jb) {
+    if (jb->data) munmap(jb->data, jb->cap);
+    jb->data = NULL;
+    jb->len = jb->cap = 0;
+}
+
+static void jb_raw(struct json_buf *jb, const char *s, size_t n) {
+    jb_reserve(jb, n);
+    if (jb->len + n + 1 > jb->cap) return;
+    memcpy(jb->data + jb->len, s, n);
+    jb->len += n;
+    jb->data[jb->len] = '\0';
+}
+
+static void jb_printf(struct json_buf *jb, const char *fmt, ...) {
+    char tmp[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, args);
+    va_end(args);
+    if (n > 0) jb_raw(jb, tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+}
+
+// 输出带引号的 JSON 字符串，控制字符转义，其余字节(包括 UTF-8)原样保留
+static void jb_strn(struct json_buf *jb, const char *s, size_t n) {
+    jb_raw(jb, "\"", 1);
+    const char *run = s;
+    const char *end = s + n;
+    for (; s < end; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        jb_raw(jb, run, (size_t)(s - run));
+        char esc[8];
+        switch (c) {
+        case '"':  jb_raw(jb, "\\\"", 2); break;
+        case '\\': jb_raw(jb, "\\\\", 2); break;
+        case '\n': jb_raw(jb, "\\n", 2); break;
+        case '\t': jb_raw(jb, "\\t", 2); break;
+        case '\r': jb_raw(jb, "\\r", 2); break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            jb_raw(jb, esc, 6);
+        }
+        run = s + 1;
+    }
+    jb_raw(jb, run, (size_t)(s - run));
+    jb_raw(jb, "\"", 1);
+}
+
+static void jb_str(struct json_buf *jb, const char *s) {
+    if (!s) {
+        jb_raw(jb, "null", 4);
+        return;
+    }
+    jb_strn(jb, s, strlen(s));
+}
+
+static void jb_argv(struct json_buf *jb, char *const argv[]) {
+    jb_raw(jb, "[", 1);
+    for (int i = 0; argv && argv[i]; i++) {
+        if (i) jb_raw(jb, ",", 1);
+        jb_str(jb, argv[i]);
+    }
+    jb_raw(jb, "]", 1);
+}
+
+// ===== 环境变量增量 =====
+// exec 记录只保存新程序环境相对于"发起 exec 的映像启动时的环境"的差异：新增或改变的
+// 变量(set)和删除的变量(unset)。映像启动时在 hook_log_init 里复制一份环境作为基准，
+// 并记下 (pid, 时刻)；fork 出的子进程沿用父进程的基准，正好是它继承到的环境。
+// 记录里的 base 指向基准映像：同一 pidns 中该 pid 在 base.ts 之前最近的一条 exec 记录，
+// trace_record 据此沿链条向上直到 hooktrace 写下的完整根环境，重建任意进程的完整环境。
+// 比较用 64 位哈希的开放寻址表，哈希相同时再比较字符串；vfork 子进程里也会走到这里，
+// 临时内存用 mmap 而不用 malloc。
+
+// 哈希表的槽：hash 为 0 表示空槽，index 是条目在对应数组(env_base 或 envp)里的下标
+struct env_slot {
+    uint64_t hash;
+    size_t index;
+};
+
+static char **env_base = NULL;
+static size_t env_base_count = 0;
+static struct env_slot *env_base_table = NULL;   // 完整 "K=V" 的哈希
+static size_t env_base_mask = 0;
+static pid_t env_base_pid = 0;
+static uint64_t env_base_ts = 0;
+
+static uint64_t env_hash(const char *s, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h ? h : 1;
+}
+
+static size_t env_key_len(const char *entry) {
+    const char *eq = strchr(entry, '=');
+    return eq ? (size_t)(eq - entry) : strlen(entry);
+}
+
+static void env_table_insert(struct env_slot *table, size_t mask, uint64_t h, size_t index) {
+    size_t i = h & mask;
+    while (table[i].hash != 0) i = (i + 1) & mask;
+    table[i].hash = h;
+    table[i].index = index;
+}
+
+// entries 中是否有与 s[0..n) 相同的条目；keys 为真时只比较条目的变量名部分
+static int env_table_contains(const struct env_slot *table, size_t mask, uint64_t h,
+                              char *const entries[], const char *s, size_t n, int keys) {
+    for (size_t i = h & mask; table[i].hash != 0; i = (i + 1) & mask) {
+        if (table[i].hash != h) continue;
+        const char *entry = entries[table[i].index];
+        size_t len = keys ? env_key_len(entry) : strlen(entry);
+        if (len == n && memcmp(entry, s, n) == 0) return 1;
+    }
+    return 0;
+}
+
+static size_t env_table_size(size_t n) {
+    size_t size = 16;
+    while (size < n * 2) size *= 2;
+    return size;
+}
+
+// 基准环境：字符串、指针数组和哈希表放在同一块 mmap 内存里
+static void env_snapshot(void) {
+    env_base_pid = hook_self_pid();
+    env_base_ts = hook_now_ns();
+
+    size_t n = 0, bytes = 0;
+    for (char **e = environ; e && *e; e++) {
+        n++;
+        bytes += strlen(*e) + 1;
+    }
+    size_t slots = env_table_size(n);
+    size_t total = slots * sizeof(struct env_slot) + (n + 1) * sizeof(char *) + bytes;
+    void *mem = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return;
+
+    env_base_table = mem;
+    env_base_mask = slots - 1;
+    env_base = (char **)(env_base_table + slots);
+    char *str = (char *)(env_base + n + 1);
+    for (size_t i = 0; i < n; i++) {
+        size_t len = strlen(environ[i]);
+        memcpy(str, environ[i], len + 1);
+        env_base[i] = str;
+        env_table_insert(env_base_table, env_base_mask, env_hash(str, len), i);
+        str += len + 1;
+    }
+    env_base[n] = NULL;
+    env_base_count = n;
+}
+
+static void jb_env_set_entry(struct json_buf *jb, const char *entry, int *first) {
+    size_t klen = env_key_len(entry);
+    if (!*first) jb_raw(jb, ",", 1);
+    *first = 0;
+    jb_strn(jb, entry, klen);
+    jb_raw(jb, ":", 1);
+    jb_str(jb, entry[klen] == '=' ? entry + klen + 1 : "");
+}
+
+// 输出 "env":{...}；没有基准时输出完整环境，临时内存分配失败时输出 "env":null(环境未知)
+static void jb_env_delta(struct json_buf *jb, char *const envp[]) {
+    int first = 1;
+    if (!env_base) {
+        jb_printf(jb, "\"env\":{\"full\":true,\"set\":{");
+        for (size_t i = 0; envp && envp[i]; i++) jb_env_set_entry(jb, envp[i], &first);
+        jb_raw(jb, "}}", 2);
+        return;
+    }
+
+    size_t n = 0;
+    while (envp && envp[n]) n++;
+    size_t slots = env_table_size(n);
+    struct env_slot *keys = mmap(NULL, slots * sizeof(struct env_slot), PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (keys == MAP_FAILED) {
+        jb_raw(jb, "\"env\":null", 10);
+        return;
+    }
+
+    jb_printf(jb, "\"env\":{\"base\":{\"pid\":%d,\"ts\":%lu},\"set\":{",
+              env_base_pid, (unsigned long)env_base_ts);
+    for (size_t i = 0; i < n; i++) {
+        const char *entry = envp[i];
+        size_t len = strlen(entry);
+        env_table_insert(keys, slots - 1, env_hash(entry, env_key_len(entry)), i);
+        if (!env_table_contains(env_base_table, env_base_mask, env_hash(entry, len), env_base, entry, len, 0)) {
+            jb_env_set_entry(jb, entry, &first);
+        }
+    }
+    jb_printf(jb, "},\"unset\":[");
+    first = 1;
+    for (size_t i = 0; i < env_base_count; i++) {
+        size_t klen = env_key_len(env_base[i]);
+        uint64_t h = env_hash(env_base[i], klen);
+        if (env_table_contains(keys, slots - 1, h, envp, env_base[i], klen, 1)) continue;
+        if (!first) jb_raw(jb, ",", 1);
+        first = 0;
+        jb_strn(jb, env_base[i], klen);
+    }
+    jb_raw(jb, "]}", 2);
+    munmap(keys, slots * sizeof(struct env_slot));
+}
+
+// ===== 字符串驻留 =====
+// hooktrace run --intern 时，exec 记录里的 cwd、path 和 argv 写成共享驻留表(布局见 intern.h)
+// 中的 ID："cwd_id"/"path_id"/"argv_id"。驻留失败(表满)的字段仍然写字符串。
+
+static struct intern_table *intern_table = NULL;
+static int intern_state = 0;               // 0 未初始化，1 可用，-1 不可用
+
+static void intern_map(void) {
+    intern_state = -1;
+    const char *file = getenv("HOOKTRACE_INTERN");
+    if (!file || !*file) return;
+
+    int fd = (int)syscall(SYS_openat, AT_FDCWD, file, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+    void *p = mmap(NULL, INTERN_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    syscall(SYS_close, fd);
+    if (p == MAP_FAILED) return;
+
+    struct intern_table *t = p;
+    if (t->magic != INTERN_MAGIC || t->version != INTERN_VERSION || t->arena_size != INTERN_ARENA_SIZE) {
+        munmap(p, INTERN_FILE_SIZE);
+        return;
+    }
+    intern_table = t;
+    intern_state = 1;
+}
+
+// 引用计数先在本条记录里累加，记录写完再一次加到共享的统计上
+struct intern_refs {
+    uint64_t refs;
+    uint64_t bytes;
+};
+
+static uint32_t intern_id(const char *s, struct intern_refs *refs) {
+    size_t n = strlen(s);
+    uint32_t id = intern_put(intern_table, s, n);
+    if (id) {
+        refs->refs++;
+        refs->bytes += n;
+    }
+    return id;
+}
+
+// 输出 ,"<key>_id":N，驻留失败时输出 ,"<key>":"..."
+static void jb_interned(struct json_buf *jb, const char *key, const char *s, struct intern_refs *refs) {
+    uint32_t id = (s && intern_table) ? intern_id(s, refs) : 0;
+    if (id) {
+        jb_printf(jb, ",\"%s_id\":%u", key, id);
+        return;
+    }
+    jb_printf(jb, ",\"%s\":", key);
+    jb_str(jb, s);
+}
+
+static void jb_interned_argv(struct json_buf *jb, char *const argv[], struct intern_refs *refs) {
+    int n = 0;
+    while (argv && argv[n]) n++;
+    uint32_t small[64];
+    uint32_t *ids = small;
+    size_t map_size = 0;
+    if (n > 64) {   // 与 jb_env_delta 一样，临时内存用 mmap
+        map_size = (size_t)n * sizeof(uint32_t);
+        ids = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ids == MAP_FAILED) ids = NULL;
+    }
+    int ok = intern_table && ids;
+    struct intern_refs mine = {0};
+    for (int i = 0; ok && i < n; i++) {
+        ids[i] = intern_id(argv[i], &mine);
+        ok = ids[i] != 0;
+    }
+    if (ok) {
+        jb_raw(jb, ",\"argv_id\":[", 12);
+        for (int i = 0; i < n; i++) jb_printf(jb, i ? ",%u" : "%u", ids[i]);
+        jb_raw(jb, "]", 1);
+        refs->refs += mine.refs;
+        refs->bytes += mine.bytes;
+    } else {
+        jb_raw(jb, ",\"argv\":", 8);
+        jb_argv(jb, argv);
+    }
+    if (ids && map_size) munmap(ids, map_size);
+}
+
+// fn: 调用的 hook 名；pid: 运行新程序的进程(posix_spawn 时是子进程)；ppid: 它的父进程；
+// envp: 新程序实际得到的环境
+static void emit_exec_record(const char *fn, pid_t pid, pid_t ppid, const char *path,
+                             char *const argv[], char *const envp[]) {
+    if (!hook_log_ready) hook_log_init();
+    if (!session_dir || logging_in_progress || hook_level() < HOOK_LEVEL_EXEC) return;
+
+    char cwd[4096];
+    if (syscall(SYS_getcwd, cwd, sizeof(cwd)) < 0) cwd[0] = '\0';
+
+    struct json_buf jb = {0};
+    jb_printf(&jb, "{\"type\":\"exec\",\"fn\":\"%s\",\"pid\":%d,\"ppid\":%d,\"pidns\":%lu,\"ts\":%lu",
+              fn, pid, ppid, pidns_ino, (unsigned long)hook_now_ns());
+    if (intern_state == 0) intern_map();
+    struct intern_refs refs = {0};
+    jb_interned(&jb, "cwd", cwd, &refs);
+    jb_interned(&jb, "path", path, &refs);
+    jb_interned_argv(&jb, argv, &refs);
+    jb_raw(&jb, ",", 1);
+    jb_env_delta(&jb, envp);
+    jb_raw(&jb, "}", 1);
+    if (refs.refs) {
+        __atomic_fetch_add(&intern_table->refs, refs.refs, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&intern_table->ref_bytes, refs.bytes, __ATOMIC_RELAXED);
+    }
+
+    if (jb.data) {
+        log_event(HOOK_LEVEL_EXEC, "exec_record", jb.data);
+        jb_free(&jb);
+    }
+}
+
+static void emit_exit_record(void) {
+    if (!session_dir) return;
+    char details[256];
+    snprintf(details, sizeof(details),
+             "{\"type\":\"exit\",\"pid\":%d,\"ppid\":%d,\"pidns\":%lu,\"ts\":%lu}",
+             image_pid, getppid(), pidns_ino, (unsigned long)hook_now_ns());
+    log_event(HOOK_LEVEL_EXEC, "exit_record", details);
+}
+
+// 回收子进程时的资源占用。pid 是被回收的子进程，由 trace_record 按 (pidns, pid) 挂到它的
+// exec 记录上。注意 rusage 包含该子进程已回收的后代(例如 g++ 的数字包含 cc1plus)
+static void emit_reap_record(const char *fn, pid_t pid, int status, const struct rusage *ru) {
+    if (!session_dir || logging_in_progress) return;
+    char details[512];
+    snprintf(details, sizeof(details),
+             "{\"type\":\"reap\",\"fn\":\"%s\",\"pid\":%d,\"ppid\":%d,\"pidns\":%lu,\"ts\":%lu,"
+             "\"status\":%d,\"utime_us\":%ld,\"stime_us\":%ld,\"maxrss_kb\":%ld,"
+             "\"minflt\":%ld,\"majflt\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld}",
+             fn, pid, hook_self_pid(), pidns_ino, (unsigned long)hook_now_ns(), status,
+             (long)(ru->ru_utime.tv_sec * 1000000 + ru->ru_utime.tv_usec),
+             (long)(ru->ru_stime.tv_sec * 1000000 + ru->ru_stime.tv_usec),
+             ru->ru_maxrss, ru->ru_minflt, ru->ru_majflt, ru->ru_nvcsw, ru->ru_nivcsw);
+    log_event(HOOK_LEVEL_EXEC, "reap_record", details);
+}
+
+// ===== 按fd的I/O统计 =====
+// write()/read() 默认不再逐次记录日志，只在按fd索引的固定大小表中累加调用次数和字节数，
+// fd 关闭时输出一条汇总。逐次事件和内容预览需要通过环境变量开启：
+//   HOOK_IO_EVENTS=1        每次 write/read 记录一条事件(不含内容)
+//   HOOK_WRITE_PREVIEW=N    每 N 次 write 采样一次内容预览(前100字节)
+//
+// fd 对应的路径由 open/openat/dup*/pipe/socket/fcntl(F_DUPFD) 等 hook 填入，以驻留后的
+// path_id 保存，事件里只带整数 ID；每个新路径第一次出现时输出一条 "path" 记录给出映射。
+// exec 之后新映像从 /proc/self/fd 重建表，内核已按 O_CLOEXEC 关掉了该关的 fd。
+
+#define FD_TABLE_SIZE     1024
+#define PREVIEW_MAX       100
+#define PATH_INTERN_SLOTS 8192   // 2 的幂，开放寻址
+
+struct fd_info {
+    uint32_t path_id;        // 0 表示路径未知
+    uint64_t write_calls;
+    uint64_t write_bytes;
+    uint64_t read_calls;
+    uint64_t read_bytes;
+};
+
+static struct fd_info fd_table[FD_TABLE_SIZE];
+static int io_log_events = 0;
+static unsigned long write_preview_every = 0;
+static uint64_t write_seq = 0;
+
+// 进程内路径驻留表：线性探测，字符串 strdup 保存，ID 从 1 开始顺序分配
+struct path_slot {
+    uint64_t hash;
+    uint32_t id;
+};
+
+static struct path_slot path_slots[PATH_INTERN_SLOTS];
+static char *path_strings[PATH_INTERN_SLOTS];   // id -> 字符串
+static uint32_t path_count = 0;
+static int path_lock = 0;
+
+static uint64_t path_hash(const char *s) {
+    uint64_t h = 1469598103934665603ull;   // FNV-1a
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 返回路径的 ID；表满时返回 0。新路径会输出一条 path 记录
+static uint32_t path_intern(const char *path) {
+    if (!path) return 0;
+    uint64_t h = path_hash(path);
+    uint32_t id = 0;
+    bool created = false;
+
+    while (__atomic_test_and_set(&path_lock, __ATOMIC_ACQUIRE)) {
+    }
+    for (uint32_t i = (uint32_t)h & (PATH_INTERN_SLOTS - 1), n = 0; n < PATH_INTERN_SLOTS;
+         i = (i + 1) & (PATH_INTERN_SLOTS - 1), n++) {
+        struct path_slot *slot = &path_slots[i];
+        if (slot->id == 0) {
+            if (path_count + 1 >= PATH_INTERN_SLOTS) break;  // 留一个空槽保证探测能终止
+            char *copy = strdup(path);
+            if (!copy) break;
+            id = ++path_count;
+            path_strings[id] = copy;
+            slot->hash = h;
+            slot->id = id;
+            created = true;
+            break;
+        }
+        if (slot->hash == h && strcmp(path_strings[slot->id], path) == 0) {
+            id = slot->id;
+            break;
+        }
+    }
+    __atomic_clear(&path_lock, __ATOMIC_RELEASE);
+
+    if (created) {
+        char details[4200];
+        snprintf(details, sizeof(details), "id=%u '%s'", id, path);
+        log_event(HOOK_LEVEL_COUNTERS, "path", details);
+    }
+    return id;
+}
+
+static const char *path_of(uint32_t id) {
+    return (id > 0 && id <= path_count) ? path_strings[id] : NULL;
+}
+
+static void fd_reset(int fd, uint32_t path_id) {
+    struct fd_info *info = &fd_table[fd];
+    info->path_id = path_id;
+    info->write_calls = 0;
+    info->write_bytes = 0;
+    info->read_calls = 0;
+    info->read_bytes = 0;
+}
+
+static void fd_track_open(int fd, const char *pathname) {
+    if (fd < 0 || fd >= FD_TABLE_SIZE) return;
+    fd_reset(fd, path_intern(pathname));
+}
+
+// openat 的相对路径：如果 dirfd 的路径已知就拼成完整路径
+static void fd_track_openat(int fd, int dirfd, const char *pathname) {
+    if (fd < 0 || fd >= FD_TABLE_SIZE) return;
+    const char *dir = (dirfd >= 0 && dirfd < FD_TABLE_SIZE) ? path_of(fd_table[dirfd].path_id) : NULL;
+    if (pathname && pathname[0] != '/' && dirfd != AT_FDCWD && dir) {
+        char full[4096];
+        snprintf(full, sizeof(full), "%s/%s", dir, pathname);
+        fd_reset(fd, path_intern(full));
+    } else {
+        fd_reset(fd, path_intern(pathname));
+    }
+}
+
+// pipe/socket 没有文件路径，用与 /proc/self/fd 相同的 "pipe:[inode]" 形式命名
+static void fd_track_anon(int fd, const char *kind) {
+    if (fd < 0 || fd >= FD_TABLE_SIZE) return;
+    struct stat st;
+    char name[64];
+    if (fstat(fd, &st) == 0) {
+        snprintf(name, sizeof(name), "%s:[%lu]", kind, (unsigned long)st.st_ino);
+    } else {
+        snprintf(name, sizeof(name), "%s:[?]", kind);
+    }
+    fd_reset(fd, path_intern(name));
+}
+
+static void fd_summary(int fd, const char *reason);
+
+// dup 系列：newfd 继承 oldfd 的路径，计数从零开始；newfd 原先打开的话先输出它的汇总
+static void fd_track_dup(int oldfd, int newfd) {
+    if (newfd < 0 || newfd >= FD_TABLE_SIZE || newfd == oldfd) return;
+    fd_summary(newfd, "dup");
+    uint32_t id = (oldfd >= 0 && oldfd < FD_TABLE_SIZE) ? fd_table[oldfd].path_id : 0;
+    fd_reset(newfd, id);
+}
+
+static void fd_account_write(int fd, ssize_t written) {
+    if (fd < 0 || fd >= FD_TABLE_SIZE) return;
+    __atomic_fetch_add(&fd_table[fd].write_calls, 1, __ATOMIC_RELAXED);
+    if (written > 0) {
+        __atomic_fetch_add(&fd_table[fd].write_bytes, (uint64_t)written, __ATOMIC_RELAXED);
+    }
+}
+
+static void fd_account_read(int fd, ssize_t got) {
+    if (fd < 0 || fd >= FD_TABLE_SIZE) return;
+    __atomic_fetch_add(&fd_table[fd].read_calls, 1, __ATOMIC_RELAXED);
+    if (got > 0) {
+        __atomic_fetch_add(&fd_table[fd].read_bytes, (uint64_t)got, __ATOMIC_RELAXED);
+    }
+}
+
+static uint32_t fd_path_id(int fd) {
+    return (fd >= 0 && fd < FD_TABLE_SIZE) ? fd_table[fd].path_id : 0;
+}
+
+static void fd_summary(int fd, const char *reason) {
+    struct fd_info *info = &fd_table[fd];
+    uint64_t wcalls = __atomic_load_n(&info->write_calls, __ATOMIC_RELAXED);
+    uint64_t rcalls = __atomic_load_n(&info->read_calls, __ATOMIC_RELAXED);
+    if (wcalls == 0 && rcalls == 0) return;
+
+    char details[256];
+    snprintf(details, sizeof(details),
+             "fd=%d (%s), path_id=%u, 写入次数=%lu, 写入字节=%lu, 读取次数=%lu, 读取字节=%lu",
+             fd, reason, info->path_id,
+             (unsigned long)wcalls,
+             (unsigned long)__atomic_load_n(&info->write_bytes, __ATOMIC_RELAXED),
+             (unsigned long)rcalls,
+             (unsigned long)__atomic_load_n(&info->read_bytes, __ATOMIC_RELAXED));
+    log_event(HOOK_LEVEL_COUNTERS, "io_summary", details);
+}
+
+// fd 关闭：输出汇总并清空表项
+static void fd_track_close(int fd) {
+    if (fd < 0 || fd >= FD_TABLE_SIZE) return;
+    fd_summary(fd, "close");
+    fd_reset(fd, 0);
+}
+
+// 进程退出或 exec 前，对仍然打开且有读写的 fd 输出汇总，然后计数清零(路径保留)
+static void io_dump_all(const char *reason) {
+    for (int fd = 0; fd < FD_TABLE_SIZE; fd++) {
+        fd_summary(fd, reason);
+        fd_reset(fd, fd_table[fd].path_id);
+    }
+}
+
+// fork 出的子进程继承了 fd 和路径，但之前的计数属于父进程
+static void io_reset_counters(void) {
+    for (int fd = 0; fd < FD_TABLE_SIZE; fd++) {
+        fd_reset(fd, fd_table[fd].path_id);
+    }
+}
+
+// 新映像启动时，从 /proc/self/fd 取回 exec 后仍然打开的 fd(包括继承的管道和重定向)
+static void fd_table_seed(void) {
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir) return;
+
+    char link[64], target[4096];
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] < '0' || ent->d_name[0] > '9') continue;
+        int fd = atoi(ent->d_name);
+        if (fd == dirfd(dir) || fd >= FD_TABLE_SIZE) continue;
+
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        ssize_t n = readlink(link, target, sizeof(target) - 1);
+        if (n < 0) continue;
+        target[n] = '\0';
+        fd_reset(fd, path_intern(target));
+    }
+    closedir(dir);
+}
+
+__attribute__((constructor))
+static void hook_io_init(void) {
+    const char *v = getenv("HOOK_IO_EVENTS");
+    io_log_events = v && *v && strcmp(v, "0") != 0;
+    v = getenv("HOOK_WRITE_PREVIEW");
+    write_preview_every = v ? strtoul(v, NULL, 10) : 0;
+    fd_table_seed();
+}
+
+
+// 把 src 的前 n 字节复制到 dst，并把不可打印字符替换为 '.'。
+// 用 GCC 向量扩展每次处理 16 字节，x86 上编译为 SSE2，ARM 上为 NEON。
+typedef unsigned char u8x16 __attribute__((vector_size(16)));
+
+static void sanitize_preview(char *dst, const void *src, size_t n) {
+    const unsigned char *in = src;
+    const u8x16 lo = {32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32};
+    const u8x16 hi = {126, 126, 126, 126, 126, 126, 126, 126, 126, 126, 126, 126, 126, 126, 126, 126};
+    const u8x16 dot = {'.', '.', '.', '.', '.', '.', '.', '.', '.', '.', '.', '.', '.', '.', '.', '.'};
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        u8x16 v;
+        memcpy(&v, in + i, sizeof(v));
+        u8x16 ok = (u8x16)(v >= lo) & (u8x16)(v <= hi);
+        u8x16 r = (v & ok) | (dot & ~ok);
+        memcpy(dst + i, &r, sizeof(r));
+    }
+    for (; i < n; i++) {
+        dst[i] = (in[i] >= 32 && in[i] <= 126) ? (char)in[i] : '.';
+    }
+    dst[n] = '\0';
+}
+
+// exec 成功后不会返回，_exit 也不会执行析构函数，所以在这之前先输出汇总并写出日志缓冲。
+// vfork 子进程(当前 pid 不是 image_pid)与父进程共享内存，统计属于父进程，只写出日志缓冲
+static void hook_flush_image(const char *reason) {
+    if (hook_self_pid() != image_pid) {
+        log_flush();
+        return;
+    }
+    hook_stats_dump(reason);
+    hook_stats_reset();
+    io_dump_all(reason);
+    if (strcmp(reason, "exit") == 0) emit_exit_record();
+    log_flush();
+}
+
+// 正常退出(exit 或 main 返回)：输出汇总和 exit_record
+__attribute__((destructor))
+static void hook_at_exit(void) {
+    hook_flush_image("exit");
+}
+
 // Hook fork()
 pid_t fork(void) {
     if (!real_fork) {
         real_fork = dlsym(RTLD_NEXT, "fork");
     }
+    HOOK_ENTER();
 
-    log_syscall("fork", "准备创建子进程");
-    pid_t result = real_fork();
+    log_event(HOOK_LEVEL_EXEC, "fork", "准备创建子进程");
+    pid_t result;
+    HOOK_REAL(result = real_fork());
+    if (result == 0) {
+        log_after_fork_child();
+        hook_stats_reset(); // 子进程只统计自己的开销
+        io_reset_counters();
+    }
 
     char details[256];
     if (result == 0) {
@@ -83,16 +1185,211 @@ pid_t fork(void) {
     } else {
         snprintf(details, sizeof(details), "fork失败,返回 %d", result);
     }
-    log_syscall("fork", details);
+    log_event(HOOK_LEVEL_EXEC, "fork", details);
 
+    HOOK_LEAVE(HOOK_FORK);
     return result;
 }
 
+// ===== 编译缓存 =====
+// hooktrace run --compile-cache DIR 时，exec cc1/cc1plus/as 改为 exec
+// "hooktrace compile-cache 工具 argv..."，由它查缓存(见 compile_cache.c)。
+// gcc 用 vfork 启动这些工具，这里只能用栈上的内存，不能 malloc。
+// 返回说明没有改道(未开启或 exec 失败)，调用者照常 exec 原来的工具。
+
+static void compile_cache_redirect(const char *path, char *const argv[], char *const envp[]) {
+    const char *cache = getenv("HOOKTRACE_COMPILE_CACHE");
+    const char *bin = getenv("HOOKTRACE_BIN");
+    if (!cache || !*cache || !bin || !*bin || !path || !argv) return;
+
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    if (strcmp(base, "cc1") != 0 && strcmp(base, "cc1plus") != 0 && strcmp(base, "as") != 0) return;
+
+    int argc = 0;
+    while (argv[argc]) argc++;
+    if (argc > 4096) return;
+    const char *wrapped[argc + 4];
+    wrapped[0] = "hooktrace";
+    wrapped[1] = "compile-cache";
+    wrapped[2] = path;
+    for (int i = 0; i <= argc; i++) wrapped[i + 3] = argv[i];
+
+    if (!real_execve) real_execve = dlsym(RTLD_NEXT, "execve");
+    real_execve(bin, (char * const *)wrapped, envp ? envp : environ);
+}
+
+// ===== PATH 查找缓存 =====
+// hooktrace run --path-cache 时，execvp/execvpe/execlp 先查共享内存中的缓存(布局见
+// path_cache.h)，命中直接用解析出的路径调用 execve，省掉逐个 PATH 目录的探测。
+// 未命中时自己按 PATH 查找并写入缓存；解析出的路径 execve 失败时退回原来的函数，
+// 由 glibc 处理 ENOEXEC 回退到 /bin/sh 等情况。
+
+static struct path_cache *path_cache = NULL;
+static int path_cache_state = 0;           // 0 未初始化，1 可用，-1 不可用
+// 上次检查过的 PATH 及结果。execvp 等在 vfork 子进程里调用，不能 strdup/free，
+// 用固定大小的静态缓冲区；放不下的 PATH 每次重新检查
+static char path_cache_last_path[4096];
+static size_t path_cache_last_len = 0;     // 0 表示没有记住的结果
+static int path_cache_last_ok = 0;
+
+static void path_cache_map(void) {
+    path_cache_state = -1;
+    const char *file = getenv("HOOKTRACE_PATH_CACHE");
+    if (!file || !*file) return;
+
+    // 直接用系统调用，不经过 open/close hook
+    int fd = (int)syscall(SYS_openat, AT_FDCWD, file, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+    void *p = mmap(NULL, sizeof(struct path_cache), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    syscall(SYS_close, fd);
+    if (p == MAP_FAILED) return;
+
+    struct path_cache *pc = p;
+    if (pc->magic != PATH_CACHE_MAGIC || pc->version != PATH_CACHE_VERSION) {
+        munmap(p, sizeof(struct path_cache));
+        return;
+    }
+    path_cache = pc;
+    path_cache_state = 1;
+}
+
+static int path_cache_dir_watched(const char *dir, size_t len) {
+    uint32_t ndirs = path_cache->ndirs;
+    for (uint32_t i = 0; i < ndirs && i < PATH_CACHE_MAX_DIRS; i++) {
+        if (strncmp(path_cache->dirs[i], dir, len) == 0 && path_cache->dirs[i][len] == '\0') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// PATH 的每一项都是被监视的绝对路径才能缓存；结果按 PATH 的内容记住，PATH 不变时不重复检查
+static int path_cache_path_ok(const char *path_env) {
+    size_t path_len = strlen(path_env);
+    if (path_cache_last_len && path_cache_last_len == path_len &&
+        memcmp(path_cache_last_path, path_env, path_len) == 0) {
+        return path_cache_last_ok;
+    }
+    int ok = 1;
+    for (const char *p = path_env; ok; ) {
+        const char *end = strchr(p, ':');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == 0 || p[0] != '/' || !path_cache_dir_watched(p, len)) ok = 0;
+        if (!end) break;
+        p = end + 1;
+    }
+    path_cache_last_len = 0;
+    if (path_len > 0 && path_len < sizeof(path_cache_last_path)) {
+        memcpy(path_cache_last_path, path_env, path_len);
+        path_cache_last_ok = ok;
+        path_cache_last_len = path_len;
+    }
+    return ok;
+}
+
+static int path_cache_lookup(uint64_t key, const char *name, uint32_t gen, char *out, size_t out_size) {
+    for (uint32_t i = 0; i < PATH_CACHE_PROBE; i++) {
+        struct path_cache_slot *slot = &path_cache->slots[(key + i) & (PATH_CACHE_SLOTS - 1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+
+        struct path_cache_slot copy;
+        memcpy(&copy, slot, sizeof(copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) continue;
+
+        if (copy.key == 0) return 0;
+        if (copy.key != key || strncmp(copy.name, name, sizeof(copy.name)) != 0) continue;
+        if (copy.gen != gen) {
+            __atomic_fetch_add(&path_cache->stale, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        copy.path[sizeof(copy.path) - 1] = '\0';
+        snprintf(out, out_size, "%s", copy.path);
+        __atomic_fetch_add(&path_cache->hits, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&path_cache->probes_saved, copy.probes, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&path_cache->ns_saved, copy.resolve_ns, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+static void path_cache_insert(uint64_t key, const char *name, uint32_t gen, const char *path,
+                              uint32_t probes, uint32_t resolve_ns) {
+    for (uint32_t i = 0; i < PATH_CACHE_PROBE; i++) {
+        struct path_cache_slot *slot = &path_cache->slots[(key + i) & (PATH_CACHE_SLOTS - 1)];
+        uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+        // 空槽、同一个键或已过期的条目可以覆盖；探测链满时覆盖最后一个
+        if (slot->key != 0 && slot->key != key && slot->gen == gen && i + 1 < PATH_CACHE_PROBE) {
+            continue;
+        }
+        if (!__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        slot->key = key;
+        slot->gen = gen;
+        slot->probes = probes;
+        slot->resolve_ns = resolve_ns;
+        snprintf(slot->name, sizeof(slot->name), "%s", name);
+        snprintf(slot->path, sizeof(slot->path), "%s", path);
+        __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+        return;
+    }
+}
+
+// 按 PATH 解析 file，成功时把路径写入 out 并返回 1；不能使用缓存或找不到时返回 0，
+// 调用者退回 glibc 自己的查找
+static int path_cache_resolve(const char *file, char *out, size_t out_size) {
+    if (path_cache_state == 0) path_cache_map();
+    if (path_cache_state != 1 || !file || !*file || strchr(file, '/')) return 0;
+    if (strlen(file) >= PATH_CACHE_NAME_LEN) return 0;
+
+    const char *path_env = getenv("PATH");
+    if (!path_env) path_env = "/bin:/usr/bin";   // 与 glibc 的默认值一致
+    if (!path_cache_path_ok(path_env)) {
+        __atomic_fetch_add(&path_cache->uncacheable, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    uint64_t key = path_cache_hash(file, path_cache_hash(path_env, 0)) | 1;
+    // 先读 generation 再查找，查找期间目录发生变化时写入的条目会被当作过期
+    uint32_t gen = __atomic_load_n(&path_cache->generation, __ATOMIC_ACQUIRE);
+    if (path_cache_lookup(key, file, gen, out, out_size)) return 1;
+
+    __atomic_fetch_add(&path_cache->misses, 1, __ATOMIC_RELAXED);
+    uint64_t t0 = hook_now_ns();
+    uint32_t probes = 0;
+    for (const char *p = path_env; ; ) {
+        const char *end = strchr(p, ':');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        char candidate[PATH_CACHE_PATH_LEN];
+        if ((size_t)snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)len, p, file) < sizeof(candidate)) {
+            probes++;
+            struct stat st;
+            if (syscall(SYS_faccessat, AT_FDCWD, candidate, X_OK, 0) == 0 &&
+                stat(candidate, &st) == 0 && S_ISREG(st.st_mode)) {
+                uint64_t ns = hook_now_ns() - t0;
+                path_cache_insert(key, file, gen, candidate, probes,
+                                  ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns);
+                snprintf(out, out_size, "%s", candidate);
+                return 1;
+            }
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
 // Hook execl() - 修复递归问题
 int execl(const char *path, const char *arg, ...) {
     if (!real_execl) {
         real_execl = dlsym(RTLD_NEXT, "execl");
     }
+    HOOK_ENTER();
 
     // 收集参数用于日志记录
     va_list args;
@@ -114,12 +1411,16 @@ int execl(const char *path, const char *arg, ...) {
     argv[argc] = NULL;
     va_end(args);
 
-    log_syscall("execl", cmd_details);
+    log_event(HOOK_LEVEL_EXEC, "execl", cmd_details);
+    emit_exec_record("execl", hook_self_pid(), getppid(), path, (char * const *)argv, environ);
 
     // 使用real_execv替代execl来避免变参问题和递归调用
     if (!real_execv) {
         real_execv = dlsym(RTLD_NEXT, "execv");
     }
+    HOOK_LEAVE(HOOK_EXECL);
+    hook_flush_image("exec");
+    compile_cache_redirect(path, (char * const *)argv, NULL);
     return real_execv(path, (char * const *)argv);
 }
 
@@ -128,6 +1429,7 @@ int execv(const char *path, char *const argv[]) {
     if (!real_execv) {
         real_execv = dlsym(RTLD_NEXT, "execv");
     }
+    HOOK_ENTER();
 
     // 记录命令和参数
     char cmd_details[10240];
@@ -140,82 +1442,55 @@ int execv(const char *path, char *const argv[]) {
         }
     }
 
-    log_syscall("execv", cmd_details);
+    log_event(HOOK_LEVEL_EXEC, "execv", cmd_details);
+    emit_exec_record("execv", hook_self_pid(), getppid(), path, argv, environ);
+    HOOK_LEAVE(HOOK_EXECV);
+    hook_flush_image("exec");
+    compile_cache_redirect(path, argv, NULL);
     return real_execv(path, argv);
 }
 
 // 引用全局变量 environ
 extern char **environ;
 
-// 修复函数签名和逻辑
+// 生成传给 execve 的环境：extra_vars 里的变量(LD_PRELOAD 和会话变量)覆盖 envp 中的同名变量，
+// envp 的其余变量原样保留，这样 env -i 或自定义环境启动的子进程仍然被追踪且处于同一会话
 char **copy_env_with_additions(char *const extra_vars[], char *const envp[]) {
-    int env_count = 0;
-    while (environ[env_count] != NULL) {
-        env_count++;
-    }
-
-    // 正确计算 extra_vars 数组的长度
     int extra_count = 0;
     while (extra_vars[extra_count] != NULL) {
         extra_count++;
     }
 
     int envp_count = 0;
-    while (envp[envp_count] != NULL) {
+    while (envp && envp[envp_count] != NULL) {
         envp_count++;
     }
 
-    // 分配新数组：原有变量 + 新变量 + NULL
-    char **new_env = malloc(sizeof(char *) * (env_count + extra_count + envp_count + 1));
-
+    char **new_env = malloc(sizeof(char *) * (extra_count + envp_count + 1));
     if (!new_env) {
         perror("malloc");
         exit(1);
     }
 
-    // 首先复制 extra_vars
     memcpy(new_env, extra_vars, extra_count * sizeof(char *));
 
-    // 然后复制原有环境变量
-    memcpy(new_env + extra_count, environ, env_count * sizeof(char *));
-
-    // 最后处理 envp 中的变量，避免重复
-    int tmp_count = 0;
+    int n = extra_count;
     for (int i = 0; i < envp_count; i++) {
-        // 获取环境变量名部分（到 = 为止）
-        char* equals = strchr(envp[i], '=');
-        if (equals == NULL) continue;
-
-        int name_len = equals - envp[i];
-        char env_prefix[256];
-        snprintf(env_prefix, sizeof(env_prefix), "%.*s=", name_len, envp[i]);
+        const char *equals = strchr(envp[i], '=');
+        size_t name_len = equals ? (size_t)(equals - envp[i]) + 1 : strlen(envp[i]);
 
-        bool found = false;
-
-        // 检查是否在 extra_vars 中已存在
+        bool overridden = false;
         for (int j = 0; j < extra_count; j++) {
-            if (strncmp(extra_vars[j], env_prefix, strlen(env_prefix)) == 0) {
-                found = true;
+            if (strncmp(extra_vars[j], envp[i], name_len) == 0) {
+                overridden = true;
                 break;
             }
         }
-
-        // 检查是否在 environ 中已存在
-        if (!found) {
-            for (int j = 0; j < env_count; j++) {
-                if (strncmp(environ[j], env_prefix, strlen(env_prefix)) == 0) {
-                    found = true;
-                    break;
-                }
-            }
-        }
-
-        if (!found) {
-            new_env[extra_count + env_count + tmp_count] = strdup(envp[i]);
-            tmp_count++;
+        if (!overridden) {
+            new_env[n++] = envp[i];
         }
     }
-    new_env[extra_count + env_count + tmp_count] = NULL;
+    new_env[n] = NULL;
     return new_env;
 }
 
@@ -224,6 +1499,7 @@ int execve(const char *path, char *const argv[], char *const envp[]) {
     if (!real_execve) {
         real_execve = dlsym(RTLD_NEXT, "execve");
     }
+    HOOK_ENTER();
 
     // 记录命令和参数
     char cmd_details[10240];
@@ -236,15 +1512,12 @@ int execve(const char *path, char *const argv[], char *const envp[]) {
         }
     }
 
-    log_syscall("execve", cmd_details);
-
-    // 修改为 NULL 结尾的数组
-    char *extra_env[] = {
-        "LD_PRELOAD=/home/kevin/sectrend/sast-c/hook_test/helloworld/syscall_hook_fixed.so"
-    };
-
-    char **new_envp = copy_env_with_additions(extra_env, envp);
-    printf("new_envp: %s\n", new_envp[0]);
+    log_event(HOOK_LEVEL_EXEC, "execve", cmd_details);
+    char **new_envp = copy_env_with_additions(hook_env_extra, envp);
+    emit_exec_record("execve", hook_self_pid(), getppid(), path, argv, new_envp);
+    HOOK_LEAVE(HOOK_EXECVE);
+    hook_flush_image("exec");
+    compile_cache_redirect(path, argv, new_envp);
     return real_execve(path, argv, new_envp);
 }
 
@@ -253,6 +1526,7 @@ int execvp(const char *file, char *const argv[]) {
     if (!real_execvp) {
         real_execvp = dlsym(RTLD_NEXT, "execvp");
     }
+    HOOK_ENTER();
 
     // 记录命令和参数
     char cmd_details[10240];
@@ -276,7 +1550,17 @@ int execvp(const char *file, char *const argv[]) {
         }
     }
 
-    log_syscall("execvp", cmd_details);
+    log_event(HOOK_LEVEL_EXEC, "execvp", cmd_details);
+    emit_exec_record("execvp", hook_self_pid(), getppid(), file, argv, environ);
+    char resolved[PATH_CACHE_PATH_LEN];
+    int cached = path_cache_resolve(file, resolved, sizeof(resolved));
+    HOOK_LEAVE(HOOK_EXECVP);
+    hook_flush_image("exec");
+    compile_cache_redirect(file, argv, NULL);
+    if (cached) {
+        if (!real_execve) real_execve = dlsym(RTLD_NEXT, "execve");
+        real_execve(resolved, argv, environ);
+    }
     return real_execvp(file, argv);
 }
 
@@ -285,6 +1569,7 @@ int execvpe(const char *file, char *const argv[], char *const envp[]) {
     if (!real_execvpe) {
         real_execvpe = dlsym(RTLD_NEXT, "execvpe");
     }
+    HOOK_ENTER();
 
     // 记录命令和参数
     char cmd_details[10240];
@@ -297,7 +1582,17 @@ int execvpe(const char *file, char *const argv[], char *const envp[]) {
         }
     }
 
-    log_syscall("execvpe", cmd_details);
+    log_event(HOOK_LEVEL_EXEC, "execvpe", cmd_details);
+    emit_exec_record("execvpe", hook_self_pid(), getppid(), file, argv, envp);
+    char resolved[PATH_CACHE_PATH_LEN];
+    int cached = path_cache_resolve(file, resolved, sizeof(resolved));
+    HOOK_LEAVE(HOOK_EXECVPE);
+    hook_flush_image("exec");
+    compile_cache_redirect(file, argv, envp);
+    if (cached) {
+        if (!real_execve) real_execve = dlsym(RTLD_NEXT, "execve");
+        real_execve(resolved, argv, envp);
+    }
     return real_execvpe(file, argv, envp);
 }
 
@@ -306,17 +1601,20 @@ int system(const char *command) {
     if (!real_system) {
         real_system = dlsym(RTLD_NEXT, "system");
     }
+    HOOK_ENTER();
 
     char cmd_details[10240];
     snprintf(cmd_details, sizeof(cmd_details), "执行系统命令: %s", command ? command : "(null)");
-    log_syscall("system", cmd_details);
+    log_event(HOOK_LEVEL_EXEC, "system", cmd_details);
 
-    int result = real_system(command);
+    int result;
+    HOOK_REAL(result = real_system(command));
 
     char result_details[256];
     snprintf(result_details, sizeof(result_details), "系统命令执行结果: %d", result);
-    log_syscall("system", result_details);
+    log_event(HOOK_LEVEL_EXEC, "system", result_details);
 
+    HOOK_LEAVE(HOOK_SYSTEM);
     return result;
 }
 
@@ -325,6 +1623,7 @@ int execlp(const char *file, const char *arg, ...) {
     if (!real_execlp) {
         real_execlp = dlsym(RTLD_NEXT, "execlp");
     }
+    HOOK_ENTER();
 
     // 收集参数用于日志记录
     va_list args;
@@ -346,12 +1645,22 @@ int execlp(const char *file, const char *arg, ...) {
     argv[argc] = NULL;
     va_end(args);
 
-    log_syscall("execlp", cmd_details);
+    log_event(HOOK_LEVEL_EXEC, "execlp", cmd_details);
+    emit_exec_record("execlp", hook_self_pid(), getppid(), file, (char * const *)argv, environ);
 
     // 使用real_execvp来实现
     if (!real_execvp) {
         real_execvp = dlsym(RTLD_NEXT, "execvp");
     }
+    char resolved[PATH_CACHE_PATH_LEN];
+    int cached = path_cache_resolve(file, resolved, sizeof(resolved));
+    HOOK_LEAVE(HOOK_EXECLP);
+    hook_flush_image("exec");
+    compile_cache_redirect(file, (char * const *)argv, NULL);
+    if (cached) {
+        if (!real_execve) real_execve = dlsym(RTLD_NEXT, "execve");
+        real_execve(resolved, (char * const *)argv, environ);
+    }
     return real_execvp(file, (char * const *)argv);
 }
 
@@ -360,6 +1669,7 @@ int execle(const char *path, const char *arg, ...) {
     if (!real_execle) {
         real_execle = dlsym(RTLD_NEXT, "execle");
     }
+    HOOK_ENTER();
 
     // 收集参数用于日志记录
     va_list args;
@@ -387,40 +1697,140 @@ int execle(const char *path, const char *arg, ...) {
     envp = va_arg(args, char *const *);
     va_end(args);
 
-    log_syscall("execle", cmd_details);
+    log_event(HOOK_LEVEL_EXEC, "execle", cmd_details);
+    char **new_envp = copy_env_with_additions(hook_env_extra, envp);
+    emit_exec_record("execle", hook_self_pid(), getppid(), path, (char * const *)argv, new_envp);
 
     // 使用real_execve来实现
     if (!real_execve) {
         real_execve = dlsym(RTLD_NEXT, "execve");
     }
-    // 修改为 NULL 结尾的数组
-    char *extra_env[] = {
-        "LD_PRELOAD=/home/kevin/sectrend/sast-c/hook_test/helloworld/syscall_hook_fixed.so",
-        NULL
-    };
-    char **new_envp = copy_env_with_additions(extra_env, envp);
-    printf("new_envp: %s\n", new_envp[0]);
+    HOOK_LEAVE(HOOK_EXECLE);
+    hook_flush_image("exec");
+    compile_cache_redirect(path, (char * const *)argv, new_envp);
     return real_execve(path, (char * const *)argv, new_envp);
 }
 
-// Hook wait()
-pid_t wait(int *status) {
-    if (!real_wait) {
-        real_wait = dlsym(RTLD_NEXT, "wait");
+// ===== 子进程回收 =====
+// wait/waitpid/wait3 在 Linux 上都等价于 wait4，统一通过 wait4 取得被回收子进程的 rusage；
+// waitid 的 glibc 接口不带 rusage，改用带第五个参数的原始系统调用。P_PIDFD 方式的回收
+// 也经过 waitid，因此一并覆盖。WNOHANG 轮询没有结果时不记录。
+
+static pid_t reap_wait4(pid_t pid, int *status, int options, struct rusage *rusage) {
+    if (!real_wait4) {
+        real_wait4 = dlsym(RTLD_NEXT, "wait4");
     }
+    return real_wait4(pid, status, options, rusage);
+}
 
-    log_syscall("wait", "等待子进程结束");
-    pid_t result = real_wait(status);
+// 把状态交给调用者并记录；只有退出或被信号杀死才算回收，停止/继续通知不记录
+static void reap_finish(const char *fn, pid_t result, int st, int *status,
+                        const struct rusage *ru) {
+    int saved = errno;
+    if (result > 0 && status) *status = st;
 
     char details[256];
-    if (result > 0) {
-        snprintf(details, sizeof(details), "子进程 %d 结束，退出状态: %d",
-                result, status ? *status : -1);
-    } else {
-        snprintf(details, sizeof(details), "wait失败，返回 %d", result);
+    if (result < 0) {
+        snprintf(details, sizeof(details), "%s失败，返回 %d", fn, result);
+        log_event(HOOK_LEVEL_EXEC, fn, details);
+    } else if (result > 0 && (WIFEXITED(st) || WIFSIGNALED(st))) {
+        snprintf(details, sizeof(details),
+                 "子进程 %d 结束，退出状态: %d, user %ld.%03lds sys %ld.%03lds maxrss %ldKB",
+                 result, st, (long)ru->ru_utime.tv_sec, (long)ru->ru_utime.tv_usec / 1000,
+                 (long)ru->ru_stime.tv_sec, (long)ru->ru_stime.tv_usec / 1000, ru->ru_maxrss);
+        log_event(HOOK_LEVEL_EXEC, fn, details);
+        emit_reap_record(fn, result, st, ru);
+    }
+    errno = saved;
+}
+
+// Hook wait()
+pid_t wait(int *status) {
+    HOOK_ENTER();
+    struct rusage ru;
+    int st = 0;
+    pid_t result;
+    HOOK_REAL(result = reap_wait4(-1, &st, 0, &ru));
+    reap_finish("wait", result, st, status, &ru);
+    HOOK_LEAVE(HOOK_WAIT);
+    return result;
+}
+
+// Hook waitpid()
+pid_t waitpid(pid_t pid, int *status, int options) {
+    HOOK_ENTER();
+    struct rusage ru;
+    int st = 0;
+    pid_t result;
+    HOOK_REAL(result = reap_wait4(pid, &st, options, &ru));
+    reap_finish("waitpid", result, st, status, &ru);
+    HOOK_LEAVE(HOOK_WAITPID);
+    return result;
+}
+
+// Hook wait3()
+pid_t wait3(int *status, int options, struct rusage *rusage) {
+    HOOK_ENTER();
+    struct rusage ru;
+    int st = 0;
+    pid_t result;
+    HOOK_REAL(result = reap_wait4(-1, &st, options, &ru));
+    if (result > 0 && rusage) *rusage = ru;
+    reap_finish("wait3", result, st, status, &ru);
+    HOOK_LEAVE(HOOK_WAIT3);
+    return result;
+}
+
+// Hook wait4()
+pid_t wait4(pid_t pid, int *status, int options, struct rusage *rusage) {
+    HOOK_ENTER();
+    struct rusage ru;
+    int st = 0;
+    pid_t result;
+    HOOK_REAL(result = reap_wait4(pid, &st, options, &ru));
+    if (result > 0 && rusage) *rusage = ru;
+    reap_finish("wait4", result, st, status, &ru);
+    HOOK_LEAVE(HOOK_WAIT4);
+    return result;
+}
+
+// siginfo 转换成 wait 状态，与 wait4 的记录格式一致
+static int siginfo_wait_status(const siginfo_t *info) {
+    switch (info->si_code) {
+    case CLD_EXITED: return (info->si_status & 0xff) << 8;
+    case CLD_KILLED: return info->si_status & 0x7f;
+    case CLD_DUMPED: return (info->si_status & 0x7f) | 0x80;
+    default:         return -1;
     }
-    log_syscall("wait", details);
+}
+
+// Hook waitid()，包括 waitid(P_PIDFD, pidfd, ...)
+int waitid(idtype_t idtype, id_t id, siginfo_t *infop, int options) {
+    HOOK_ENTER();
+
+    struct rusage ru;
+    siginfo_t local;
+    siginfo_t *info = infop ? infop : &local;
+    memset(info, 0, sizeof(*info));
+    int result;
+    HOOK_REAL(result = (int)syscall(SYS_waitid, idtype, id, info, options, &ru));
+
+    // WNOWAIT 只查看不回收，之后真正回收时再记录
+    int saved = errno;
+    if (result == 0 && info->si_pid > 0 && (options & WEXITED) && !(options & WNOWAIT)) {
+        int st = siginfo_wait_status(info);
+        if (st >= 0) {
+            char details[256];
+            snprintf(details, sizeof(details),
+                     "子进程 %d 结束(idtype=%d)，退出状态: %d, maxrss %ldKB",
+                     info->si_pid, (int)idtype, st, ru.ru_maxrss);
+            log_event(HOOK_LEVEL_EXEC, "waitid", details);
+            emit_reap_record("waitid", info->si_pid, st, &ru);
+        }
+    }
+    errno = saved;
 
+    HOOK_LEAVE(HOOK_WAITID);
     return result;
 }
 
@@ -429,7 +1839,9 @@ pid_t getpid(void) {
     if (!real_getpid) {
         real_getpid = dlsym(RTLD_NEXT, "getpid");
     }
-    pid_t result = real_getpid();
+    HOOK_ENTER();
+    pid_t result;
+    HOOK_REAL(result = real_getpid());
 
     if (!logging_in_progress) {
         char details[256];
@@ -437,6 +1849,7 @@ pid_t getpid(void) {
         log_syscall("getpid", details);
     }
 
+    HOOK_LEAVE(HOOK_GETPID);
     return result;
 }
 
@@ -445,12 +1858,15 @@ uid_t getuid(void) {
     if (!real_getuid) {
         real_getuid = dlsym(RTLD_NEXT, "getuid");
     }
-    uid_t result = real_getuid();
+    HOOK_ENTER();
+    uid_t result;
+    HOOK_REAL(result = real_getuid());
 
     char details[256];
     snprintf(details, sizeof(details), "返回用户ID = %d", result);
     log_syscall("getuid", details);
 
+    HOOK_LEAVE(HOOK_GETUID);
     return result;
 }
 
@@ -459,21 +1875,52 @@ char *getcwd(char *buf, size_t size) {
     if (!real_getcwd) {
         real_getcwd = dlsym(RTLD_NEXT, "getcwd");
     }
-    char *result = real_getcwd(buf, size);
+    HOOK_ENTER();
+    char *result;
+    HOOK_REAL(result = real_getcwd(buf, size));
 
     char details[512];
     snprintf(details, sizeof(details), "获取当前目录 = %s (缓冲区大小:%zu)",
              result ? result : "NULL", size);
     log_syscall("getcwd", details);
 
+    HOOK_LEAVE(HOOK_GETCWD);
     return result;
 }
 
+// open 系列共用的记录逻辑：登记 fd 表并输出一条事件
+static void log_open_event(uint32_t level, const char *syscall_name, int dirfd, const char *pathname,
+                           int flags, mode_t mode, int result) {
+    // 避免记录日志文件本身的open调用
+    if (level == HOOK_LEVEL_OFF || logging_in_progress || strcmp(pathname, "syscall_hook.log") == 0) return;
+
+    if (dirfd == AT_FDCWD) {
+        fd_track_open(result, pathname);
+    } else {
+        fd_track_openat(result, dirfd, pathname);
+    }
+    if (level < HOOK_LEVEL_FULL) return;
+
+    char details[512];
+    char flags_str[128] = {0};
+    if (flags & O_CREAT) strcat(flags_str, "O_CREAT ");
+    if (flags & O_WRONLY) strcat(flags_str, "O_WRONLY ");
+    if (flags & O_RDONLY) strcat(flags_str, "O_RDONLY ");
+    if (flags & O_TRUNC) strcat(flags_str, "O_TRUNC ");
+    if (flags & O_APPEND) strcat(flags_str, "O_APPEND ");
+    if (flags & O_CLOEXEC) strcat(flags_str, "O_CLOEXEC ");
+
+    snprintf(details, sizeof(details), "打开文件 '%s', 标志:[%s], 模式:0%o, 文件描述符=%d, path_id=%u",
+             pathname, flags_str, mode, result, fd_path_id(result));
+    log_syscall(syscall_name, details);
+}
+
 // Hook open() - 但要小心在log_syscall中的递归
 int open(const char *pathname, int flags, ...) {
     if (!real_open) {
         real_open = dlsym(RTLD_NEXT, "open");
     }
+    HOOK_ENTER();
 
     mode_t mode = 0;
     if (flags & O_CREAT) {
@@ -483,23 +1930,80 @@ int open(const char *pathname, int flags, ...) {
         va_end(args);
     }
 
-    int result = real_open(pathname, flags, mode);
+    int result;
+    HOOK_REAL(result = real_open(pathname, flags, mode));
+    log_open_event(hook_level_, "open", AT_FDCWD, pathname, flags, mode, result);
 
-    // 避免记录日志文件本身的open调用
-    if (!logging_in_progress && strcmp(pathname, "syscall_hook.log") != 0) {
-        char details[512];
-        char flags_str[128] = {0};
-        if (flags & O_CREAT) strcat(flags_str, "O_CREAT ");
-        if (flags & O_WRONLY) strcat(flags_str, "O_WRONLY ");
-        if (flags & O_RDONLY) strcat(flags_str, "O_RDONLY ");
-        if (flags & O_TRUNC) strcat(flags_str, "O_TRUNC ");
-        if (flags & O_APPEND) strcat(flags_str, "O_APPEND ");
+    HOOK_LEAVE(HOOK_OPEN);
+    return result;
+}
+
+// Hook open64() - 以 _FILE_OFFSET_BITS=64 编译的程序(如 make)调用的是这个符号
+int open64(const char *pathname, int flags, ...) {
+    if (!real_open64) {
+        real_open64 = dlsym(RTLD_NEXT, "open64");
+    }
+    HOOK_ENTER();
+
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+
+    int result;
+    HOOK_REAL(result = real_open64(pathname, flags, mode));
+    log_open_event(hook_level_, "open", AT_FDCWD, pathname, flags, mode, result);
+
+    HOOK_LEAVE(HOOK_OPEN);
+    return result;
+}
+
+// Hook openat()
+int openat(int dirfd, const char *pathname, int flags, ...) {
+    if (!real_openat) {
+        real_openat = dlsym(RTLD_NEXT, "openat");
+    }
+    HOOK_ENTER();
 
-        snprintf(details, sizeof(details), "打开文件 '%s', 标志:[%s], 模式:0%o, 文件描述符=%d",
-                 pathname, flags_str, mode, result);
-        log_syscall("open", details);
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
     }
 
+    int result;
+    HOOK_REAL(result = real_openat(dirfd, pathname, flags, mode));
+    log_open_event(hook_level_, "openat", dirfd, pathname, flags, mode, result);
+
+    HOOK_LEAVE(HOOK_OPENAT);
+    return result;
+}
+
+// Hook openat64()
+int openat64(int dirfd, const char *pathname, int flags, ...) {
+    if (!real_openat64) {
+        real_openat64 = dlsym(RTLD_NEXT, "openat64");
+    }
+    HOOK_ENTER();
+
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+
+    int result;
+    HOOK_REAL(result = real_openat64(dirfd, pathname, flags, mode));
+    log_open_event(hook_level_, "openat", dirfd, pathname, flags, mode, result);
+
+    HOOK_LEAVE(HOOK_OPENAT);
     return result;
 }
 
@@ -508,28 +2012,35 @@ ssize_t write(int fd, const void *buf, size_t count) {
     if (!real_write) {
         real_write = dlsym(RTLD_NEXT, "write");
     }
-    ssize_t result = real_write(fd, buf, count);
+    HOOK_ENTER();
+    ssize_t result;
+    HOOK_REAL(result = real_write(fd, buf, count));
+
+    if (logging_in_progress || hook_level_ == HOOK_LEVEL_OFF) {
+        HOOK_LEAVE(HOOK_WRITE);
+        return result; // 日志自身的写入不统计
+    }
 
-    // 避免记录日志写入操作和标准输出
-    if (!logging_in_progress && fd != 1 && fd != 2) {
+    fd_account_write(fd, result);
+
+    // 逐次事件只在开启时记录，且跳过标准输出
+    bool preview_due = write_preview_every > 0 &&
+        __atomic_fetch_add(&write_seq, 1, __ATOMIC_RELAXED) % write_preview_every == 0;
+    if ((io_log_events || preview_due) && fd != 1 && fd != 2 && hook_level_ >= HOOK_LEVEL_FULL) {
         char details[512];
-        char preview[101] = {0};
-        if (buf && count > 0) {
-            size_t preview_len = count < 100 ? count : 100;
-            memcpy(preview, buf, preview_len);
-            // 替换非打印字符为'.'
-            for (size_t i = 0; i < preview_len; i++) {
-                if (preview[i] < 32 || preview[i] > 126) {
-                    preview[i] = '.';
-                }
-            }
+        if (preview_due && buf && count > 0) {
+            char preview[PREVIEW_MAX + 1];
+            sanitize_preview(preview, buf, count < PREVIEW_MAX ? count : PREVIEW_MAX);
+            snprintf(details, sizeof(details), "写入fd=%d, path_id=%u, 字节数=%zu, 实际写入=%ld, 内容:'%s'",
+                     fd, fd_path_id(fd), count, result, preview);
+        } else {
+            snprintf(details, sizeof(details), "写入fd=%d, path_id=%u, 字节数=%zu, 实际写入=%ld",
+                     fd, fd_path_id(fd), count, result);
         }
-
-        snprintf(details, sizeof(details), "写入fd=%d, 字节数=%zu, 实际写入=%ld, 内容:'%s'",
-                 fd, count, result, preview);
         log_syscall("write", details);
     }
 
+    HOOK_LEAVE(HOOK_WRITE);
     return result;
 }
 
@@ -538,23 +2049,232 @@ int close(int fd) {
     if (!real_close) {
         real_close = dlsym(RTLD_NEXT, "close");
     }
-    int result = real_close(fd);
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_close(fd));
+
+    if (!logging_in_progress && hook_level_ >= HOOK_LEVEL_COUNTERS) {
+        uint32_t path_id = fd_path_id(fd);
+        if (result == 0) fd_track_close(fd);
+
+        if (hook_level_ >= HOOK_LEVEL_FULL) {
+            char details[256];
+            snprintf(details, sizeof(details), "关闭文件描述符=%d, path_id=%u, 结果=%d", fd, path_id, result);
+            log_syscall("close", details);
+        }
+    }
+
+    HOOK_LEAVE(HOOK_CLOSE);
+    return result;
+}
+
+// Hook read() - 只做按fd统计，逐次事件需要 HOOK_IO_EVENTS=1
+ssize_t read(int fd, void *buf, size_t count) {
+    if (!real_read) {
+        real_read = dlsym(RTLD_NEXT, "read");
+    }
+    HOOK_ENTER();
+    ssize_t result;
+    HOOK_REAL(result = real_read(fd, buf, count));
+
+    if (!logging_in_progress && hook_level_ >= HOOK_LEVEL_COUNTERS) {
+        fd_account_read(fd, result);
+        if (io_log_events && fd != 0 && hook_level_ >= HOOK_LEVEL_FULL) {
+            char details[256];
+            snprintf(details, sizeof(details), "读取fd=%d, path_id=%u, 字节数=%zu, 实际读取=%ld",
+                     fd, fd_path_id(fd), count, result);
+            log_syscall("read", details);
+        }
+    }
+
+    HOOK_LEAVE(HOOK_READ);
+    return result;
+}
+
+// dup 系列共用的记录逻辑
+static void log_dup_event(uint32_t level, const char *syscall_name, int oldfd, int result) {
+    if (level == HOOK_LEVEL_OFF || logging_in_progress || result < 0) return;
+    fd_track_dup(oldfd, result);
+    if (level < HOOK_LEVEL_FULL) return;
+
+    char details[256];
+    snprintf(details, sizeof(details), "复制文件描述符 %d -> %d, path_id=%u",
+             oldfd, result, fd_path_id(result));
+    log_syscall(syscall_name, details);
+}
+
+// Hook dup()
+int dup(int oldfd) {
+    if (!real_dup) {
+        real_dup = dlsym(RTLD_NEXT, "dup");
+    }
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_dup(oldfd));
+    log_dup_event(hook_level_, "dup", oldfd, result);
+
+    HOOK_LEAVE(HOOK_DUP);
+    return result;
+}
+
+// Hook dup2()
+int dup2(int oldfd, int newfd) {
+    if (!real_dup2) {
+        real_dup2 = dlsym(RTLD_NEXT, "dup2");
+    }
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_dup2(oldfd, newfd));
+    log_dup_event(hook_level_, "dup2", oldfd, result);
+
+    HOOK_LEAVE(HOOK_DUP);
+    return result;
+}
+
+// Hook dup3()
+int dup3(int oldfd, int newfd, int flags) {
+    if (!real_dup3) {
+        real_dup3 = dlsym(RTLD_NEXT, "dup3");
+    }
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_dup3(oldfd, newfd, flags));
+    log_dup_event(hook_level_, "dup3", oldfd, result);
+
+    HOOK_LEAVE(HOOK_DUP);
+    return result;
+}
+
+// pipe 系列共用的记录逻辑
+static void log_pipe_event(uint32_t level, const char *syscall_name, int pipefd[2], int result) {
+    if (level == HOOK_LEVEL_OFF || logging_in_progress || result != 0) return;
+    fd_track_anon(pipefd[0], "pipe");
+    fd_track_anon(pipefd[1], "pipe");
+    if (level < HOOK_LEVEL_FULL) return;
+
+    char details[256];
+    snprintf(details, sizeof(details), "创建管道 读端=%d 写端=%d, path_id=%u",
+             pipefd[0], pipefd[1], fd_path_id(pipefd[0]));
+    log_syscall(syscall_name, details);
+}
+
+// Hook pipe()
+int pipe(int pipefd[2]) {
+    if (!real_pipe) {
+        real_pipe = dlsym(RTLD_NEXT, "pipe");
+    }
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_pipe(pipefd));
+    log_pipe_event(hook_level_, "pipe", pipefd, result);
+
+    HOOK_LEAVE(HOOK_PIPE);
+    return result;
+}
+
+// Hook pipe2()
+int pipe2(int pipefd[2], int flags) {
+    if (!real_pipe2) {
+        real_pipe2 = dlsym(RTLD_NEXT, "pipe2");
+    }
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_pipe2(pipefd, flags));
+    log_pipe_event(hook_level_, "pipe2", pipefd, result);
+
+    HOOK_LEAVE(HOOK_PIPE);
+    return result;
+}
+
+// Hook socket()
+int socket(int domain, int type, int protocol) {
+    if (!real_socket) {
+        real_socket = dlsym(RTLD_NEXT, "socket");
+    }
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_socket(domain, type, protocol));
+
+    if (!logging_in_progress && result >= 0 && hook_level_ >= HOOK_LEVEL_COUNTERS) {
+        fd_track_anon(result, "socket");
 
-    if (!logging_in_progress) {
         char details[256];
-        snprintf(details, sizeof(details), "关闭文件描述符=%d, 结果=%d", fd, result);
-        log_syscall("close", details);
+        snprintf(details, sizeof(details), "创建socket domain=%d type=%d, 文件描述符=%d, path_id=%u",
+                 domain, type, result, fd_path_id(result));
+        log_syscall("socket", details);
+    }
+
+    HOOK_LEAVE(HOOK_SOCKET);
+    return result;
+}
+
+// fcntl 的第三个参数按 cmd 不同可能是 int 或指针，统一按 long 取出原样转发
+// (x86-64/aarch64 的调用约定下二者都放在同一个寄存器里)
+static int fcntl_common(int (*real)(int, int, ...), int fd, int cmd, long arg) {
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real(fd, cmd, arg));
+
+    if (cmd == F_DUPFD || cmd == F_DUPFD_CLOEXEC) {
+        log_dup_event(hook_level_, "fcntl", fd, result);
     }
 
+    HOOK_LEAVE(HOOK_FCNTL);
     return result;
 }
 
+// Hook fcntl() - 只关心 F_DUPFD/F_DUPFD_CLOEXEC
+int fcntl(int fd, int cmd, ...) {
+    if (!real_fcntl) {
+        real_fcntl = dlsym(RTLD_NEXT, "fcntl");
+    }
+    va_list args;
+    va_start(args, cmd);
+    long arg = va_arg(args, long);
+    va_end(args);
+    return fcntl_common(real_fcntl, fd, cmd, arg);
+}
+
+// Hook fcntl64() - glibc 2.28 起以 _FILE_OFFSET_BITS=64 编译的程序调用这个符号
+int fcntl64(int fd, int cmd, ...) {
+    if (!real_fcntl64) {
+        real_fcntl64 = dlsym(RTLD_NEXT, "fcntl64");
+    }
+    va_list args;
+    va_start(args, cmd);
+    long arg = va_arg(args, long);
+    va_end(args);
+    return fcntl_common(real_fcntl64, fd, cmd, arg);
+}
+
+// Hook _exit() - dash 等程序不经过 exit() 而是直接 _exit 退出，析构函数不会执行
+void _exit(int status) {
+    if (!real__exit) {
+        real__exit = dlsym(RTLD_NEXT, "_exit");
+    }
+    hook_flush_image("exit");
+    real__exit(status);
+    __builtin_unreachable();
+}
+
+// Hook _Exit()
+void _Exit(int status) {
+    if (!real__Exit) {
+        real__Exit = dlsym(RTLD_NEXT, "_Exit");
+    }
+    hook_flush_image("exit");
+    real__Exit(status);
+    __builtin_unreachable();
+}
+
 // Hook access()
 int access(const char *pathname, int mode) {
     if (!real_access) {
         real_access = dlsym(RTLD_NEXT, "access");
     }
-    int result = real_access(pathname, mode);
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_access(pathname, mode));
 
     char details[512];
     char mode_str[32] = {0};
@@ -569,6 +2289,7 @@ int access(const char *pathname, int mode) {
              pathname, mode_str, result, result == 0 ? "(成功)" : "(失败)");
     log_syscall("access", details);
 
+    HOOK_LEAVE(HOOK_ACCESS);
     return result;
 }
 
@@ -577,16 +2298,19 @@ unsigned int sleep(unsigned int seconds) {
     if (!real_sleep) {
         real_sleep = dlsym(RTLD_NEXT, "sleep");
     }
+    HOOK_ENTER();
 
     char details[256];
     snprintf(details, sizeof(details), "开始睡眠 %u 秒", seconds);
     log_syscall("sleep", details);
 
-    unsigned int result = real_sleep(seconds);
+    unsigned int result;
+    HOOK_REAL(result = real_sleep(seconds));
 
     snprintf(details, sizeof(details), "睡眠结束，剩余未完成的秒数: %u", result);
     log_syscall("sleep", details);
 
+    HOOK_LEAVE(HOOK_SLEEP);
     return result;
 }
 
@@ -595,13 +2319,16 @@ int unlink(const char *pathname) {
     if (!real_unlink) {
         real_unlink = dlsym(RTLD_NEXT, "unlink");
     }
-    int result = real_unlink(pathname);
+    HOOK_ENTER();
+    int result;
+    HOOK_REAL(result = real_unlink(pathname));
 
     char details[512];
     snprintf(details, sizeof(details), "删除文件 '%s', 结果=%d %s",
              pathname, result, result == 0 ? "(成功)" : "(失败)");
     log_syscall("unlink", details);
 
+    HOOK_LEAVE(HOOK_UNLINK);
     return result;
 }
 
@@ -612,6 +2339,7 @@ int posix_spawn(pid_t *pid,
                 char *const argv[],
                 char *const envp[]
                 ) {
+    HOOK_ENTER();
 
     char cmd_details[10240];
     snprintf(cmd_details, sizeof(cmd_details), "执行命令(POSIX spawn): %s", path);
@@ -639,6 +2367,14 @@ int posix_spawn(pid_t *pid,
     //     }
     // }
     cmd_details[sizeof(cmd_details) - 1] = '\0';
-    log_syscall("posix_spawn", cmd_details);
-    return real_posix_spawn(pid, path, file_actions, attrp, argv, envp);
+    log_event(HOOK_LEVEL_EXEC, "posix_spawn", cmd_details);
+    pid_t child = 0;
+    int result;
+    HOOK_REAL(result = real_posix_spawn(&child, path, file_actions, attrp, argv, envp));
+    if (pid) *pid = child;
+    if (result == 0) {
+        emit_exec_record("posix_spawn", child, hook_self_pid(), path, argv, envp ? envp : environ);
+    }
+    HOOK_LEAVE(HOOK_POSIX_SPAWN);
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#!/bin/bash
+# test_compile_cache.sh - 测试 hooktrace 的编译缓存(--compile-cache / hooktrace compile-cache)
+#   1. 同一个翻译单元编译两次：第一次未命中、第二次命中，两次的 .o 逐字节相同
+#   2. 编译失败时退出码仍为 1，缓存目录里不留下 .out
+#   3. 工具被信号终止时，compile-cache 以同一个信号结束
+#   4. N 个相同的编译并发运行，结束后缓存目录里没有残留的 *.tmp.* 文件
+# 用法: ./test_compile_cache.sh [并发数，默认 8]
+
+N=${1:-8}
+CURRENT_DIR=$(pwd)
+WORK=$(mktemp -d /tmp/test_compile_cache.XXXXXX)
+HOOKTRACE="$WORK/hooktrace"
+FAILED=0
+
+pass() { echo "✅ $1"; }
+fail() { echo "❌ $1"; FAILED=1; }
+
+echo "🚀 ========== 测试编译缓存 =========="
+echo "📁 临时目录: $WORK"
+echo ""
+
+echo "🔨 编译 hook 库和 hooktrace..."
+if ! make -s -C "$CURRENT_DIR" tools HOOK_LIB="$WORK/syscall_hook_fixed.so" LAUNCHER="$HOOKTRACE"; then
+    echo "❌ 编译失败!"
+    exit 1
+fi
+echo ""
+
+cd "$WORK" || exit 1
+cat > t.cpp <<'EOF'
+#include <iostream>
+int main() { std::cout << "hello" << std::endl; return 0; }
+EOF
+
+# ===== 1. 未命中后命中，产物相同 =====
+echo "🎯 ========== 1. 两次编译同一个翻译单元 =========="
+CACHE="$WORK/cache"
+mkdir -p "$CACHE" out
+"$HOOKTRACE" run --out out --session first --compile-cache "$CACHE" -- g++ -O2 -c t.cpp -o t.o 2>/dev/null
+mv t.o first.o
+"$HOOKTRACE" run --out out --session second --compile-cache "$CACHE" -- g++ -O2 -c t.cpp -o t.o 2>/dev/null
+mv t.o second.o
+
+misses=$(grep -c '"result":"miss"' out/first/compile_cache.log 2>/dev/null)
+hits=$(grep -c '"result":"hit"' out/second/compile_cache.log 2>/dev/null)
+others=$(grep -vc '"result":"hit"' out/second/compile_cache.log 2>/dev/null)
+echo "📊 第一次未命中 ${misses:-0} 个工具，第二次命中 ${hits:-0} 个、其他 ${others:-0} 个"
+if [ "${misses:-0}" -ge 2 ] && [ "${hits:-0}" -eq "$misses" ] && [ "${others:-0}" -eq 0 ]; then
+    pass "cc1plus 和 as 第一次未命中、第二次全部命中"
+else
+    fail "命中情况不符合预期"
+fi
+if [ -s first.o ] && cmp -s first.o second.o; then
+    pass "两次生成的 .o 逐字节相同"
+else
+    fail "两次生成的 .o 不同"
+fi
+echo ""
+
+# ===== 2. 编译失败 =====
+echo "🎯 ========== 2. 编译失败 =========="
+CC1PLUS=$(g++ -print-prog-name=cc1plus)
+echo 'int main() { return missing; }' > bad.cpp
+FAIL_CACHE="$WORK/fail_cache"
+mkdir -p "$FAIL_CACHE"
+HOOKTRACE_COMPILE_CACHE="$FAIL_CACHE" "$HOOKTRACE" compile-cache "$CC1PLUS" cc1plus -quiet bad.cpp -o bad.s 2>/dev/null
+status=$?
+outs=$(find "$FAIL_CACHE" -name '*.out' | wc -l)
+echo "📊 退出码 $status，缓存中 .out 文件 $outs 个"
+[ "$status" -eq 1 ] && pass "失败的编译退出码为 1" || fail "失败的编译退出码为 $status，应为 1"
+[ "$outs" -eq 0 ] && pass "失败的编译没有写入缓存" || fail "失败的编译留下了 .out"
+echo ""
+
+# ===== 3. 工具被信号终止 =====
+# 名为 as 的脚本才会被当作可缓存的工具；它收到 SIGSEGV 后结束
+echo "🎯 ========== 3. 工具被信号终止 =========="
+mkdir -p sigtool
+printf '#!/bin/sh\nkill -SEGV $$\n' > sigtool/as
+chmod +x sigtool/as
+echo '.text' > sig.s
+SIG_CACHE="$WORK/sig_cache"
+mkdir -p "$SIG_CACHE"
+{ (ulimit -c 0; HOOKTRACE_COMPILE_CACHE="$SIG_CACHE" exec "$HOOKTRACE" compile-cache "$WORK/sigtool/as" as sig.s -o sig.o); } 2>/dev/null
+status=$?
+echo "📊 退出状态 $status (SIGSEGV 对应 $((128 + 11)))"
+[ "$status" -eq $((128 + 11)) ] && pass "compile-cache 以 SIGSEGV 结束" || fail "退出状态 $status，应为 SIGSEGV"
+[ "$(find "$SIG_CACHE" -name '*.out' | wc -l)" -eq 0 ] && pass "被信号终止的结果没有写入缓存" || fail "被信号终止的结果写入了缓存"
+echo ""
+
+# ===== 4. 并发的相同编译 =====
+echo "🎯 ========== 4. $N 个相同的编译并发运行 =========="
+AS=$(g++ -print-prog-name=as)
+case "$AS" in */*) ;; *) AS=$(command -v "$AS") ;; esac
+g++ -O2 -S t.cpp -o t.s
+CONC_CACHE="$WORK/conc_cache"
+mkdir -p "$CONC_CACHE"
+for i in $(seq 1 "$N"); do
+    HOOKTRACE_COMPILE_CACHE="$CONC_CACHE" "$HOOKTRACE" compile-cache "$AS" as t.s -o "conc_$i.o" &
+done
+wait
+tmps=$(find "$CONC_CACHE" -name '*.tmp.*' | wc -l)
+outs=$(find "$CONC_CACHE" -name '*.out' | wc -l)
+same=1
+for i in $(seq 2 "$N"); do
+    cmp -s conc_1.o "conc_$i.o" || same=0
+done
+echo "📊 残留临时文件 $tmps 个，缓存 .out $outs 个"
+[ "$tmps" -eq 0 ] && pass "没有残留的 *.tmp.* 文件" || fail "残留了 $tmps 个 *.tmp.* 文件"
+[ "$outs" -eq 1 ] && pass "缓存中只有一份产物" || fail "缓存中有 $outs 份产物"
+[ -s conc_1.o ] && [ "$same" -eq 1 ] && pass "$N 个 .o 逐字节相同" || fail "并发编译的 .o 不一致"
+echo ""
+
+cd "$CURRENT_DIR"
+rm -rf "$WORK"
+if [ "$FAILED" -eq 0 ]; then
+    echo "🎉 编译缓存测试全部通过!"
+else
+    echo "❌ 编译缓存测试有失败项"
+fi
+exit $FAILED
@@ -0,0 +1,863 @@
+/* trace_record.c
+ * 追踪记录读取，见 trace_record.h
+ */
+
+#define _GNU_SOURCE
+#include "trace_record.h"
+#include "intern.h"
+#include "trace_sink.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ===== JSON 解析 =====
+
+struct json_parser {
+    const char *p;
+    const char *end;
+};
+
+static void skip_ws(struct json_parser *jp) {
+    while (jp->p < jp->end && isspace((unsigned char)*jp->p)) jp->p++;
+}
+
+static int parse_value(struct json_parser *jp, struct json_value *out);
+
+static void put_utf8(char **dst, unsigned cp) {
+    char *d = *dst;
+    if (cp < 0x80) {
+        *d++ = (char)cp;
+    } else if (cp < 0x800) {
+        *d++ = (char)(0xC0 | (cp >> 6));
+        *d++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *d++ = (char)(0xE0 | (cp >> 12));
+        *d++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *d++ = (char)(0x80 | (cp & 0x3F));
+    }
+    *dst = d;
+}
+
+static char *parse_string(struct json_parser *jp) {
+    if (jp->p >= jp->end || *jp->p != '"') return NULL;
+    jp->p++;
+
+    // 转义后的长度不会超过原文
+    const char *start = jp->p;
+    while (jp->p < jp->end && *jp->p != '"') {
+        if (*jp->p == '\\') jp->p++;
+        jp->p++;
+    }
+    if (jp->p >= jp->end) return NULL;
+
+    char *s = malloc((size_t)(jp->p - start) + 1);
+    if (!s) return NULL;
+    char *d = s;
+    for (const char *q = start; q < jp->p; q++) {
+        if (*q != '\\') {
+            *d++ = *q;
+            continue;
+        }
+        q++;
+        switch (*q) {
+        case 'n': *d++ = '\n'; break;
+        case 't': *d++ = '\t'; break;
+        case 'r': *d++ = '\r'; break;
+        case 'b': *d++ = '\b'; break;
+        case 'f': *d++ = '\f'; break;
+        case 'u': {
+            unsigned cp = 0;
+            for (int i = 1; i <= 4 && q + i < jp->p; i++) {
+                char c = q[i];
+                cp = cp * 16 + (unsigned)(isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+            }
+            q += 4;
+            put_utf8(&d, cp);
+            break;
+        }
+        default: *d++ = *q; break;   // \" \\ \/
+        }
+    }
+    *d = '\0';
+    jp->p++; // 结尾的引号
+    return s;
+}
+
+static int parse_container(struct json_parser *jp, struct json_value *out, int is_object) {
+    char close = is_object ? '}' : ']';
+    size_t cap = 0;
+    out->type = is_object ? JSON_OBJECT : JSON_ARRAY;
+    jp->p++;
+
+    skip_ws(jp);
+    if (jp->p < jp->end && *jp->p == close) {
+        jp->p++;
+        return 0;
+    }
+    for (;;) {
+        if (out->count == cap) {
+            cap = cap ? cap * 2 : 8;
+            struct json_value *items = realloc(out->items, cap * sizeof(*items));
+            if (!items) return -1;
+            out->items = items;
+            if (is_object) {
+                char **keys = realloc(out->keys, cap * sizeof(*keys));
+                if (!keys) return -1;
+                out->keys = keys;
+            }
+        }
+
+        skip_ws(jp);
+        if (is_object) {
+            char *key = parse_string(jp);
+            if (!key) return -1;
+            out->keys[out->count] = key;
+            skip_ws(jp);
+            if (jp->p >= jp->end || *jp->p != ':') {
+                free(key);
+                return -1;
+            }
+            jp->p++;
+        }
+        struct json_value *item = &out->items[out->count];
+        memset(item, 0, sizeof(*item));
+        out->count++;
+        if (parse_value(jp, item) != 0) return -1;
+
+        skip_ws(jp);
+        if (jp->p < jp->end && *jp->p == ',') {
+            jp->p++;
+            continue;
+        }
+        if (jp->p < jp->end && *jp->p == close) {
+            jp->p++;
+            return 0;
+        }
+        return -1;
+    }
+}
+
+static int parse_value(struct json_parser *jp, struct json_value *out) {
+    skip_ws(jp);
+    if (jp->p >= jp->end) return -1;
+
+    char c = *jp->p;
+    if (c == '{' || c == '[') return parse_container(jp, out, c == '{');
+    if (c == '"') {
+        out->type = JSON_STRING;
+        out->string = parse_string(jp);
+        return out->string ? 0 : -1;
+    }
+    if (strncmp(jp->p, "true", 4) == 0 || strncmp(jp->p, "false", 5) == 0) {
+        out->type = JSON_BOOL;
+        out->boolean = (c == 't');
+        jp->p += out->boolean ? 4 : 5;
+        return 0;
+    }
+    if (strncmp(jp->p, "null", 4) == 0) {
+        out->type = JSON_NULL;
+        jp->p += 4;
+        return 0;
+    }
+    if (c == '-' || isdigit((unsigned char)c)) {
+        char buf[64];
+        size_t n = 0;
+        while (jp->p < jp->end && n < sizeof(buf) - 1 &&
+               (isdigit((unsigned char)*jp->p) || strchr("+-.eE", *jp->p))) {
+            buf[n++] = *jp->p++;
+        }
+        buf[n] = '\0';
+        out->type = JSON_NUMBER;
+        out->number = strtod(buf, NULL);
+        out->integer = strtoll(buf, NULL, 10);
+        return 0;
+    }
+    return -1;
+}
+
+static void json_free_children(struct json_value *v) {
+    free(v->string);
+    for (size_t i = 0; i < v->count; i++) {
+        json_free_children(&v->items[i]);
+        if (v->keys) free(v->keys[i]);
+    }
+    free(v->items);
+    free(v->keys);
+}
+
+struct json_value *json_parse(const char *text, size_t len) {
+    struct json_parser jp = {text, text + len};
+    struct json_value *v = calloc(1, sizeof(*v));
+    if (!v) return NULL;
+    if (parse_value(&jp, v) != 0) {
+        json_free(v);
+        return NULL;
+    }
+    return v;
+}
+
+void json_free(struct json_value *v) {
+    if (!v) return;
+    json_free_children(v);
+    free(v);
+}
+
+const struct json_value *json_get(const struct json_value *obj, const char *key) {
+    if (!obj || obj->type != JSON_OBJECT) return NULL;
+    for (size_t i = 0; i < obj->count; i++) {
+        if (strcmp(obj->keys[i], key) == 0) return &obj->items[i];
+    }
+    return NULL;
+}
+
+const char *json_get_str(const struct json_value *obj, const char *key) {
+    const struct json_value *v = json_get(obj, key);
+    return (v && v->type == JSON_STRING) ? v->string : NULL;
+}
+
+long long json_get_int(const struct json_value *obj, const char *key, long long def) {
+    const struct json_value *v = json_get(obj, key);
+    return (v && v->type == JSON_NUMBER) ? v->integer : def;
+}
+
+void json_write_str(FILE *out, const char *s) {
+    if (!s) {
+        fputs("null", out);
+        return;
+    }
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        switch (c) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\t': fputs("\\t", out); break;
+        case '\r': fputs("\\r", out); break;
+        default:
+            if (c < 0x20) fprintf(out, "\\u%04x", c);
+            else fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// ===== 执行记录 =====
+
+static char *dup_or_null(const char *s) {
+    return s ? strdup(s) : NULL;
+}
+
+static struct exec_record *trace_append(struct trace_set *set) {
+    if (set->count == set->cap) {
+        size_t cap = set->cap ? set->cap * 2 : 256;
+        struct exec_record *records = realloc(set->records, cap * sizeof(*records));
+        if (!records) return NULL;
+        set->records = records;
+        set->cap = cap;
+    }
+    struct exec_record *rec = &set->records[set->count++];
+    memset(rec, 0, sizeof(*rec));
+    rec->exit_status = -1;
+    return rec;
+}
+
+static void exec_fill_argv(struct exec_record *rec, const struct json_value *argv) {
+    if (!argv || argv->type != JSON_ARRAY) return;
+    rec->argv = calloc(argv->count + 1, sizeof(char *));
+    if (!rec->argv) return;
+    for (size_t i = 0; i < argv->count; i++) {
+        if (argv->items[i].type == JSON_STRING) {
+            rec->argv[rec->argc++] = strdup(argv->items[i].string);
+        }
+    }
+}
+
+// 驻留表中的 ID 还原成字符串，没有 "<key>_id" 时读 "<key>"
+static char *record_str(const struct json_value *v, const char *key,
+                        const struct intern_table *strings, uint32_t *id_out) {
+    char id_key[32];
+    snprintf(id_key, sizeof(id_key), "%s_id", key);
+    const struct json_value *id = json_get(v, id_key);
+    if (id && id->type == JSON_NUMBER && strings) {
+        const char *s = intern_str(strings, (uint32_t)id->integer, NULL);
+        if (s) {
+            *id_out = (uint32_t)id->integer;
+            return strdup(s);
+        }
+    }
+    return dup_or_null(json_get_str(v, key));
+}
+
+static int exec_fill_argv_id(struct exec_record *rec, const struct json_value *ids,
+                             const struct intern_table *strings) {
+    if (!ids || ids->type != JSON_ARRAY || !strings) return -1;
+    rec->argv = calloc(ids->count + 1, sizeof(char *));
+    rec->argv_id = calloc(ids->count + 1, sizeof(uint32_t));
+    if (!rec->argv || !rec->argv_id) return -1;
+    for (size_t i = 0; i < ids->count; i++) {
+        uint32_t id = ids->items[i].type == JSON_NUMBER ? (uint32_t)ids->items[i].integer : 0;
+        const char *s = intern_str(strings, id, NULL);
+        if (!s) continue;
+        rec->argv_id[rec->argc] = id;
+        rec->argv[rec->argc++] = strdup(s);
+    }
+    return 0;
+}
+
+// 会话日志中除 exec 外的事件：进程自己的 exit_record 和 hooktrace 回收子进程的 reap
+struct trace_event {
+    unsigned long pidns;
+    pid_t pid;
+    uint64_t ts;
+    int status;          // reap 事件的 wait 状态，其他为 -1
+    long rec;            // exec 事件对应的记录下标，其他为 -1
+    struct exec_rusage rusage;
+};
+
+struct event_list {
+    struct trace_event *items;
+    size_t count;
+    size_t cap;
+};
+
+static void event_push(struct event_list *list, struct trace_event ev) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 256;
+        struct trace_event *items = realloc(list->items, cap * sizeof(*items));
+        if (!items) return;
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->count++] = ev;
+}
+
+static char *env_entry(const char *key, const char *value) {
+    size_t len = strlen(key) + (value ? strlen(value) + 1 : 0) + 1;
+    char *entry = malloc(len);
+    if (!entry) return NULL;
+    if (value) snprintf(entry, len, "%s=%s", key, value);
+    else snprintf(entry, len, "%s", key);
+    return entry;
+}
+
+static void env_from_json(struct exec_env *env, const struct json_value *v) {
+    if (!v || v->type != JSON_OBJECT) return;
+    env->valid = 1;
+    const struct json_value *full = json_get(v, "full");
+    env->full = full && full->type == JSON_BOOL && full->boolean;
+    const struct json_value *base = json_get(v, "base");
+    env->base_pid = (pid_t)json_get_int(base, "pid", 0);
+    env->base_ts = (uint64_t)json_get_int(base, "ts", 0);
+
+    const struct json_value *set = json_get(v, "set");
+    if (set && set->type == JSON_OBJECT) {
+        env->set = calloc(set->count + 1, sizeof(char *));
+        for (size_t i = 0; env->set && i < set->count; i++) {
+            const char *value = set->items[i].type == JSON_STRING ? set->items[i].string : "";
+            char *entry = env_entry(set->keys[i], value);
+            if (entry) env->set[env->nset++] = entry;
+        }
+    }
+    const struct json_value *unset = json_get(v, "unset");
+    if (unset && unset->type == JSON_ARRAY) {
+        env->unset = calloc(unset->count + 1, sizeof(char *));
+        for (size_t i = 0; env->unset && i < unset->count; i++) {
+            if (unset->items[i].type != JSON_STRING) continue;
+            char *entry = env_entry(unset->items[i].string, NULL);
+            if (entry) env->unset[env->nunset++] = entry;
+        }
+    }
+}
+
+static void rusage_from_json(struct exec_rusage *ru, const struct json_value *v) {
+    if (!json_get(v, "maxrss_kb")) return;
+    ru->valid = 1;
+    ru->utime_us = (long)json_get_int(v, "utime_us", 0);
+    ru->stime_us = (long)json_get_int(v, "stime_us", 0);
+    ru->maxrss_kb = (long)json_get_int(v, "maxrss_kb", 0);
+    ru->minflt = (long)json_get_int(v, "minflt", 0);
+    ru->majflt = (long)json_get_int(v, "majflt", 0);
+    ru->nvcsw = (long)json_get_int(v, "nvcsw", 0);
+    ru->nivcsw = (long)json_get_int(v, "nivcsw", 0);
+}
+
+static void load_record_line(const char *json, size_t len, struct trace_set *set,
+                             struct event_list *events, const struct intern_table *strings) {
+    struct json_value *v = json_parse(json, len);
+    if (!v) return;
+
+    const char *type = json_get_str(v, "type");
+    struct trace_event ev = {
+        .pidns = (unsigned long)json_get_int(v, "pidns", 0),
+        .pid = (pid_t)json_get_int(v, "pid", 0),
+        .ts = (uint64_t)json_get_int(v, "ts", 0),
+        .status = -1,
+        .rec = -1,
+    };
+
+    if (type && strcmp(type, "exec") == 0) {
+        struct exec_record *rec = trace_append(set);
+        if (rec) {
+            rec->pid = ev.pid;
+            rec->ppid = (pid_t)json_get_int(v, "ppid", 0);
+            rec->pidns = ev.pidns;
+            rec->start_ns = ev.ts;
+            rec->fn = dup_or_null(json_get_str(v, "fn"));
+            rec->cwd = record_str(v, "cwd", strings, &rec->cwd_id);
+            rec->path = record_str(v, "path", strings, &rec->path_id);
+            if (exec_fill_argv_id(rec, json_get(v, "argv_id"), strings) != 0) {
+                exec_fill_argv(rec, json_get(v, "argv"));
+            }
+            env_from_json(&rec->env, json_get(v, "env"));
+            ev.rec = (long)(set->count - 1);
+            event_push(events, ev);
+        }
+    } else if (type && (strcmp(type, "exit") == 0 || strcmp(type, "reap") == 0)) {
+        ev.status = (int)json_get_int(v, "status", -1);
+        rusage_from_json(&ev.rusage, v);
+        event_push(events, ev);
+    }
+    json_free(v);
+}
+
+static void load_log_file(const char *path, struct trace_set *set, struct event_list *events,
+                          const struct intern_table *strings) {
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        // 进程日志行: "[PID:123] exec_record: {...}"；reaper.log 直接是 JSON
+        const char *json = line;
+        if (line[0] == '[') {
+            const char *tag = strstr(line, "] ");
+            if (!tag) continue;
+            tag += 2;
+            if (strncmp(tag, "exec_record: ", 13) != 0 && strncmp(tag, "exit_record: ", 13) != 0 &&
+                strncmp(tag, "reap_record: ", 13) != 0) {
+                continue;
+            }
+            json = tag + 13;
+        } else if (line[0] != '{') {
+            continue;
+        }
+        load_record_line(json, (size_t)(line + n - json), set, events, strings);
+    }
+    free(line);
+    fclose(f);
+}
+
+static int event_cmp(const void *a, const void *b) {
+    const struct trace_event *x = a, *y = b;
+    if (x->pidns != y->pidns) return x->pidns < y->pidns ? -1 : 1;
+    if (x->pid != y->pid) return x->pid < y->pid ? -1 : 1;
+    if (x->ts != y->ts) return x->ts < y->ts ? -1 : 1;
+    // 同一时刻 exec 排在退出之前
+    return (x->rec < 0) - (y->rec < 0);
+}
+
+static int record_cmp(const void *a, const void *b) {
+    const struct exec_record *x = a, *y = b;
+    if (x->start_ns != y->start_ns) return x->start_ns < y->start_ns ? -1 : 1;
+    return x->pid - y->pid;
+}
+
+static int is_session_log(const char *name) {
+    if (strcmp(name, "reaper.log") == 0 || strcmp(name, "bpf.log") == 0) return 1;
+    const char *p = name;
+    while (isdigit((unsigned char)*p)) p++;
+    return p != name && strcmp(p, ".log") == 0;
+}
+
+// 只读映射会话的字符串表，不存在或格式不对时返回 NULL
+static const struct intern_table *map_intern_table(const char *session_dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/intern.shm", session_dir);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_size >= INTERN_FILE_SIZE) {
+        p = mmap(NULL, INTERN_FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    const struct intern_table *t = p;
+    if (t->magic != INTERN_MAGIC || t->version != INTERN_VERSION || t->arena_size != INTERN_ARENA_SIZE) {
+        munmap(p, INTERN_FILE_SIZE);
+        return NULL;
+    }
+    return t;
+}
+
+int trace_load_session(const char *session_dir, struct trace_set *set) {
+    memset(set, 0, sizeof(*set));
+    DIR *dir = opendir(session_dir);
+    if (!dir) return -1;
+
+    const struct intern_table *strings = map_intern_table(session_dir);
+    struct event_list events = {0};
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (!is_session_log(ent->d_name)) continue;
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", session_dir, ent->d_name);
+        load_log_file(path, set, &events, strings);
+    }
+    closedir(dir);
+    if (strings) munmap((void *)strings, INTERN_FILE_SIZE);
+
+    // 同一 (pidns, pid) 的事件按时间排列：每个 exec 映像在下一次 exec 或退出时结束。
+    // 回收状态来自 reap 事件，可能晚于进程自己的 exit_record，一直找到下一次 exec 为止
+    if (events.count > 0) {
+        qsort(events.items, events.count, sizeof(events.items[0]), event_cmp);
+    }
+    for (size_t i = 0; i < events.count; i++) {
+        struct trace_event *ev = &events.items[i];
+        if (ev->rec < 0) continue;
+        struct exec_record *rec = &set->records[ev->rec];
+        for (size_t j = i + 1; j < events.count; j++) {
+            struct trace_event *next = &events.items[j];
+            if (next->pidns != ev->pidns || next->pid != ev->pid) break;
+            if (next->rec >= 0) {
+                if (rec->end_ns == 0) rec->end_ns = next->ts;
+                break;
+            }
+            if (rec->end_ns == 0) rec->end_ns = next->ts;
+            if (next->status >= 0) rec->exit_status = next->status;
+            if (next->rusage.valid) rec->rusage = next->rusage;
+        }
+    }
+    free(events.items);
+
+    if (set->count > 0) {
+        qsort(set->records, set->count, sizeof(set->records[0]), record_cmp);
+    }
+    return 0;
+}
+
+static void write_env_key(FILE *out, const char *entry, size_t len) {
+    char key[256];
+    if (len >= sizeof(key)) len = sizeof(key) - 1;
+    memcpy(key, entry, len);
+    key[len] = '\0';
+    json_write_str(out, key);
+}
+
+static void write_env(FILE *out, const struct exec_env *env) {
+    fprintf(out, ",\"env\":{\"full\":%s,\"base\":{\"pid\":%d,\"ts\":%lu},\"set\":{",
+            env->full ? "true" : "false", env->base_pid, (unsigned long)env->base_ts);
+    for (int i = 0; i < env->nset; i++) {
+        const char *eq = strchr(env->set[i], '=');
+        size_t klen = eq ? (size_t)(eq - env->set[i]) : strlen(env->set[i]);
+        if (i) fputc(',', out);
+        write_env_key(out, env->set[i], klen);
+        fputc(':', out);
+        json_write_str(out, eq ? eq + 1 : "");
+    }
+    fputs("},\"unset\":[", out);
+    for (int i = 0; i < env->nunset; i++) {
+        if (i) fputc(',', out);
+        json_write_str(out, env->unset[i]);
+    }
+    fputs("]}", out);
+}
+
+int trace_write_records(const char *path, const struct trace_set *set) {
+    FILE *out = trace_sink_fopen(path);
+    if (!out) return -1;
+
+    for (size_t i = 0; i < set->count; i++) {
+        const struct exec_record *rec = &set->records[i];
+        fprintf(out, "{\"pid\":%d,\"ppid\":%d,\"pidns\":%lu,\"start\":%lu,\"end\":%lu,\"status\":%d,\"fn\":",
+                rec->pid, rec->ppid, rec->pidns, (unsigned long)rec->start_ns,
+                (unsigned long)rec->end_ns, rec->exit_status);
+        json_write_str(out, rec->fn);
+        fputs(",\"cwd\":", out);
+        json_write_str(out, rec->cwd);
+        fputs(",\"path\":", out);
+        json_write_str(out, rec->path);
+        fputs(",\"argv\":[", out);
+        for (int a = 0; a < rec->argc; a++) {
+            if (a) fputc(',', out);
+            json_write_str(out, rec->argv[a]);
+        }
+        fputc(']', out);
+        if (rec->env.valid) write_env(out, &rec->env);
+        if (rec->rusage.valid) {
+            const struct exec_rusage *ru = &rec->rusage;
+            fprintf(out, ",\"rusage\":{\"utime_us\":%ld,\"stime_us\":%ld,\"maxrss_kb\":%ld,"
+                    "\"minflt\":%ld,\"majflt\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld}",
+                    ru->utime_us, ru->stime_us, ru->maxrss_kb, ru->minflt, ru->majflt,
+                    ru->nvcsw, ru->nivcsw);
+        }
+        fputs("}\n", out);
+    }
+    return fclose(out);
+}
+
+static void record_from_json(const struct json_value *v, struct exec_record *rec) {
+    rec->pid = (pid_t)json_get_int(v, "pid", 0);
+    rec->ppid = (pid_t)json_get_int(v, "ppid", 0);
+    rec->pidns = (unsigned long)json_get_int(v, "pidns", 0);
+    rec->start_ns = (uint64_t)json_get_int(v, "start", 0);
+    rec->end_ns = (uint64_t)json_get_int(v, "end", 0);
+    rec->exit_status = (int)json_get_int(v, "status", -1);
+    rec->fn = dup_or_null(json_get_str(v, "fn"));
+    rec->cwd = dup_or_null(json_get_str(v, "cwd"));
+    rec->path = dup_or_null(json_get_str(v, "path"));
+    exec_fill_argv(rec, json_get(v, "argv"));
+    rusage_from_json(&rec->rusage, json_get(v, "rusage"));
+    env_from_json(&rec->env, json_get(v, "env"));
+}
+
+int trace_parse_record(const char *line, size_t len, struct exec_record *rec) {
+    memset(rec, 0, sizeof(*rec));
+    struct json_value *v = json_parse(line, len);
+    if (!v) return -1;
+    record_from_json(v, rec);
+    json_free(v);
+    return 0;
+}
+
+int trace_load_records(const char *path, struct trace_set *set) {
+    memset(set, 0, sizeof(*set));
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        struct json_value *v = json_parse(line, (size_t)n);
+        if (!v) continue;
+        struct exec_record *rec = trace_append(set);
+        if (rec) record_from_json(v, rec);
+        json_free(v);
+    }
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+void trace_record_free(struct exec_record *rec) {
+    free(rec->fn);
+    free(rec->cwd);
+    free(rec->path);
+    for (int a = 0; a < rec->argc; a++) free(rec->argv[a]);
+    free(rec->argv);
+    free(rec->argv_id);
+    for (int e = 0; e < rec->env.nset; e++) free(rec->env.set[e]);
+    for (int e = 0; e < rec->env.nunset; e++) free(rec->env.unset[e]);
+    free(rec->env.set);
+    free(rec->env.unset);
+    memset(rec, 0, sizeof(*rec));
+}
+
+void trace_free(struct trace_set *set) {
+    for (size_t i = 0; i < set->count; i++) trace_record_free(&set->records[i]);
+    free(set->records);
+    free(set->by_pid);
+    memset(set, 0, sizeof(*set));
+}
+
+// ===== 环境重建 =====
+
+static const struct trace_set *pid_sort_set;   // qsort 比较函数用
+
+static int by_pid_cmp(const void *a, const void *b) {
+    const struct exec_record *x = &pid_sort_set->records[*(const size_t *)a];
+    const struct exec_record *y = &pid_sort_set->records[*(const size_t *)b];
+    if (x->pidns != y->pidns) return x->pidns < y->pidns ? -1 : 1;
+    if (x->pid != y->pid) return x->pid < y->pid ? -1 : 1;
+    if (x->start_ns != y->start_ns) return x->start_ns < y->start_ns ? -1 : 1;
+    return 0;
+}
+
+static int build_pid_index(struct trace_set *set) {
+    if (set->by_pid) return 0;
+    set->by_pid = malloc((set->count + 1) * sizeof(size_t));
+    if (!set->by_pid) return -1;
+    for (size_t i = 0; i < set->count; i++) set->by_pid[i] = i;
+    pid_sort_set = set;
+    qsort(set->by_pid, set->count, sizeof(size_t), by_pid_cmp);
+    return 0;
+}
+
+// (pidns, pid) 中 start_ns <= ts 的最后一条记录，没有则返回 -1
+static long find_base(const struct trace_set *set, unsigned long pidns, pid_t pid, uint64_t ts) {
+    size_t lo = 0, hi = set->count;
+    while (lo < hi) {   // 第一个 > (pidns, pid, ts) 的位置
+        size_t mid = (lo + hi) / 2;
+        const struct exec_record *r = &set->records[set->by_pid[mid]];
+        int le = r->pidns < pidns || (r->pidns == pidns &&
+                 (r->pid < pid || (r->pid == pid && r->start_ns <= ts)));
+        if (le) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo > 0) {
+        const struct exec_record *r = &set->records[set->by_pid[lo - 1]];
+        if (r->pidns == pidns && r->pid == pid) return (long)set->by_pid[lo - 1];
+    }
+    // posix_spawn 的记录由父进程在返回后写出，可能晚于子进程自己的快照时间；
+    // 此时该 pid 没有更早的映像，取它的第一条记录
+    if (lo < set->count) {
+        const struct exec_record *r = &set->records[set->by_pid[lo]];
+        if (r->pidns == pidns && r->pid == pid) return (long)set->by_pid[lo];
+    }
+    return -1;
+}
+
+static int env_find(char **env, int n, const char *key, size_t klen) {
+    for (int i = 0; i < n; i++) {
+        if (strncmp(env[i], key, klen) == 0 && (env[i][klen] == '=' || env[i][klen] == '\0')) return i;
+    }
+    return -1;
+}
+
+#define ENV_CHAIN_MAX 256
+
+char **trace_exec_env(struct trace_set *set, size_t idx) {
+    if (idx >= set->count || build_pid_index(set) != 0) return NULL;
+
+    // 从当前记录沿 base 向上，直到完整环境
+    size_t chain[ENV_CHAIN_MAX];
+    int depth = 0;
+    long cur = (long)idx;
+    for (;;) {
+        const struct exec_record *rec = &set->records[cur];
+        if (!rec->env.valid || depth == ENV_CHAIN_MAX) return NULL;
+        chain[depth++] = (size_t)cur;
+        if (rec->env.full) break;
+        long base = find_base(set, rec->pidns, rec->env.base_pid, rec->env.base_ts);
+        if (base < 0 || base == cur) return NULL;
+        cur = base;
+    }
+
+    // 从根开始依次应用增量
+    int cap = 64, n = 0;
+    char **env = malloc((size_t)cap * sizeof(char *));
+    if (!env) return NULL;
+    for (int d = depth - 1; d >= 0; d--) {
+        const struct exec_env *delta = &set->records[chain[d]].env;
+        for (int u = 0; u < delta->nunset; u++) {
+            int at = env_find(env, n, delta->unset[u], strlen(delta->unset[u]));
+            if (at >= 0) {
+                free(env[at]);
+                env[at] = env[--n];
+            }
+        }
+        for (int k = 0; k < delta->nset; k++) {
+            const char *entry = delta->set[k];
+            const char *eq = strchr(entry, '=');
+            size_t klen = eq ? (size_t)(eq - entry) : strlen(entry);
+            int at = env_find(env, n, entry, klen);
+            char *copy = strdup(entry);
+            if (!copy) continue;
+            if (at >= 0) {
+                free(env[at]);
+                env[at] = copy;
+                continue;
+            }
+            if (n + 1 >= cap) {
+                cap *= 2;
+                char **grown = realloc(env, (size_t)cap * sizeof(char *));
+                if (!grown) {
+                    free(copy);
+                    continue;
+                }
+                env = grown;
+            }
+            env[n++] = copy;
+        }
+    }
+    env[n] = NULL;
+    return env;
+}
+
+void trace_env_free(char **env) {
+    if (!env) return;
+    for (char **e = env; *e; e++) free(*e);
+    free(env);
+}
+
+// ===== 辅助函数 =====
+
+const char *exec_output_arg(const struct exec_record *rec) {
+    for (int i = 0; i < rec->argc; i++) {
+        if (strcmp(rec->argv[i], "-o") == 0 && i + 1 < rec->argc) return rec->argv[i + 1];
+        if (strncmp(rec->argv[i], "-o", 2) == 0 && rec->argv[i][2]) return rec->argv[i] + 2;
+    }
+    return NULL;
+}
+
+const char *exec_basename(const struct exec_record *rec) {
+    const char *name = rec->argc > 0 ? rec->argv[0] : rec->path;
+    if (!name) return "";
+    const char *slash = strrchr(name, '/');
+    return slash ? slash + 1 : name;
+}
+
+int exec_is_compiler(const struct exec_record *rec) {
+    char name[256];
+    snprintf(name, sizeof(name), "%s", exec_basename(rec));
+
+    // 去掉版本后缀，如 gcc-12、clang++-17
+    char *dash = strrchr(name, '-');
+    if (dash && dash[1] && strspn(dash + 1, "0123456789.") == strlen(dash + 1)) *dash = '\0';
+
+    static const char *const drivers[] = {"gcc", "g++", "cc", "c++", "clang", "clang++"};
+    size_t len = strlen(name);
+    for (size_t i = 0; i < sizeof(drivers) / sizeof(drivers[0]); i++) {
+        size_t dl = strlen(drivers[i]);
+        if (len < dl || strcmp(name + len - dl, drivers[i]) != 0) continue;
+        // 允许交叉编译前缀，如 x86_64-linux-gnu-gcc
+        if (len == dl || name[len - dl - 1] == '-') return 1;
+    }
+    return 0;
+}
+
+int exec_is_source_arg(const char *arg) {
+    if (arg[0] == '-') return 0;
+    const char *dot = strrchr(arg, '.');
+    if (!dot) return 0;
+    static const char *const exts[] = {".c", ".cc", ".cp", ".cpp", ".cxx", ".c++", ".C",
+                                       ".m", ".mm", ".S"};
+    for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+        if (strcmp(dot, exts[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+int exec_next_source(const struct exec_record *rec, int from) {
+    static const char *const takes_value[] = {"-o", "-MF", "-MT", "-MQ", "-x", "-include", "-imacros"};
+    for (int a = from < 1 ? 1 : from; a < rec->argc; a++) {
+        int is_value = 0;
+        for (size_t k = 0; k < sizeof(takes_value) / sizeof(takes_value[0]); k++) {
+            if (strcmp(rec->argv[a - 1], takes_value[k]) == 0) is_value = 1;
+        }
+        if (!is_value && exec_is_source_arg(rec->argv[a])) return a;
+    }
+    return -1;
+}
+
+int exec_is_compile(const struct exec_record *rec) {
+    if (!exec_is_compiler(rec)) return 0;
+    for (int a = 1; a < rec->argc; a++) {
+        if (strcmp(rec->argv[a], "-E") == 0 || strcmp(rec->argv[a], "-M") == 0 ||
+            strcmp(rec->argv[a], "-MM") == 0) {
+            return 0;
+        }
+    }
+    return exec_next_source(rec, 1) > 0;
+}
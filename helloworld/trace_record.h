@@ -0,0 +1,119 @@
+/* trace_record.h
+ * hooktrace 各子命令共用的追踪记录读取：一个只覆盖记录格式所需的小型 JSON 解析器，
+ * 以及把会话目录中各进程日志里的 exec_record/exit_record 合并成按进程的执行记录。
+ */
+
+#ifndef TRACE_RECORD_H
+#define TRACE_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// ===== JSON =====
+
+enum json_type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+struct json_value {
+    enum json_type type;
+    int boolean;
+    double number;
+    long long integer;           // 整数形式的数字(时间戳等超过 double 精度的值)
+    char *string;
+    struct json_value *items;    // 数组元素 / 对象的值
+    char **keys;                 // 对象的键
+    size_t count;
+};
+
+// 解析失败返回 NULL
+struct json_value *json_parse(const char *text, size_t len);
+void json_free(struct json_value *v);
+
+const struct json_value *json_get(const struct json_value *obj, const char *key);
+const char *json_get_str(const struct json_value *obj, const char *key);
+long long json_get_int(const struct json_value *obj, const char *key, long long def);
+
+// 输出带引号并转义的 JSON 字符串
+void json_write_str(FILE *out, const char *s);
+
+// ===== 执行记录 =====
+
+// 一次程序执行：exec 系列调用或 posix_spawn 产生的新映像，加上它的结束信息
+struct exec_record {
+    pid_t pid;
+    pid_t ppid;
+    unsigned long pidns;
+    uint64_t start_ns;           // exec 时刻(CLOCK_MONOTONIC)
+    uint64_t end_ns;             // 进程退出或被回收的时刻，0 表示未知
+    int exit_status;             // wait 状态，-1 表示未知
+    struct exec_rusage {         // 父进程回收时的资源占用，包含该进程已回收的后代
+        int valid;
+        long utime_us, stime_us;
+        long maxrss_kb;
+        long minflt, majflt;
+        long nvcsw, nivcsw;
+    } rusage;
+    char *fn;                    // execve / execvp / posix_spawn ...
+    char *cwd;
+    char *path;
+    char **argv;
+    int argc;
+    // hooktrace run --intern 时字符串在会话字符串表(intern.h)中的 ID，0 表示没有；
+    // 同一次构建里相同的字符串 ID 相同，分组时可以直接比较整数。records.jsonl 不保存
+    uint32_t cwd_id;
+    uint32_t path_id;
+    uint32_t *argv_id;           // argc 个，或 NULL
+    struct exec_env {            // 环境变量：相对基准映像的增量，或完整环境(full)
+        int valid;
+        int full;
+        pid_t base_pid;          // 基准映像：同一 pidns 中该 pid 在 base_ts 之前最近的 exec 记录
+        uint64_t base_ts;
+        char **set;              // "K=V"
+        int nset;
+        char **unset;            // "K"
+        int nunset;
+    } env;
+};
+
+struct trace_set {
+    struct exec_record *records;
+    size_t count;
+    size_t cap;
+    size_t *by_pid;              // 按 (pidns, pid, start_ns) 排序的下标，查找环境基准时建立
+};
+
+// 读取会话目录下所有 <pid>.log 和 reaper.log，合并成按开始时间排序的执行记录。
+// 会话目录里有 intern.shm 时，记录中的 cwd_id/path_id/argv_id 用它还原成字符串。
+// 退出/回收事件按 (pidns, pid) 关联到该进程最近一次 exec，不同 PID 命名空间的同号进程不会混淆
+int trace_load_session(const char *session_dir, struct trace_set *set);
+
+// 读取 hooktrace 输出的 records.jsonl
+int trace_load_records(const char *path, struct trace_set *set);
+int trace_write_records(const char *path, const struct trace_set *set);
+
+void trace_free(struct trace_set *set);
+
+// 解析 records.jsonl 中的一行，用 trace_record_free 释放
+int trace_parse_record(const char *line, size_t len, struct exec_record *rec);
+void trace_record_free(struct exec_record *rec);
+
+// 重建第 idx 条记录启动的程序的完整环境("K=V" 数组，NULL 结尾)，用 trace_env_free 释放。
+// 沿 base 链一直找到完整环境的根记录；链条中断(基准记录缺失)时返回 NULL
+char **trace_exec_env(struct trace_set *set, size_t idx);
+void trace_env_free(char **env);
+
+// 辅助：argv 中 -o 的参数，没有则返回 NULL
+const char *exec_output_arg(const struct exec_record *rec);
+// 程序名(argv[0] 或 path 的最后一段)
+const char *exec_basename(const struct exec_record *rec);
+// 是否为编译器驱动(gcc/g++/cc/c++/clang/clang++ 及其带前后缀的变体)
+int exec_is_compiler(const struct exec_record *rec);
+// 命令行参数是否为源文件(按扩展名判断)
+int exec_is_source_arg(const char *arg);
+// 从 argv[from] 起下一个源文件参数的下标(跳过 -o/-MF 等选项的值)，没有则返回 -1
+int exec_next_source(const struct exec_record *rec, int from);
+// 是否为产生目标文件的编译：编译器驱动、带源文件、不是 -E/-M 这类只做预处理的调用
+int exec_is_compile(const struct exec_record *rec);
+
+#endif
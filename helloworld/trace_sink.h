@@ -0,0 +1,40 @@
+/* trace_sink.h
+ * 启动器写大文件(bpf.log、records.jsonl、compile_commands.json)用的输出通道：
+ * 数据先进入几块大缓冲区，写满一块就整块提交。优先用 io_uring(注册缓冲区 + 注册文件的
+ * WRITE_FIXED，同时在途的写不超过缓冲区数)，内核不支持或被禁用时退回 pwritev，
+ * 攒满所有缓冲区后一次写出。
+ *
+ * 环境变量 HOOKTRACE_SINK=pwritev 强制使用 pwritev。
+ */
+
+#ifndef TRACE_SINK_H
+#define TRACE_SINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum trace_sink_mode { SINK_AUTO, SINK_URING, SINK_PWRITEV };
+
+struct trace_sink;
+
+struct trace_sink_stats {
+    const char *backend;         // "io_uring" / "pwritev"
+    uint64_t bytes;
+    uint64_t syscalls;           // io_uring_enter 或 pwritev 的次数
+    uint32_t max_inflight;
+};
+
+// 截断或创建 path。SINK_URING 时 io_uring 不可用返回 NULL，SINK_AUTO 时自动退回 pwritev
+struct trace_sink *trace_sink_open(const char *path, enum trace_sink_mode mode);
+int trace_sink_write(struct trace_sink *s, const void *data, size_t len);
+// 写出剩余数据并关闭；任何一次写失败都返回 -1。stats 可以为 NULL
+int trace_sink_close(struct trace_sink *s, struct trace_sink_stats *stats);
+
+// 以 trace_sink 为后端的 FILE*，供 fprintf/json_write_str 这类代码直接使用；fclose 时写完
+FILE *trace_sink_fopen(const char *path);
+
+// hooktrace bench-sink：比较逐行 write、pwritev 和 io_uring 的吞吐与 CPU
+int cmd_bench_sink(int argc, char **argv);
+
+#endif
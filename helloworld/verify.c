@@ -0,0 +1,712 @@
+/* verify.c
+ * hooktrace verify 的比较部分。两边的事件先归一化成 (类别, 键, 进程号)：
+ *   exec    程序名(路径的最后一段)   hook 库: exec_record          strace: 成功的 execve/execveat
+ *   spawn   子进程号                 hook 库: fork、posix_spawn    strace: clone/clone3/fork/vfork(不含线程)
+ *   open    路径                     hook 库: open/openat          strace: open/openat/openat2/creat
+ *   access  路径                     hook 库: access               strace: access/faccessat/faccessat2
+ *   unlink  路径                     hook 库: unlink               strace: unlink/unlinkat(不含删目录)
+ *   wait    子进程号                 hook 库: reap_record          strace: wait4/waitid 回收到子进程
+ *   exit    -                        hook 库: exit_record          strace: +++ exited/killed +++
+ * 然后两边各自按 (类别, 键的哈希, 键, 进程号) 排序，按组归并：
+ *   同一进程两边都有        匹配；hook 库多出来的算重复，strace 多出来的待定
+ *   只有 hook 库有的进程    与同组中 strace 待定的事件配对，算归属错误，配不上的算多余
+ *   剩下的 strace 事件      遗漏；动态加载器和 hook 库自身的文件访问单独算作预期遗漏
+ * strace 进程本身(会话的根进程)也加载了 hook 库，它的事件不参与比较。
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <limits.h>
+
+#include "verify.h"
+#include "trace_record.h"
+
+enum verify_kind { VK_EXEC, VK_SPAWN, VK_OPEN, VK_ACCESS, VK_UNLINK, VK_WAIT, VK_EXIT, VK_COUNT };
+
+static const char *const kind_names[VK_COUNT] = {
+    "exec", "spawn", "open", "access", "unlink", "wait", "exit",
+};
+
+enum verify_result { VR_MATCHED, VR_MISSED, VR_DUP, VR_MISATTR, VR_EXTRA, VR_EXPECTED, VR_COUNT };
+
+static const char *const result_keys[VR_COUNT] = {
+    "matched", "missed", "duplicated", "misattributed", "extra", "expected",
+};
+static const char *const result_names[VR_COUNT] = {
+    "匹配", "遗漏", "重复", "归属错误", "多余", "预期遗漏",
+};
+
+struct vevent {
+    uint64_t hash;
+    size_t key;                  // 键在 arena 中的偏移
+    pid_t pid;
+    uint8_t kind;
+    uint8_t hook;                // hook 库一侧的 hook 名下标
+    uint8_t result;
+};
+
+struct vside {
+    struct vevent *items;
+    size_t count, cap;
+};
+
+#define VERIFY_MAX_HOOKS 64
+#define VERIFY_MAX_OTHER 128
+
+struct verify_state {
+    char *arena;
+    size_t arena_len, arena_cap;
+    struct vside preload, strace;
+    char hooks[VERIFY_MAX_HOOKS][24];
+    int nhooks;
+    // strace 中没有比较的系统调用(stat、readlink、chdir 等)，只统计次数
+    char other[VERIFY_MAX_OTHER][24];
+    unsigned long other_count[VERIFY_MAX_OTHER];
+    int nother;
+    const char *session_dir;
+    pid_t exclude_pid;
+    unsigned long strace_lines, strace_unparsed;
+};
+
+static const char *key_of(const struct verify_state *vs, const struct vevent *e) {
+    return vs->arena + e->key;
+}
+
+static uint64_t key_hash(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static int add_event(struct verify_state *vs, struct vside *side, int kind, pid_t pid,
+                     const char *key, size_t len, int hook) {
+    if (side->count == side->cap) {
+        size_t cap = side->cap ? side->cap * 2 : 4096;
+        struct vevent *items = realloc(side->items, cap * sizeof(*items));
+        if (!items) return -1;
+        side->items = items;
+        side->cap = cap;
+    }
+    if (vs->arena_len + len + 1 > vs->arena_cap) {
+        size_t cap = vs->arena_cap ? vs->arena_cap * 2 : 1 << 20;
+        while (cap < vs->arena_len + len + 1) cap *= 2;
+        char *arena = realloc(vs->arena, cap);
+        if (!arena) return -1;
+        vs->arena = arena;
+        vs->arena_cap = cap;
+    }
+    struct vevent *e = &side->items[side->count++];
+    e->hash = key_hash(key, len);
+    e->key = vs->arena_len;
+    e->pid = pid;
+    e->kind = (uint8_t)kind;
+    e->hook = (uint8_t)hook;
+    e->result = VR_MATCHED;
+    memcpy(vs->arena + vs->arena_len, key, len);
+    vs->arena[vs->arena_len + len] = '\0';
+    vs->arena_len += len + 1;
+    return 0;
+}
+
+static int hook_index(struct verify_state *vs, const char *name) {
+    for (int i = 0; i < vs->nhooks; i++) {
+        if (strcmp(vs->hooks[i], name) == 0) return i;
+    }
+    if (vs->nhooks == VERIFY_MAX_HOOKS) return VERIFY_MAX_HOOKS - 1;
+    snprintf(vs->hooks[vs->nhooks], sizeof(vs->hooks[0]), "%s", name);
+    return vs->nhooks++;
+}
+
+static void count_other(struct verify_state *vs, const char *name, size_t len) {
+    if (len >= sizeof(vs->other[0])) len = sizeof(vs->other[0]) - 1;
+    for (int i = 0; i < vs->nother; i++) {
+        if (strncmp(vs->other[i], name, len) == 0 && vs->other[i][len] == '\0') {
+            vs->other_count[i]++;
+            return;
+        }
+    }
+    if (vs->nother == VERIFY_MAX_OTHER) return;
+    memcpy(vs->other[vs->nother], name, len);
+    vs->other[vs->nother][len] = '\0';
+    vs->other_count[vs->nother++] = 1;
+}
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// ===== hook 库日志 =====
+
+static void add_pid_key(struct verify_state *vs, struct vside *side, int kind, pid_t pid,
+                        long key, int hook) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%ld", key);
+    add_event(vs, side, kind, pid, buf, (size_t)len, hook);
+}
+
+static void load_json_record(struct verify_state *vs, pid_t line_pid, const char *tag,
+                             const char *json, size_t len) {
+    struct json_value *v = json_parse(json, len);
+    if (!v) return;
+    pid_t pid = (pid_t)json_get_int(v, "pid", line_pid);
+    pid_t ppid = (pid_t)json_get_int(v, "ppid", 0);
+    const char *fn = json_get_str(v, "fn");
+
+    if (strcmp(tag, "exec_record") == 0) {
+        const char *path = json_get_str(v, "path");
+        int hook = hook_index(vs, fn ? fn : "exec");
+        if (path && pid != vs->exclude_pid) {
+            const char *name = base_name(path);
+            add_event(vs, &vs->preload, VK_EXEC, pid, name, strlen(name), hook);
+        }
+        // posix_spawn 的记录由父进程写出，同时说明父进程创建了这个子进程
+        if (fn && strcmp(fn, "posix_spawn") == 0 && ppid != vs->exclude_pid) {
+            add_pid_key(vs, &vs->preload, VK_SPAWN, ppid, pid, hook);
+        }
+    } else if (strcmp(tag, "exit_record") == 0) {
+        if (pid != vs->exclude_pid) {
+            add_event(vs, &vs->preload, VK_EXIT, pid, "", 0, hook_index(vs, "exit_record"));
+        }
+    } else if (strcmp(tag, "reap_record") == 0) {
+        if (ppid != vs->exclude_pid) {
+            add_pid_key(vs, &vs->preload, VK_WAIT, ppid, pid, hook_index(vs, fn ? fn : "wait"));
+        }
+    }
+    json_free(v);
+}
+
+// details 形如 "打开文件 'PATH', 标志:..."，取 prefix 与 suffix 之间的路径；
+// 路径里可能有引号，suffix 取最后一次出现的位置
+static void add_quoted(struct verify_state *vs, int kind, pid_t pid, const char *details,
+                       const char *prefix, const char *suffix, int hook) {
+    const char *start = strstr(details, prefix);
+    if (!start) return;
+    start += strlen(prefix);
+    const char *end = NULL;
+    for (const char *p = start; (p = strstr(p, suffix)) != NULL; p++) end = p;
+    if (!end) return;
+    add_event(vs, &vs->preload, kind, pid, start, (size_t)(end - start), hook);
+}
+
+static void load_preload_line(struct verify_state *vs, char *line, size_t len) {
+    // "[PID:123] name: details"
+    if (strncmp(line, "[PID:", 5) != 0) return;
+    char *end;
+    pid_t pid = (pid_t)strtol(line + 5, &end, 10);
+    if (strncmp(end, "] ", 2) != 0) return;
+    char *tag = end + 2;
+    char *colon = strstr(tag, ": ");
+    if (!colon) return;
+    *colon = '\0';
+    char *details = colon + 2;
+    if (len > 0 && line[len - 1] == '\n') line[--len] = '\0';
+
+    if (strcmp(tag, "exec_record") == 0 || strcmp(tag, "exit_record") == 0 ||
+        strcmp(tag, "reap_record") == 0) {
+        load_json_record(vs, pid, tag, details, (size_t)(line + len - details));
+        return;
+    }
+    if (pid == vs->exclude_pid) return;
+    if (strcmp(tag, "open") == 0 || strcmp(tag, "openat") == 0) {
+        add_quoted(vs, VK_OPEN, pid, details, "打开文件 '", "', 标志:", hook_index(vs, tag));
+    } else if (strcmp(tag, "access") == 0) {
+        add_quoted(vs, VK_ACCESS, pid, details, "检查文件 '", "', 模式:", hook_index(vs, tag));
+    } else if (strcmp(tag, "unlink") == 0) {
+        add_quoted(vs, VK_UNLINK, pid, details, "删除文件 '", "', 结果=", hook_index(vs, tag));
+    } else if (strcmp(tag, "fork") == 0) {
+        const char *child = strstr(details, "子进程PID = ");
+        if (child) {
+            add_pid_key(vs, &vs->preload, VK_SPAWN, pid, atol(child + strlen("子进程PID = ")),
+                        hook_index(vs, "fork"));
+        }
+    }
+}
+
+static int is_process_log(const char *name) {
+    const char *p = name;
+    while (isdigit((unsigned char)*p)) p++;
+    return p != name && strcmp(p, ".log") == 0;
+}
+
+static int load_preload(struct verify_state *vs) {
+    DIR *dir = opendir(vs->session_dir);
+    if (!dir) return -1;
+    char *line = NULL;
+    size_t cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (!is_process_log(ent->d_name)) continue;
+        char path[PATH_MAX + 256];
+        snprintf(path, sizeof(path), "%s/%s", vs->session_dir, ent->d_name);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        ssize_t n;
+        while ((n = getline(&line, &cap, f)) > 0) load_preload_line(vs, line, (size_t)n);
+        fclose(f);
+    }
+    free(line);
+    closedir(dir);
+    return 0;
+}
+
+// 会话的根进程(这里是 strace 本身)，由启动器写在 reaper.log 的第一条 exec 记录里
+static pid_t session_root_pid(const char *session_dir) {
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/reaper.log", session_dir);
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+    pid_t pid = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while (pid == 0 && (n = getline(&line, &cap, f)) > 0) {
+        if (!strstr(line, "\"fn\":\"hooktrace\"")) continue;
+        struct json_value *v = json_parse(line, (size_t)n);
+        if (v) pid = (pid_t)json_get_int(v, "pid", 0);
+        json_free(v);
+    }
+    free(line);
+    fclose(f);
+    return pid;
+}
+
+// ===== strace 输出 =====
+
+// 解码 strace 的 C 风格字符串，s 指向开头的引号；返回解码后的长度，失败返回 -1
+static long strace_string(const char *s, char *out, size_t cap) {
+    if (*s++ != '"') return -1;
+    size_t n = 0;
+    while (*s && *s != '"') {
+        int c = (unsigned char)*s++;
+        if (c == '\\' && *s) {
+            c = (unsigned char)*s++;
+            switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'v': c = '\v'; break;
+            case 'f': c = '\f'; break;
+            case 'x': {
+                int v = 0;
+                for (int i = 0; i < 2 && isxdigit((unsigned char)*s); i++, s++) {
+                    v = v * 16 + (isdigit((unsigned char)*s) ? *s - '0' : (tolower((unsigned char)*s) - 'a' + 10));
+                }
+                c = v;
+                break;
+            }
+            default:
+                if (c >= '0' && c <= '7') {
+                    int v = c - '0';
+                    for (int i = 0; i < 2 && *s >= '0' && *s <= '7'; i++) v = v * 8 + (*s++ - '0');
+                    c = v;
+                }
+                break;
+            }
+        }
+        if (n + 1 < cap) out[n++] = (char)c;
+    }
+    if (*s != '"') return -1;
+    out[n] = '\0';
+    return (long)n;
+}
+
+// 第一个字符串参数
+static long first_string_arg(const char *args, char *out, size_t cap) {
+    const char *q = strchr(args, '"');
+    return q ? strace_string(q, out, cap) : -1;
+}
+
+static int name_is(const char *name, size_t len, const char *what) {
+    return strlen(what) == len && strncmp(name, what, len) == 0;
+}
+
+// 一条完整的系统调用："name(args) = ret ..."
+static void strace_syscall(struct verify_state *vs, pid_t pid, const char *text) {
+    const char *paren = strchr(text, '(');
+    if (!paren) {
+        vs->strace_unparsed++;
+        return;
+    }
+    const char *name = text;
+    size_t nlen = (size_t)(paren - text);
+    const char *ret = NULL;
+    for (const char *p = paren; (p = strstr(p, ") = ")) != NULL; p++) ret = p;
+    if (!ret) {
+        vs->strace_unparsed++;   // 例如 exit_group(0) = ?
+        return;
+    }
+    const char *args = paren + 1;
+    long result = strtol(ret + 4, NULL, 10);
+    char path[PATH_MAX];
+
+    if (name_is(name, nlen, "execve") || name_is(name, nlen, "execveat")) {
+        // execvp 在 PATH 中逐个尝试，只有成功的那次才是真正的执行
+        if (result == 0 && first_string_arg(args, path, sizeof(path)) >= 0) {
+            const char *base = base_name(path);
+            add_event(vs, &vs->strace, VK_EXEC, pid, base, strlen(base), 0);
+        }
+    } else if (name_is(name, nlen, "clone") || name_is(name, nlen, "clone3") ||
+               name_is(name, nlen, "fork") || name_is(name, nlen, "vfork")) {
+        int thread = memmem(args, (size_t)(ret - args), "CLONE_THREAD", 12) != NULL;
+        if (result > 0 && !thread) add_pid_key(vs, &vs->strace, VK_SPAWN, pid, result, 0);
+    } else if (name_is(name, nlen, "open") || name_is(name, nlen, "openat") ||
+               name_is(name, nlen, "openat2") || name_is(name, nlen, "creat")) {
+        long len = first_string_arg(args, path, sizeof(path));
+        if (len >= 0) add_event(vs, &vs->strace, VK_OPEN, pid, path, (size_t)len, 0);
+    } else if (name_is(name, nlen, "access") || name_is(name, nlen, "faccessat") ||
+               name_is(name, nlen, "faccessat2")) {
+        long len = first_string_arg(args, path, sizeof(path));
+        if (len >= 0) add_event(vs, &vs->strace, VK_ACCESS, pid, path, (size_t)len, 0);
+    } else if (name_is(name, nlen, "unlink") || name_is(name, nlen, "unlinkat")) {
+        long len = first_string_arg(args, path, sizeof(path));
+        if (len >= 0 && !strstr(args, "AT_REMOVEDIR")) {
+            add_event(vs, &vs->strace, VK_UNLINK, pid, path, (size_t)len, 0);
+        }
+    } else if (name_is(name, nlen, "wait4")) {
+        if (result > 0) add_pid_key(vs, &vs->strace, VK_WAIT, pid, result, 0);
+    } else if (name_is(name, nlen, "waitid")) {
+        const char *si = strstr(args, "si_pid=");
+        if (result == 0 && si) add_pid_key(vs, &vs->strace, VK_WAIT, pid, atol(si + 7), 0);
+    } else {
+        count_other(vs, name, nlen);
+    }
+}
+
+// strace -f 输出中被其他进程打断的调用分成两行：
+//   123 openat(AT_FDCWD, "x", O_RDONLY <unfinished ...>
+//   123 <... openat resumed>) = 3
+// 按进程号暂存前半行，遇到 resumed 时拼接
+struct pending_call {
+    pid_t pid;
+    char *text;
+};
+
+static int load_strace(struct verify_state *vs, const char *strace_log) {
+    FILE *f = fopen(strace_log, "r");
+    if (!f) return -1;
+
+    struct pending_call *pending = NULL;
+    size_t npending = 0, pending_cap = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        vs->strace_lines++;
+        if (line[n - 1] == '\n') line[--n] = '\0';
+        char *text;
+        pid_t pid = (pid_t)strtol(line, &text, 10);
+        if (text == line) continue;
+        while (*text == ' ') text++;
+
+        if (strncmp(text, "+++ exited with", 15) == 0 || strncmp(text, "+++ killed by", 13) == 0) {
+            add_event(vs, &vs->strace, VK_EXIT, pid, "", 0, 0);
+            continue;
+        }
+        if (text[0] == '-' || text[0] == '+') continue;   // 信号等
+
+        size_t tlen = strlen(text);
+        static const char unfinished[] = " <unfinished ...>";
+        size_t ulen = sizeof(unfinished) - 1;
+        if (tlen >= ulen && strcmp(text + tlen - ulen, unfinished) == 0) {
+            if (npending == pending_cap) {
+                pending_cap = pending_cap ? pending_cap * 2 : 64;
+                struct pending_call *p = realloc(pending, pending_cap * sizeof(*p));
+                if (!p) break;
+                pending = p;
+            }
+            pending[npending].pid = pid;
+            pending[npending].text = strndup(text, tlen - ulen);
+            if (pending[npending].text) npending++;
+            continue;
+        }
+        if (strncmp(text, "<... ", 5) == 0) {
+            const char *rest = strstr(text, " resumed>");
+            size_t i = 0;
+            while (i < npending && pending[i].pid != pid) i++;
+            if (!rest || i == npending) {
+                vs->strace_unparsed++;
+                continue;
+            }
+            rest += 9;
+            char *joined = NULL;
+            if (asprintf(&joined, "%s%s", pending[i].text, rest) >= 0) {
+                strace_syscall(vs, pid, joined);
+                free(joined);
+            }
+            free(pending[i].text);
+            pending[i] = pending[--npending];
+            continue;
+        }
+        strace_syscall(vs, pid, text);
+    }
+    for (size_t i = 0; i < npending; i++) free(pending[i].text);
+    free(pending);
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+// ===== 归并 =====
+
+static struct verify_state *sort_state;
+
+static int vevent_cmp(const void *a, const void *b) {
+    const struct vevent *x = a, *y = b;
+    if (x->kind != y->kind) return x->kind - y->kind;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    int c = strcmp(key_of(sort_state, x), key_of(sort_state, y));
+    if (c != 0) return c;
+    return (x->pid > y->pid) - (x->pid < y->pid);
+}
+
+static int same_group(const struct verify_state *vs, const struct vevent *x, const struct vevent *y) {
+    return x->kind == y->kind && x->hash == y->hash && strcmp(key_of(vs, x), key_of(vs, y)) == 0;
+}
+
+// strace 看到而 hook 库注定看不到的：动态加载器在 hook 库初始化之前的文件访问，
+// 以及 hook 库自己的日志/缓存文件
+static int expected_miss(const struct verify_state *vs, const struct vevent *e) {
+    if (e->kind != VK_OPEN && e->kind != VK_ACCESS) return 0;
+    const char *path = key_of(vs, e);
+    size_t dlen = strlen(vs->session_dir);
+    if (strncmp(path, vs->session_dir, dlen) == 0 && path[dlen] == '/') return 1;
+    if (strncmp(path, "/proc/self/", 11) == 0) return 1;
+    if (strcmp(path, "/etc/ld.so.cache") == 0 || strcmp(path, "/etc/ld.so.preload") == 0) return 1;
+    const char *base = base_name(path);
+    size_t blen = strlen(base);
+    return (blen > 3 && strcmp(base + blen - 3, ".so") == 0) || strstr(base, ".so.") != NULL;
+}
+
+static void merge_group(struct verify_state *vs, struct vevent *p, size_t np,
+                        struct vevent *s, size_t ns) {
+    // 两边都按进程号有序
+    size_t i = 0, j = 0;
+    size_t orphan_p = 0, orphan_s = 0;   // 组内未配对的数量，结果先标为多余/遗漏
+    while (i < np || j < ns) {
+        pid_t pid = i < np && (j >= ns || p[i].pid <= s[j].pid) ? p[i].pid : s[j].pid;
+        size_t pi = i, sj = j;
+        while (i < np && p[i].pid == pid) i++;
+        while (j < ns && s[j].pid == pid) j++;
+        size_t pc = i - pi, sc = j - sj, m = pc < sc ? pc : sc;
+        for (size_t k = 0; k < m; k++) {
+            p[pi + k].result = VR_MATCHED;
+            s[sj + k].result = VR_MATCHED;
+        }
+        for (size_t k = m; k < pc; k++) {
+            p[pi + k].result = sc > 0 ? VR_DUP : VR_EXTRA;
+            if (sc == 0) orphan_p++;
+        }
+        for (size_t k = m; k < sc; k++) {
+            s[sj + k].result = VR_MISSED;
+            orphan_s++;
+        }
+    }
+    // 同一个键在 hook 库里记到了别的进程上
+    size_t pairs = orphan_p < orphan_s ? orphan_p : orphan_s;
+    for (size_t k = 0, a = 0, b = 0; k < pairs; k++) {
+        while (p[a].result != VR_EXTRA) a++;
+        while (s[b].result != VR_MISSED) b++;
+        p[a++].result = VR_MISATTR;
+        s[b++].result = VR_MISATTR;
+    }
+    for (size_t k = 0; k < ns; k++) {
+        if (s[k].result == VR_MISSED && expected_miss(vs, &s[k])) s[k].result = VR_EXPECTED;
+    }
+}
+
+static void merge(struct verify_state *vs) {
+    sort_state = vs;
+    qsort(vs->preload.items, vs->preload.count, sizeof(struct vevent), vevent_cmp);
+    qsort(vs->strace.items, vs->strace.count, sizeof(struct vevent), vevent_cmp);
+
+    struct vevent *p = vs->preload.items, *s = vs->strace.items;
+    size_t i = 0, j = 0;
+    while (i < vs->preload.count || j < vs->strace.count) {
+        // 取两边较小的组
+        struct vevent *head;
+        if (i == vs->preload.count) head = &s[j];
+        else if (j == vs->strace.count) head = &p[i];
+        else head = vevent_cmp(&p[i], &s[j]) <= 0 ? &p[i] : &s[j];
+        size_t pi = i, sj = j;
+        while (i < vs->preload.count && same_group(vs, &p[i], head)) i++;
+        while (j < vs->strace.count && same_group(vs, &s[j], head)) j++;
+        merge_group(vs, p + pi, i - pi, s + sj, j - sj);
+    }
+}
+
+// ===== 报告 =====
+
+struct verify_counts {
+    unsigned long kinds[VK_COUNT][VR_COUNT];
+    unsigned long hooks[VERIFY_MAX_HOOKS][VR_COUNT];
+};
+
+static void tally(const struct verify_state *vs, struct verify_counts *c) {
+    memset(c, 0, sizeof(*c));
+    for (size_t i = 0; i < vs->preload.count; i++) {
+        const struct vevent *e = &vs->preload.items[i];
+        c->kinds[e->kind][e->result]++;
+        c->hooks[e->hook][e->result]++;
+    }
+    // 两边配对的事件只按 hook 库一侧计数
+    for (size_t i = 0; i < vs->strace.count; i++) {
+        const struct vevent *e = &vs->strace.items[i];
+        if (e->result == VR_MISSED || e->result == VR_EXPECTED) c->kinds[e->kind][e->result]++;
+    }
+}
+
+// 每类列出几个遗漏的例子
+#define VERIFY_EXAMPLES 5
+
+static void write_report(FILE *out, const struct verify_state *vs, const struct verify_counts *c) {
+    fprintf(out, "hook 库事件 %zu 条, strace 事件 %zu 条(%lu 行, %lu 行无法解析)\n",
+            vs->preload.count, vs->strace.count, vs->strace_lines, vs->strace_unparsed);
+
+    fprintf(out, "\n%-8s", "类别");
+    for (int r = 0; r < VR_COUNT; r++) fprintf(out, " %10s", result_names[r]);
+    fputc('\n', out);
+    for (int k = 0; k < VK_COUNT; k++) {
+        fprintf(out, "%-8s", kind_names[k]);
+        for (int r = 0; r < VR_COUNT; r++) fprintf(out, " %10lu", c->kinds[k][r]);
+        fputc('\n', out);
+    }
+
+    fprintf(out, "\n%-14s", "hook");
+    for (int r = 0; r < VR_COUNT; r++) {
+        if (r != VR_MISSED && r != VR_EXPECTED) fprintf(out, " %10s", result_names[r]);
+    }
+    fputc('\n', out);
+    for (int h = 0; h < vs->nhooks; h++) {
+        fprintf(out, "%-14s", vs->hooks[h]);
+        for (int r = 0; r < VR_COUNT; r++) {
+            if (r != VR_MISSED && r != VR_EXPECTED) fprintf(out, " %10lu", c->hooks[h][r]);
+        }
+        fputc('\n', out);
+    }
+
+    for (int k = 0; k < VK_COUNT; k++) {
+        int shown = 0;
+        for (size_t i = 0; i < vs->strace.count && shown < VERIFY_EXAMPLES; i++) {
+            const struct vevent *e = &vs->strace.items[i];
+            if (e->kind != k || e->result != VR_MISSED) continue;
+            if (shown++ == 0) fprintf(out, "\n遗漏的 %s 事件(例):\n", kind_names[k]);
+            fprintf(out, "  pid=%d %s\n", e->pid, key_of(vs, e));
+        }
+    }
+
+    if (vs->nother > 0) {
+        fprintf(out, "\n未比较的系统调用:");
+        for (int i = 0; i < vs->nother; i++) fprintf(out, " %s=%lu", vs->other[i], vs->other_count[i]);
+        fputc('\n', out);
+    }
+}
+
+static int write_json(const char *path, const struct verify_state *vs, const struct verify_counts *c) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    fputs("{\"kinds\":{", out);
+    for (int k = 0; k < VK_COUNT; k++) {
+        fprintf(out, "%s\"%s\":{", k ? "," : "", kind_names[k]);
+        for (int r = 0; r < VR_COUNT; r++) fprintf(out, "%s\"%s\":%lu", r ? "," : "", result_keys[r], c->kinds[k][r]);
+        fputc('}', out);
+    }
+    fputs("},\"hooks\":{", out);
+    for (int h = 0; h < vs->nhooks; h++) {
+        if (h) fputc(',', out);
+        json_write_str(out, vs->hooks[h]);
+        fputs(":{", out);
+        for (int r = 0; r < VR_COUNT; r++) fprintf(out, "%s\"%s\":%lu", r ? "," : "", result_keys[r], c->hooks[h][r]);
+        fputc('}', out);
+    }
+    fputs("}}\n", out);
+    return fclose(out);
+}
+
+// 与基线比较：遗漏、重复、归属错误、多余任一类变多即视为退化
+static int check_baseline(const char *baseline, const struct verify_counts *c) {
+    FILE *f = fopen(baseline, "r");
+    if (!f) {
+        fprintf(stderr, "hooktrace: 无法读取基线 %s\n", baseline);
+        return 2;
+    }
+    char *text = NULL;
+    size_t cap = 0;
+    ssize_t n = getdelim(&text, &cap, '\0', f);
+    fclose(f);
+    struct json_value *v = n > 0 ? json_parse(text, (size_t)n) : NULL;
+    free(text);
+    const struct json_value *kinds = v ? json_get(v, "kinds") : NULL;
+    if (!kinds) {
+        fprintf(stderr, "hooktrace: 基线 %s 格式不对\n", baseline);
+        json_free(v);
+        return 2;
+    }
+
+    static const int gated[] = { VR_MISSED, VR_DUP, VR_MISATTR, VR_EXTRA };
+    int regressions = 0;
+    for (int k = 0; k < VK_COUNT; k++) {
+        const struct json_value *base = json_get(kinds, kind_names[k]);
+        for (size_t g = 0; g < sizeof(gated) / sizeof(gated[0]); g++) {
+            int r = gated[g];
+            long long before = base ? json_get_int(base, result_keys[r], 0) : 0;
+            if ((long long)c->kinds[k][r] > before) {
+                fprintf(stderr, "hooktrace: 退化 %s %s: %lld -> %lu\n", kind_names[k],
+                        result_names[r], before, c->kinds[k][r]);
+                regressions++;
+            }
+        }
+    }
+    json_free(v);
+    return regressions ? 1 : 0;
+}
+
+int verify_compare(const char *session_dir, const char *strace_log, const char *baseline) {
+    struct verify_state *vs = calloc(1, sizeof(*vs));
+    if (!vs) return 2;
+    vs->session_dir = session_dir;
+    vs->exclude_pid = session_root_pid(session_dir);
+
+    int rc = 2;
+    if (load_preload(vs) != 0) {
+        fprintf(stderr, "hooktrace: 无法读取会话目录 %s\n", session_dir);
+        goto out;
+    }
+    if (load_strace(vs, strace_log) != 0) {
+        fprintf(stderr, "hooktrace: 无法读取 strace 输出 %s\n", strace_log);
+        goto out;
+    }
+    merge(vs);
+
+    struct verify_counts *c = malloc(sizeof(*c));
+    if (!c) goto out;
+    tally(vs, c);
+    write_report(stdout, vs, c);
+    // 基线可能就是本会话目录里的 verify.json，先比较再覆盖
+    rc = baseline ? check_baseline(baseline, c) : 0;
+
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/verify.txt", session_dir);
+    FILE *txt = fopen(path, "w");
+    if (txt) {
+        write_report(txt, vs, c);
+        fclose(txt);
+    }
+    snprintf(path, sizeof(path), "%s/verify.json", session_dir);
+    if (write_json(path, vs, c) != 0) fprintf(stderr, "hooktrace: 无法写入 %s\n", path);
+
+    free(c);
+out:
+    free(vs->preload.items);
+    free(vs->strace.items);
+    free(vs->arena);
+    free(vs);
+    return rc;
+}
@@ -0,0 +1,16 @@
+/* verify.h
+ * hooktrace verify：同一次构建同时用 strace 和 hook 库追踪，比较两边的事件，
+ * 报告 hook 库遗漏、重复和记到别的进程上的事件，作为修改 tracer 时的正确性检查。
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <sys/types.h>
+
+// 比较会话目录中的进程日志和 strace -f 的输出，报告写到 stdout 和会话目录下的
+// verify.txt / verify.json。baseline 非 NULL 时与之前的 verify.json 比较，
+// 任一类别的遗漏/重复/归属错误/多余比基线多就返回 1；读取失败返回 2
+int verify_compare(const char *session_dir, const char *strace_log, const char *baseline);
+
+#endif
@@ -2,6 +2,12 @@
  * A dynamic library that hooks posix_spawn and execve to trace gcc internal stages
  * Compile with: gcc -shared -fPIC -o gcc_spawn_tracer.so gcc_spawn_tracer.c -ldl
  * Use with: LD_PRELOAD=./gcc_spawn_tracer.so your_build_command
+ *
+ * 日志位置：由 hooktrace 启动(设置了 HOOKTRACE_DIR)时，每个进程写会话目录下的
+ * gcc_trace.<pid>.log，并发构建之间互不干扰；否则使用 GCC_TRACE_LOG，默认 /tmp/gcc_trace.log
+ *
+ * 记录级别：hooktrace 设置了 HOOKTRACE_CTL 时映射会话的控制页，级别低于 exec 时不记录，
+ * hooktrace ctl 修改级别后已经在运行的进程立即生效。
  */
 
 #define _GNU_SOURCE
@@ -13,7 +19,10 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 extern char **environ;
 
@@ -26,8 +35,53 @@ static int (*real_posix_spawn)( pid_t *pid,
 
 static int (*real_execve)(const char *pathname, char *const argv[], char *const envp[]) = NULL;
 
+// 控制页，布局与 helloworld/hook_ctl.h 相同
+#define HOOK_CTL_MAGIC 0x4c435448u
+#define HOOK_CTL_VERSION 1
+#define HOOK_LEVEL_EXEC 2
+#define HOOK_LEVEL_FULL 3
+
+struct hook_ctl {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t level;
+    uint32_t changes;
+    uint64_t changed_ns;
+};
+
+static struct hook_ctl ctl_local = { .level = HOOK_LEVEL_FULL };
+static struct hook_ctl *ctl = &ctl_local;
+
+__attribute__((constructor))
+static void ctl_map(void) {
+    const char *file = getenv("HOOKTRACE_CTL");
+    if (!file || !*file) return;
+    int fd = open(file, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+    struct hook_ctl *p = mmap(NULL, sizeof(*p), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return;
+    if (p->magic != HOOK_CTL_MAGIC || p->version != HOOK_CTL_VERSION) {
+        munmap(p, sizeof(*p));
+        return;
+    }
+    ctl = p;
+}
+
+static const char *trace_log_path(char *buf, size_t size) {
+    const char *dir = getenv("HOOKTRACE_DIR");
+    if (dir && *dir) {
+        snprintf(buf, size, "%s/gcc_trace.%d.log", dir, getpid());
+        return buf;
+    }
+    const char *path = getenv("GCC_TRACE_LOG");
+    return (path && *path) ? path : "/tmp/gcc_trace.log";
+}
+
 static void log_spawn(const char *label, const char *path, char *const argv[]) {
-    FILE *logf = fopen("/tmp/gcc_trace.log", "a");
+    if (__atomic_load_n(&ctl->level, __ATOMIC_RELAXED) < HOOK_LEVEL_EXEC) return;
+    char path_buf[4096];
+    FILE *logf = fopen(trace_log_path(path_buf, sizeof(path_buf)), "a");
     if (!logf) return;
 
     time_t now = time(NULL);
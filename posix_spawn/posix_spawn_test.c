@@ -1,21 +1,435 @@
+/* posix_spawn_test.c
+ * 进程创建的微基准：测量 "创建 + exec + 回收" 一个子进程的延迟和吞吐，比较
+ *   fork+execve、vfork+execve、posix_spawn、posix_spawnp、clone3(CLONE_VFORK)+execve、system()
+ * 并发线程数从 1 逐级加倍到 -t N；-r MB 让父进程先占用并写过一块内存，放大 fork 复制页表的开销；
+ * -p LIB 在 LD_PRELOAD=LIB 下把同样的测试再跑一遍，逐项列出每次进程创建多花的时间。
+ *
+ * Compile with: gcc -O2 -pthread -o posix_test posix_spawn_test.c
+ * Use with: ./posix_test -t 8 -r 512 -p ../helloworld/syscall_hook_fixed.so,./gcc_spawn_tracer.so
+ */
+
+/* hook gcc 编译器： LD_PRELOAD=./gcc_spawn_tracer.so gcc -v -O2 -c posix_spawn_test.c > gcc_spawn_tracer.log 2>&1 */
+/* hook make 构建器： LD_PRELOAD=./gcc_spawn_tracer.so make */
+
+#define _GNU_SOURCE
 #include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <linux/sched.h>
 
 extern char **environ;
 
-int main() {
+enum spawn_method { M_FORK, M_VFORK, M_POSIX_SPAWN, M_POSIX_SPAWNP, M_CLONE3, M_SYSTEM, M_COUNT };
+
+static const char *const method_names[M_COUNT] = {
+    "fork", "vfork", "posix_spawn", "posix_spawnp", "clone3", "system",
+};
+
+#define MAX_THREADS 256
+#define MAX_RESULTS (M_COUNT * 16)
+
+struct bench_options {
+    int methods[M_COUNT];        // 要测的方式
+    int iterations;              // 每个线程每种方式的创建次数
+    int max_threads;
+    long rss_mb;                 // 父进程预先占用的内存
+    const char *program;         // 子进程执行的程序
+    int tsv;                     // 只输出制表符分隔的结果(-p 时由父进程解析)
+};
+
+struct bench_result {
+    int method;
+    int threads;
+    long ops;
+    long failures;
+    double throughput;           // 次/秒
+    double p50_us, p99_us, mean_us;
+};
+
+static struct bench_options opts;
+static char *child_argv[2];
+static char child_name[256];     // posix_spawnp/system 用的程序名
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ===== 各种创建方式：都是创建子进程、exec 目标程序、等它结束，成功返回 0 =====
+
+static int wait_child(pid_t pid) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static int spawn_fork(void) {
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        execve(opts.program, child_argv, environ);
+        _exit(127);
+    }
+    return wait_child(pid);
+}
+
+static int spawn_vfork(void) {
+    pid_t pid = vfork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        execve(opts.program, child_argv, environ);
+        _exit(127);
+    }
+    return wait_child(pid);
+}
+
+static int spawn_posix(void) {
+    pid_t pid;
+    if (posix_spawn(&pid, opts.program, NULL, NULL, child_argv, environ) != 0) return -1;
+    return wait_child(pid);
+}
+
+static int spawn_posixp(void) {
+    char *argv[] = { child_name, NULL };
+    pid_t pid;
+    if (posix_spawnp(&pid, child_name, NULL, NULL, argv, environ) != 0) return -1;
+    return wait_child(pid);
+}
+
+// clone3 直接走系统调用，不带 CLONE_VM：子进程在写时复制的地址空间里继续执行这段 C 代码，
+// 父进程像 vfork 一样挂起到子进程 exec 为止。带 CLONE_VM 需要给子进程单独的栈并用汇编接管，
+// glibc 的 posix_spawn 内部就是那条路径。
+// glibc 不导出 clone3，预加载库 hook 不到这一步；子进程改用 libc 的 execve，exec 的 hook 照常运行，
+// 所以 -p 对比时这一行包含 exec 的拦截开销，但不含 fork/vfork 那一侧的
+static int spawn_clone3(void) {
+    struct clone_args args;
+    memset(&args, 0, sizeof(args));
+    args.flags = CLONE_VFORK;
+    args.exit_signal = SIGCHLD;
+    long pid = syscall(SYS_clone3, &args, sizeof(args));
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        execve(opts.program, child_argv, environ);
+        _exit(127);
+    }
+    return wait_child((pid_t)pid);
+}
+
+// system() 额外包含启动 /bin/sh 的开销，sh 再 exec 目标程序
+static int spawn_system(void) {
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), "exec %s", opts.program);
+    int status = system(cmd);
+    return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static int (*const spawn_fns[M_COUNT])(void) = {
+    spawn_fork, spawn_vfork, spawn_posix, spawn_posixp, spawn_clone3, spawn_system,
+};
+
+// ===== 并发测量 =====
+
+struct worker {
+    pthread_t thread;
+    int method;
+    uint64_t *latency_ns;        // 每次创建的耗时
+    long failures;
+};
+
+static pthread_barrier_t start_barrier;
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    pthread_barrier_wait(&start_barrier);
+    for (int i = 0; i < opts.iterations; i++) {
+        uint64_t t0 = now_ns();
+        if (spawn_fns[w->method]() != 0) w->failures++;
+        w->latency_ns[i] = now_ns() - t0;
+    }
+    return NULL;
+}
+
+static int u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int run_one(int method, int threads, struct bench_result *res) {
+    struct worker workers[MAX_THREADS];
+    size_t total = (size_t)threads * (size_t)opts.iterations;
+    uint64_t *all = malloc(total * sizeof(uint64_t));
+    if (!all) return -1;
+
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)threads + 1);
+    for (int t = 0; t < threads; t++) {
+        workers[t].method = method;
+        workers[t].latency_ns = all + (size_t)t * (size_t)opts.iterations;
+        workers[t].failures = 0;
+        pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]);
+    }
+    pthread_barrier_wait(&start_barrier);
+    uint64_t t0 = now_ns();
+    long failures = 0;
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t].thread, NULL);
+        failures += workers[t].failures;
+    }
+    uint64_t wall = now_ns() - t0;
+    pthread_barrier_destroy(&start_barrier);
+
+    qsort(all, total, sizeof(uint64_t), u64_cmp);
+    double sum = 0;
+    for (size_t i = 0; i < total; i++) sum += (double)all[i];
+    res->method = method;
+    res->threads = threads;
+    res->ops = (long)total;
+    res->failures = failures;
+    res->throughput = wall ? (double)total * 1e9 / (double)wall : 0;
+    res->p50_us = (double)all[total / 2] / 1e3;
+    res->p99_us = (double)all[total * 99 / 100] / 1e3;
+    res->mean_us = sum / (double)total / 1e3;
+    free(all);
+    return 0;
+}
+
+// 依次测每种方式、每个并发级别(1, 2, 4 ... max_threads)
+static int run_suite(struct bench_result *results) {
+    int n = 0;
+    for (int m = 0; m < M_COUNT; m++) {
+        if (!opts.methods[m]) continue;
+        for (int t = 1;; t = t * 2 < opts.max_threads ? t * 2 : opts.max_threads) {
+            if (n < MAX_RESULTS && run_one(m, t, &results[n]) == 0) n++;
+            if (t == opts.max_threads) break;
+        }
+    }
+    return n;
+}
+
+// ===== 预加载对比：在 LD_PRELOAD=LIB 下重新运行自己(-q)，读回结果 =====
+
+static void print_tsv(FILE *out, const struct bench_result *r, int n) {
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "%s\t%d\t%ld\t%ld\t%.1f\t%.2f\t%.2f\t%.2f\n", method_names[r[i].method],
+                r[i].threads, r[i].ops, r[i].failures, r[i].throughput, r[i].p50_us, r[i].p99_us,
+                r[i].mean_us);
+    }
+}
+
+static int parse_tsv_line(const char *line, struct bench_result *r) {
+    char name[32];
+    if (sscanf(line, "%31s\t%d\t%ld\t%ld\t%lf\t%lf\t%lf\t%lf", name, &r->threads, &r->ops,
+               &r->failures, &r->throughput, &r->p50_us, &r->p99_us, &r->mean_us) != 8) {
+        return -1;
+    }
+    for (int m = 0; m < M_COUNT; m++) {
+        if (strcmp(name, method_names[m]) == 0) {
+            r->method = m;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int run_with_preload(char **self_argv, const char *lib, struct bench_result *results) {
+    // 环境里换掉/加上 LD_PRELOAD
+    int nenv = 0;
+    while (environ[nenv]) nenv++;
+    char **envp = calloc((size_t)nenv + 2, sizeof(char *));
+    char *preload = NULL;
+    if (!envp || asprintf(&preload, "LD_PRELOAD=%s", lib) < 0) {
+        free(envp);
+        return -1;
+    }
+    int k = 0;
+    for (int i = 0; i < nenv; i++) {
+        if (strncmp(environ[i], "LD_PRELOAD=", 11) != 0) envp[k++] = environ[i];
+    }
+    envp[k++] = preload;
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        free(preload);
+        free(envp);
+        return -1;
+    }
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&fa, fds[0]);
     pid_t pid;
-    char *argv[] = {"/bin/ls", "-l", NULL};
+    int err = posix_spawn(&pid, "/proc/self/exe", &fa, NULL, self_argv, envp);
+    posix_spawn_file_actions_destroy(&fa);
+    close(fds[1]);
+    free(preload);
+    free(envp);
+    if (err != 0) {
+        close(fds[0]);
+        fprintf(stderr, "无法在 LD_PRELOAD=%s 下运行: %s\n", lib, strerror(err));
+        return -1;
+    }
+
+    FILE *in = fdopen(fds[0], "r");
+    int n = 0;
+    char line[512];
+    while (in && fgets(line, sizeof(line), in)) {
+        if (n < MAX_RESULTS && parse_tsv_line(line, &results[n]) == 0) n++;
+    }
+    if (in) fclose(in);
+    int status;
+    waitpid(pid, &status, 0);
+    return n;
+}
 
-    if (posix_spawn(&pid, "/bin/ls", NULL, NULL, argv, environ) != 0) {
-        perror("posix_spawn failed");
-        return 1;
+static void print_results(const struct bench_result *r, int n) {
+    printf("%-13s %6s %8s %6s %12s %10s %10s %10s\n", "方式", "线程", "次数", "失败",
+           "吞吐(次/s)", "p50(us)", "p99(us)", "平均(us)");
+    for (int i = 0; i < n; i++) {
+        printf("%-13s %6d %8ld %6ld %12.1f %10.1f %10.1f %10.1f\n", method_names[r[i].method],
+               r[i].threads, r[i].ops, r[i].failures, r[i].throughput, r[i].p50_us, r[i].p99_us,
+               r[i].mean_us);
     }
+}
+
+static const struct bench_result *find_result(const struct bench_result *r, int n, int method, int threads) {
+    for (int i = 0; i < n; i++) {
+        if (r[i].method == method && r[i].threads == threads) return &r[i];
+    }
+    return NULL;
+}
+
+// 每次进程创建因拦截多花的时间(按中位数和平均值)，以及吞吐的变化
+static void print_overhead(const char *lib, const struct bench_result *base, int nbase,
+                           const struct bench_result *hooked, int nhooked) {
+    printf("\nLD_PRELOAD=%s 的开销:\n", lib);
+    printf("%-13s %6s %12s %12s %14s %12s\n", "方式", "线程", "p50(us)", "+p50(us)",
+           "+平均(us/次)", "吞吐变化");
+    for (int i = 0; i < nbase; i++) {
+        const struct bench_result *h = find_result(hooked, nhooked, base[i].method, base[i].threads);
+        if (!h) continue;
+        printf("%-13s %6d %12.1f %+12.1f %+14.1f %+11.1f%%\n", method_names[base[i].method],
+               base[i].threads, h->p50_us, h->p50_us - base[i].p50_us, h->mean_us - base[i].mean_us,
+               base[i].throughput > 0 ? (h->throughput / base[i].throughput - 1) * 100 : 0);
+    }
+    if (opts.methods[M_CLONE3]) {
+        printf("注: clone3 是直接的系统调用，不经过库的 fork/vfork hook，只含 execve hook 和子进程加载库的开销\n");
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "用法: %s [选项]\n"
+            "  -m LIST   创建方式，逗号分隔(默认全部): fork,vfork,posix_spawn,posix_spawnp,clone3,system\n"
+            "  -n N      每个线程每种方式创建 N 个进程(默认 200)\n"
+            "  -t N      并发线程从 1 加倍到 N(默认 1)\n"
+            "  -r MB     父进程先占用并写入 MB 兆内存(默认 0)\n"
+            "  -x PATH   子进程执行的程序(默认 /bin/true)\n"
+            "  -p LIBS   逗号分隔的预加载库，分别在 LD_PRELOAD 下重跑并对比\n",
+            prog);
+}
+
+// 在副本上切分：list 是 argv 里的字符串，-p 重跑时原样传给子进程
+static int parse_methods(const char *list) {
+    char *copy = strdup(list);
+    if (!copy) return -1;
+    memset(opts.methods, 0, sizeof(opts.methods));
+    int ret = 0;
+    for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        int m = 0;
+        while (m < M_COUNT && strcmp(tok, method_names[m]) != 0) m++;
+        if (m == M_COUNT) {
+            fprintf(stderr, "未知的创建方式: %s\n", tok);
+            ret = -1;
+            break;
+        }
+        opts.methods[m] = 1;
+    }
+    free(copy);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    for (int m = 0; m < M_COUNT; m++) opts.methods[m] = 1;
+    opts.iterations = 200;
+    opts.max_threads = 1;
+    opts.program = "/bin/true";
+
+    int c;
+    char *libs = NULL;
+    while ((c = getopt(argc, argv, "m:n:t:r:x:p:q")) != -1) {
+        switch (c) {
+        case 'm':
+            if (parse_methods(optarg) != 0) return 2;
+            break;
+        case 'n': opts.iterations = atoi(optarg); break;
+        case 't': opts.max_threads = atoi(optarg); break;
+        case 'r': opts.rss_mb = atol(optarg); break;
+        case 'x': opts.program = optarg; break;
+        case 'p': libs = optarg; break;
+        case 'q': opts.tsv = 1; break;   // 内部使用：-p 重跑时输出 TSV
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opts.iterations <= 0 || opts.max_threads <= 0 || opts.max_threads > MAX_THREADS) {
+        usage(argv[0]);
+        return 2;
+    }
+    child_argv[0] = (char *)opts.program;
+    const char *slash = strrchr(opts.program, '/');
+    snprintf(child_name, sizeof(child_name), "%s", slash ? slash + 1 : opts.program);
 
-    // 等待子进程结束
-    waitpid(pid, NULL, 0);
+    // 父进程的内存越大，fork 复制页表越慢；vfork/posix_spawn/clone3 不受影响
+    if (opts.rss_mb > 0) {
+        size_t size = (size_t)opts.rss_mb << 20;
+        char *ballast = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ballast == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        long page = sysconf(_SC_PAGESIZE);
+        for (size_t off = 0; off < size; off += (size_t)page) ballast[off] = 1;
+    }
+
+    static struct bench_result base[MAX_RESULTS];
+    int nbase = run_suite(base);
+    if (opts.tsv) {
+        print_tsv(stdout, base, nbase);
+        return 0;
+    }
+    printf("子进程: %s, 每线程 %d 次, 父进程预占内存 %ld MB\n\n", opts.program, opts.iterations,
+           opts.rss_mb);
+    print_results(base, nbase);
+
+    if (libs) {
+        // 重跑时带上同样的参数，再加 -q
+        char **self_argv = calloc((size_t)argc + 2, sizeof(char *));
+        if (!self_argv) return 1;
+        for (int i = 0; i < argc; i++) self_argv[i] = argv[i];
+        self_argv[argc] = "-q";
+        libs = strdup(libs);   // 同 parse_methods，不改动 argv
+        if (!libs) return 1;
+        for (char *lib = strtok(libs, ","); lib; lib = strtok(NULL, ",")) {
+            static struct bench_result hooked[MAX_RESULTS];
+            int nhooked = run_with_preload(self_argv, lib, hooked);
+            if (nhooked > 0) print_overhead(lib, base, nbase, hooked, nhooked);
+        }
+        free(libs);
+        free(self_argv);
+    }
     return 0;
 }